@@ -90,13 +90,132 @@ ipc_msgs_t ipcMsgs =
 
 volatile uint32_t callBackDone;
 
-void CM4_MessageCallback(uint32_t *msg __attribute__((unused)))
+/* Requests wait in a FIFO and go to the CM0+ back to back: each one is submitted when the previous one completes.
+   A slot keeps the outcome of its request until it is reused CORE_QUEUE_SIZE requests later. */
+#define CORE_QUEUE_SIZE		8		// A power of two
+
+typedef struct
+{
+	coreHandle_t			handle;
+	coreFunctions_e			function;
+	uint32_t				arg1;
+	uint32_t				arg2;
+	uint32_t				arg3;
+	coreCallback_t			callback;
+	void *					context;
+	coreRequestState_e		state;
+	coreStatus_t			status;
+} coreRequest_t;
+
+static coreRequest_t requests[CORE_QUEUE_SIZE];
+static coreHandle_t lastHandle;					// Last queued
+static volatile coreHandle_t runningHandle;		// Submitted to the CM0+, 0 when none
+
+static coreHandle_t nextHandle(coreHandle_t handle)
 {
+	return handle + 1 != 0 ? handle + 1 : 1;
 }
 
+static coreRequest_t * requestSlot(coreHandle_t handle)
+{
+	coreRequest_t * request = &requests[handle & (CORE_QUEUE_SIZE - 1)];
+	return handle != 0 && request->handle == handle ? request : NULL;
+}
+
+static void coreService(void);
+
+/* The pipe is free again, a request left queued on a busy pipe goes now */
 void CM4_ReleaseCallback(void)
 {
 	callBackDone = 1; 
+	coreService();
+}
+
+/* Hands the claimed function to the CM0+ without waiting for the IPC release, so it can run from the IPC interrupt;
+   outside the critical section, as the CM0+ may take a moment to get to sleep */
+static cy_en_ipc_pipe_status_t coreSubmit(void)
+{
+	callBackDone = 0;
+	while ((coreArguments.status.system.isSleeping) && ((CPUSS->CM0_STATUS & 3) == 0)) {}	// Check critical state as M0 should be asleep but isn't (yet)
+	return Cy_IPC_Pipe_SendMessage(CY_IPC_EP_CYPIPE_CM0_ADDR, CY_IPC_EP_CYPIPE_CM4_ADDR, (void *) &ipcMsgs.forCM0, CM4_ReleaseCallback);
+}
+
+/* Takes the outcome of a request from the core status, before the next request changes it */
+static void requestDone(coreRequest_t * request)
+{
+	request->status = coreArguments.status;
+	request->state = coreRequest_Done;
+}
+
+static void requestCallback(coreRequest_t * request)
+{
+	if (request->callback != NULL) request->callback(request->handle, request->status, request->context);
+}
+
+/* Completes the running request once the core is no longer busy and submits the next one,
+   from the IPC interrupt or from a thread that waits or polls */
+static void coreService(void)
+{
+	for (;;)
+	{
+		uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+		coreRequest_t * done = NULL;
+		coreRequest_t * next = NULL;
+		if (runningHandle != 0 && !coreArguments.status.system.isBusy)
+		{
+			done = requestSlot(runningHandle);
+			if (done != NULL) requestDone(done);
+			next = requestSlot(nextHandle(runningHandle));
+			runningHandle = 0;
+		}
+		else if (runningHandle == 0 && lastHandle != 0 && !coreArguments.status.system.isBusy)
+		{
+			/* Nothing running: the oldest queued request, if any, follows the last completed one */
+			for (coreHandle_t handle = nextHandle(lastHandle - CORE_QUEUE_SIZE); ; handle = nextHandle(handle))
+			{
+				coreRequest_t * request = requestSlot(handle);
+				if (request != NULL && request->state == coreRequest_Queued) { next = request; break; }
+				if (handle == lastHandle) break;
+			}
+		}
+		if (next != NULL && next->state == coreRequest_Queued)
+		{
+			/* Claimed: busy, so a completion check meanwhile leaves it alone until it is sent */
+			coreArguments.function = next->function;
+			coreArguments.arg1 = next->arg1;
+			coreArguments.arg2 = next->arg2;
+			coreArguments.arg3 = next->arg3;
+			coreArguments.status.system.isBusy = true;
+			next->state = coreRequest_Running;
+			runningHandle = next->handle;
+		}
+		else next = NULL;
+		Cy_SysLib_ExitCriticalSection(interruptState);
+		cy_en_ipc_pipe_status_t pipeStatus = next != NULL ? coreSubmit() : CY_IPC_PIPE_SUCCESS;
+		if (pipeStatus != CY_IPC_PIPE_SUCCESS)
+		{
+			interruptState = Cy_SysLib_EnterCriticalSection();
+			coreArguments.status.system.isBusy = false;							// Nothing was started
+			runningHandle = 0;
+			if (pipeStatus == CY_IPC_PIPE_ERROR_SEND_BUSY) next->state = coreRequest_Queued;	// Retried at the pipe release or the next poll
+			else
+			{
+				coreArguments.status.system.errorStatus = system_IPCError;		// IPC failed, reported in its status
+				requestDone(next);
+			}
+			Cy_SysLib_ExitCriticalSection(interruptState);
+		}
+		if (done != NULL) requestCallback(done);
+		if (pipeStatus == CY_IPC_PIPE_ERROR_SEND_BUSY) return;
+		if (pipeStatus != CY_IPC_PIPE_SUCCESS) requestCallback(next);
+		else if (done == NULL) return;
+	}
+}
+
+/* The CM0+ messages the CM4 when it finishes a function (this is what wakes the M4_Wait modes) */
+void CM4_MessageCallback(uint32_t *msg __attribute__((unused)))
+{
+	coreService();
 }
 
 coreStatus_t coreComm(coreFunctions_e function, WaitMode_e waitMode)
@@ -110,7 +229,11 @@ coreStatus_t coreComm(coreFunctions_e function, WaitMode_e waitMode)
 		callBackDone = 0;
 		while ((coreArguments.status.system.isSleeping) && ((CPUSS->CM0_STATUS & 3) == 0)) {}															// Check critical state as M0 should be asleep but isn't (yet)
 		pipeStatus = Cy_IPC_Pipe_SendMessage(CY_IPC_EP_CYPIPE_CM0_ADDR, CY_IPC_EP_CYPIPE_CM4_ADDR, (void *) &ipcMsgs.forCM0, CM4_ReleaseCallback);
-		if (pipeStatus != CY_IPC_PIPE_SUCCESS) systemError = system_IPCError;
+		if (pipeStatus != CY_IPC_PIPE_SUCCESS)
+		{
+			systemError = system_IPCError;
+			coreArguments.status.system.isBusy = false;							// Nothing was started
+		}
 		else
 		{
 			while (!callBackDone) {}													// Wait till IPC call is finalized. If the Onethinx core 'hangs' at this point, make sure the global interrupts are enabled: __enable_irq();
@@ -135,6 +258,58 @@ coreStatus_t coreComm(coreFunctions_e function, WaitMode_e waitMode)
 	return coreArguments.status;
 }
 
+/* Queues a function with its arguments, 0 with system_BusyError when the queue is full */
+static coreHandle_t coreQueue(coreFunctions_e function, uint32_t arg1, uint32_t arg2, uint32_t arg3, coreCallback_t callback, void * context)
+{
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	coreHandle_t handle = nextHandle(lastHandle);
+	coreRequest_t * request = &requests[handle & (CORE_QUEUE_SIZE - 1)];
+	bool full = request->handle != 0 && request->state != coreRequest_Done;
+	if (!full)
+	{
+		request->handle = handle;
+		request->function = function;
+		request->arg1 = arg1;
+		request->arg2 = arg2;
+		request->arg3 = arg3;
+		request->callback = callback;
+		request->context = context;
+		request->state = coreRequest_Queued;
+		lastHandle = handle;
+	}
+	Cy_SysLib_ExitCriticalSection(interruptState);
+	if (full)
+	{
+		coreArguments.status.system.errorStatus = system_BusyError;
+		return 0;
+	}
+	coreService();
+	return handle;
+}
+
+/* Waits for a queued function the way the wait mode says, the status is the one of that function;
+   system_UndefinedError for a handle that is not (or no longer) in the queue: the handle is a sequence
+   number, its slot answers only while it holds that request */
+static coreStatus_t coreWait(coreHandle_t handle, WaitMode_e waitMode)
+{
+	if (handle == 0) return coreArguments.status;
+	if (waitMode == M4_NoWait) return coreArguments.status;
+	coreStatus_t status;
+	for (coreRequestState_e state; (state = LoRaWAN_GetRequest(handle, &status)) != coreRequest_Done; )
+	{
+		if (state != coreRequest_Queued && state != coreRequest_Running)
+		{
+			status = coreArguments.status;
+			status.system.errorStatus = system_UndefinedError;
+			return status;
+		}
+		if (waitMode == M4_WaitSleep) Cy_SysPm_Sleep(CY_SYSPM_WAIT_FOR_INTERRUPT);		// The completion message wakes the CM4
+		else if (waitMode == M4_WaitDeepSleep) Cy_SysPm_DeepSleep(CY_SYSPM_WAIT_FOR_INTERRUPT);
+		waitMode = M4_WaitActive;														// Once, as a wake-up may come before the end
+	}
+	return status;
+}
+
 /****************************************************************************
 *			Public Functions
 *****************************************************************************/
@@ -156,8 +331,13 @@ coreStatus_t LoRaWAN_Init(coreConfiguration_t * coreConfigurationPtr)
 	return coreArguments.status;
 }
 
+/* Also drops the queued requests, without calling back */
 coreStatus_t LoRaWAN_Reset(void)
 {
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	memset(requests, 0, sizeof(requests));
+	runningHandle = 0;
+	Cy_SysLib_ExitCriticalSection(interruptState);
 	/* Force current function to quit */
 	coreArguments.status.system.breakCurrentFunction = true;
 	coreArguments.status.system.isBusy = false;
@@ -166,35 +346,27 @@ coreStatus_t LoRaWAN_Reset(void)
 
 coreStatus_t LoRaWAN_Join(WaitMode_e waitMode)
 {
-	return coreComm(coreFunction_LW_join, waitMode);
+	return coreWait(coreQueue(coreFunction_LW_join, 0, 0, 0, NULL, NULL), waitMode);
 }
 
 coreStatus_t LoRaWAN_GetInfo(coreInfo_t * coreInfo)
 {
-	coreArguments.arg1 = (uint32_t) coreInfo;
-	return coreComm(coreFunction_GetInfo, M4_WaitActive);
+	return coreWait(coreQueue(coreFunction_GetInfo, (uint32_t) coreInfo, 0, 0, NULL, NULL), M4_WaitActive);
 }
 
 coreStatus_t LoRaWAN_Send(uint8_t * bufferPtr, uint8_t length, WaitMode_e waitMode)
 {
-	coreArguments.arg1 = (uint32_t) bufferPtr;
-	coreArguments.arg2 = length;
-	return coreComm(coreFunction_LW_send, waitMode);
+	return coreWait(coreQueue(coreFunction_LW_send, (uint32_t) bufferPtr, length, 0, NULL, NULL), waitMode);
 }
 
 coreStatus_t LoRaWAN_SendMac(uint8_t* bufferPtr, uint8_t length, WaitMode_e waitMode, MACcmd_e MACcmd)
 {
-	coreArguments.arg1 = (uint32_t) bufferPtr;
-	coreArguments.arg2 = length;
-	coreArguments.arg3 = MACcmd;
-	return coreComm(coreFunction_LW_sendMac, waitMode);
+	return coreWait(coreQueue(coreFunction_LW_sendMac, (uint32_t) bufferPtr, length, MACcmd, NULL, NULL), waitMode);
 }
 
 coreStatus_t LoRaWAN_GetRXdata(uint8_t * RXdata, uint8_t length)
 {
-	coreArguments.arg1 = (uint32_t) RXdata;
-	coreArguments.arg2 = length;
-	return coreComm(coreFunction_LW_getRXdata, M4_WaitActive);
+	return coreWait(coreQueue(coreFunction_LW_getRXdata, (uint32_t) RXdata, length, 0, NULL, NULL), M4_WaitActive);
 }
 
 coreStatus_t LoRaWAN_GetStatus()
@@ -212,49 +384,109 @@ errorStatus_t LoRaWAN_GetError()
 	return errorStatus;
 }
 
+/* Queued behind the pending requests, the CM4 sleeps once the sleep is submitted */
 coreStatus_t LoRaWAN_Sleep(sleepConfig_t * sleepConfig)
 {																						// Debugging will halt here as SWD pins are put in High-Z mode
-	coreArguments.arg1 = (uint32_t) sleepConfig;
-	coreComm(coreFunction_LW_sleep, M4_NoWait);
-	if (coreArguments.status.system.errorStatus != system_OK) return coreArguments.status;
+	coreStatus_t status;
+	coreHandle_t handle = coreQueue(coreFunction_LW_sleep, (uint32_t) sleepConfig, 0, 0, NULL, NULL);
+	if (handle == 0) return coreArguments.status;
+	while (LoRaWAN_GetRequest(handle, &status) == coreRequest_Queued) {}				// Earlier requests first
+	if (LoRaWAN_GetRequest(handle, &status) == coreRequest_Done && status.system.errorStatus != system_OK) return status;
 	if (sleepConfig->sleepMode >= modeHibernate)	
 		while(1);																		// CM0+ will put system in hibernate and system will restart with a reset
- 	//while (!callBackDone) {}															// Wait till IPC call is finalized
 	if (sleepConfig->sleepMode == modeDeepSleep)
 		Cy_SysPm_DeepSleep(CY_SYSPM_WAIT_FOR_INTERRUPT);								// Wait till M0+ generates interrupt to wake
 	else if (sleepConfig->sleepMode == modeSleep)
 		Cy_SysPm_Sleep(CY_SYSPM_WAIT_FOR_INTERRUPT);
 
-	while (coreArguments.status.system.isBusy) {}										// Wait till M0+ ready
-	return coreArguments.status;
+	return coreWait(handle, M4_WaitActive);												// Wait till M0+ ready
 }
 
 coreStatus_t LoRaWAN_SetDateTime(dateTime_t* dt)
 {
-	coreArguments.arg1 = (uint32_t) dt;
-	return coreComm(coreFunction_LW_setDateTime, M4_WaitActive);
+	return coreWait(coreQueue(coreFunction_LW_setDateTime, (uint32_t) dt, 0, 0, NULL, NULL), M4_WaitActive);
 }
 
 coreStatus_t LoRaWAN_GetDateTime(dateTime_t* dt)
 {
-	coreArguments.arg1 = (uint32_t) dt;
-	return coreComm(coreFunction_LW_getDateTime, M4_WaitActive);
+	return coreWait(coreQueue(coreFunction_LW_getDateTime, (uint32_t) dt, 0, 0, NULL, NULL), M4_WaitActive);
 }
 
 coreStatus_t LoRaWAN_FlashRead(uint8_t* buffer, uint8_t block, uint8_t length)
 {
-	coreArguments.arg1 = (uint32_t) buffer;
-	coreArguments.arg2 = block;
-	coreArguments.arg3 = length;
-	return coreComm(coreFunction_LW_flashRead, M4_WaitActive);
+	return coreWait(coreQueue(coreFunction_LW_flashRead, (uint32_t) buffer, block, length, NULL, NULL), M4_WaitActive);
 }
 
 coreStatus_t LoRaWAN_FlashWrite(uint8_t* buffer, uint8_t block, uint8_t length)
 {
-	coreArguments.arg1 = (uint32_t) buffer;
-	coreArguments.arg2 = block;
-	coreArguments.arg3 = length;
-	return coreComm(coreFunction_LW_flashWrite, M4_WaitActive);
+	return coreWait(coreQueue(coreFunction_LW_flashWrite, (uint32_t) buffer, block, length, NULL, NULL), M4_WaitActive);
+}
+
+coreHandle_t LoRaWAN_JoinAsync(coreCallback_t callback, void * context)
+{
+	return coreQueue(coreFunction_LW_join, 0, 0, 0, callback, context);
+}
+
+coreHandle_t LoRaWAN_SendAsync(uint8_t * bufferPtr, uint8_t length, coreCallback_t callback, void * context)
+{
+	return coreQueue(coreFunction_LW_send, (uint32_t) bufferPtr, length, 0, callback, context);	// Buffer must stay valid until the callback
+}
+
+coreHandle_t LoRaWAN_GetRXdataAsync(uint8_t * RXdata, uint8_t length, coreCallback_t callback, void * context)
+{
+	return coreQueue(coreFunction_LW_getRXdata, (uint32_t) RXdata, length, 0, callback, context);
+}
+
+coreHandle_t LoRaWAN_SetDateTimeAsync(dateTime_t* dt, coreCallback_t callback, void * context)
+{
+	return coreQueue(coreFunction_LW_setDateTime, (uint32_t) dt, 0, 0, callback, context);
+}
+
+coreHandle_t LoRaWAN_GetDateTimeAsync(dateTime_t* dt, coreCallback_t callback, void * context)
+{
+	return coreQueue(coreFunction_LW_getDateTime, (uint32_t) dt, 0, 0, callback, context);
+}
+
+coreHandle_t LoRaWAN_FlashReadAsync(uint8_t* buffer, uint8_t block, uint8_t length, coreCallback_t callback, void * context)
+{
+	return coreQueue(coreFunction_LW_flashRead, (uint32_t) buffer, block, length, callback, context);
+}
+
+coreHandle_t LoRaWAN_FlashWriteAsync(uint8_t* buffer, uint8_t block, uint8_t length, coreCallback_t callback, void * context)
+{
+	return coreQueue(coreFunction_LW_flashWrite, (uint32_t) buffer, block, length, callback, context);
+}
+
+/* Requests the sleep from the core and returns, the caller enters its own (deep) sleep once the request runs;
+   the callback runs after the wake-up */
+coreHandle_t LoRaWAN_SleepAsync(sleepConfig_t * sleepConfig, coreCallback_t callback, void * context)
+{
+	coreHandle_t handle = coreQueue(coreFunction_LW_sleep, (uint32_t) sleepConfig, 0, 0, callback, context);
+	if (handle != 0 && sleepConfig->sleepMode >= modeHibernate)
+	{
+		while (LoRaWAN_GetRequest(handle, NULL) == coreRequest_Queued) {}
+		while(1);																		// CM0+ will put system in hibernate and system will restart with a reset
+	}
+	return handle;
+}
+
+/* State and, once done, the outcome of a request; coreRequest_Unknown when its slot was reused */
+coreRequestState_e LoRaWAN_GetRequest(coreHandle_t handle, coreStatus_t * status)
+{
+	coreService();																		// In case the completion message was missed
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	coreRequest_t * request = requestSlot(handle);
+	coreRequestState_e state = request != NULL ? request->state : coreRequest_Unknown;
+	if (state == coreRequest_Done && status != NULL) *status = request->status;
+	Cy_SysLib_ExitCriticalSection(interruptState);
+	return state;
+}
+
+/* True when the request finished (or is no longer known) */
+bool LoRaWAN_IsDone(coreHandle_t handle)
+{
+	coreRequestState_e state = LoRaWAN_GetRequest(handle, NULL);
+	return state == coreRequest_Done || state == coreRequest_Unknown;
 }
 
 /* [] END OF FILE */
\ No newline at end of file
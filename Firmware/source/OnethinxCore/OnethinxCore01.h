@@ -505,6 +505,20 @@ typedef struct  __attribute__ ((__packed__))
 	char			codeName[16];							/**< core firmware code name */
 } coreInfo_t;
 	
+/* Requests to the core are queued (8 deep) and run one after the other, a request made while the core is busy
+   waits its turn instead of failing with system_BusyError; only a full queue refuses it with that error.
+   Asynchronous calls return at once with a handle (0 when refused, see LoRaWAN_GetError), the callback runs
+   from the IPC interrupt when the core finishes the request, keep it short */
+typedef uint32_t coreHandle_t;
+typedef void (*coreCallback_t)(coreHandle_t handle, coreStatus_t status, void* context);
+
+typedef enum  {
+	coreRequest_Unknown			= 0x0,			//!< Never queued or its slot was reused
+	coreRequest_Queued			= 0x1,			//!< Waiting for the requests before it
+	coreRequest_Running			= 0x2,			//!< Submitted to the core
+	coreRequest_Done			= 0x3,			//!< Finished, its status is available
+} coreRequestState_e;
+
 coreStatus_t				LoRaWAN_Reset(void);
 coreStatus_t		 		LoRaWAN_Init(coreConfiguration_t * coreConfigurationPtr);
 coreStatus_t				LoRaWAN_GetInfo(coreInfo_t * coreInfo);
@@ -519,5 +533,15 @@ coreStatus_t 				LoRaWAN_SendMac(uint8_t* buffer, uint8_t length, WaitMode_e wai
 coreStatus_t 				LoRaWAN_Sleep(sleepConfig_t * sleepConfig);
 coreStatus_t 				LoRaWAN_GetStatus();
 errorStatus_t 				LoRaWAN_GetError();
+coreHandle_t				LoRaWAN_JoinAsync(coreCallback_t callback, void* context);
+coreHandle_t				LoRaWAN_SendAsync(uint8_t* buffer, uint8_t length, coreCallback_t callback, void* context);
+coreHandle_t				LoRaWAN_SleepAsync(sleepConfig_t * sleepConfig, coreCallback_t callback, void* context);
+coreHandle_t				LoRaWAN_GetRXdataAsync(uint8_t * RXdata, uint8_t length, coreCallback_t callback, void* context);
+coreHandle_t				LoRaWAN_SetDateTimeAsync(dateTime_t* dt, coreCallback_t callback, void* context);
+coreHandle_t				LoRaWAN_GetDateTimeAsync(dateTime_t* dt, coreCallback_t callback, void* context);
+coreHandle_t				LoRaWAN_FlashReadAsync(uint8_t* buffer, uint8_t block, uint8_t length, coreCallback_t callback, void* context);
+coreHandle_t				LoRaWAN_FlashWriteAsync(uint8_t* buffer, uint8_t block, uint8_t length, coreCallback_t callback, void* context);
+coreRequestState_e			LoRaWAN_GetRequest(coreHandle_t handle, coreStatus_t * status);
+bool						LoRaWAN_IsDone(coreHandle_t handle);
 
 #endif /* ONETHINXCORE01_H */
\ No newline at end of file
@@ -0,0 +1,225 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC processing: filter, decimation and window statistics on the ADC stream
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#define ARM_MATH_CM4
+#include "arm_math.h"
+#include "adcdsp.h"
+#include <string.h>
+
+/* 10 tap moving average, 1 kHz stream decimated to 100 Hz, 32 outputs per window */
+static adcDspConfig_t config =
+{
+	.filter = adcFilter_FIR,
+	.length = 10,
+	.decimation = 10,
+	.window = 32,
+	.coeffs = { 3277, 3277, 3277, 3277, 3277, 3277, 3277, 3277, 3277, 3277 },
+};
+
+static q15_t coeffs[ADCDSP_MAX_COEFFS] __attribute__ ((aligned(4)));	// FIR taps oldest sample first, or the biquad stages
+static q15_t firState[ADCDSP_MAX_COEFFS] __attribute__ ((aligned(4)));	// Oldest sample first
+static q31_t biquadState[ADCDSP_MAX_STAGES][2];							// Packed (x[n-1], x[n-2]) and (y[n-1], y[n-2])
+static q31_t biquadResidual[ADCDSP_MAX_STAGES];							// Bits dropped from the last output
+static uint16_t phase;
+static uint32_t streamRate;
+static adcStream_t output __attribute__ ((aligned(4))) = ADCSTREAM_RING_INIT;
+
+static struct
+{
+	q15_t		min, max;
+	q63_t		sum, sumSquares;
+	uint16_t	count;
+} running;
+static adcStats_t stats;
+static volatile uint32_t windows;
+static void (*windowNotify)(void);
+
+/* Loads the working coefficients and clears the filter state, the caller keeps the ISR out */
+static void Load(void)
+{
+	if (config.filter == adcFilter_FIR)
+		for (uint8_t i = 0; i < config.length; i++) coeffs[i] = config.coeffs[config.length - 1 - i];
+	else
+		memcpy(coeffs, config.coeffs, sizeof(coeffs));
+	memset(firState, 0, sizeof(firState));
+	memset(biquadState, 0, sizeof(biquadState));
+	memset(biquadResidual, 0, sizeof(biquadResidual));
+	memset(&running, 0, sizeof(running));
+	memset(&stats, 0, sizeof(stats));
+	stats.windows = windows;
+	phase = 0;
+}
+
+bool AdcDsp_Configure(const adcDspConfig_t* newConfig)
+{
+	if (newConfig->decimation == 0 || newConfig->window == 0) return false;
+	switch (newConfig->filter)
+	{
+		case adcFilter_None: break;
+		case adcFilter_FIR: if (newConfig->length == 0 || newConfig->length > ADCDSP_MAX_COEFFS || (newConfig->length & 1)) return false; break;
+		case adcFilter_Biquad: if (newConfig->length == 0 || newConfig->length > ADCDSP_MAX_STAGES || newConfig->postShift < 0 || newConfig->postShift > 14) return false; break;
+		default: return false;
+	}
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	config = *newConfig;
+	AdcDsp_Reset(streamRate);
+	Cy_SysLib_ExitCriticalSection(interruptState);
+	return true;
+}
+
+void AdcDsp_GetConfig(adcDspConfig_t* copy)
+{
+	*copy = config;
+}
+
+/* Restarts filtering and statistics for a stream at rate (Hz), 0 when stopped */
+void AdcDsp_Reset(uint32_t rate)
+{
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	Load();
+	streamRate = rate;
+	output.rate = rate / config.decimation;
+	Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+/* FIR output on the delay line, two taps per SMLALD */
+static q15_t FirOutput(void)
+{
+	q15_t* state = firState;
+	q15_t* taps = coeffs;
+	q63_t acc = 0;
+	for (uint8_t i = 0; i < config.length; i += 2)
+		acc = __SMLALD(*__SIMD32(state)++, *__SIMD32(taps)++, acc);
+	return (q15_t) __SSAT((q31_t) (acc >> 15), 16);
+}
+
+/* Direct form I biquad cascade, one stage takes a multiply and two SMLALDs */
+static q15_t Biquad(q15_t x)
+{
+	q15_t* stage = coeffs;
+	for (uint8_t i = 0; i < config.length; i++, stage += 6)
+	{
+		q63_t acc = ((q31_t) stage[0] * x) + biquadResidual[i];
+		acc = __SMLALD(*__SIMD32_CONST(stage + 2), biquadState[i][0], acc);
+		acc = __SMLALD(*__SIMD32_CONST(stage + 4), biquadState[i][1], acc);
+		q31_t wide = (q31_t) (acc >> (15 - config.postShift));
+		biquadResidual[i] = (q31_t) (acc - ((q63_t) wide << (15 - config.postShift)));	// Error feedback, truncation alone biases low cutoffs
+		q15_t y = (q15_t) __SSAT(wide, 16);
+		biquadState[i][0] = __PKHBT(x, biquadState[i][0], 16);
+		biquadState[i][1] = __PKHBT(y, biquadState[i][1], 16);
+		x = y;
+	}
+	return x;
+}
+
+static uint16_t Sqrt32(uint32_t value)
+{
+	uint32_t root = 0;
+	for (uint32_t bit = 1UL << 30; bit; bit >>= 2)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else root >>= 1;
+	}
+	return (uint16_t) root;
+}
+
+static void Accumulate(q15_t y, uint32_t timestamp)
+{
+	if (running.count == 0) running.min = running.max = y;
+	else if (y < running.min) running.min = y;
+	else if (y > running.max) running.max = y;
+	running.sum += y;
+	running.sumSquares += (q31_t) y * y;
+	if (++running.count < config.window) return;
+
+	q63_t count = running.count;
+	stats.windows = windows + 1;
+	stats.timestamp = timestamp;
+	stats.count = running.count;
+	stats.min = running.min;
+	stats.max = running.max;
+	stats.mean = (q15_t) ((2 * running.sum + (running.sum < 0 ? -count : count)) / (2 * count));
+	stats.rms = Sqrt32((uint32_t) ((running.sumSquares + count / 2) / count));
+	memset(&running, 0, sizeof(running));
+	windows = stats.windows;
+	if (windowNotify != NULL) windowNotify();
+}
+
+/* Called by the stream ISR for every sample */
+void AdcDsp_Process(const adcSample_t* sample)
+{
+	q15_t x = sample->millivolts;
+	if (config.filter == adcFilter_Biquad) x = Biquad(x);
+	else if (config.filter == adcFilter_FIR)
+	{
+		memmove(&firState[0], &firState[1], (config.length - 1) * sizeof(q15_t));
+		firState[config.length - 1] = x;
+	}
+	if (++phase < config.decimation) return;
+	phase = 0;
+	if (config.filter == adcFilter_FIR) x = FirOutput();
+
+	adcSample_t filtered = { .timestamp = sample->timestamp, .millivolts = x, .counts = sample->counts };
+	AdcStream_Put(&output, &filtered);
+	Accumulate(x, sample->timestamp);
+}
+
+/* Copies the statistics of the last completed window, windows is 0 before the first one */
+void AdcDsp_GetStats(adcStats_t* copy)
+{
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	*copy = stats;
+	Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+/* Sets a function the stream ISR calls when a window completes, NULL for none */
+void AdcDsp_SetNotify(void (*notify)(void))
+{
+	windowNotify = notify;
+}
+
+void AdcDsp_GetOutputInfo(adcStreamInfo_t* info)
+{
+	AdcStream_RingInfo(&output, info);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,97 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC processing: filter, decimation and window statistics on the ADC stream
+ *
+ * Every stream sample (millivolts, handled as Q15) passes a FIR or biquad
+ * cascade filter, every decimation-th filtered sample goes into the output
+ * ring and into running min/max/mean/RMS. A completed window of output samples
+ * is published as statistics, so the host and the uplink can take a few bytes
+ * per window instead of the raw samples.
+ *
+ * The filters use the Cortex-M4 dual 16-bit MAC instructions on the CMSIS-DSP
+ * types and coefficient layouts of arm_math.h:
+ *   FIR		coeffs[0..length-1] = b[0]..b[length-1] in Q15, b[0] on the
+ *				newest sample, length even
+ *   Biquad	{ b0, 0, b1, b2, a1, a2 } per stage in Q(15 - postShift), the
+ *				arm_biquad_cascade_df1_q15 layout (a1, a2 with inverted sign)
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "adcstream.h"
+
+#define ADCDSP_MAX_COEFFS			32		// FIR taps, or 6 per biquad stage
+#define ADCDSP_MAX_STAGES			(ADCDSP_MAX_COEFFS / 6)
+
+typedef enum __attribute__ ((__packed__))
+{
+	adcFilter_None			= 0x00,
+	adcFilter_FIR			= 0x01,
+	adcFilter_Biquad		= 0x02,
+} adcFilter_e;
+
+/* Processing configuration, read and written with CMD_ADCDSP */
+typedef struct __attribute__ ((__packed__))
+{
+	adcFilter_e	filter;
+	uint8_t		length;						// FIR taps or biquad stages
+	int8_t		postShift;					// Biquad coefficient scaling
+	uint8_t		reserved;
+	uint16_t	decimation;					// Filtered samples per output sample
+	uint16_t	window;						// Output samples per statistics window
+	int16_t		coeffs[ADCDSP_MAX_COEFFS];
+} adcDspConfig_t;
+
+/* Statistics of the last completed window, read with CMD_ADCSTATS */
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	windows;					// Windows completed since boot
+	uint32_t	timestamp;					// Stream timestamp of the last sample in the window
+	uint16_t	count;						// Output samples in the window
+	int16_t		min;						// Millivolts
+	int16_t		max;
+	int16_t		mean;
+	uint16_t	rms;
+	uint16_t	reserved;
+} adcStats_t;
+
+bool		AdcDsp_Configure(const adcDspConfig_t* config);
+void		AdcDsp_GetConfig(adcDspConfig_t* config);
+void		AdcDsp_Reset(uint32_t rate);
+void		AdcDsp_Process(const adcSample_t* sample);
+void		AdcDsp_GetStats(adcStats_t* stats);
+void		AdcDsp_SetNotify(void (*notify)(void));
+void		AdcDsp_GetOutputInfo(adcStreamInfo_t* info);
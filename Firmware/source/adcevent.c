@@ -0,0 +1,194 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC events: threshold triggered sampling on the SAR range detection
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#include "adcevent.h"
+
+typedef enum
+{
+	eventArmed,								// Range interrupt enabled
+	eventCapturing,							// Triggered, waiting for the post-trigger samples
+	eventHoldoff,							// Captured, waiting to re-arm
+} eventState_e;
+
+static adcEventConfig_t eventConfig =
+{
+	.condition = adcEvent_Off,
+	.pre = 4,
+	.post = 12,
+	.low = 0,
+	.high = ADC_CFG0_VREF_MV_VALUE,
+	.holdoff = 100,
+};
+static int16_t lowCounts, highCounts;
+static volatile eventState_e state;
+static uint32_t triggerHead, rearmHead;
+static adcEvent_t queue[ADCEVENT_QUEUE_SIZE];
+static volatile uint32_t queueHead, queueTail;
+static uint32_t triggered;
+static uint16_t dropped;
+static adcEvent_t last;
+static void (*queueNotify)(void);
+
+/* Lowest count the SAR reports for a voltage of at least millivolts, the limits compare raw results */
+static int16_t AdcEvent_Counts(int16_t millivolts)
+{
+	int32_t low = INT16_MIN, high = INT16_MAX;
+	while (low < high)
+	{
+		int32_t mid = low + (high - low) / 2;
+		if (ADC_CountsTo_mVolts(0, (int16_t) mid) < millivolts) low = mid + 1;
+		else high = mid;
+	}
+	return (int16_t) low;
+}
+
+/* Checks and takes an event configuration, detection starts over */
+bool AdcEvent_Configure(const adcEventConfig_t* config)
+{
+	if (config->condition > adcEvent_Outside || config->post == 0) return false;
+	if (config->pre + config->post > ADCEVENT_MAX_SAMPLES || config->low > config->high) return false;
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	eventConfig = *config;
+	lowCounts = AdcEvent_Counts(config->low);
+	highCounts = AdcEvent_Counts(config->high);
+	AdcEvent_Reset();
+	Cy_SysLib_ExitCriticalSection(interruptState);
+	return true;
+}
+
+void AdcEvent_GetConfig(adcEventConfig_t* config)
+{
+	*config = eventConfig;
+}
+
+bool AdcEvent_IsEnabled(void)
+{
+	return eventConfig.condition != adcEvent_Off;
+}
+
+/* Drops a capture in progress and arms the detection, at a stream (re)start */
+void AdcEvent_Reset(void)
+{
+	state = eventArmed;
+	AdcEvent_Arm();
+}
+
+/* Programs the limits into the SAR while armed, again after it was reinitialized */
+void AdcEvent_Arm(void)
+{
+	Cy_SAR_ClearRangeInterrupt(ADC_SAR__HW, 1);
+	if (eventConfig.condition == adcEvent_Off || state != eventArmed)
+	{
+		ADC_SetLimitMask(0);
+		return;
+	}
+	ADC_SetLowLimit((uint16_t) lowCounts);
+	ADC_SetHighLimit((uint16_t) highCounts);
+	Cy_SAR_SetRangeCond(ADC_SAR__HW, (cy_en_sar_range_detect_condition_t) (eventConfig.condition - adcEvent_Below));
+	ADC_SetLimitMask(1);
+}
+
+/* Range interrupt, the stream sample being taken (head) is the trigger */
+void AdcEvent_Range(uint32_t head)
+{
+	ADC_SetLimitMask(0);					// One trigger per event
+	if (state != eventArmed || eventConfig.condition == adcEvent_Off) return;
+	triggerHead = head;
+	triggered++;
+	state = eventCapturing;
+}
+
+/* Called by the stream interrupt after every sample, head counts the sample */
+void AdcEvent_Sample(uint32_t head)
+{
+	if (state == eventHoldoff && (int32_t) (head - rearmHead) >= 0)
+	{
+		state = eventArmed;
+		AdcEvent_Arm();
+	}
+	if (state != eventCapturing || head - triggerHead < eventConfig.post) return;
+
+	/* The latest samples are the pre- and post-trigger samples, fewer pre-trigger ones early after a start */
+	adcSample_t samples[ADCEVENT_MAX_SAMPLES];
+	uint32_t latest;
+	uint16_t count = AdcStream_History(samples, eventConfig.pre + eventConfig.post, &latest);
+	adcEvent_t event = { .number = (uint16_t) triggered, .count = (uint8_t) count };
+	event.pre = (uint8_t) (count > eventConfig.post ? count - eventConfig.post : 0);
+	event.timestamp = samples[event.pre].timestamp;
+	for (uint16_t i = 0; i < count; i++) event.millivolts[i] = samples[i].millivolts;
+	last = event;
+	if (queueHead - queueTail >= ADCEVENT_QUEUE_SIZE) dropped++;	// Keep the first events of a burst
+	else
+	{
+		queue[queueHead & (ADCEVENT_QUEUE_SIZE - 1)] = event;
+		__DMB();
+		queueHead++;
+		if (queueNotify != NULL) queueNotify();
+	}
+	rearmHead = head + eventConfig.holdoff;
+	state = eventHoldoff;
+}
+
+/* Takes the oldest queued event, false when there is none */
+bool AdcEvent_Take(adcEvent_t* event)
+{
+	if (queueHead == queueTail) return false;
+	__DMB();
+	*event = queue[queueTail & (ADCEVENT_QUEUE_SIZE - 1)];
+	__DMB();
+	queueTail++;
+	return true;
+}
+
+/* Sets a function the stream ISR calls when an event is queued, NULL for none */
+void AdcEvent_SetNotify(void (*notify)(void))
+{
+	queueNotify = notify;
+}
+
+void AdcEvent_GetStatus(adcEventStatus_t* status)
+{
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	status->triggered = triggered;
+	status->queued = (uint16_t) (queueHead - queueTail);
+	status->dropped = dropped;
+	status->last = last;
+	Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,112 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC events: threshold triggered sampling on the SAR range detection
+ *
+ * The SAR compares every scan result of channel 0 with a low and a high limit
+ * in hardware (ADC_SetLowLimit, ADC_SetHighLimit) and raises the range
+ * interrupt on the configured condition. The interrupt marks the stream sample
+ * being taken as the trigger; once the post-trigger samples are in, the pre-
+ * and post-trigger samples are copied from the stream ring into an event and
+ * queued for uplink. Detection is re-armed holdoff samples after an event, so
+ * a signal that stays out of range does not flood the queue.
+ *
+ * The SAR does not convert in deep sleep: in event mode the CM4 stays in sleep
+ * between events instead of deep sleeping between timed uplinks, and only the
+ * events go out over the radio.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "adcstream.h"
+
+#define ADCEVENT_MAX_SAMPLES		16		// Pre- and post-trigger samples per event
+#define ADCEVENT_QUEUE_SIZE			4		// Events waiting for uplink, a power of two
+
+typedef enum __attribute__ ((__packed__))
+{
+	adcEvent_Off			= 0x00,
+	adcEvent_Below			= 0x01,			// Below low
+	adcEvent_Inside			= 0x02,			// From low up to high
+	adcEvent_Above			= 0x03,			// From high up
+	adcEvent_Outside		= 0x04,			// Below low or from high up
+} adcEventCondition_e;
+
+/* Event mode configuration, read and written with CMD_ADCEVENTCFG */
+typedef struct __attribute__ ((__packed__))
+{
+	adcEventCondition_e condition;
+	uint8_t		pre;						// Stream samples before the trigger
+	uint8_t		post;						// Stream samples from the trigger on, pre + post <= ADCEVENT_MAX_SAMPLES
+	uint8_t		reserved;
+	int16_t		low;						// Millivolts
+	int16_t		high;
+	uint16_t	holdoff;					// Stream samples after an event before detection is re-armed
+	uint16_t	reserved2;
+} adcEventConfig_t;
+
+/* Event as sent in the uplink, the samples beyond count are not sent */
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	timestamp;					// Stream timestamp of the trigger sample
+	uint16_t	number;						// Events triggered since boot, this one included
+	uint8_t		pre;						// Samples before the trigger
+	uint8_t		count;
+	int16_t		millivolts[ADCEVENT_MAX_SAMPLES];
+} adcEvent_t;
+
+#define ADCEVENT_UPLINK_SIZE(event)	(sizeof(adcEvent_t) - sizeof((event)->millivolts) + (event)->count * sizeof(int16_t))
+
+/* Result of the CMD_ADCEVENT read */
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	triggered;					// Events since boot
+	uint16_t	queued;						// Events waiting for uplink
+	uint16_t	dropped;					// Events lost to a full queue
+	adcEvent_t	last;						// Last completed event, count 0 before the first
+} adcEventStatus_t;
+
+bool		AdcEvent_Configure(const adcEventConfig_t* config);
+void		AdcEvent_GetConfig(adcEventConfig_t* config);
+bool		AdcEvent_IsEnabled(void);
+void		AdcEvent_Reset(void);
+void		AdcEvent_Arm(void);
+void		AdcEvent_Range(uint32_t head);
+void		AdcEvent_Sample(uint32_t head);
+bool		AdcEvent_Take(adcEvent_t* event);
+void		AdcEvent_SetNotify(void (*notify)(void));
+void		AdcEvent_GetStatus(adcEventStatus_t* status);
+
+/* [] END OF FILE */
@@ -0,0 +1,140 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC scan: multi-channel SAR scans with hardware averaging
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#include "adcscan.h"
+#include "adcstream.h"
+
+#define ADCSCAN_PORT				ADC_Pin_0_PORT	// The SARMUX dedicated port
+
+static adcScanConfig_t scanConfig =
+{
+	.channels = 1u << ADC_Pin_0_NUM,
+	.averaging = 1,							// ADC_CFG0_SAMPLES_AVERAGED
+	.sampleTime = ADC_CFG0_APERTURE_TIME0,
+};
+static uint32_t scans;
+
+/* Checks and takes a scan configuration, pins driven by other peripherals are refused */
+bool AdcScan_Configure(const adcScanConfig_t* config)
+{
+	if (config->channels == 0 || config->averaging > ADCSCAN_MAX_AVERAGING) return false;
+	if (config->sampleTime < ADCSCAN_MIN_SAMPLE_TIME || config->sampleTime > ADCSCAN_MAX_SAMPLE_TIME) return false;
+	for (uint32_t pin = 0; pin < ADCSCAN_CHANNELS; pin++)
+	{
+		if ((config->channels & (1u << pin)) == 0) continue;
+		uint32_t driveMode = Cy_GPIO_GetDrivemode(ADCSCAN_PORT, pin);
+		if (driveMode != CY_GPIO_DM_ANALOG && driveMode != CY_GPIO_DM_HIGHZ) return false;
+	}
+	scanConfig = *config;
+	return true;
+}
+
+void AdcScan_GetConfig(adcScanConfig_t* config)
+{
+	*config = scanConfig;
+}
+
+/* Derives the SAR configuration of a scan from configuration 0 of the ADC component */
+static void AdcScan_HwConfig(cy_stc_sar_config_t* hw)
+{
+	*hw = *ADC_allConfigs[0].hwConfigStc;
+	hw->ctrl = (hw->ctrl & ~SAR_CTRL_SWITCH_DISABLE_Msk) | SAR_CTRL_SAR_HW_CTRL_NEGVREF_Msk;	// Sequencer drives the switches
+	hw->sampleCtrl &= ~(SAR_SAMPLE_CTRL_AVG_CNT_Msk | SAR_SAMPLE_CTRL_AVG_MODE_Msk | SAR_SAMPLE_CTRL_AVG_SHIFT_Msk);
+	if (scanConfig.averaging > 0)			// Back to back per channel, shifted to 12 bits
+		hw->sampleCtrl |= ((uint32_t) (scanConfig.averaging - 1) << SAR_SAMPLE_CTRL_AVG_CNT_Pos) | SAR_SAMPLE_CTRL_AVG_SHIFT_Msk;
+	hw->sampleTime01 = (hw->sampleTime01 & ~SAR_SAMPLE_TIME01_SAMPLE_TIME0_Msk) | scanConfig.sampleTime;
+	hw->chanEn = scanConfig.channels;
+	hw->muxSwitch = CY_SAR_MUX_FW_VSSA_VMINUS;
+	hw->muxSwitchSqCtrl = CY_SAR_MUX_SQ_CTRL_VSSA;
+	for (uint32_t chan = 0; chan < CY_SAR_MAX_NUM_CHANNELS; chan++)
+	{
+		if (chan >= ADCSCAN_CHANNELS || (scanConfig.channels & (1u << chan)) == 0)
+		{
+			hw->chanConfig[chan] = CY_SAR_DEINIT;
+			continue;
+		}
+		hw->chanConfig[chan] = (chan << SAR_CHAN_CONFIG_POS_PIN_ADDR_Pos) | CY_SAR_POS_PORT_ADDR_SARMUX
+			| (scanConfig.averaging > 0 ? SAR_CHAN_CONFIG_AVG_EN_Msk : 0);
+		hw->muxSwitchSqCtrl |= (uint32_t) CY_SAR_MUX_SQ_CTRL_P0 << chan;
+	}
+	hw->intrMask = 0;						// Polled, the stream owns the interrupt
+	hw->rangeIntrMask = 0;
+	hw->configRouting = true;
+}
+
+/* Converts all channels of the configuration in one scan */
+void AdcScan_Run(adcScan_t* result)
+{
+	cy_stc_sar_config_t hw;
+	AdcScan_HwConfig(&hw);
+	ADC_CONFIG_STRUCT config = ADC_allConfigs[0];
+	config.hwConfigStc = &hw;
+	config.numChannels = 0;
+	for (uint8_t mask = scanConfig.channels; mask != 0; mask &= mask - 1) config.numChannels++;
+
+	bool streaming = AdcStream_Pause();
+	uint32_t switches = Cy_SAR_GetAnalogSwitch(ADC_SAR__HW, CY_SAR_MUX_SWITCH0);
+	uint32_t seqCtrl = SAR_MUX_SWITCH_SQ_CTRL(ADC_SAR__HW);
+	ADC_InitConfig(&config);
+	ADC_Enable();
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	uint32_t start = DWT->CYCCNT;
+	Cy_SAR_StartConvert(ADC_SAR__HW, CY_SAR_START_CONVERT_SINGLE_SHOT);
+	while (Cy_SAR_IsEndConversion(ADC_SAR__HW, CY_SAR_WAIT_FOR_RESULT) != CY_SAR_SUCCESS) {}
+	uint32_t duration = (DWT->CYCCNT - start) / (SystemCoreClock / 1000000);
+
+	*result = (adcScan_t) { .scans = ++scans, .channels = scanConfig.channels, .duration = duration > UINT16_MAX ? UINT16_MAX : (uint16_t) duration };
+	for (uint32_t chan = 0; chan < ADCSCAN_CHANNELS; chan++)
+	{
+		if ((scanConfig.channels & (1u << chan)) == 0) continue;
+		result->counts[chan] = Cy_SAR_GetResult16(ADC_SAR__HW, chan);
+		result->millivolts[chan] = Cy_SAR_CountsTo_mVolts(ADC_SAR__HW, chan, result->counts[chan]);
+	}
+
+	/* Back to the component configuration, its routing is not part of it */
+	ADC_InitConfig(&ADC_allConfigs[0]);
+	Cy_SAR_SetSwitchSarSeqCtrl(ADC_SAR__HW, hw.muxSwitchSqCtrl & ~seqCtrl, CY_SAR_SWITCH_SEQ_CTRL_DISABLE);
+	Cy_SAR_SetAnalogSwitch(ADC_SAR__HW, CY_SAR_MUX_SWITCH0, hw.muxSwitch & ~switches, CY_SAR_SWITCH_OPEN);
+	Cy_SAR_SetAnalogSwitch(ADC_SAR__HW, CY_SAR_MUX_SWITCH0, switches, CY_SAR_SWITCH_CLOSE);
+	ADC_Enable();
+	if (streaming) AdcStream_Resume();
+}
+
+/* [] END OF FILE */
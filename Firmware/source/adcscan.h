@@ -0,0 +1,80 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC scan: multi-channel SAR scans with hardware averaging
+ *
+ * The ADC component converts one channel. A scan reconfigures the SAR for the
+ * channels of its mask, one per pin of the SARMUX dedicated port (P10.0 to
+ * P10.7), lets the sequencer convert them all with hardware averaging, and
+ * puts the results into one adcScan_t. The host reads N sensors with one
+ * scan and one mailbox transfer.
+ *
+ * A running ADC stream pauses for the scan and continues afterwards, its
+ * timestamps show the gap. The SAR is back in the ADC component configuration
+ * between scans, so single conversions and the stream do not change.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ADCSCAN_CHANNELS			8		// SARMUX dedicated port pins
+#define ADCSCAN_MAX_AVERAGING		8		// log2 of the samples averaged, 256
+#define ADCSCAN_MIN_SAMPLE_TIME		2		// SAR clock cycles
+#define ADCSCAN_MAX_SAMPLE_TIME		1023
+
+/* Scan configuration, read and written with CMD_ADCSCANCFG */
+typedef struct __attribute__ ((__packed__))
+{
+	uint8_t		channels;					// Bit n scans pin n of the SARMUX port
+	uint8_t		averaging;					// log2 of the samples averaged per channel, 0 is off
+	uint16_t	sampleTime;					// Aperture in SAR clock cycles
+} adcScanConfig_t;
+
+/* Result of the CMD_ADCSCAN read, the channels not scanned read 0 */
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	scans;						// Scans since boot, this one included
+	uint8_t		channels;
+	uint8_t		reserved;
+	uint16_t	duration;					// Microseconds from the start to the end of the scan
+	int16_t		millivolts[ADCSCAN_CHANNELS];
+	int16_t		counts[ADCSCAN_CHANNELS];
+} adcScan_t;
+
+bool		AdcScan_Configure(const adcScanConfig_t* config);
+void		AdcScan_GetConfig(adcScanConfig_t* config);
+void		AdcScan_Run(adcScan_t* result);
+
+/* [] END OF FILE */
@@ -0,0 +1,219 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC stream: continuous interrupt driven sampling into a ring buffer
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#include "adcstream.h"
+#include "adcdsp.h"
+#include "adcevent.h"
+
+static adcStream_t stream __attribute__ ((aligned(4))) = ADCSTREAM_RING_INIT;
+static uint32_t scansPerSample;				// Hardware scans averaged into one sample
+static uint32_t scans;
+static int32_t accumulator;
+static uint32_t lastCycles, cycleRest, microseconds;
+static volatile uint32_t validHead;			// Lowest head holding a sample taken after the last (re)start
+
+static void AdcStream_ISR(void)
+{
+	uint32_t range = Cy_SAR_GetRangeInterruptStatusMasked(ADC_SAR__HW);
+	if (range != 0)							// Limit crossed, the sample being taken is the trigger
+	{
+		Cy_SAR_ClearRangeInterrupt(ADC_SAR__HW, range);
+		AdcEvent_Range(stream.head);
+	}
+	uint32_t status = Cy_SAR_GetInterruptStatus(ADC_SAR__HW);
+	Cy_SAR_ClearInterrupt(ADC_SAR__HW, status);
+	if ((status & CY_SAR_INTR_EOS_MASK) == 0) return;
+
+	/* Timestamp from the cycle counter, it cannot wrap unnoticed as the ISR runs every scan */
+	uint32_t cycles = DWT->CYCCNT;
+	uint32_t cyclesPerUs = SystemCoreClock / 1000000;
+	cycleRest += cycles - lastCycles;
+	lastCycles = cycles;
+	microseconds += cycleRest / cyclesPerUs;
+	cycleRest %= cyclesPerUs;
+
+	accumulator += ADC_GetResult16(0);
+	if (++scans < scansPerSample) return;
+
+	adcSample_t sample;
+	sample.timestamp = microseconds;
+	sample.counts = (int16_t) (accumulator / (int32_t) scansPerSample);
+	sample.millivolts = ADC_CountsTo_mVolts(0, sample.counts);
+	scans = 0;
+	accumulator = 0;
+	AdcStream_Put(&stream, &sample);
+	AdcDsp_Process(&sample);
+	AdcEvent_Sample(stream.head);
+}
+
+/* Appends a sample to a ring, from a single producer */
+void AdcStream_Put(adcStream_t* ring, const adcSample_t* sample)
+{
+	uint32_t head = ring->head;
+	ring->samples[head & (ADCSTREAM_SIZE - 1)] = *sample;
+	__DMB();								// Slot before head, for readers on the CPU and over SWD
+	ring->head = head + 1;
+}
+
+/* Starts continuous sampling, returns the rate achieved with the scan rate of the ADC component */
+uint32_t AdcStream_Start(uint32_t rate)
+{
+	AdcStream_Stop();
+	if (rate == 0) return 0;
+	scansPerSample = ADC_CFG0_SAMPLE_RATE / rate;
+	if (scansPerSample == 0) scansPerSample = 1;
+	scans = 0;
+	accumulator = 0;
+	microseconds = 0;
+	cycleRest = 0;
+	stream.head = 0;
+	validHead = 1;
+	stream.rate = ADC_CFG0_SAMPLE_RATE / scansPerSample;
+	AdcDsp_Reset(stream.rate);
+	AdcEvent_Reset();
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	lastCycles = DWT->CYCCNT;
+
+	ADC_StartEx(AdcStream_ISR);
+	ADC_SetEosMask(1);
+	ADC_SetConvertMode(CY_SAR_START_CONVERT_CONTINUOUS);
+	ADC_StartConvert();
+	return stream.rate;
+}
+
+/* Stops sampling, the ADC stays enabled for single conversions */
+void AdcStream_Stop(void)
+{
+	if (!AdcStream_Pause()) return;
+	stream.rate = 0;
+}
+
+/* Halts the conversions for another use of the SAR, keeping the rate, the ring and the partial sample */
+bool AdcStream_Pause(void)
+{
+	if (stream.rate == 0) return false;
+	ADC_StopConvert();
+	NVIC_DisableIRQ(ADC_IRQ_cfg.intrSrc);
+	ADC_SetConvertMode(CY_SAR_START_CONVERT_SINGLE_SHOT);
+	Cy_SAR_ClearInterrupt(ADC_SAR__HW, CY_SAR_INTR_EOS_MASK);
+	return true;
+}
+
+/* Continues after AdcStream_Pause, with the SAR back in the ADC component configuration */
+void AdcStream_Resume(void)
+{
+	if (stream.rate == 0) return;
+	AdcEvent_Arm();							// The limits are not part of the component configuration
+	ADC_StartEx(AdcStream_ISR);
+	ADC_SetEosMask(1);
+	ADC_SetConvertMode(CY_SAR_START_CONVERT_CONTINUOUS);
+	ADC_StartConvert();
+}
+
+bool AdcStream_IsRunning(void)
+{
+	return stream.rate != 0;
+}
+
+/* The SAR does not run in deep sleep, call before sleeping and after waking up */
+void AdcStream_Sleep(void)
+{
+	if (stream.rate != 0) ADC_Sleep();
+}
+
+void AdcStream_Wakeup(void)
+{
+	if (stream.rate == 0) return;
+	scans = 0;
+	accumulator = 0;
+	lastCycles = DWT->CYCCNT;
+	validHead = stream.head + 1;			// Samples from before the sleep are not the latest
+	AdcDsp_Reset(stream.rate);				// Neither are the filter state and the statistics window
+	ADC_Wakeup();
+}
+
+/* Copies the latest sample, false until the first sample after a start or wakeup */
+bool AdcStream_Latest(adcSample_t* sample)
+{
+	uint32_t head;
+	do
+	{
+		head = stream.head;
+		if (stream.rate == 0 || (int32_t) (head - validHead) < 0) return false;
+		__DMB();
+		*sample = stream.samples[(head - 1) & (ADCSTREAM_SIZE - 1)];
+		__DMB();
+	} while (stream.head - (head - 1) >= ADCSTREAM_SIZE);
+	return true;
+}
+
+/* Copies the latest count samples, oldest first, returns the number copied and the head after them */
+uint16_t AdcStream_History(adcSample_t* samples, uint16_t count, uint32_t* head)
+{
+	uint32_t first;
+	uint16_t copied;
+	do
+	{
+		*head = stream.head;
+		copied = *head < count ? (uint16_t) *head : count;
+		if (copied > ADCSTREAM_SIZE - 1) copied = ADCSTREAM_SIZE - 1;
+		first = *head - copied;
+		__DMB();
+		for (uint16_t i = 0; i < copied; i++) samples[i] = stream.samples[(first + i) & (ADCSTREAM_SIZE - 1)];
+		__DMB();
+	} while (copied > 0 && stream.head - first >= ADCSTREAM_SIZE);	// Retry when the ISR lapped the copy
+	return copied;
+}
+
+void AdcStream_RingInfo(const adcStream_t* ring, adcStreamInfo_t* info)
+{
+	info->address = (uint32_t) ring;
+	info->head = ring->head;
+	info->rate = ring->rate;
+	info->size = ADCSTREAM_SIZE;
+	info->sampleSize = sizeof(adcSample_t);
+}
+
+void AdcStream_GetInfo(adcStreamInfo_t* info)
+{
+	AdcStream_RingInfo(&stream, info);
+}
+
+/* [] END OF FILE */
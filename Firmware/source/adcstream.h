@@ -0,0 +1,105 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * ADC stream: continuous interrupt driven sampling into a ring buffer
+ *
+ * The SAR sequencer scans continuously at the rate set in the ADC component,
+ * the end-of-scan interrupt averages the scans of one sample period and stores
+ * the result with a timestamp in a single producer ring buffer. Readers never
+ * wait for a conversion: the firmware takes the latest sample or a block of
+ * history, the host reads the ring directly over SWD.
+ *
+ * Readers detect overwritten samples by sequence number: sample n sits in slot
+ * n % ADCSTREAM_SIZE and is intact while head - n < ADCSTREAM_SIZE. The ISR
+ * writes the slot before it publishes the new head.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ADCSTREAM_SIZE				512		// Ring buffer slots, a power of two
+#define ADCSTREAM_DEFAULT_RATE		1000	// Sample rate (Hz) started at boot
+#define ADCSTREAM_MAGIC				0x53434441	// "ADCS"
+
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	timestamp;					// Microseconds since the stream started
+	int16_t		millivolts;					// Average of the scans in the sample period
+	int16_t		counts;						// Raw average, channel 0
+} adcSample_t;
+
+/* Ring buffer as the host sees it in target RAM */
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	magic;						// ADCSTREAM_MAGIC
+	volatile uint32_t head;					// Samples written since the stream started
+	uint32_t	rate;						// Sample rate (Hz), 0 when stopped
+	uint16_t	size;						// ADCSTREAM_SIZE
+	uint16_t	sampleSize;					// sizeof(adcSample_t)
+	adcSample_t	samples[ADCSTREAM_SIZE];
+} adcStream_t;
+
+#define ADCSTREAM_RING_INIT			{ .magic = ADCSTREAM_MAGIC, .size = ADCSTREAM_SIZE, .sampleSize = sizeof(adcSample_t) }
+
+/* Result of the CMD_ADCSTREAM read */
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	address;					// Address of the adcStream_t in target RAM
+	uint32_t	head;
+	uint32_t	rate;
+	uint16_t	size;
+	uint16_t	sampleSize;
+} adcStreamInfo_t;
+
+/* Result of the CMD_ADCHISTORY read, followed by count samples (oldest first) */
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	head;						// Sequence number after the last sample
+	uint16_t	count;						// Samples returned, fewer than asked early after a start
+	uint16_t	reserved;
+} adcHistory_t;
+
+uint32_t	AdcStream_Start(uint32_t rate);
+void		AdcStream_Stop(void);
+bool		AdcStream_Pause(void);
+void		AdcStream_Resume(void);
+bool		AdcStream_IsRunning(void);
+void		AdcStream_Sleep(void);
+void		AdcStream_Wakeup(void);
+bool		AdcStream_Latest(adcSample_t* sample);
+uint16_t	AdcStream_History(adcSample_t* samples, uint16_t count, uint32_t* head);
+void		AdcStream_GetInfo(adcStreamInfo_t* info);
+void		AdcStream_Put(adcStream_t* ring, const adcSample_t* sample);
+void		AdcStream_RingInfo(const adcStream_t* ring, adcStreamInfo_t* info);
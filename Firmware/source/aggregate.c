@@ -0,0 +1,190 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Aggregate: batches timestamped readings into one compact uplink frame
+ *
+ ********************************************************************************/
+
+#include <string.h>
+#include "aggregate.h"
+
+#define AGGREGATE_MIN_HEADER		2		// Format byte and the age, 1 to 3 bytes up to AGGREGATE_MAX_AGE
+#define AGGREGATE_RAW_VERSION		0		// Format of a single reading that does not fit a batch frame
+#define AGGREGATE_MAX_AGE			0x1FFFFF	// Seconds, 3 varint bytes
+#define AGGREGATE_MAX_READING		(5 + AGGREGATE_MAX_VALUES * 3)
+
+static struct
+{
+	uint8_t		values;
+	uint8_t		frameSize;
+	uint32_t	deadline;					// Milliseconds
+	uint8_t		count;
+	uint8_t		length;
+	uint32_t	firstTime;					// Milliseconds, as passed to Aggregate_Add
+	uint32_t	lastTime;					// firstTime plus the whole seconds coded so far
+	uint8_t		headerSize;					// Reserved for the format byte and the age
+	int16_t		last[AGGREGATE_MAX_VALUES];
+	uint8_t		body[AGGREGATE_MAX_FRAME - AGGREGATE_MIN_HEADER];	// Readings
+} batch;
+
+static uint8_t Varint(uint8_t* out, uint32_t value)
+{
+	uint8_t length = 0;
+	do
+	{
+		out[length] = value & 0x7F;
+		value >>= 7;
+		if (value != 0) out[length] |= 0x80;
+		length++;
+	} while (value != 0);
+	return length;
+}
+
+static uint8_t VarintSize(uint32_t value)
+{
+	uint8_t length = 1;
+	while (value >>= 7) length++;
+	return length;
+}
+
+/* Format byte and the age the batch will have at its flush: the readings so far plus the deadline,
+   the batch is flushed by then or the reading after that is added just before */
+static uint8_t HeaderSize(uint32_t time)
+{
+	uint32_t span = batch.count > 0 ? time - batch.firstTime : 0;
+	uint32_t age = (span + batch.deadline) / 1000;
+	return 1 + VarintSize(age > AGGREGATE_MAX_AGE ? AGGREGATE_MAX_AGE : age);
+}
+
+static uint32_t ZigZag(int32_t value)
+{
+	return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+/* Starts an empty batch of readings with values (1 to AGGREGATE_MAX_VALUES) each, flushed at most deadline ms after its first reading */
+void Aggregate_Init(uint8_t values, uint32_t deadline)
+{
+	memset(&batch, 0, sizeof(batch));
+	batch.values = values < 1 ? 1 : values > AGGREGATE_MAX_VALUES ? AGGREGATE_MAX_VALUES : values;
+	batch.deadline = deadline;
+	batch.frameSize = Aggregate_MaxPayload(stack_EU_H, DR_0);
+}
+
+/* Frame size for the data rate, readings already in the batch stay */
+void Aggregate_SetFrameSize(uint8_t size)
+{
+	batch.frameSize = size > AGGREGATE_MAX_FRAME ? AGGREGATE_MAX_FRAME : size;
+}
+
+/* Application payload size of a data rate (LoRaWAN regional parameters), the smallest one of the
+   region for DR_ADR as the core does not report the rate the network has set */
+uint8_t Aggregate_MaxPayload(stackRegion_e region, Radio_DataRate_e dataRate)
+{
+	static const uint8_t us[] = { 11, 53, 125, 242, 242 };
+	static const uint8_t others[] = { 51, 51, 51, 115, 222, 222, 222, 222 };
+	if (region == stack_US) return dataRate < sizeof(us) ? us[dataRate] : us[0];
+	return dataRate < sizeof(others) ? others[dataRate] : others[0];
+}
+
+/* Codes a reading into the batch, false when it does not fit the frame: flush and add it again */
+bool Aggregate_Add(uint32_t time, const int16_t* values)
+{
+	uint8_t reading[AGGREGATE_MAX_READING];
+	uint8_t length = 0;
+	uint32_t seconds = 0;
+	if (batch.count > 0)
+	{
+		seconds = (time - batch.lastTime) / 1000;
+		length += Varint(&reading[length], seconds);
+	}
+	for (uint8_t i = 0; i < batch.values; i++)
+		length += Varint(&reading[length], ZigZag(batch.count > 0 ? (int32_t) values[i] - batch.last[i] : values[i]));
+	uint8_t header = HeaderSize(time);
+	if (header + batch.length + length > batch.frameSize) return false;
+
+	memcpy(&batch.body[batch.length], reading, length);
+	batch.length += length;
+	if (batch.count++ == 0) batch.firstTime = batch.lastTime = time;
+	else batch.lastTime += seconds * 1000;	// Keeps the remainder, the coded times do not drift
+	memcpy(batch.last, values, batch.values * sizeof(int16_t));
+	batch.headerSize = header;
+	return true;
+}
+
+/* A reading as is, for one that does not fit an empty batch frame: format byte (version 0), then the
+   values as int16, as many as fit the frame; returns the frame length */
+uint8_t Aggregate_Raw(const int16_t* values, uint8_t* frame)
+{
+	uint8_t count = (batch.frameSize - 1) / sizeof(int16_t);
+	if (count > batch.values) count = batch.values;
+	frame[0] = (AGGREGATE_RAW_VERSION << 4) | count;
+	memcpy(&frame[1], values, count * sizeof(int16_t));
+	return 1 + count * sizeof(int16_t);
+}
+
+uint8_t Aggregate_Count(void)
+{
+	return batch.count;
+}
+
+/* True when the oldest reading reached the deadline */
+bool Aggregate_IsDue(uint32_t time)
+{
+	return batch.count > 0 && time - batch.firstTime >= batch.deadline;
+}
+
+/* Writes the frame (up to the frame size) and empties the batch, returns the frame length, 0 without readings */
+/* Codes the batch into a frame, the batch stays until Aggregate_Clear: the uplink may not be queued */
+uint8_t Aggregate_Encode(uint32_t time, uint8_t* frame)
+{
+	if (batch.count == 0) return 0;
+	/* The age is coded in the bytes the readings left, which are at least the reserved header:
+	   a batch flushed well past its deadline reports the largest age that fits */
+	uint32_t age = (time - batch.firstTime) / 1000;
+	uint8_t ageSize = batch.frameSize > batch.length + batch.headerSize ? batch.frameSize - batch.length - 1 : batch.headerSize - 1;
+	uint32_t maxAge = ageSize >= 3 ? AGGREGATE_MAX_AGE : (1UL << (7 * ageSize)) - 1;
+	uint8_t length = 0;
+	frame[length++] = (AGGREGATE_VERSION << 4) | batch.values;
+	length += Varint(&frame[length], age > maxAge ? maxAge : age);
+	memcpy(&frame[length], batch.body, batch.length);
+	length += batch.length;
+	return length;
+}
+
+void Aggregate_Clear(void)
+{
+	batch.count = 0;
+	batch.length = 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,78 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Aggregate: batches timestamped readings into one compact uplink frame
+ *
+ * A LoRaWAN frame costs the MAC header, the MIC, airtime and duty-cycle budget
+ * whatever it carries, so readings are collected and sent together. A frame
+ * is flushed when the next reading does not fit the payload size of the data
+ * rate, or when its oldest reading reaches the latency deadline.
+ *
+ * Frame layout, all numbers unsigned LEB128 varints, signed ones zigzag coded:
+ *   format		1 byte: version (1) in the high nibble, values per reading
+ *				in the low nibble
+ *   age		seconds from the first reading to the flush
+ *   reading 0	the values
+ *   reading n	seconds since reading n-1, then per value the difference
+ *				with the same value of reading n-1
+ * The readings run to the end of the frame. The age takes the bytes the
+ * readings leave: a reading fits when the frame has room for it and for the
+ * age the batch will have at its deadline. A reading that does not fit even
+ * an empty frame goes out on its own (Aggregate_Raw): format version 0 with
+ * the number of values, then the values as int16, as many as fit.
+ * Aggregate_Encode leaves the batch in place, Aggregate_Clear drops it once
+ * the uplink is queued. AdcAggregate.Decode in the
+ * PC-Utility decodes it, the receive time gives the absolute times.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "OnethinxCore01.h"
+
+#define AGGREGATE_MAX_VALUES		8		// Values per reading
+#define AGGREGATE_MAX_FRAME			242		// Largest LoRaWAN application payload
+#define AGGREGATE_VERSION			1
+
+void		Aggregate_Init(uint8_t values, uint32_t deadline);
+void		Aggregate_SetFrameSize(uint8_t size);
+uint8_t		Aggregate_MaxPayload(stackRegion_e region, Radio_DataRate_e dataRate);
+bool		Aggregate_Add(uint32_t time, const int16_t* values);
+uint8_t		Aggregate_Count(void);
+bool		Aggregate_IsDue(uint32_t time);
+uint8_t		Aggregate_Encode(uint32_t time, uint8_t* frame);
+void		Aggregate_Clear(void);
+uint8_t		Aggregate_Raw(const int16_t* values, uint8_t* frame);
+
+/* [] END OF FILE */
@@ -44,6 +44,12 @@
 #include "OnethinxCore01.h"
 #include "maestro.h"
 #include "PrintF.h"
+#include "flashstore.h"
+#include "adcstream.h"
+#include "adcdsp.h"
+#include "adcscan.h"
+#include "adcevent.h"
+#include "kvstore.h"
 
 extern coreStatus_t 	    coreStatus;
 extern coreInfo_t 		    coreInfo;
@@ -62,9 +68,32 @@ typedef enum __attribute__ ((__packed__))
 	CMD_KEYS,
 	CMD_ADCVAL,
 	CMD_LEDS,
+	CMD_COMMIT,
+	CMD_ADCSTREAM,
+	CMD_ADCHISTORY,
+	CMD_ADCDSP,
+	CMD_ADCSTATS,
+	CMD_ADCOUTPUT,
+	CMD_ADCSCANCFG,
+	CMD_ADCSCAN,
+	CMD_ADCEVENTCFG,
+	CMD_ADCEVENT,
+	CMD_KVINFO,
+	CMD_KVCURSOR,
+	CMD_KVDATA,
 	CMD_EXIT = 0xFF
 } Command_e;
 
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t			keysCrc;				// CRC-32 of the keys record
+	uint32_t			configCrc;				// CRC-32 of the configuration record
+	flashStoreResult_e	keysResult;
+	flashStoreResult_e	configResult;
+	uint8_t				configLength;
+	uint8_t				reserved;
+} CommitInfo_t;
+
 typedef struct __attribute__ ((__packed__)) 
 {
 	union
@@ -86,6 +115,8 @@ typedef struct __attribute__ ((__packed__))
 } CommData_t;
 
 
+static uint8_t kvCursor;					// Key the next CMD_KVDATA read starts from
+
 void PrintHexDump(const char* header, const void* data, int16_t size)
 {
     printf("%s: ", header);
@@ -95,93 +126,272 @@ void PrintHexDump(const char* header, const void* data, int16_t size)
     printf("%02X\n", ((const uint8_t*)bytes)[i]);
 }
 
-void Communicator(void)
+void Communicator_Init(void)
 {
 	volatile CommData_t * CommData = (volatile CommData_t*)0x08038000;
 	CommData->Header.Value = 0x00004000;	// Reset
+}
 
-	while (true)
+/* Serves the pending host command, if any, true after CMD_EXIT */
+bool Communicator_Poll(void)
+{
+	volatile CommData_t * CommData = (volatile CommData_t*)0x08038000;
+	if (CommData->Header.Command == CMD_IDLE) return false;
+
+	//printf("Received packet, length %d bytes", CommData->Header.DataLength);
+	//printf("\nCommheader: %08X\n", CommData->Header);
+	//PrintHexDump("\n  data",  (const void *) CommData->Data, CommData->Header.DataLength);
+	uint16_t dataCnt = 0;
+	if (CommData->Header.Read)
 	{
-		if (CommData->Header.Command != CMD_IDLE)
+		switch (CommData->Header.Command)
 		{
-			//printf("Received packet, length %d bytes", CommData->Header.DataLength);
-			//printf("\nCommheader: %08X\n", CommData->Header);
-			//PrintHexDump("\n  data",  (const void *) CommData->Data, CommData->Header.DataLength);
-			uint16_t dataCnt = 0;
-			if (CommData->Header.Read)
+			case CMD_INFO_STACK:
 			{
-				switch (CommData->Header.Command)
-				{
-					case CMD_INFO_STACK:
-					{
-						* (uint32_t *) &CommData->Data = (uint32_t) coreStatus.system.version;
-						for (dataCnt = 0; dataCnt < sizeof(coreInfo); dataCnt++) CommData->Data[dataCnt + 4] = ((uint8_t *) &coreInfo)[dataCnt];
-						dataCnt += 4;
-					}
-					break;
-					case CMD_INFO_FIRMWARE:
-					{
-						for (dataCnt = 0; dataCnt < sizeof(FirmwareInfo); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &FirmwareInfo)[dataCnt];
-					}
-					break;
-					case CMD_KEYS:
-					{
-						for (dataCnt = 0; dataCnt < sizeof(Keys_0); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &Keys_0)[dataCnt];
-					}
-					break;
+				* (uint32_t *) &CommData->Data = (uint32_t) coreStatus.system.version;
+				for (dataCnt = 0; dataCnt < sizeof(coreInfo); dataCnt++) CommData->Data[dataCnt + 4] = ((uint8_t *) &coreInfo)[dataCnt];
+				dataCnt += 4;
+			}
+			break;
+			case CMD_INFO_FIRMWARE:
+			{
+				for (dataCnt = 0; dataCnt < sizeof(FirmwareInfo); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &FirmwareInfo)[dataCnt];
+			}
+			break;
+			case CMD_KEYS:
+			{
+				for (dataCnt = 0; dataCnt < sizeof(Keys_0); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &Keys_0)[dataCnt];
+			}
+			break;
 
-					case CMD_ADCVAL:
-					{
-						* (int32_t *) &CommData->Data = GetADCvoltage(CY_SAR_WAIT_FOR_RESULT);
-						dataCnt = 4;
-					}
-					break;
-					case CMD_LEDS:
-					{
-						* (uint32_t *) &CommData->Data = leds;
-						dataCnt = 4;
-					}
-					break;
-					default:
-					{
-						CommData->Header.CommandInvalid = true;
-					}
-					break;
+			case CMD_ADCVAL:
+			{
+				* (int32_t *) &CommData->Data = GetADCvoltage(CY_SAR_WAIT_FOR_RESULT);
+				dataCnt = 4;
+			}
+			break;
+			case CMD_LEDS:
+			{
+				* (uint32_t *) &CommData->Data = leds;
+				dataCnt = 4;
+			}
+			break;
+			case CMD_ADCSTREAM:	// Ring buffer location and state, for the host to read it directly
+			{
+				adcStreamInfo_t info;
+				AdcStream_GetInfo(&info);
+				for (dataCnt = 0; dataCnt < sizeof(info); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &info)[dataCnt];
+			}
+			break;
+			case CMD_ADCHISTORY:	// Latest samples, as many as fit the requested length
+			{
+				adcHistory_t history = { 0 };
+				adcSample_t samples[(sizeof(CommData->Data) - sizeof(adcHistory_t)) / sizeof(adcSample_t)];
+				uint16_t count = CommData->Header.DataLength < sizeof(history) ? 0 : (CommData->Header.DataLength - sizeof(history)) / sizeof(adcSample_t);
+				if (count > sizeof(samples) / sizeof(adcSample_t)) count = sizeof(samples) / sizeof(adcSample_t);
+				uint32_t head;
+				history.count = AdcStream_History(samples, count, &head);
+				history.head = head;
+				for (uint16_t i = history.count; i < count; i++) samples[i] = (adcSample_t) { 0 };
+				for (dataCnt = 0; dataCnt < sizeof(history); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &history)[dataCnt];
+				for (uint16_t i = 0; i < count * sizeof(adcSample_t); i++) CommData->Data[dataCnt++] = ((uint8_t *) samples)[i];
+			}
+			break;
+			case CMD_ADCDSP:
+			{
+				adcDspConfig_t config;
+				AdcDsp_GetConfig(&config);
+				for (dataCnt = 0; dataCnt < sizeof(config); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &config)[dataCnt];
+			}
+			break;
+			case CMD_ADCSTATS:	// Statistics of the last completed window
+			{
+				adcStats_t stats;
+				AdcDsp_GetStats(&stats);
+				for (dataCnt = 0; dataCnt < sizeof(stats); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &stats)[dataCnt];
+			}
+			break;
+			case CMD_ADCOUTPUT:	// Ring buffer of the filtered and decimated samples
+			{
+				adcStreamInfo_t info;
+				AdcDsp_GetOutputInfo(&info);
+				for (dataCnt = 0; dataCnt < sizeof(info); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &info)[dataCnt];
+			}
+			break;
+			case CMD_ADCSCANCFG:
+			{
+				adcScanConfig_t config;
+				AdcScan_GetConfig(&config);
+				for (dataCnt = 0; dataCnt < sizeof(config); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &config)[dataCnt];
+			}
+			break;
+			case CMD_ADCSCAN:	// One scan of all configured channels
+			{
+				adcScan_t scan;
+				AdcScan_Run(&scan);
+				for (dataCnt = 0; dataCnt < sizeof(scan); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &scan)[dataCnt];
+			}
+			break;
+			case CMD_ADCEVENTCFG:
+			{
+				adcEventConfig_t config;
+				AdcEvent_GetConfig(&config);
+				for (dataCnt = 0; dataCnt < sizeof(config); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &config)[dataCnt];
+			}
+			break;
+			case CMD_ADCEVENT:	// Event counters and the last event
+			{
+				adcEventStatus_t status;
+				AdcEvent_GetStatus(&status);
+				for (dataCnt = 0; dataCnt < sizeof(status); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &status)[dataCnt];
+			}
+			break;
+			case CMD_KVINFO:
+			{
+				kvStoreInfo_t info;
+				KvStore_GetInfo(&info);
+				for (dataCnt = 0; dataCnt < sizeof(info); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &info)[dataCnt];
+			}
+			break;
+			case CMD_KVDATA:	// Values from the cursor on, as many as fit the requested length, the cursor moves on
+			{
+				kvList_t list = { 0 };
+				uint16_t length = CommData->Header.DataLength;
+				if (length < sizeof(list) || length > sizeof(CommData->Data)) break;
+				uint8_t value[KVSTORE_MAX_VALUE];
+				uint8_t valueLength;
+				dataCnt = sizeof(list);
+				for (kvCursor = KvStore_Next(kvCursor); kvCursor < KVSTORE_KEYS; kvCursor = KvStore_Next(kvCursor + 1))
+				{
+					if (KvStore_Get(kvCursor, value, sizeof(value), &valueLength) != kvStore_OK) continue;	// Corrupt, skipped
+					if (dataCnt + sizeof(kvEntry_t) + valueLength > length) break;
+					CommData->Data[dataCnt++] = kvCursor;
+					CommData->Data[dataCnt++] = valueLength;
+					for (uint8_t i = 0; i < valueLength; i++) CommData->Data[dataCnt++] = value[i];
+					list.count++;
 				}
+				list.next = kvCursor;
+				for (uint16_t i = 0; i < sizeof(list); i++) CommData->Data[i] = ((uint8_t *) &list)[i];
+				while (dataCnt < length) CommData->Data[dataCnt++] = 0;
+			}
+			break;
+			case CMD_COMMIT:	// Digest of the records stored in flash
+			{
+				CommitInfo_t info = { 0 };
+				LoRaWAN_keys_t keys;
+				uint8_t config[FLASHSTORE_CONFIG_MAX];
+				uint32_t keysCrc = 0, configCrc = 0;
+				uint8_t configLength = 0;
+				info.keysResult = FlashStore_Read(FLASHSTORE_BLOCK_KEYS, &keys, sizeof(keys), NULL, &keysCrc);
+				info.configResult = FlashStore_Read(FLASHSTORE_BLOCK_CONFIG, config, sizeof(config), &configLength, &configCrc);
+				info.keysCrc = keysCrc;
+				info.configCrc = configCrc;
+				info.configLength = configLength;
+				for (dataCnt = 0; dataCnt < sizeof(info); dataCnt++) CommData->Data[dataCnt] = ((uint8_t *) &info)[dataCnt];
+			}
+			break;
+			default:
+			{
+				CommData->Header.CommandInvalid = true;
+			}
+			break;
+		}
+	}
+	else	// Write Function
+	{
+		switch (CommData->Header.Command)
+		{
+			case CMD_KEYS:
+			{
+				for (dataCnt = 0; dataCnt < sizeof(Keys_0); dataCnt++) ((uint8_t *) &Keys_0)[dataCnt] = CommData->Data[dataCnt];
+			}
+			break;
+			case CMD_LEDS:
+			{
+				leds = * (uint32_t *) &CommData->Data;
+				Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, (leds & 0x00000001) != 0);
+				Cy_GPIO_Write(LED_B_PORT, LED_B_NUM, (leds & 0x00000100) != 0);
+				dataCnt = 4;
 			}
-			else	// Write Function
+			break;
+			case CMD_COMMIT:	// Store Keys_0 and the optional configuration blob in flash
 			{
-				switch (CommData->Header.Command)
+				CommitInfo_t info = { 0 };
+				uint8_t config[FLASHSTORE_CONFIG_MAX];
+				dataCnt = CommData->Header.DataLength;
+				if (dataCnt > sizeof(config)) { dataCnt = 0; break; }
+				for (uint16_t i = 0; i < dataCnt; i++) config[i] = CommData->Data[i];
+				uint32_t keysCrc = 0, configCrc = 0;
+				info.keysResult = FlashStore_Write(FLASHSTORE_BLOCK_KEYS, &Keys_0, sizeof(Keys_0), &keysCrc);
+				if (dataCnt > 0)
 				{
-					case CMD_KEYS:
-					{
-						for (dataCnt = 0; dataCnt < sizeof(Keys_0); dataCnt++) ((uint8_t *) &Keys_0)[dataCnt] = CommData->Data[dataCnt];
-					}
-					break;
-					case CMD_LEDS:
-					{
-						leds = * (uint32_t *) &CommData->Data;
-						Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, (leds & 0x00000001) != 0);
-						Cy_GPIO_Write(LED_B_PORT, LED_B_NUM, (leds & 0x00000100) != 0);
-						dataCnt = 4;
-					}
-					break;
-					case CMD_EXIT:
-						CommData->Header.Command = CMD_IDLE;
-						return;
-					default:
-					{
-						CommData->Header.CommandInvalid = true;
-					}
-					break;
+					info.configResult = FlashStore_Write(FLASHSTORE_BLOCK_CONFIG, config, dataCnt, &configCrc);
+					info.configLength = dataCnt;
 				}
-
+				else info.configResult = flashStore_Empty;
+				info.keysCrc = keysCrc;
+				info.configCrc = configCrc;
+				for (uint16_t i = 0; i < sizeof(info); i++) CommData->Data[i] = ((uint8_t *) &info)[i];
+			}
+			break;
+			case CMD_ADCSTREAM:	// Sample rate (Hz), 0 stops the stream, answers the rate achieved
+			{
+				uint32_t rate = AdcStream_Start(* (uint32_t *) &CommData->Data);
+				* (uint32_t *) &CommData->Data = rate;
+				dataCnt = 4;
+			}
+			break;
+			case CMD_ADCDSP:	// Processing configuration, rejected as an invalid command when out of range
+			{
+				adcDspConfig_t config;
+				for (dataCnt = 0; dataCnt < sizeof(config); dataCnt++) ((uint8_t *) &config)[dataCnt] = CommData->Data[dataCnt];
+				if (!AdcDsp_Configure(&config)) CommData->Header.CommandInvalid = true;
+			}
+			break;
+			case CMD_ADCSCANCFG:	// Scan configuration, rejected as an invalid command when out of range
+			{
+				adcScanConfig_t config;
+				for (dataCnt = 0; dataCnt < sizeof(config); dataCnt++) ((uint8_t *) &config)[dataCnt] = CommData->Data[dataCnt];
+				if (!AdcScan_Configure(&config)) CommData->Header.CommandInvalid = true;
+			}
+			break;
+			case CMD_ADCEVENTCFG:	// Event mode configuration, rejected as an invalid command when out of range
+			{
+				adcEventConfig_t config;
+				for (dataCnt = 0; dataCnt < sizeof(config); dataCnt++) ((uint8_t *) &config)[dataCnt] = CommData->Data[dataCnt];
+				if (!AdcEvent_Configure(&config)) CommData->Header.CommandInvalid = true;
+			}
+			break;
+			case CMD_KVCURSOR:	// Key the next CMD_KVDATA read starts from
+			{
+				kvCursor = (uint8_t) * (uint32_t *) &CommData->Data;
+				dataCnt = 4;
+			}
+			break;
+			case CMD_KVDATA:	// Puts (KVSTORE_DELETED length: deletes) in one commit, rejected as an invalid command when malformed or not stored
+			{
+				uint16_t length = CommData->Header.DataLength;
+				uint8_t data[sizeof(CommData->Data)];
+				if (length > sizeof(data)) break;
+				for (dataCnt = 0; dataCnt < length; dataCnt++) data[dataCnt] = CommData->Data[dataCnt];
+				if (KvStore_Write(data, length) != kvStore_OK) CommData->Header.CommandInvalid = true;
+			}
+			break;
+			case CMD_EXIT:
+				CommData->Header.Command = CMD_IDLE;
+				return true;
+			default:
+			{
+				CommData->Header.CommandInvalid = true;
 			}
-			CommData->Header.SizeInvalid = CommData->Header.DataLength != dataCnt;
-			CommData->Header.DataLength = dataCnt;
-			CommData->Header.Command = CMD_IDLE;
+			break;
 		}
+
 	}
+	CommData->Header.SizeInvalid = CommData->Header.DataLength != dataCnt;
+	CommData->Header.DataLength = dataCnt;
+	CommData->Header.Command = CMD_IDLE;
+	return false;
 }
 
 /* [] END OF FILE */
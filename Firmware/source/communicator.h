@@ -1,3 +1,6 @@
 #pragma once
 
-void Communicator(void);
\ No newline at end of file
+#include <stdbool.h>
+
+void Communicator_Init(void);
+bool Communicator_Poll(void);
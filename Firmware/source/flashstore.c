@@ -0,0 +1,111 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Flash store: checksummed records in LoRaWAN_FlashWrite blocks
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#include "flashstore.h"
+#include <string.h>
+
+static uint8_t recordBuffer[FLASHSTORE_MAX_RECORD] __attribute__ ((aligned(4)));
+
+uint32_t FlashStore_Crc32(const void* data, uint32_t length)
+{
+	const uint8_t* bytes = (const uint8_t*) data;
+	uint32_t crc = 0xFFFFFFFF;
+	while (length--)
+	{
+		crc ^= *bytes++;
+		for (uint8_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+/* Reads and checks the record of a block into recordBuffer */
+static flashStoreResult_e ReadRecord(uint8_t block)
+{
+	flashRecord_t* record = (flashRecord_t*) recordBuffer;
+	if (LoRaWAN_FlashRead(recordBuffer, block, sizeof(flashRecord_t)).system.errorStatus != system_OK) return flashStore_FlashError;
+	if (record->magic != FLASHSTORE_MAGIC || record->length > FLASHSTORE_MAX_PAYLOAD) return flashStore_Empty;
+	if (LoRaWAN_FlashRead(recordBuffer, block, sizeof(flashRecord_t) + record->length).system.errorStatus != system_OK) return flashStore_FlashError;
+	if (FlashStore_Crc32(&recordBuffer[sizeof(flashRecord_t)], record->length) != record->crc) return flashStore_CrcError;
+	return flashStore_OK;
+}
+
+flashStoreResult_e FlashStore_Read(uint8_t block, void* data, uint8_t maxLength, uint8_t* length, uint32_t* crc)
+{
+	flashRecord_t* record = (flashRecord_t*) recordBuffer;
+	flashStoreResult_e result = ReadRecord(block);
+	if (result != flashStore_OK) return result;
+	if (record->length > maxLength) return flashStore_LengthError;
+	memcpy(data, &recordBuffer[sizeof(flashRecord_t)], record->length);
+	if (length) *length = record->length;
+	if (crc) *crc = record->crc;
+	return flashStore_OK;
+}
+
+flashStoreResult_e FlashStore_Write(uint8_t block, const void* data, uint8_t length, uint32_t* crc)
+{
+	flashRecord_t* record = (flashRecord_t*) recordBuffer;
+	if (length > FLASHSTORE_MAX_PAYLOAD) return flashStore_LengthError;
+	uint32_t newCrc = FlashStore_Crc32(data, length);
+	if (crc) *crc = newCrc;
+
+	/* Skip the write when the block already holds this content */
+	if (ReadRecord(block) == flashStore_OK && record->length == length && record->crc == newCrc &&
+		memcmp(&recordBuffer[sizeof(flashRecord_t)], data, length) == 0) return flashStore_Unchanged;
+
+	record->magic = FLASHSTORE_MAGIC;
+	record->length = length;
+	record->reserved = 0;
+	record->crc = newCrc;
+	memcpy(&recordBuffer[sizeof(flashRecord_t)], data, length);
+	if (LoRaWAN_FlashWrite(recordBuffer, block, sizeof(flashRecord_t) + length).system.errorStatus != system_OK) return flashStore_FlashError;
+
+	/* Read back and check the digest of what was stored */
+	if (ReadRecord(block) != flashStore_OK || record->crc != newCrc) return flashStore_FlashError;
+	return flashStore_OK;
+}
+
+bool FlashStore_LoadKeys(LoRaWAN_keys_t* keys)
+{
+	LoRaWAN_keys_t stored;
+	uint8_t length;
+	if (FlashStore_Read(FLASHSTORE_BLOCK_KEYS, &stored, sizeof(stored), &length, NULL) != flashStore_OK || length != sizeof(stored)) return false;
+	*keys = stored;
+	return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,88 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Flash store: checksummed records in LoRaWAN_FlashWrite blocks
+ *
+ * Every block holds one record: an 8 byte header (magic, length, CRC-32 of the
+ * payload) followed by the payload. Writes that do not change the stored
+ * content are skipped to save flash endurance and time.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "OnethinxCore01.h"
+
+/********************************************************************************
+ * BLOCK LAYOUT
+ ********************************************************************************
+ * The stack stores user data in blocks addressed by LoRaWAN_FlashWrite/Read.
+ * Allocate new blocks here so modules never share a block.
+ ********************************************************************************/
+
+#define FLASHSTORE_BLOCK_KEYS		0		// Committed LoRaWAN keys (Keys_0)
+#define FLASHSTORE_BLOCK_CONFIG		1		// Host supplied configuration blob
+#define FLASHSTORE_BLOCK_SAMPLELOG	2		// Sample log ring, FLASHSTORE_SAMPLELOG_BLOCKS blocks
+#define FLASHSTORE_SAMPLELOG_BLOCKS	8
+#define FLASHSTORE_BLOCK_KVSTORE	10		// Key-value store segments, FLASHSTORE_KVSTORE_BLOCKS blocks
+#define FLASHSTORE_KVSTORE_BLOCKS	8
+#define FLASHSTORE_BLOCK_FREE		18		// First unallocated block
+
+#define FLASHSTORE_MAGIC			0x5346	// "FS"
+#define FLASHSTORE_MAX_RECORD		255		// Limited by the uint8_t length of LoRaWAN_FlashWrite
+#define FLASHSTORE_MAX_PAYLOAD		(FLASHSTORE_MAX_RECORD - sizeof(flashRecord_t))
+#define FLASHSTORE_CONFIG_MAX		64		// Maximum size of the configuration blob
+
+typedef struct __attribute__ ((__packed__))
+{
+	uint16_t	magic;						// FLASHSTORE_MAGIC
+	uint8_t		length;						// Payload length
+	uint8_t		reserved;
+	uint32_t	crc;						// CRC-32 of the payload
+} flashRecord_t;
+
+typedef enum __attribute__ ((__packed__))
+{
+	flashStore_OK			= 0x00,			// Record read or written
+	flashStore_Unchanged	= 0x01,			// Write skipped, content already stored
+	flashStore_Empty		= 0x02,			// No valid record in the block
+	flashStore_CrcError		= 0x03,			// Record header found, payload corrupt
+	flashStore_LengthError	= 0x04,			// Record does not fit the buffer
+	flashStore_FlashError	= 0x05,			// Stack flash access failed or read-back mismatch
+} flashStoreResult_e;
+
+uint32_t			FlashStore_Crc32(const void* data, uint32_t length);
+flashStoreResult_e	FlashStore_Read(uint8_t block, void* data, uint8_t maxLength, uint8_t* length, uint32_t* crc);
+flashStoreResult_e	FlashStore_Write(uint8_t block, const void* data, uint8_t length, uint32_t* crc);
+bool				FlashStore_LoadKeys(LoRaWAN_keys_t* keys);
@@ -0,0 +1,371 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Key-value store: a log of CRC-protected records over LoRaWAN_FlashWrite blocks
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#include "kvstore.h"
+#include <string.h>
+
+#define BLOCKS		FLASHSTORE_KVSTORE_BLOCKS
+#define NONE		0xFF					// Index: no record, segment: not written yet
+#define OPEN		0xFE					// Index: record staged in the open segment
+
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	sequence;
+	uint8_t		data[KVSTORE_SEGMENT_DATA];
+} segment_t;
+
+typedef struct
+{
+	uint8_t		block;						// NONE, OPEN or the block of the record
+	uint8_t		offset;						// Of the record in the segment data
+	uint8_t		length;
+} kvIndex_t;
+
+static kvIndex_t keys[KVSTORE_KEYS];
+static segment_t segment;						// Open segment, its last copy is in openBlock
+static uint8_t openBlock;
+static uint8_t openUsed;
+static bool staged;							// Records in the open segment not committed
+static segment_t buffer;					// Segment read from flash
+static uint8_t readBuffer[FLASHSTORE_MAX_RECORD] __attribute__ ((aligned(4)));
+static uint32_t sequences[BLOCKS];			// Sequence of the segment in each block, 0 when not valid
+static uint16_t live[BLOCKS];				// Bytes of the records the index points to
+static uint8_t used[BLOCKS];				// Bytes of all records
+static uint64_t present[BLOCKS];			// Keys with a record in the segment in each block, tombstones included
+static uint64_t openPresent;				// Same for the open segment
+static uint8_t nextBlock;					// Where the search for a free block starts, for wear levelling
+static uint32_t sequence;
+static uint32_t compactions;
+
+static uint8_t RecordSize(uint8_t length)
+{
+	return sizeof(kvRecord_t) + (length == KVSTORE_DELETED ? 0 : length);
+}
+
+static uint16_t RecordCrc(const kvRecord_t* record)
+{
+	return (uint16_t) FlashStore_Crc32(&record->key, RecordSize(record->length) - sizeof(record->crc));
+}
+
+/* Reads the segment in block into buffer, its data length or -1 when not valid */
+static int16_t ReadSegment(uint8_t block)
+{
+	uint8_t length;
+	if (FlashStore_Read(FLASHSTORE_BLOCK_KVSTORE + block, &buffer, sizeof(buffer), &length, NULL) != flashStore_OK ||
+		length < sizeof(buffer.sequence)) return -1;
+	return length - sizeof(buffer.sequence);
+}
+
+static void Recount(void)
+{
+	memset(live, 0, sizeof(live));
+	for (uint8_t key = 0; key < KVSTORE_KEYS; key++)
+		if (keys[key].block < BLOCKS) live[keys[key].block] += RecordSize(keys[key].length);
+}
+
+static bool IsFree(uint8_t block)
+{
+	return live[block] == 0 && block != openBlock;
+}
+
+static uint8_t FreeBlocks(void)
+{
+	uint8_t count = 0;
+	for (uint8_t block = 0; block < BLOCKS; block++) count += IsFree(block);
+	return count;
+}
+
+/* True when a segment other than the one in block still holds a record of key, in use or stale */
+static bool RecordElsewhere(uint8_t key, uint8_t block)
+{
+	for (uint8_t b = 0; b < BLOCKS; b++)
+		if (b != block && sequences[b] != 0 && (present[b] & (1ULL << key))) return true;
+	return false;
+}
+
+void KvStore_Init(void)
+{
+	memset(keys, NONE, sizeof(keys));
+	memset(sequences, 0, sizeof(sequences));
+	memset(used, 0, sizeof(used));
+	memset(present, 0, sizeof(present));
+	openBlock = NONE;
+	openUsed = 0;
+	openPresent = 0;
+	staged = false;
+	sequence = 0;
+	for (uint8_t block = 0; block < BLOCKS; block++)
+		if (ReadSegment(block) >= 0) sequences[block] = buffer.sequence;
+
+	/* Replay the segments oldest first, the newest record of a key wins */
+	for (uint32_t last = 0;;)
+	{
+		uint8_t block = NONE;
+		for (uint8_t b = 0; b < BLOCKS; b++)
+			if (sequences[b] > last && (block == NONE || sequences[b] < sequences[block])) block = b;
+		if (block == NONE) break;
+		last = sequences[block];
+		int16_t length = ReadSegment(block);
+		uint8_t offset = 0;
+		while (length >= 0 && offset + sizeof(kvRecord_t) <= length)
+		{
+			kvRecord_t* record = (kvRecord_t*) &buffer.data[offset];
+			if (record->key >= KVSTORE_KEYS || offset + RecordSize(record->length) > length || RecordCrc(record) != record->crc) break;
+			keys[record->key] = (kvIndex_t) { block, offset, record->length };
+			present[block] |= 1ULL << record->key;
+			offset += RecordSize(record->length);
+		}
+		used[block] = offset;
+		sequence = last;
+		openBlock = block;					// The newest segment stays open
+		openUsed = offset;
+		openPresent = present[block];
+		memcpy(&segment, &buffer, sizeof(segment));
+	}
+	/* Tombstones no other segment needs, like those dropped by a compaction that are left in its free block */
+	for (uint8_t key = 0; key < KVSTORE_KEYS; key++)
+		if (keys[key].block != NONE && keys[key].length == KVSTORE_DELETED && !RecordElsewhere(key, keys[key].block)) keys[key].block = NONE;
+	nextBlock = openBlock == NONE ? 0 : (openBlock + 1) % BLOCKS;
+	Recount();
+}
+
+kvStoreResult_e KvStore_Get(uint8_t key, void* value, uint8_t maxLength, uint8_t* length)
+{
+	if (key >= KVSTORE_KEYS) return kvStore_KeyError;
+	kvIndex_t entry = keys[key];
+	if (entry.block == NONE || entry.length == KVSTORE_DELETED) return kvStore_NotFound;
+	if (entry.length > maxLength) return kvStore_LengthError;
+	const kvRecord_t* record;
+	if (entry.block == OPEN || entry.block == openBlock) record = (const kvRecord_t*) &segment.data[entry.offset];
+	else
+	{
+		/* Only the block up to the end of the record */
+		uint16_t start = sizeof(flashRecord_t) + sizeof(buffer.sequence) + entry.offset;
+		if (LoRaWAN_FlashRead(readBuffer, FLASHSTORE_BLOCK_KVSTORE + entry.block, start + RecordSize(entry.length)).system.errorStatus != system_OK) return kvStore_FlashError;
+		record = (const kvRecord_t*) &readBuffer[start];
+		if (record->key != key || record->length != entry.length || RecordCrc(record) != record->crc) return kvStore_CrcError;
+	}
+	memcpy(value, (const uint8_t*) record + sizeof(kvRecord_t), entry.length);
+	if (length) *length = entry.length;
+	return kvStore_OK;
+}
+
+/* Writes the open segment to the next free block and frees the block of its previous copy */
+kvStoreResult_e KvStore_Commit(void)
+{
+	if (!staged) return kvStore_OK;
+	uint8_t target = NONE;
+	for (uint8_t i = 0; i < BLOCKS && target == NONE; i++)
+		if (IsFree((nextBlock + i) % BLOCKS)) target = (nextBlock + i) % BLOCKS;
+	if (target == NONE) return kvStore_Full;
+	segment.sequence = sequence + 1;
+	if (FlashStore_Write(FLASHSTORE_BLOCK_KVSTORE + target, &segment, sizeof(segment.sequence) + openUsed, NULL) != flashStore_OK)
+	{
+		KvStore_Init();						// Back to what flash holds
+		return kvStore_FlashError;
+	}
+	sequence++;
+	sequences[target] = sequence;
+	used[target] = openUsed;
+	present[target] = openPresent;
+	for (uint8_t key = 0; key < KVSTORE_KEYS; key++)
+		if (keys[key].block == OPEN || (keys[key].block == openBlock && openBlock != NONE)) keys[key].block = target;
+	openBlock = target;
+	nextBlock = (target + 1) % BLOCKS;
+	staged = false;
+	Recount();
+	return kvStore_OK;
+}
+
+static void Append(uint8_t key, const void* value, uint8_t length)
+{
+	kvRecord_t* record = (kvRecord_t*) &segment.data[openUsed];
+	record->key = key;
+	record->length = length;
+	if (length != KVSTORE_DELETED) memcpy((uint8_t*) record + sizeof(kvRecord_t), value, length);
+	record->crc = RecordCrc(record);
+	keys[key] = (kvIndex_t) { OPEN, openUsed, length };
+	openPresent |= 1ULL << key;
+	openUsed += RecordSize(length);
+	staged = true;
+}
+
+/* Moves the live records of the segment with the most stale records to the (empty) open segment,
+   without the tombstones no other segment needs */
+static kvStoreResult_e Compact(void)
+{
+	uint8_t victim = NONE;
+	for (uint8_t block = 0; block < BLOCKS; block++)
+	{
+		if (IsFree(block) || used[block] == live[block]) continue;
+		if (victim == NONE || used[block] - live[block] > used[victim] - live[victim] ||
+			(used[block] - live[block] == used[victim] - live[victim] && sequences[block] < sequences[victim])) victim = block;
+	}
+	if (victim == NONE) return kvStore_Full;
+	int16_t length = ReadSegment(victim);
+	for (uint8_t key = 0; key < KVSTORE_KEYS; key++)
+	{
+		if (keys[key].block != victim) continue;
+		const kvRecord_t* record = (const kvRecord_t*) &buffer.data[keys[key].offset];
+		if (length < 0 || record->key != key || RecordCrc(record) != record->crc) keys[key].block = NONE;	// Lost
+		else if (record->length == KVSTORE_DELETED && !RecordElsewhere(key, victim)) keys[key].block = NONE;
+		else Append(key, (const uint8_t*) record + sizeof(kvRecord_t), record->length);
+	}
+	compactions++;
+	if (!staged) Recount();					// Only tombstones, dropped: the block is free without a write
+	return KvStore_Commit();
+}
+
+/* Makes room for size bytes of records in the open segment: closes it when full, and compacts while a new
+   segment would take the last free block, which the compaction needs */
+static kvStoreResult_e Reserve(uint16_t size)
+{
+	for (uint8_t attempt = 0; openUsed + size > KVSTORE_SEGMENT_DATA || (openBlock == NONE && FreeBlocks() < 2); attempt++)
+	{
+		kvStoreResult_e result = KvStore_Commit();
+		if (result != kvStore_OK) return result;
+		if (attempt == BLOCKS) return kvStore_Full;
+		if (openUsed + size > KVSTORE_SEGMENT_DATA)
+		{
+			openBlock = NONE;
+			openUsed = 0;
+			openPresent = 0;
+		}
+		if (FreeBlocks() < 2 && (result = Compact()) != kvStore_OK) return result;
+	}
+	return kvStore_OK;
+}
+
+/* Adds a put (or a delete: length KVSTORE_DELETED) to the open segment, KvStore_Commit writes it */
+kvStoreResult_e KvStore_Stage(uint8_t key, const void* value, uint8_t length)
+{
+	if (key >= KVSTORE_KEYS) return kvStore_KeyError;
+	if (length > KVSTORE_MAX_VALUE && length != KVSTORE_DELETED) return kvStore_LengthError;
+	if (length == KVSTORE_DELETED)
+	{
+		if (keys[key].block == NONE || keys[key].length == KVSTORE_DELETED) return kvStore_OK;
+	}
+	else if (keys[key].length == length)	// Skip rewriting the same value
+	{
+		uint8_t current[KVSTORE_MAX_VALUE];
+		if (KvStore_Get(key, current, sizeof(current), NULL) == kvStore_OK && memcmp(current, value, length) == 0) return kvStore_OK;
+	}
+
+	uint16_t liveBytes = 0;
+	for (uint8_t k = 0; k < KVSTORE_KEYS; k++)
+		if (k != key && keys[k].block != NONE) liveBytes += RecordSize(keys[k].length);
+	if (liveBytes + RecordSize(length) > KVSTORE_CAPACITY) return kvStore_Full;
+
+	kvStoreResult_e result = Reserve(RecordSize(length));
+	if (result != kvStore_OK) return result;
+	Append(key, value, length);
+	return kvStore_OK;
+}
+
+/* Stores a list of kvEntry_t, each followed by its value, all or nothing: the whole list is checked against
+   the capacity and one open segment before any of it is staged, so staging never commits part of it */
+kvStoreResult_e KvStore_Write(const uint8_t* entries, uint16_t length)
+{
+	uint8_t lengths[KVSTORE_KEYS];			// Record length of each key after the write, NONE without record
+	uint16_t size = 0, offset = 0;
+	for (uint8_t key = 0; key < KVSTORE_KEYS; key++) lengths[key] = keys[key].block == NONE ? NONE : keys[key].length;
+	while (offset + sizeof(kvEntry_t) <= length)
+	{
+		const kvEntry_t* entry = (const kvEntry_t*) &entries[offset];
+		if (entry->key >= KVSTORE_KEYS) return kvStore_KeyError;
+		if (entry->length > KVSTORE_MAX_VALUE && entry->length != KVSTORE_DELETED) return kvStore_LengthError;
+		if (entry->length != KVSTORE_DELETED || lengths[entry->key] != NONE) lengths[entry->key] = entry->length;
+		size += RecordSize(entry->length);
+		offset += sizeof(kvEntry_t) + (entry->length == KVSTORE_DELETED ? 0 : entry->length);
+	}
+	if (offset != length || size > KVSTORE_SEGMENT_DATA) return kvStore_LengthError;
+	uint16_t liveBytes = 0;
+	for (uint8_t key = 0; key < KVSTORE_KEYS; key++)
+		if (lengths[key] != NONE) liveBytes += RecordSize(lengths[key]);
+	if (liveBytes > KVSTORE_CAPACITY) return kvStore_Full;
+
+	kvStoreResult_e result = Reserve(size);
+	for (offset = 0; offset < length && result == kvStore_OK; )
+	{
+		const kvEntry_t* entry = (const kvEntry_t*) &entries[offset];
+		result = KvStore_Stage(entry->key, &entries[offset + sizeof(kvEntry_t)], entry->length);
+		offset += sizeof(kvEntry_t) + (entry->length == KVSTORE_DELETED ? 0 : entry->length);
+	}
+	if (result == kvStore_OK) result = KvStore_Commit();
+	if (result != kvStore_OK) KvStore_Init();	// Drop what was staged, back to what flash holds
+	return result;
+}
+
+kvStoreResult_e KvStore_Put(uint8_t key, const void* value, uint8_t length)
+{
+	if (length == KVSTORE_DELETED) return kvStore_LengthError;
+	kvStoreResult_e result = KvStore_Stage(key, value, length);
+	return result == kvStore_OK ? KvStore_Commit() : result;
+}
+
+kvStoreResult_e KvStore_Delete(uint8_t key)
+{
+	kvStoreResult_e result = KvStore_Stage(key, NULL, KVSTORE_DELETED);
+	return result == kvStore_OK ? KvStore_Commit() : result;
+}
+
+/* First key from key on that has a value, KVSTORE_KEYS when none */
+uint8_t KvStore_Next(uint8_t key)
+{
+	while (key < KVSTORE_KEYS && (keys[key].block == NONE || keys[key].length == KVSTORE_DELETED)) key++;
+	return key;
+}
+
+void KvStore_GetInfo(kvStoreInfo_t* info)
+{
+	memset(info, 0, sizeof(*info));
+	for (uint8_t key = 0; key < KVSTORE_KEYS; key++)
+	{
+		if (keys[key].block == NONE) continue;
+		info->liveBytes += RecordSize(keys[key].length);
+		if (keys[key].length != KVSTORE_DELETED) info->keys++;
+	}
+	info->freeBlocks = FreeBlocks();
+	info->blocks = BLOCKS;
+	info->maxValue = KVSTORE_MAX_VALUE;
+	info->capacity = KVSTORE_CAPACITY;
+	info->sequence = sequence;
+	info->compactions = compactions;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,130 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Key-value store: a log of CRC-protected records over LoRaWAN_FlashWrite blocks
+ *
+ * Keys are numbers from 0 to KVSTORE_KEYS - 1, values up to KVSTORE_MAX_VALUE
+ * bytes. The store uses the flash store blocks FLASHSTORE_BLOCK_KVSTORE
+ * onwards, one segment per block: a sequence number followed by records, each
+ * with a CRC over its key, length and value. A put appends a record to the
+ * open segment, a delete appends a record without value (a tombstone).
+ *
+ * Segments are written copy-on-write: every commit writes the open segment
+ * with a new sequence number to a free block, taken in turn, and frees the
+ * block of its previous copy. A power loss during a write leaves the previous
+ * copy intact, and the writes go round all blocks instead of wearing one.
+ * When the open segment is full it is closed and a new one opened; when that
+ * would leave no free block, the segment with the most stale bytes is
+ * compacted: its live records move to the new segment and its block is free.
+ *
+ * KvStore_Write stores a list of puts and deletes (the CMD_KVDATA format) in
+ * one segment write, all or nothing: a list larger than a segment, or one the
+ * store has no room for, is refused before anything is staged.
+ *
+ * KvStore_Init rebuilds the index in RAM from the blocks, in sequence order,
+ * the newest record of a key wins. The index holds the block and offset of
+ * every key, so reads go straight to the record (or to the open segment in
+ * RAM) without scanning blocks. A tombstone stays live while another segment,
+ * even one in a free block, still holds a record of its key: that record must
+ * not come back at the next boot. Compaction drops the other tombstones.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flashstore.h"
+
+#define KVSTORE_KEYS				64
+#define KVSTORE_MAX_VALUE			64
+#define KVSTORE_DELETED				0xFF	// Record length of a tombstone
+#define KVSTORE_SEGMENT_DATA		(FLASHSTORE_MAX_PAYLOAD - sizeof(uint32_t))
+#define KVSTORE_MAX_RECORD			(sizeof(kvRecord_t) + KVSTORE_MAX_VALUE)
+#define KVSTORE_CAPACITY			((FLASHSTORE_KVSTORE_BLOCKS - 2) * (KVSTORE_SEGMENT_DATA - KVSTORE_MAX_RECORD))	// Live bytes the compaction always finds room for
+
+typedef struct __attribute__ ((__packed__))
+{
+	uint16_t	crc;						// CRC-32 of key, length and value, lower half
+	uint8_t		key;
+	uint8_t		length;						// Value length, KVSTORE_DELETED for a tombstone
+} kvRecord_t;
+
+typedef enum __attribute__ ((__packed__))
+{
+	kvStore_OK				= 0x00,
+	kvStore_NotFound		= 0x01,			// Key without value
+	kvStore_KeyError		= 0x02,			// Key out of range
+	kvStore_LengthError		= 0x03,			// Value too long, or does not fit the buffer
+	kvStore_Full			= 0x04,			// Compaction found no room
+	kvStore_CrcError		= 0x05,			// Record corrupt
+	kvStore_FlashError		= 0x06,			// Stack flash access failed, the store is rebuilt from flash
+} kvStoreResult_e;
+
+/* Result of CMD_KVINFO */
+typedef struct __attribute__ ((__packed__))
+{
+	uint8_t		keys;						// Keys with a value
+	uint8_t		freeBlocks;
+	uint8_t		blocks;
+	uint8_t		maxValue;
+	uint16_t	liveBytes;					// Records in use, tombstones included
+	uint16_t	capacity;					// KVSTORE_CAPACITY
+	uint32_t	sequence;					// Segment writes
+	uint32_t	compactions;				// Since boot
+} kvStoreInfo_t;
+
+/* Mailbox entry of CMD_KVDATA, followed by the value */
+typedef struct __attribute__ ((__packed__))
+{
+	uint8_t		key;
+	uint8_t		length;						// KVSTORE_DELETED deletes the key (write)
+} kvEntry_t;
+
+/* Result of CMD_KVDATA, followed by count entries */
+typedef struct __attribute__ ((__packed__))
+{
+	uint8_t		count;
+	uint8_t		next;						// Key to read on from, KVSTORE_KEYS after the last key
+} kvList_t;
+
+void			KvStore_Init(void);
+kvStoreResult_e	KvStore_Get(uint8_t key, void* value, uint8_t maxLength, uint8_t* length);
+kvStoreResult_e	KvStore_Stage(uint8_t key, const void* value, uint8_t length);
+kvStoreResult_e	KvStore_Commit(void);
+kvStoreResult_e	KvStore_Write(const uint8_t* entries, uint16_t length);
+kvStoreResult_e	KvStore_Put(uint8_t key, const void* value, uint8_t length);
+kvStoreResult_e	KvStore_Delete(uint8_t key);
+uint8_t			KvStore_Next(uint8_t key);
+void			KvStore_GetInfo(kvStoreInfo_t* info);
+
+/* [] END OF FILE */
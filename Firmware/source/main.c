@@ -46,6 +46,15 @@
 #include <stdbool.h>
 #include <PrintF.h>
 #include "maestro.h"
+#include "flashstore.h"
+#include "adcstream.h"
+#include "adcdsp.h"
+#include "adcevent.h"
+#include "sched.h"
+#include "aggregate.h"
+#include "samplelog.h"
+#include "kvstore.h"
+#include <string.h>
 
 coreConfiguration_t	coreConfig = {
 	.Join =
@@ -81,14 +90,22 @@ coreConfiguration_t	coreConfig = {
 
 sleepConfig_t sleepConfig =
 {
-	.sleepMode = modeDeepSleep,
+	.sleepMode = modeDeepSleep,			// modeHibernate_MACsave: hibernate between readings, kept in the sample log
 	.BleEcoON = false,
 	.DebugON = true,
 	.sleepCores = coresBoth,
 	.wakeUpPin = wakeUpPinHigh(true),
-	.wakeUpTime = wakeUpDelay(0, 0, 10, 0), // day, hour, minute, second
+	.wakeUpTime = wakeUpTimeOff,			// set by the scheduler to the next timer
 };
 
+#define SAMPLE_INTERVAL_MS		(2 * 60 * 1000)
+#define UPLINK_INTERVAL_MS		(10 * 60 * 1000)	// Latency deadline of a batch of readings
+#define READING_VALUES			4		// Mean, min, max, RMS
+#define COMM_POLL_MS			10
+#define JOIN_BLINK_MS			400
+#define STATS_POLL_MS			100
+#define UPLINK_BUFFERS			4		// Uplinks queued in the core at once, an event burst queues up
+
 FirmwareInfo_t FirmwareInfo =
 {
     .FirmwareVersion        = 0x00000100,
@@ -108,59 +125,326 @@ volatile uint32_t leds = 0;
 
 int32_t GetADCvoltage()
 {
+	/* while streaming, the latest sample is served without a conversion */
+	adcSample_t sample;
+	if (AdcStream_IsRunning())
+	{
+		while (!AdcStream_Latest(&sample)) {}	// only waits for the first sample after a start or wakeup
+		return sample.millivolts;
+	}
 	ADC_StartConvert();
 	while (ADC_IsEndConversion(CY_SAR_WAIT_FOR_RESULT) == 0) {}
 	int32_t adcResult = ADC_GetResult32(0);
 	return ADC_CountsTo_mVolts(0, adcResult);
 }
 
-int main(void)
+static schedTimer_t commTimer, blinkTimer, sampleTimer, statsTimer;
+static bool released;						// Host sent CMD_EXIT
+static bool joined;
+static uint8_t sending;						// Uplinks queued in the core
+static uint8_t sendNext;
+static volatile bool awaitingStats;
+static bool sendNow;						// Woken by the wake-up pin
+static uint8_t uplinks[UPLINK_BUFFERS][AGGREGATE_MAX_FRAME];	// Stay valid while the core sends them
+static coreHandle_t uplinkHandles[UPLINK_BUFFERS];
+
+static void Join(void* arg);
+static void SendEvent(void* arg);
+static void SendLog(void* arg);
+static void JoinDone(void* arg);
+
+/* Hibernate loses the RAM and restarts at the wake-up, the readings wait in the sample log */
+static bool Hibernating(void)
 {
-	/* enable global interrupts */
-	__enable_irq();
+	return sleepConfig.sleepMode >= modeHibernate;
+}
 
-	/* initialize radio with parameters in coreConfig */
-	coreStatus = LoRaWAN_Init(&coreConfig);
-	coreStatus = LoRaWAN_GetInfo(&coreInfo);
-	PrintF_Start();
-	ADC_Start();
-	
-	int32_t voltage = GetADCvoltage(CY_SAR_WAIT_FOR_RESULT);
-	printf("Reset occured, reading voltage: %ld Volt\n", voltage);
+static void SetLeds(uint8_t red, uint8_t blue)
+{
+	Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, red);
+	Cy_GPIO_Write(LED_B_PORT, LED_B_NUM, blue);
+}
+
+/* Event mode needs the SAR converting, which it does not in deep sleep */
+static void HoldForEvents(void)
+{
+	static bool holding;
+	if (AdcEvent_IsEnabled() == holding) return;
+	holding = !holding;
+	if (holding) Sched_Hold(schedPower_Sleep);
+	else Sched_Release(schedPower_Sleep);
+}
+
+/* Serves the host mailbox, the device stays awake until the host sends CMD_EXIT */
+static void Communicate(void* arg)
+{
+	bool exit = Communicator_Poll();
+	HoldForEvents();
+	if (!exit || released) return;
+	released = true;
+	commTimer.deferrable = true;			// Served whenever awake from now on
+	Sched_Release(schedPower_Sleep);
+	Sched_Post(Join, NULL);
+}
+
+/* The core completes the uplinks in order, the oldest buffer is free again */
+static void SendDone(void* arg)
+{
+	coreStatus_t status;
+	uint8_t oldest = (uint8_t) (sendNext - sending) % UPLINK_BUFFERS;
+	Sched_Release(schedPower_Sleep);
+	sending--;
+	if (LoRaWAN_GetRequest(uplinkHandles[oldest], &status) == coreRequest_Done &&
+		(status.parameters.errorStatus | status.radio.errorStatus | status.mac.errorStatus | status.system.errorStatus) != 0)
+		Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, 1);
+	Sched_Post(SendEvent, NULL);			// Next queued event, if any
+	if (SampleLog_Count() > 0 || (Aggregate_Count() > 0 && (Hibernating() || Aggregate_IsDue(Sched_Now())))) Sched_Post(SendLog, NULL);
+}
 
-	Communicator();
+static schedSignal_t sendDone = { .task = SendDone };
+static schedSignal_t joinDone = { .task = JoinDone };
 
-	Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, 0);
-	Cy_GPIO_Write(LED_B_PORT, LED_B_NUM, 1);
+/* Core completion callbacks run from the IPC interrupt, the work is done in a task; a signal, as a lost
+   completion would keep its uplink buffer and sleep hold forever */
+static void CoreDone(coreHandle_t handle, coreStatus_t status, void* signal)
+{
+	Sched_Signal((schedSignal_t*) signal);
+}
+
+/* Queues an uplink behind the ones in progress, false when all buffers are in use */
+static bool Send(const void* data, uint8_t length)
+{
+	if (sending == UPLINK_BUFFERS) return false;
+	uint8_t* buffer = uplinks[sendNext % UPLINK_BUFFERS];
+	memcpy(buffer, data, length);
+	coreHandle_t handle = LoRaWAN_SendAsync(buffer, length, CoreDone, &sendDone);
+	if (handle == 0)
+	{
+		Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, 1);
+		return false;
+	}
+	uplinkHandles[sendNext % UPLINK_BUFFERS] = handle;
+	sendNext++;
+	sending++;
+	Sched_Hold(schedPower_Sleep);			// Until the core is done, the CM4 sleeps meanwhile
+	return true;
+}
+
+/* Event mode: only the events go out over the radio, as they come */
+static void SendEvent(void* arg)
+{
+	adcEvent_t event;
+	while (joined && sending < UPLINK_BUFFERS && AdcEvent_Take(&event))
+		Send(&event, ADCEVENT_UPLINK_SIZE(&event));
+}
+
+static void EventQueued(void)
+{
+	Sched_Post(SendEvent, NULL);
+}
+
+/* Sends the batch, it stays batched when no uplink buffer is free or the core queue is full */
+static bool SendBatch(uint32_t now)
+{
+	uint8_t frame[AGGREGATE_MAX_FRAME];
+	uint8_t length = Aggregate_Encode(now, frame);
+	if (length > 0 && !Send(frame, length)) return false;
+	Aggregate_Clear();
+	return true;
+}
+
+static bool SendRaw(const int16_t* values)
+{
+	uint8_t frame[AGGREGATE_MAX_FRAME];
+	return Send(frame, Aggregate_Raw(values, frame));
+}
+
+/* Adds a reading to the batch, sending the batch first when it is full; false when that uplink could not be queued */
+static bool BatchReading(uint32_t now, uint32_t time, const int16_t* values)
+{
+	if (Aggregate_Add(time, values)) return true;
+	if (!SendBatch(now)) return false;
+	return Aggregate_Add(time, values) || SendRaw(values);	// Larger than a frame at this data rate
+}
+
+/* Sends the logged readings in batches, as far as the uplink buffers allow; the rest stays logged */
+static void SendLog(void* arg)
+{
+	sampleLogReading_t reading;
+	int16_t values[SAMPLELOG_VALUES];		// Aligned copy of the packed reading
+	uint32_t now = Sched_Now();
+	uint32_t clock = Sched_Clock();
+	while (joined && SampleLog_Oldest(&reading))
+	{
+		uint32_t time = now - (clock - reading.time) * 1000;
+		memcpy(values, reading.values, sizeof(values));
+		if (!BatchReading(now, time, values)) return;	// SendDone carries on
+		SampleLog_Remove();
+	}
+	if (sendNow || Hibernating() || Aggregate_IsDue(now)) SendBatch(now);
+}
 
-	coreStatus = LoRaWAN_Join(M4_NoWait);
+/* Logs a reading, the log goes out when its oldest reading reaches the latency deadline */
+static void LogReading(const int16_t* values)
+{
+	sampleLogReading_t reading;
+	reading.time = Sched_Clock();
+	memcpy(reading.values, values, sizeof(reading.values));
+	SampleLog_Append(&reading);
+	if (sendNow || (SampleLog_Oldest(&reading) && Sched_Clock() - reading.time >= UPLINK_INTERVAL_MS / 1000))
+		SendLog(NULL);
+	sendNow = false;
+}
 
-	/* Flash LEDs while joining */
-	while (LoRaWAN_GetStatus().system.isBusy)
+/* Adds mean, min, max and RMS (mV) to the batch, all the same single conversion without statistics;
+   the batch goes out when the next reading does not fit the frame or the oldest one is due */
+static void SendStats(const adcStats_t* stats)
+{
+	int16_t reading[READING_VALUES];
+	uint32_t now = Sched_Now();
+	if (stats != NULL)
 	{
-		Cy_GPIO_Inv(LED_R_PORT, LED_R_NUM);
-		Cy_GPIO_Inv(LED_B_PORT, LED_B_NUM);
-		CyDelay(400);
+		reading[0] = stats->mean;
+		reading[1] = stats->min;
+		reading[2] = stats->max;
+		reading[3] = (int16_t) stats->rms;
 	}
+	else reading[0] = reading[1] = reading[2] = reading[3] = (int16_t) GetADCvoltage(CY_SAR_WAIT_FOR_RESULT);
+	awaitingStats = false;
+	Sched_TimerStop(&statsTimer);
+	Sched_Release(schedPower_Sleep);
+	/* Behind the readings waiting in the log, or into the log when no uplink could be queued: SendDone sends them */
+	if (Hibernating() || SampleLog_Count() > 0 || !BatchReading(now, now, reading))
+	{
+		LogReading(reading);
+		return;
+	}
+	if (sendNow || Aggregate_IsDue(now)) SendBatch(now);	// Stays batched when it cannot go yet
+	sendNow = false;
+}
+
+static void StatsReady(void* arg)
+{
+	adcStats_t stats;
+	if (!awaitingStats) return;
+	AdcDsp_GetStats(&stats);
+	SendStats(&stats);
+}
+
+static void WindowCompleted(void)
+{
+	if (awaitingStats) Sched_Post(StatsReady, NULL);
+}
+
+/* Falls back to a single conversion when the stream stops before the window completes */
+static void StatsCheck(void* arg)
+{
+	if (awaitingStats && !AdcStream_IsRunning()) SendStats(NULL);
+}
+
+/* Statistics of the next processing window (mean, min, max, RMS in mV) instead of a raw sample */
+static void Sample(void* arg)
+{
+	SetLeds(0, 1);
+	if (AdcEvent_IsEnabled() || awaitingStats) return;
+	Sched_Hold(schedPower_Sleep);			// The stream stops in deep sleep
+	awaitingStats = true;
+	if (AdcStream_IsRunning()) Sched_TimerStart(&statsTimer, StatsCheck, NULL, STATS_POLL_MS, STATS_POLL_MS);
+	else SendStats(NULL);
+}
+
+static void JoinBlink(void* arg)
+{
+	Cy_GPIO_Inv(LED_R_PORT, LED_R_NUM);
+	Cy_GPIO_Inv(LED_B_PORT, LED_B_NUM);
+}
+
+/* Joined: a reading now and every interval */
+static void Started(void)
+{
+	joined = true;
+	Aggregate_SetFrameSize(Aggregate_MaxPayload(coreInfo.stackRegion, coreConfig.TX.DataRate));
+	Sched_TimerStart(&sampleTimer, Sample, NULL, 0, SAMPLE_INTERVAL_MS);
+	Sched_Post(SendEvent, NULL);			// Events queued while joining
+}
+
+static void JoinDone(void* arg)
+{
+	Sched_TimerStop(&blinkTimer);
+	Sched_Release(schedPower_Sleep);
 	if (!LoRaWAN_GetStatus().mac.isJoined)	// Perform reset LoRaWAN join failed.
 	{
 		*((uint32_t *) 0x40210000) = 0x05FA0000;   // SW RESET M4
 		NVIC_SystemReset();
 	}
+	sendNow = true;							// First reading right away, as a sign of life
+	Started();
+}
 
-	/* main loop */
-	for(;;)
-	{
-		Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, 0);
-		Cy_GPIO_Write(LED_B_PORT, LED_B_NUM, 1);
-		int32_t voltage = GetADCvoltage(CY_SAR_WAIT_FOR_RESULT);
-		/* Send message over LoRaWAN */
-        coreStatus = LoRaWAN_Send((uint8_t *) &voltage, 4, M4_WaitDeepSleep);
+/* Flash LEDs while joining */
+static void Join(void* arg)
+{
+	SetLeds(0, 1);
+	Sched_Hold(schedPower_Sleep);
+	if (LoRaWAN_JoinAsync(CoreDone, &joinDone) == 0) Sched_Signal(&joinDone);	// Not started, resets
+	Sched_TimerStart(&blinkTimer, JoinBlink, NULL, JOIN_BLINK_MS, JOIN_BLINK_MS);
+}
+
+/* Last chance before LoRaWAN_Sleep, hibernate does not return */
+static void Sleeping(void)
+{
+	AdcStream_Sleep();
+	if (Hibernating()) SampleLog_Flush();
+}
+
+/* Wake-up pin: sample and send the batch right away */
+static void Wakeup(void)
+{
+	AdcStream_Wakeup();
+	if (!sampleTimer.active || (int32_t) (Sched_Now() - sampleTimer.due) >= 0) return;	// RTC wake-up for the timer
+	sendNow = true;
+	Sched_TimerStart(&sampleTimer, Sample, NULL, 0, SAMPLE_INTERVAL_MS);
+}
 
-		if (LoRaWAN_GetError().errorValue != errorStatus_NoError)
-			Cy_GPIO_Write(LED_R_PORT, LED_R_NUM, 1);
+int main(void)
+{
+	/* enable global interrupts */
+	__enable_irq();
 
-		/* Sleep before sending next message, wake up with a button as well */
-		LoRaWAN_Sleep(&sleepConfig);
+	/* initialize radio with parameters in coreConfig */
+	coreStatus = LoRaWAN_Init(&coreConfig);
+	coreStatus = LoRaWAN_GetInfo(&coreInfo);
+	PrintF_Start();
+
+	/* use keys committed by the host instead of the build-time keys */
+	if (FlashStore_LoadKeys(&Keys_0)) printf("Using committed LoRaWAN keys\n");
+	ADC_Start();
+	AdcStream_Start(ADCSTREAM_DEFAULT_RATE);
+	AdcDsp_SetNotify(WindowCompleted);
+	AdcEvent_SetNotify(EventQueued);
+	Aggregate_Init(READING_VALUES, UPLINK_INTERVAL_MS);
+	SampleLog_Init();
+	KvStore_Init();
+
+	int32_t voltage = GetADCvoltage(CY_SAR_WAIT_FOR_RESULT);
+	printf("Reset occured, reading voltage: %ld Volt\n", voltage);
+
+	/* Tasks: the host mailbox until CMD_EXIT, then join, then a reading every interval, sent in batches */
+	Sched_Init(&sleepConfig);
+	Sched_SetDeepSleepHooks(Sleeping, Wakeup);
+	Communicator_Init();
+	if ((Cy_SysLib_GetResetReason() & CY_SYSLIB_RESET_HIB_WAKEUP) && LoRaWAN_GetStatus().mac.isJoined)
+	{
+		/* Woken from hibernate, the MAC state was saved: carry on sampling */
+		released = true;
+		commTimer.deferrable = true;
+		Sched_TimerStart(&commTimer, Communicate, NULL, 0, COMM_POLL_MS);
+		Started();
 	}
-}
\ No newline at end of file
+	else
+	{
+		Sched_Hold(schedPower_Sleep);		// Until the host releases the device
+		Sched_TimerStart(&commTimer, Communicate, NULL, 0, COMM_POLL_MS);
+	}
+	Sched_Run();
+}
@@ -0,0 +1,184 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Sample log: readings kept in flash across hibernate, for a later uplink
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#include "samplelog.h"
+#include <string.h>
+
+#define BLOCKS		FLASHSTORE_SAMPLELOG_BLOCKS
+
+typedef struct __attribute__ ((__packed__))
+{
+	sampleLogPage_t		header;
+	sampleLogReading_t	readings[SAMPLELOG_PAGE_READINGS];
+} page_t;
+
+static page_t cache;						// Page being filled, page head
+static page_t oldestPage;					// Page oldest, read from flash
+static uint32_t head;
+static uint32_t oldest;						// Oldest reading not taken: page and index
+static uint8_t oldestIndex;
+static uint8_t counts[BLOCKS];				// Readings of the pages oldest to head - 1
+static bool dirty;							// Cache or oldest changed since the last flush
+
+static uint8_t Block(uint32_t sequence)
+{
+	return FLASHSTORE_BLOCK_SAMPLELOG + sequence % BLOCKS;
+}
+
+static bool IsPage(const page_t* page, uint8_t length)
+{
+	return length >= sizeof(sampleLogPage_t) && page->header.count <= SAMPLELOG_PAGE_READINGS &&
+		length == sizeof(sampleLogPage_t) + page->header.count * sizeof(sampleLogReading_t);
+}
+
+/* Reads page sequence into buffer, false when it is not intact */
+static bool ReadPage(uint32_t sequence, page_t* buffer)
+{
+	uint8_t length;
+	if (FlashStore_Read(Block(sequence), buffer, sizeof(page_t), &length, NULL) != flashStore_OK) return false;
+	return IsPage(buffer, length) && buffer->header.sequence == sequence;
+}
+
+void SampleLog_Init(void)
+{
+	uint32_t newest = 0;
+	uint8_t length;
+	for (uint8_t block = 0; block < BLOCKS; block++)
+	{
+		/* The block of page n is n % BLOCKS, the newest intact page holds the log state */
+		if (FlashStore_Read(FLASHSTORE_BLOCK_SAMPLELOG + block, &cache, sizeof(page_t), &length, NULL) == flashStore_OK &&
+			IsPage(&cache, length) && cache.header.sequence % BLOCKS == block && cache.header.sequence > newest)
+			newest = cache.header.sequence;
+	}
+	memset(counts, 0, sizeof(counts));
+	memset(&oldestPage, 0, sizeof(oldestPage));	// Sequence 0: no page loaded
+	dirty = false;
+	if (newest == 0 || !ReadPage(newest, &cache))
+	{
+		head = oldest = 1;					// Empty log
+		oldestIndex = 0;
+		memset(&cache, 0, sizeof(cache));
+		return;
+	}
+	head = newest;
+	oldest = cache.header.oldest;
+	oldestIndex = cache.header.oldestIndex;
+	if (oldest > head || head - oldest >= BLOCKS)	// Not written by this log
+	{
+		oldest = head > BLOCKS - 1 ? head - (BLOCKS - 1) : 1;
+		oldestIndex = 0;
+	}
+	for (uint32_t sequence = oldest; sequence != head; sequence++)
+		counts[sequence % BLOCKS] = ReadPage(sequence, &oldestPage) ? oldestPage.header.count : 0;
+	oldestPage.header.sequence = 0;
+}
+
+void SampleLog_Flush(void)
+{
+	if (!dirty) return;
+	cache.header.sequence = head;
+	cache.header.oldest = oldest;
+	cache.header.oldestIndex = oldestIndex;
+	cache.header.reserved = 0;
+	FlashStore_Write(Block(head), &cache, sizeof(sampleLogPage_t) + cache.header.count * sizeof(sampleLogReading_t), NULL);
+	dirty = false;
+}
+
+void SampleLog_Append(const sampleLogReading_t* reading)
+{
+	if (cache.header.count == SAMPLELOG_PAGE_READINGS)
+	{
+		/* Full page: write it and start the next one, overwriting the oldest page when the ring is full */
+		SampleLog_Flush();
+		counts[head % BLOCKS] = cache.header.count;
+		head++;
+		cache.header.count = 0;
+		if (head - oldest >= BLOCKS)
+		{
+			oldest = head - (BLOCKS - 1);
+			oldestIndex = 0;
+		}
+	}
+	cache.readings[cache.header.count++] = *reading;
+	dirty = true;
+}
+
+uint16_t SampleLog_Count(void)
+{
+	uint16_t count = cache.header.count;
+	for (uint32_t sequence = oldest; sequence != head; sequence++) count += counts[sequence % BLOCKS];
+	return count - oldestIndex;
+}
+
+/* Reads the oldest reading not taken, false when the log is empty */
+bool SampleLog_Oldest(sampleLogReading_t* reading)
+{
+	while (oldest != head)
+	{
+		if (oldestIndex < counts[oldest % BLOCKS])
+		{
+			if (oldestPage.header.sequence != oldest && (!ReadPage(oldest, &oldestPage) || oldestPage.header.count != counts[oldest % BLOCKS]))
+			{
+				oldestPage.header.sequence = 0;
+				counts[oldest % BLOCKS] = 0;	// Corrupted since the scan, skip the page
+			}
+			else
+			{
+				*reading = oldestPage.readings[oldestIndex];
+				return true;
+			}
+		}
+		oldest++;
+		oldestIndex = 0;
+		dirty = true;
+	}
+	if (oldestIndex >= cache.header.count) return false;
+	*reading = cache.readings[oldestIndex];
+	return true;
+}
+
+/* Takes the reading SampleLog_Oldest returned, persisted with the next flush */
+void SampleLog_Remove(void)
+{
+	sampleLogReading_t reading;
+	if (!SampleLog_Oldest(&reading)) return;
+	oldestIndex++;
+	dirty = true;
+}
+
+/* [] END OF FILE */
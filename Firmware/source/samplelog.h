@@ -0,0 +1,84 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Sample log: readings kept in flash across hibernate, for a later uplink
+ *
+ * In hibernate the CM4 RAM is lost and the device restarts at every wake-up,
+ * so readings waiting for an uplink are appended to a log in the flash store
+ * blocks FLASHSTORE_BLOCK_SAMPLELOG onwards. The log is a ring of pages, one
+ * page per block: page n lives in block n % FLASHSTORE_SAMPLELOG_BLOCKS, so
+ * the pages are written in turn and the wear spreads over all blocks. When
+ * the ring is full the oldest page is overwritten.
+ *
+ * The page being filled is cached in RAM and written on SampleLog_Flush,
+ * called before LoRaWAN_Sleep, and when it is full. Every page records the
+ * oldest reading not yet taken, the newest page tells where the log starts
+ * after a restart. SampleLog_Init rebuilds the state from the blocks and
+ * reloads a partly filled newest page into the cache, so flushes at every
+ * hibernate keep filling that page instead of starting a new one.
+ *
+ * Readings taken and not flushed yet are taken again after a restart.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flashstore.h"
+
+#define SAMPLELOG_VALUES			4		// Values per reading
+#define SAMPLELOG_PAGE_READINGS		19		// Readings per page, header and readings fit FLASHSTORE_MAX_PAYLOAD
+
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	time;						// RTC seconds since 2000 (Sched_Clock)
+	int16_t		values[SAMPLELOG_VALUES];
+} sampleLogReading_t;
+
+typedef struct __attribute__ ((__packed__))
+{
+	uint32_t	sequence;					// Page number, the block is sequence % FLASHSTORE_SAMPLELOG_BLOCKS
+	uint32_t	oldest;						// Page of the oldest reading not taken
+	uint8_t		oldestIndex;				// Its index in that page
+	uint8_t		count;						// Readings in this page
+	uint16_t	reserved;
+} sampleLogPage_t;
+
+void		SampleLog_Init(void);
+void		SampleLog_Append(const sampleLogReading_t* reading);
+void		SampleLog_Flush(void);
+uint16_t	SampleLog_Count(void);
+bool		SampleLog_Oldest(sampleLogReading_t* reading);
+void		SampleLog_Remove(void);
+
+/* [] END OF FILE */
@@ -0,0 +1,314 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Scheduler: cooperative run-to-completion tasks for the CM4 main loop
+ *
+ ********************************************************************************/
+
+#include "project.h"
+#include "sched.h"
+
+#define SCHED_IMO_HZ				8000000u	// Internal main oscillator, keeps the tick running in CPU sleep
+
+typedef struct
+{
+	schedTask_t	task;
+	void*		arg;
+} schedEvent_t;
+
+static volatile uint32_t ticks;
+static schedTimer_t* timers;				// Sorted by due time
+static schedEvent_t events[SCHED_EVENTS];
+static volatile uint32_t eventHead, eventTail;
+static volatile uint32_t lostEvents;		// Posts refused by a full FIFO
+static schedSignal_t* signals;				// Raised at least once
+static volatile uint32_t signalsPending;
+static uint16_t holds[schedPower_Active + 1];
+static sleepConfig_t sleepConfig;
+static void (*beforeDeepSleep)(void);
+static void (*afterDeepSleep)(void);
+static dateTime_t clockRead;				// Filled in by the core
+static volatile uint32_t clockSeconds;		// RTC seconds since 2000 at tick clockTicks
+static volatile uint32_t clockTicks;
+static volatile bool clockPending;			// RTC read under way, deep sleep waits for it
+static volatile bool clockResync;			// The tick stopped in deep sleep, advance it to the RTC
+
+static void Sched_Tick(void)
+{
+	ticks++;
+}
+
+static uint32_t Sched_Seconds(const dateTime_t* dt)
+{
+	static const uint16_t daysBefore[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+	uint32_t days = dt->Year * 365 + (dt->Year + 3) / 4 + daysBefore[dt->Month] + dt->DayOfMonth;
+	if (dt->Month > 1 && dt->Year % 4 == 0) days++;
+	return ((days * 24 + dt->Hour) * 60 + dt->Minute) * 60 + dt->Second;
+}
+
+/* Takes the RTC time from the core, from the IPC interrupt */
+static void Sched_ClockRead(coreHandle_t handle __attribute__((unused)), coreStatus_t status, void* context __attribute__((unused)))
+{
+	if (status.system.errorStatus == system_OK)
+	{
+		uint32_t seconds = Sched_Seconds(&clockRead);
+		uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+		int32_t slept = (int32_t) (seconds - (clockSeconds + (ticks - clockTicks) / SCHED_TICK_HZ));
+		if (clockResync && slept > 0) ticks += slept * SCHED_TICK_HZ;
+		clockSeconds = seconds;
+		clockTicks = ticks;
+		Cy_SysLib_ExitCriticalSection(interruptState);
+	}
+	clockResync = false;
+	clockPending = false;
+}
+
+/* Requests the RTC of the core, queued behind the requests before it (a join or uplink may take seconds);
+   the tick keeps time and runs the timers meanwhile, the RTC corrects it once read */
+static void Sched_ClockRefresh(bool resync)
+{
+	clockResync = resync;
+	clockPending = true;
+	if (LoRaWAN_GetDateTimeAsync(&clockRead, Sched_ClockRead, NULL) == 0)
+	{
+		clockResync = false;
+		clockPending = false;
+	}
+}
+
+void Sched_Init(const sleepConfig_t* deepSleep)
+{
+	sleepConfig = *deepSleep;
+	Cy_SysTick_Init(CY_SYSTICK_CLOCK_SOURCE_CLK_IMO, SCHED_IMO_HZ / SCHED_TICK_HZ - 1);
+	Cy_SysTick_SetCallback(0, Sched_Tick);
+	Sched_ClockRefresh(false);
+}
+
+uint32_t Sched_Now(void)
+{
+	return ticks;
+}
+
+static void Sched_Insert(schedTimer_t* timer)
+{
+	schedTimer_t** link = &timers;
+	while (*link != NULL && (int32_t) ((*link)->due - timer->due) <= 0) link = &(*link)->next;
+	timer->next = *link;
+	*link = timer;
+	timer->active = true;
+}
+
+/* Starts (or restarts) a timer, its task runs after delay ms and then every period ms */
+void Sched_TimerStart(schedTimer_t* timer, schedTask_t task, void* arg, uint32_t delay, uint32_t period)
+{
+	Sched_TimerStop(timer);
+	timer->task = task;
+	timer->arg = arg;
+	timer->due = ticks + delay;
+	timer->period = period;
+	Sched_Insert(timer);
+}
+
+void Sched_TimerStop(schedTimer_t* timer)
+{
+	if (!timer->active) return;
+	for (schedTimer_t** link = &timers; *link != NULL; link = &(*link)->next)
+	{
+		if (*link != timer) continue;
+		*link = timer->next;
+		break;
+	}
+	timer->active = false;
+}
+
+/* Queues a task to run as soon as the current one completes, from tasks and interrupts, false when the FIFO is full */
+bool Sched_Post(schedTask_t task, void* arg)
+{
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	bool posted = eventHead - eventTail < SCHED_EVENTS;
+	if (posted)
+	{
+		events[eventHead & (SCHED_EVENTS - 1)] = (schedEvent_t) { task, arg };
+		eventHead++;
+	}
+	else lostEvents++;
+	Cy_SysLib_ExitCriticalSection(interruptState);
+	return posted;
+}
+
+/* Has the task of the signal run once more, from tasks and interrupts; never lost, unlike a post */
+void Sched_Signal(schedSignal_t* signal)
+{
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	if (!signal->listed)
+	{
+		signal->next = signals;
+		signals = signal;
+		signal->listed = true;
+	}
+	signal->pending++;
+	signalsPending++;
+	Cy_SysLib_ExitCriticalSection(interruptState);
+}
+
+uint32_t Sched_LostEvents(void)
+{
+	return lostEvents;
+}
+
+/* Keeps the CM4 from power modes below level until released */
+void Sched_Hold(schedPower_e level)
+{
+	holds[level]++;
+}
+
+void Sched_Release(schedPower_e level)
+{
+	if (holds[level] > 0) holds[level]--;
+}
+
+/* Called around deep sleep, for peripherals that stop in it */
+void Sched_SetDeepSleepHooks(void (*before)(void), void (*after)(void))
+{
+	beforeDeepSleep = before;
+	afterDeepSleep = after;
+}
+
+static bool Sched_NextEvent(schedEvent_t* event)
+{
+	if (eventTail == eventHead) return false;
+	*event = events[eventTail & (SCHED_EVENTS - 1)];
+	eventTail++;
+	return true;
+}
+
+static schedSignal_t* Sched_NextSignal(void)
+{
+	if (signalsPending == 0) return NULL;
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	schedSignal_t* signal = signals;
+	while (signal != NULL && signal->pending == 0) signal = signal->next;
+	if (signal != NULL)
+	{
+		signal->pending--;
+		signalsPending--;
+	}
+	Cy_SysLib_ExitCriticalSection(interruptState);
+	return signal;
+}
+
+static bool Sched_TimerDue(void)
+{
+	return timers != NULL && (int32_t) (ticks - timers->due) >= 0;
+}
+
+/* Takes the first due timer off the list, periodic ones go back in for their next run */
+static schedTimer_t* Sched_NextTimer(void)
+{
+	if (!Sched_TimerDue()) return NULL;
+	schedTimer_t* timer = timers;
+	timers = timer->next;
+	timer->active = false;
+	if (timer->period != 0)
+	{
+		timer->due += timer->period;
+		if ((int32_t) (ticks - timer->due) >= 0) timer->due = ticks + timer->period;	// Missed runs are skipped
+		Sched_Insert(timer);
+	}
+	return timer;
+}
+
+/* RTC time of the core in seconds since 2000, keeps counting through deep sleep and hibernate;
+   the tick carries it on from the last read of the RTC, at start-up and after each deep sleep */
+uint32_t Sched_Clock(void)
+{
+	uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+	uint32_t seconds = clockSeconds + (ticks - clockTicks) / SCHED_TICK_HZ;
+	Cy_SysLib_ExitCriticalSection(interruptState);
+	return seconds;
+}
+
+/* Milliseconds to the first timer that wakes from deep sleep, UINT32_MAX without one */
+static uint32_t Sched_IdleTime(void)
+{
+	for (schedTimer_t* timer = timers; timer != NULL; timer = timer->next)
+	{
+		if (timer->deferrable) continue;
+		int32_t left = (int32_t) (timer->due - ticks);
+		return left > 0 ? (uint32_t) left : 0;
+	}
+	return UINT32_MAX;
+}
+
+static void Sched_DeepSleep(uint32_t idle)
+{
+	if (beforeDeepSleep != NULL) beforeDeepSleep();
+	if (eventHead == eventTail && signalsPending == 0)	// Nothing posted on the way down
+	{
+		sleepConfig_t config = sleepConfig;
+		uint32_t seconds = idle / 1000;
+		if (idle == UINT32_MAX) config.wakeUpTime = (wakeUpTime_t) wakeUpTimeOff;
+		else config.wakeUpTime = (wakeUpTime_t) wakeUpDelay(seconds / 86400, seconds / 3600 % 24, seconds / 60 % 60, seconds % 60);
+		LoRaWAN_Sleep(&config);
+		Sched_ClockRefresh(true);			// The tick stopped meanwhile
+	}
+	if (afterDeepSleep != NULL) afterDeepSleep();
+}
+
+/* Runs the tasks forever, sleeping whenever none is ready */
+void Sched_Run(void)
+{
+	for (;;)
+	{
+		schedEvent_t event;
+		schedSignal_t* signal;
+		schedTimer_t* timer;
+		if (Sched_NextEvent(&event)) event.task(event.arg);
+		else if ((signal = Sched_NextSignal()) != NULL) signal->task(signal->arg);
+		else if ((timer = Sched_NextTimer()) != NULL) timer->task(timer->arg);
+		else if (holds[schedPower_Active] == 0)
+		{
+			uint32_t idle = Sched_IdleTime();
+			if (holds[schedPower_Sleep] == 0 && !clockPending && idle >= SCHED_RTC_MIN_MS) Sched_DeepSleep(idle);
+			else
+			{
+				/* A pending interrupt ends the sleep even while masked, so none is missed between the check and the sleep */
+				uint32_t interruptState = Cy_SysLib_EnterCriticalSection();
+				if (eventHead == eventTail && signalsPending == 0 && !Sched_TimerDue()) Cy_SysPm_CpuEnterSleep(CY_SYSPM_WAIT_FOR_INTERRUPT);
+				Cy_SysLib_ExitCriticalSection(interruptState);
+			}
+		}
+	}
+}
+
+/* [] END OF FILE */
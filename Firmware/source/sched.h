@@ -0,0 +1,112 @@
+/********************************************************************************
+ *    ___             _   _     _			
+ *   / _ \ _ __   ___| |_| |__ (_)_ __ __  __
+ *  | | | | '_ \ / _ \ __| '_ \| | '_ \\ \/ /
+ *  | |_| | | | |  __/ |_| | | | | | | |>  < 
+ *   \___/|_| |_|\___|\__|_| |_|_|_| |_/_/\_\
+ *
+ ********************************************************************************
+ *
+ * Copyright (c) 2019-2025 Onethinx BV <info@onethinx.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ********************************************************************************
+ *
+ * Created by: Rolf Nooteboom | Onethinx
+ *
+ * Scheduler: cooperative run-to-completion tasks for the CM4 main loop
+ *
+ * Tasks are plain functions that run to completion, started by a timer or by
+ * an event. Events are posted from interrupts (or tasks) into a FIFO and run
+ * before the timers. Timers are kept in a list sorted by due time, on a 1 ms
+ * cy_systick tick, one-shot or periodic, and are started and stopped from
+ * tasks only. Signals are events that cannot be lost, for completions that
+ * must run their task: an interrupt counts them up without taking an event
+ * slot, and the loop runs the task once per count, after the events. A post
+ * to a full event FIFO fails and is counted (Sched_LostEvents).
+ *
+ * When nothing is ready the CM4 goes to the deepest power mode allowed:
+ *   Active		a task holds schedPower_Active, the loop keeps polling
+ *   Sleep		a task holds schedPower_Sleep (the SAR stream, a radio
+ *				operation), or the next timer is due within SCHED_RTC_MIN_MS:
+ *				Cy_SysPm_CpuEnterSleep, woken by the tick or any interrupt
+ *   DeepSleep	both cores sleep through LoRaWAN_Sleep, woken by the RTC of the
+ *				core at the next timer or by the wake-up pin; the tick is
+ *				resynchronized from the RTC once the core reads it, the timers
+ *				run on the tick meanwhile
+ * Deferrable timers (periodic housekeeping) never wake the device from deep
+ * sleep, they run at the first wake-up after they are due.
+ *
+ ********************************************************************************/
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "OnethinxCore01.h"
+
+#define SCHED_TICK_HZ				1000	// Timer resolution
+#define SCHED_EVENTS				16		// Event FIFO size, a power of two
+#define SCHED_RTC_MIN_MS			2000	// Shortest idle time that deep sleeps, the RTC wake-up counts seconds
+
+typedef void (*schedTask_t)(void* arg);
+
+typedef enum
+{
+	schedPower_DeepSleep	= 0,
+	schedPower_Sleep		= 1,
+	schedPower_Active		= 2,
+} schedPower_e;
+
+/* Timer, owned by the task that starts it */
+typedef struct schedTimer_s
+{
+	struct schedTimer_s* next;
+	schedTask_t	task;
+	void*		arg;
+	uint32_t	due;						// Sched_Now() at expiry
+	uint32_t	period;						// Milliseconds, 0 for a one-shot timer
+	bool		active;
+	bool		deferrable;					// Does not wake the device from deep sleep
+} schedTimer_t;
+
+/* Signal, static, owned by the code that raises it */
+typedef struct schedSignal_s
+{
+	struct schedSignal_s* next;
+	schedTask_t	task;
+	void*		arg;
+	volatile uint16_t pending;			// Raised, task not run yet
+	bool		listed;
+} schedSignal_t;
+
+void		Sched_Init(const sleepConfig_t* deepSleep);
+uint32_t	Sched_Now(void);
+uint32_t	Sched_Clock(void);
+void		Sched_TimerStart(schedTimer_t* timer, schedTask_t task, void* arg, uint32_t delay, uint32_t period);
+void		Sched_TimerStop(schedTimer_t* timer);
+bool		Sched_Post(schedTask_t task, void* arg);
+void		Sched_Signal(schedSignal_t* signal);
+uint32_t	Sched_LostEvents(void);
+void		Sched_Hold(schedPower_e level);
+void		Sched_Release(schedPower_e level);
+void		Sched_SetDeepSleepHooks(void (*before)(void), void (*after)(void));
+void		Sched_Run(void) __attribute__ ((noreturn));
+
+/* [] END OF FILE */
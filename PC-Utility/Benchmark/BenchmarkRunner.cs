@@ -0,0 +1,170 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Benchmark Runner
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Times benchmark cases, counts allocations and USB packets per operation
+// - Saves results as JSON and compares them against a baseline run
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Diagnostics;
+using System.Text.Json;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>One benchmarked operation.</summary>
+    public class BenchmarkCase
+    {
+        public string Name { get; init; } = string.Empty;
+        public int BytesPerOp { get; init; }                                    // Payload bytes moved by one operation, 0 for control operations.
+        public Action Run { get; init; } = () => { };                           // The timed operation.
+        public Action? Setup { get; init; }                                     // Untimed preparation before every operation (e.g. erase).
+    }
+
+    /// <summary>Measured result of a benchmark case.</summary>
+    public class BenchmarkResult
+    {
+        public string Name { get; set; } = string.Empty;
+        public int Operations { get; set; }
+        public double TotalMs { get; set; }
+        public double MeanMs { get; set; }
+        public double MinMs { get; set; }
+        public double MaxMs { get; set; }
+        public double OpsPerSecond { get; set; }
+        public double BytesPerSecond { get; set; }
+        public double AllocatedBytesPerOp { get; set; }
+        public double PacketsPerOp { get; set; }
+        public double UsbBytesOutPerOp { get; set; }
+        public double UsbBytesInPerOp { get; set; }
+    }
+
+    /// <summary>Complete benchmark run as saved to JSON.</summary>
+    public class BenchmarkReport
+    {
+        public DateTime Timestamp { get; set; } = DateTime.UtcNow;
+        public string Probe { get; set; } = string.Empty;
+        public string Machine { get; set; } = Environment.MachineName;
+        public string Runtime { get; set; } = Environment.Version.ToString();
+        public Dictionary<string, string> Settings { get; set; } = new();
+        public List<BenchmarkResult> Results { get; set; } = new();
+    }
+
+    /// <summary>Runs benchmark cases against a probe.</summary>
+    public class BenchmarkRunner
+    {
+        private static readonly JsonSerializerOptions JsonOptions = new() { WriteIndented = true };
+        private readonly DapStatistics statistics;
+
+        public TimeSpan MinTime { get; set; } = TimeSpan.FromSeconds(2);        // Minimum measuring time per case.
+        public int MinOperations { get; set; } = 3;                             // Minimum operations per case.
+        public int MaxOperations { get; set; } = 100000;                        // Maximum operations per case.
+
+        /// <summary>Constructs a runner.</summary>
+        /// <param name="device">Probe under test, its statistics give the packet counts.</param>
+        public BenchmarkRunner(CmsisDap.Device device)
+        {
+            statistics = device.Statistics;
+        }
+
+        /// <summary>Runs one case: a warm-up operation, then timed operations until MinTime and MinOperations are reached.</summary>
+        public BenchmarkResult Measure(BenchmarkCase benchmark)
+        {
+            benchmark.Setup?.Invoke();
+            benchmark.Run();
+
+            double total = 0, min = double.MaxValue, max = 0;
+            long allocated = 0, packets = 0, bytesOut = 0, bytesIn = 0;
+            int operations = 0;
+            while (operations < MaxOperations && (operations < MinOperations || total < MinTime.TotalMilliseconds))
+            {
+                benchmark.Setup?.Invoke();
+
+                var before = statistics.Snapshot();
+                long allocBefore = GC.GetAllocatedBytesForCurrentThread();
+                long start = Stopwatch.GetTimestamp();
+                benchmark.Run();
+                double elapsed = Stopwatch.GetElapsedTime(start).TotalMilliseconds;
+                allocated += GC.GetAllocatedBytesForCurrentThread() - allocBefore;
+                var after = statistics.Snapshot();
+                packets += after.Packets - before.Packets;
+                bytesOut += after.BytesOut - before.BytesOut;
+                bytesIn += after.BytesIn - before.BytesIn;
+
+                total += elapsed;
+                min = Math.Min(min, elapsed);
+                max = Math.Max(max, elapsed);
+                operations++;
+            }
+
+            return new BenchmarkResult
+            {
+                Name = benchmark.Name,
+                Operations = operations,
+                TotalMs = total,
+                MeanMs = total / operations,
+                MinMs = min,
+                MaxMs = max,
+                OpsPerSecond = operations / (total / 1000),
+                BytesPerSecond = (double)benchmark.BytesPerOp * operations / (total / 1000),
+                AllocatedBytesPerOp = (double)allocated / operations,
+                PacketsPerOp = (double)packets / operations,
+                UsbBytesOutPerOp = (double)bytesOut / operations,
+                UsbBytesInPerOp = (double)bytesIn / operations,
+            };
+        }
+
+        public static void Save(BenchmarkReport report, string path) =>
+            File.WriteAllText(path, JsonSerializer.Serialize(report, JsonOptions));
+
+        public static BenchmarkReport Load(string path) =>
+            JsonSerializer.Deserialize<BenchmarkReport>(File.ReadAllText(path), JsonOptions)
+                ?? throw new InvalidDataException($"{path} is not a benchmark report.");
+
+        /// <summary>Prints the change against a baseline report.</summary>
+        /// <param name="threshold">Relative throughput loss that counts as a regression (0.1 = 10%).</param>
+        /// <returns>Number of regressed cases.</returns>
+        public static int Compare(BenchmarkReport report, BenchmarkReport baseline, double threshold)
+        {
+            int regressions = 0;
+            Console.WriteLine($"\nCompared to baseline of {baseline.Timestamp:yyyy-MM-dd HH:mm} ({baseline.Probe}):");
+            foreach (var result in report.Results)
+            {
+                var old = baseline.Results.FirstOrDefault(r => r.Name == result.Name);
+                if (old == null || old.OpsPerSecond <= 0)
+                {
+                    Console.WriteLine($"  {result.Name,-20} new");
+                    continue;
+                }
+                double change = result.OpsPerSecond / old.OpsPerSecond - 1;
+                bool regressed = change < -threshold;
+                if (regressed) regressions++;
+                Console.WriteLine($"  {result.Name,-20} {change,8:+0.0%;-0.0%}  packets/op {old.PacketsPerOp,8:F1} -> {result.PacketsPerOp,8:F1}{(regressed ? "  REGRESSION" : "")}");
+            }
+            return regressions;
+        }
+
+        public static void PrintHeader()
+        {
+            Console.WriteLine($"{"Case",-20} {"ops",7} {"ops/s",10} {"KB/s",9} {"mean ms",9} {"alloc B/op",11} {"pkts/op",8} {"out B/op",9} {"in B/op",9}");
+        }
+
+        public static void Print(BenchmarkResult r)
+        {
+            Console.WriteLine($"{r.Name,-20} {r.Operations,7} {r.OpsPerSecond,10:F1} {r.BytesPerSecond / 1024,9:F1} {r.MeanMs,9:F3} {r.AllocatedBytesPerOp,11:F0} {r.PacketsPerOp,8:F1} {r.UsbBytesOutPerOp,9:F0} {r.UsbBytesInPerOp,9:F0}");
+        }
+    }
+}
@@ -0,0 +1,243 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - DAP Throughput Benchmark
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Measures ReadIO, WriteIO, TransferBlock, TransferBlockRead, EraseFlash,
+//   ProgramFlash, VerifyFlash and mailbox commands on a simulated or USB probe
+// - Reports ops/s, bytes/s, allocations and USB packets per operation
+// - Saves the results as JSON and flags regressions against a baseline run
+//
+// Usage:
+//   DapBenchmark [--probe sim|hid[:index]] [--latency us] [--row-time us] [--clock hz]
+//                [--bytes n] [--time s] [--filter text] [--mailbox]
+//                [--out file.json] [--baseline file.json] [--threshold percent]
+//
+// Note: on a USB probe the flash cases erase and program the last rows of
+// application flash, and the mailbox cases need the communicator firmware.
+//
+// Exit code: 0 success, 1 regression against the baseline, 2 usage error
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using HidSharp;
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    internal static class Program
+    {
+        static int Main(string[] args)
+        {
+            Dictionary<string, string> options;
+            try
+            {
+                options = ParseArgs(args);
+            }
+            catch (ArgumentException ex)
+            {
+                Console.Error.WriteLine(ex.Message);
+                return Usage(2);
+            }
+            if (options.ContainsKey("help"))
+                return Usage(0);
+
+            string probeArg = options.GetValueOrDefault("probe", "sim");
+            var family = PSoC6Family.PSOC6ABLE2;
+            var psoc = family.Create();
+            uint clock = uint.Parse(options.GetValueOrDefault("clock", "4000000"));
+            int bytes = Math.Max((int)psoc.ROW_SIZE, int.Parse(options.GetValueOrDefault("bytes", "4096")) / (int)psoc.ROW_SIZE * (int)psoc.ROW_SIZE);
+
+            var report = new BenchmarkReport();
+            report.Settings["clock"] = clock.ToString();
+            report.Settings["bytes"] = bytes.ToString();
+
+            // Open the probe
+            IDapTransport transport;
+            SimulatedProbe? sim = null;
+            if (probeArg == "sim")
+            {
+                sim = new SimulatedProbe(family)
+                {
+                    UsbLatency = TimeSpan.FromMicroseconds(double.Parse(options.GetValueOrDefault("latency", "1000"))),
+                    ModelSwdTime = true,
+                };
+                sim.Target.RowWriteTime = TimeSpan.FromMicroseconds(double.Parse(options.GetValueOrDefault("row-time", "0")));
+                transport = sim;
+                report.Probe = "Simulated";
+                report.Settings["latency"] = options.GetValueOrDefault("latency", "1000");
+                report.Settings["row-time"] = options.GetValueOrDefault("row-time", "0");
+            }
+            else if (probeArg.StartsWith("hid"))
+            {
+                int index = probeArg.Contains(':') ? int.Parse(probeArg.Split(':')[1]) : 0;
+                var probes = new CmsisDap().Enumerate();
+                if (index >= probes.Count)
+                {
+                    Console.Error.WriteLine($"Probe {index} not found, {probes.Count} CMSIS-DAP probe(s) connected.");
+                    return 2;
+                }
+                var hid = DeviceList.Local.GetHidDevices().First(d => d.DevicePath == probes[index].Path);
+                transport = new HidTransport(hid);
+                report.Probe = probes[index].ToString();
+            }
+            else
+            {
+                Console.Error.WriteLine($"Unknown probe '{probeArg}', use sim or hid[:index].");
+                return 2;
+            }
+
+            using var device = new CmsisDap.Device(transport);
+            var programmer = new Psoc6Programmer(device, family, SWJ_Interface.SWD, clock);
+            var runner = new BenchmarkRunner(device)
+            {
+                MinTime = TimeSpan.FromSeconds(double.Parse(options.GetValueOrDefault("time", "2"))),
+            };
+
+            uint ioAddr = psoc.SRAM_SCRATCH_ADDR + 0x1000;                      // Clear of the SROM parameter block.
+            uint blockAddr = psoc.SRAM_SCRATCH_ADDR + 0x2000;
+            uint flashAddr = psoc.MEM_BASE_FLASH + psoc.MEM_SIZE_FLASH - (uint)bytes;   // Last rows of application flash.
+            byte[] data = new byte[bytes];
+            new Random(1).NextBytes(data);
+
+            string? filter = options.GetValueOrDefault("filter");
+            bool mailbox = sim != null || options.ContainsKey("mailbox");
+            BenchmarkRunner.PrintHeader();
+
+            void Run(BenchmarkCase benchmark)
+            {
+                if (filter != null && !benchmark.Name.Contains(filter, StringComparison.OrdinalIgnoreCase)) return;
+                var result = runner.Measure(benchmark);
+                report.Results.Add(result);
+                BenchmarkRunner.Print(result);
+            }
+
+            // Mailbox cases need the firmware running, they go before the CPU is halted
+            if (mailbox)
+            {
+                programmer.ToggleXRES();
+                Thread.Sleep(100);
+                var client = new MailboxClient(programmer).Attach();
+                Run(new BenchmarkCase { Name = "MailboxWriteInt32", BytesPerOp = 4, Run = () => client.WriteInt32(0, Command_e.CMD_LEDS) });
+                Run(new BenchmarkCase { Name = "MailboxReadInt32", BytesPerOp = 4, Run = () => client.ReadInt32(Command_e.CMD_ADCVAL) });
+                Run(new BenchmarkCase { Name = "MailboxReadBlock", BytesPerOp = GetStructSize<coreInfo_t>(), Run = () => client.ReadData(Command_e.CMD_INFO_STACK, GetStructSize<coreInfo_t>()) });
+            }
+
+            programmer.Acquire(AcquireMode.ACQ_RESET, false, AP_e.AP_CM4);
+            Run(new BenchmarkCase { Name = "ReadIO", BytesPerOp = 4, Run = () => programmer.ReadIO(ioAddr) });
+            Run(new BenchmarkCase { Name = "WriteIO", BytesPerOp = 4, Run = () => programmer.WriteIO(ioAddr, 0x12345678) });
+            Run(new BenchmarkCase { Name = "TransferBlock", BytesPerOp = bytes, Run = () => programmer.TransferBlock(blockAddr, data, 0, bytes) });
+            Run(new BenchmarkCase { Name = "TransferBlockRead", BytesPerOp = bytes, Run = () => programmer.TransferBlockRead(blockAddr, 0, bytes) });
+            Run(new BenchmarkCase { Name = "EraseFlash", BytesPerOp = bytes, Run = () => programmer.EraseFlash(flashAddr, flashAddr + (uint)bytes) });
+            Run(new BenchmarkCase
+            {
+                Name = "ProgramFlash",
+                BytesPerOp = bytes,
+                Setup = () => programmer.EraseFlash(flashAddr, flashAddr + (uint)bytes),
+                Run = () => programmer.ProgramFlash(data, flashAddr),
+            });
+            Run(new BenchmarkCase { Name = "VerifyFlash", BytesPerOp = bytes, Run = () => programmer.VerifyFlash(data, flashAddr) });
+            programmer.ToggleXRES();
+
+            Console.WriteLine(device.Statistics.Snapshot().ToReport().Replace("\r\n", Environment.NewLine));
+
+            string output = options.GetValueOrDefault("out", $"benchmark-{DateTime.Now:yyyyMMdd-HHmmss}.json");
+            BenchmarkRunner.Save(report, output);
+            Console.WriteLine($"\nResults saved to {output}");
+
+            if (options.TryGetValue("baseline", out string? baselinePath))
+            {
+                double threshold = double.Parse(options.GetValueOrDefault("threshold", "10")) / 100;
+                if (BenchmarkRunner.Compare(report, BenchmarkRunner.Load(baselinePath), threshold) > 0)
+                    return 1;
+            }
+            return 0;
+        }
+
+        // Options taking a value, with the check of the value (null for free text)
+        private static readonly Dictionary<string, (Func<string, bool>? Valid, string Expected)> ValueOptions = new()
+        {
+            ["probe"] = (v => v == "sim" || v == "hid" || (v.StartsWith("hid:") && uint.TryParse(v.Substring(4), out _)), "sim or hid[:index]"),
+            ["latency"] = (IsNumber, "a number"),
+            ["row-time"] = (IsNumber, "a number"),
+            ["clock"] = (v => uint.TryParse(v, out uint hz) && hz > 0, "a frequency in Hz"),
+            ["bytes"] = (v => int.TryParse(v, out int n) && n >= 0, "a byte count"),
+            ["time"] = (IsNumber, "a number"),
+            ["filter"] = (null, ""),
+            ["out"] = (null, ""),
+            ["baseline"] = (null, ""),
+            ["threshold"] = (IsNumber, "a number"),
+        };
+
+        private static bool IsNumber(string value) => double.TryParse(value, out double number) && number >= 0;
+
+        // Options without a value
+        private static readonly string[] FlagOptions = { "mailbox", "help" };
+
+        /// <summary>Parses "--name value" and "--flag" arguments, "-h" is "--help".</summary>
+        /// <exception cref="ArgumentException">Thrown on an unknown option, a missing or malformed value, or a stray argument.</exception>
+        private static Dictionary<string, string> ParseArgs(string[] args)
+        {
+            var options = new Dictionary<string, string>();
+            for (int i = 0; i < args.Length; i++)
+            {
+                string name = args[i] == "-h" ? "help" : args[i].StartsWith("--") ? args[i].Substring(2) : throw new ArgumentException($"Unexpected argument '{args[i]}'.");
+                if (FlagOptions.Contains(name))
+                {
+                    options[name] = "true";
+                    continue;
+                }
+                if (!ValueOptions.TryGetValue(name, out var option))
+                    throw new ArgumentException($"Unknown option '{args[i]}'.");
+                if (i + 1 >= args.Length || args[i + 1].StartsWith("--"))
+                    throw new ArgumentException($"Option '{args[i]}' needs a value.");
+                string value = args[++i];
+                if (option.Valid != null && !option.Valid(value))
+                    throw new ArgumentException($"Option '{args[i - 1]}' needs {option.Expected}, not '{value}'.");
+                options[name] = value;
+            }
+            return options;
+        }
+
+        private static int Usage(int exitCode)
+        {
+            var output = exitCode == 0 ? Console.Out : Console.Error;
+            output.WriteLine("""
+                Usage: DapBenchmark [--probe sim|hid[:index]] [--latency us] [--row-time us] [--clock hz]
+                                    [--bytes n] [--time s] [--filter text] [--mailbox]
+                                    [--out file.json] [--baseline file.json] [--threshold percent]
+
+                Options:
+                  --probe sim|hid[:index]   Simulated probe (default) or the USB probe with this index
+                  --latency us              USB round trip of the simulated probe (default 1000)
+                  --row-time us             Flash row write time of the simulated target (default 0)
+                  --clock hz                SWD clock (default 4000000)
+                  --bytes n                 Bytes per block and flash operation, whole rows (default 4096)
+                  --time s                  Minimum time per case (default 2)
+                  --filter text             Run only the cases whose name contains text
+                  --mailbox                 Run the mailbox cases on a USB probe (needs the communicator firmware)
+                  --out file.json           Results file (default benchmark-<time>.json)
+                  --baseline file.json      Compare against a previous run, exit 1 on a regression
+                  --threshold percent       Slowdown counted as a regression (default 10)
+                  -h, --help                Show this help
+
+                Note: on a USB probe the flash cases erase and program the last rows of application flash.
+                Exit code: 0 success, 1 regression against the baseline, 2 usage error
+                """);
+            return exitCode;
+        }
+    }
+}
@@ -0,0 +1,731 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Command Line Session
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Implements the CLI commands on top of the core library
+// - Keeps the probe open between commands, so a batch pays the USB open and
+//   DAP_Info queries only once
+// - With UseServer the memory and mailbox commands go through a probe
+//   server, which shares the probe with other tools
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Diagnostics;
+using System.Numerics;
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Probe connection and command set of the CLI.</summary>
+    public class CliSession : IDisposable
+    {
+        private readonly CmsisDap dap = new CmsisDap();
+        private CmsisDap.Device? device;
+        private Psoc6Programmer? programmer;
+        private ProbeClient? client;
+
+        public string ProbeSelector { get; set; } = "0";                        // Probe index, serial number / path fragment or "sim[:n]".
+        public PSoC6Family Family { get; set; } = PSoC6Family.PSOC6ABLE2;
+        public uint? SwjClockSpeed { get; set; }                                // SWD clock speed (Hz), null for the probe's clock profile.
+        public const uint DefaultSwjClock = 4000000;                            // SWD clock of probes without a clock profile.
+        private readonly ProbeProfileStore probeProfiles = new();
+        public bool ShowProgress { get; set; } = true;                          // Write progress percentages to stderr.
+        public CancellationToken Cancel { get; set; }                           // Stops long running commands (watch, monitor, serve).
+        public bool UseServer { get; set; }                                     // Use the probe through a probe server.
+        public string? SocketPath { get; set; }                                 // Probe server socket, null for the default.
+
+        /// <summary>Programmer on the selected probe, opened on first use.</summary>
+        public Psoc6Programmer Programmer
+        {
+            get
+            {
+                if (UseServer)
+                    throw new InvalidOperationException("Command not available through the probe server.");
+                if (programmer != null && device!.IsConnected) return programmer;
+                device?.Dispose();
+                device = dap.Open(SelectProbe());
+                var probe = device;
+                programmer = new Psoc6Programmer(device, Family, SWJ_Interface.SWD, SwjClockSpeed ?? probeProfiles.ClockFor(device.SerialNumber, Family, DefaultSwjClock))
+                {
+                    Progress = ReportProgress,
+                    AdaptiveClock = SwjClockSpeed == null,                      // A clock given on the command line is kept.
+                    Profiles = probeProfiles,
+                };
+                programmer.ClockChanged += clock =>
+                {
+                    probeProfiles.UpdateClock(probe.SerialNumber, Family, clock);
+                    Console.Error.WriteLine($"Transfer errors, SWD clock lowered to {clock} Hz.");
+                };
+                return programmer;
+            }
+        }
+
+        /// <summary>Runs one command.</summary>
+        /// <param name="args">Command name followed by its arguments.</param>
+        /// <param name="emit">Receives the result object(s) of the command.</param>
+        /// <exception cref="ArgumentException">Thrown on unknown commands or invalid arguments.</exception>
+        public void Run(IReadOnlyList<string> args, Action<object> emit)
+        {
+            if (args.Count == 0) throw new ArgumentException("Missing command.");
+            string command = args[0].ToLowerInvariant();
+            var rest = args.Skip(1).ToList();
+            switch (command)
+            {
+                case "list": emit(List()); break;
+                case "acquire": emit(Acquire()); break;
+                case "tune": emit(Tune((uint)Option(rest, "--max", 30000000))); break;
+                case "reset":
+                    Programmer.ToggleXRES();
+                    emit(new { Reset = true });
+                    break;
+                case "flash": emit(Flash(Argument(rest, 0, "image"), !rest.Contains("--no-verify"))); break;
+                case "verify": emit(Verify(Argument(rest, 0, "image"))); break;
+                case "keys":
+                    string action = Argument(rest, 0, "read|write");
+                    if (action == "read") emit(ReadKeys());
+                    else if (action == "write") emit(WriteKeys(Argument(rest, 1, "DevEUI"), Argument(rest, 2, "AppEUI"), Argument(rest, 3, "AppKey"), !rest.Contains("--no-commit")));
+                    else throw new ArgumentException($"Unknown keys action '{action}', use read or write.");
+                    break;
+                case "info": emit(Info()); break;
+                case "adc":
+                    string adcAction = rest.Count > 0 && !rest[0].StartsWith("--") ? rest[0] : "read";
+                    if (adcAction == "read") emit(ReadAdc());
+                    else if (adcAction == "history") emit(AdcHistory(rest.Count > 1 ? int.Parse(rest[1]) : AdcStream.MAX_HISTORY));
+                    else if (adcAction == "start") emit(new { Rate = AdcStreamReader().Start(uint.Parse(Argument(rest, 1, "rate"))) });
+                    else if (adcAction == "stop") { AdcStreamReader().Stop(); emit(new { Rate = 0 }); }
+                    else if (adcAction == "stream") StreamAdc((uint)Option(rest, "--rate", 0), Option(rest, "--interval", 20), Option(rest, "--count", 0), rest.Contains("--filtered"), emit);
+                    else if (adcAction == "filter") emit(AdcProcessing(rest.Skip(1).TakeWhile(a => !a.StartsWith("--")).ToList(), Option(rest, "--decimate", 0), Option(rest, "--window", 0)));
+                    else if (adcAction == "stats") emit(AdcStatistics(AdcStreamReader().Stats()));
+                    else if (adcAction == "scan") emit(ScanAdc(OptionText(rest, "--channels"), Option(rest, "--average", 0), Option(rest, "--aperture", 0)));
+                    else if (adcAction == "event") emit(AdcEventMode(rest.Skip(1).TakeWhile(a => !a.StartsWith("--")).ToList(), Option(rest, "--pre", -1), Option(rest, "--post", -1), Option(rest, "--holdoff", -1)));
+                    else throw new ArgumentException($"Unknown adc action '{adcAction}', use history, start, stop, stream, filter, stats, scan or event.");
+                    break;
+                case "kv":
+                    string kvAction = rest.Count > 0 ? rest[0] : "info";
+                    var kvArgs = rest.Skip(1).ToList();
+                    if (kvAction == "info") emit(KvInfo());
+                    else if (kvAction == "get") emit(KvGet(kvArgs.Select(ParseKey).ToList()));
+                    else if (kvAction == "put") emit(KvWrite(kvArgs.Count > 0 && kvArgs.Count % 2 == 0
+                        ? kvArgs.Chunk(2).Select(pair => new KeyValuePair<byte, byte[]?>(ParseKey(pair[0]), ParseHex(pair[1], 0))).ToList()
+                        : throw new ArgumentException("Missing value, use kv put <key> <hex> [<key> <hex> ..].")));
+                    else if (kvAction == "delete") emit(KvWrite(kvArgs.Count > 0
+                        ? kvArgs.Select(key => new KeyValuePair<byte, byte[]?>(ParseKey(key), null)).ToList()
+                        : throw new ArgumentException("Missing key, use kv delete <key> [key ..].")));
+                    else throw new ArgumentException($"Unknown kv action '{kvAction}', use info, get, put or delete.");
+                    break;
+                case "decode": emit(DecodeUplink(ParseHex(Argument(rest, 0, "hex payload"), 0), rest.Contains("--event"), OptionText(rest, "--received"))); break;
+                case "leds": emit(rest.Count >= 2 ? SetLeds(ParseOnOff(rest[0]), ParseOnOff(rest[1])) : ReadLeds()); break;
+                case "watch": Watch(Option(rest, "--interval", 1000), Option(rest, "--count", 0), emit); break;
+                case "read": emit(ReadMemory(ParseAddress(Argument(rest, 0, "address")), (int)ParseAddress(Argument(rest, 1, "length")))); break;
+                case "write": emit(WriteMemory(ParseAddress(Argument(rest, 0, "address")), ParseHex(Argument(rest, 1, "hex data"), 0))); break;
+                case "monitor": Monitor(ParseAddress(Argument(rest, 0, "address")), (int)ParseAddress(Argument(rest, 1, "length")), Option(rest, "--interval", 1000), Option(rest, "--count", 0), emit); break;
+                case "serve": Serve(emit); break;
+                case "sleep":
+                    Thread.Sleep(int.Parse(Argument(rest, 0, "milliseconds")));
+                    emit(new { Slept = true });
+                    break;
+                default:
+                    throw new ArgumentException($"Unknown command '{args[0]}'.");
+            }
+        }
+
+        private object List() =>
+            dap.Enumerate().Select((d, i) => new
+            {
+                Index = i,
+                d.Path,
+                d.Manufacturer,
+                d.Product,
+                VendorId = $"0x{d.VendorId:X4}",
+                ProductId = $"0x{d.ProductId:X4}",
+                Unverified = d.IsUnverified,
+            }).ToList();
+
+        private object Acquire()
+        {
+            Programmer.Acquire(AcquireMode.ACQ_RESET, false, AP_e.AP_CM4);
+            Programmer.GetSiliconInfo(out ushort familyId, out ushort siliconId, out byte revisionId, out byte protectionState);
+            return new
+            {
+                FamilyId = $"0x{familyId:X4}",
+                Family = PSoC6Family.All.FirstOrDefault(f => f.FamilyId == familyId)?.Name ?? "UNKNOWN",
+                SiliconId = $"0x{siliconId:X4}",
+                RevisionId = $"0x{revisionId:X2}",
+                Protection = Enum.IsDefined(typeof(ProtectionState_e), protectionState)
+                    ? ((ProtectionState_e)protectionState).ToString()
+                    : $"UNKNOWN (0x{protectionState:X2})",
+            };
+        }
+
+        /// <summary>Finds the highest reliable SWD clock and stores it in the probe's clock profile.</summary>
+        private object Tune(uint maxHz)
+        {
+            var stopwatch = Stopwatch.StartNew();
+            Programmer.Acquire(AcquireMode.ACQ_RESET, false, AP_e.AP_CM4);
+            uint previous = Programmer.SwjClockSpeed;
+            uint clock = Programmer.TuneClock(maxHz);
+            probeProfiles.UpdateClock(device!.SerialNumber, Family, clock, true);
+            Programmer.ToggleXRES();
+            return new { Probe = device.SerialNumber, Target = Family.Name, PreviousClockHz = previous, ClockHz = clock, Profiles = probeProfiles.FilePath, Seconds = Math.Round(stopwatch.Elapsed.TotalSeconds, 3) };
+        }
+
+        private object Flash(string path, bool verify)
+        {
+            var stopwatch = Stopwatch.StartNew();
+            using var image = FlashImage.Load(path);
+            Programmer.Acquire(AcquireMode.ACQ_RESET, false, AP_e.AP_CM4);
+            Programmer.ProgramImage(image);
+            if (verify)
+                Programmer.VerifyImage(image);
+            Programmer.ToggleXRES();
+            return new { Image = path, Segments = image.Segments.Count, Bytes = image.TotalBytes, Verified = verify, Seconds = Math.Round(stopwatch.Elapsed.TotalSeconds, 3) };
+        }
+
+        private object Verify(string path)
+        {
+            var stopwatch = Stopwatch.StartNew();
+            using var image = FlashImage.Load(path);
+            Programmer.Acquire(AcquireMode.ACQ_RESET, false, AP_e.AP_CM4);
+            Programmer.VerifyImage(image);
+            Programmer.ToggleXRES();
+            return new { Image = path, Bytes = image.TotalBytes, Verified = true, Seconds = Math.Round(stopwatch.Elapsed.TotalSeconds, 3) };
+        }
+
+        /// <summary>Probe server connection, opened on first use.</summary>
+        private ProbeClient Client
+        {
+            get
+            {
+                if (client != null && client.IsConnected) return client;
+                client?.Dispose();
+                client = new ProbeClient(SocketPath);
+                return client;
+            }
+        }
+
+        private IMailbox Mailbox() => UseServer ? Client.Mailbox : new MailboxClient(Programmer).Attach();
+
+        private object ReadMemory(uint address, int length)
+        {
+            byte[] data;
+            if (UseServer)
+                data = Client.ReadMemory(address, length);
+            else
+            {
+                // Block reads are word aligned, read the surrounding words
+                uint start = address & ~3u;
+                Programmer.Attach(AP_e.AP_CM4);
+                data = Programmer.TransferBlockRead(start, 0, (int)(address - start) + length).Skip((int)(address - start)).ToArray();
+            }
+            return new { Address = $"0x{address:X8}", Length = length, Data = Convert.ToHexString(data) };
+        }
+
+        private object WriteMemory(uint address, byte[] data)
+        {
+            if (UseServer)
+                Client.WriteMemory(address, data);
+            else
+            {
+                if ((address & 3) != 0 || (data.Length & 3) != 0)
+                    throw new ArgumentException("Without the probe server writes must be word aligned.");
+                Programmer.Attach(AP_e.AP_CM4);
+                Programmer.TransferBlock(address, data, 0, data.Length);
+            }
+            return new { Address = $"0x{address:X8}", Length = data.Length, Written = true };
+        }
+
+        /// <summary>Reads a memory range periodically until cancelled or count samples are taken.</summary>
+        private void Monitor(uint address, int length, int intervalMs, int count, Action<object> emit)
+        {
+            var start = Stopwatch.StartNew();
+            object Sample(int sample, byte[] data) =>
+                new { Sample = sample, Time = Math.Round(start.Elapsed.TotalSeconds, 3), Address = $"0x{address:X8}", Data = Convert.ToHexString(data) };
+
+            if (!UseServer)
+            {
+                for (int sample = 0; (count == 0 || sample < count) && !Cancel.IsCancellationRequested; sample++)
+                {
+                    if (sample > 0 && Cancel.WaitHandle.WaitOne(intervalMs)) break;
+                    uint aligned = address & ~3u;
+                    Programmer.Attach(AP_e.AP_CM4);
+                    emit(Sample(sample, Programmer.TransferBlockRead(aligned, 0, (int)(address - aligned) + length).Skip((int)(address - aligned)).ToArray()));
+                }
+                return;
+            }
+
+            // The server polls, samples of other clients on the same range share its reads
+            var samples = new System.Collections.Concurrent.BlockingCollection<object>();
+            int received = 0;
+            string? error = null;
+            int id = 0;
+            // Data may arrive before the subscribe response, it waits until the id is known
+            var early = new List<(int Subscription, byte[]? Data, string? Error)>();
+            void Deliver(int subscription, byte[]? data, string? message)
+            {
+                if (id == 0) early.Add((subscription, data, message));
+                else if (subscription != id || samples.IsAddingCompleted) return;
+                else if (data != null) samples.Add(Sample(received++, data));
+                else { error = message; samples.CompleteAdding(); }
+            }
+            void OnData(int subscription, byte[] data)
+            {
+                lock (early) Deliver(subscription, data, null);
+            }
+            void OnFailed(int subscription, string message)
+            {
+                lock (early) Deliver(subscription, null, message);
+            }
+            Client.DataReceived += OnData;
+            Client.DataFailed += OnFailed;
+            try
+            {
+                int subscribed = Client.Subscribe(address, length, intervalMs);
+                lock (early)
+                {
+                    id = subscribed;
+                    foreach (var (subscription, data, message) in early)
+                        Deliver(subscription, data, message);
+                    early.Clear();
+                }
+                for (int sample = 0; count == 0 || sample < count; sample++)
+                {
+                    if (!samples.TryTake(out var item, Timeout.Infinite, Cancel)) break;
+                    emit(item);
+                }
+            }
+            catch (OperationCanceledException) { }
+            finally
+            {
+                Client.DataReceived -= OnData;
+                Client.DataFailed -= OnFailed;
+                if (id != 0 && Client.IsConnected) Client.Unsubscribe(id);
+            }
+            if (error != null)
+                throw new InvalidOperationException(error);
+        }
+
+        /// <summary>Shares the selected probe with other processes until cancelled.</summary>
+        private void Serve(Action<object> emit)
+        {
+            var probe = Programmer;
+            using var server = new ProbeServer(probe, SocketPath);
+            server.Log += text => Console.Error.WriteLine($"{DateTime.Now:HH:mm:ss.fff} {text}");
+            server.Start();
+            Cancel.WaitHandle.WaitOne();
+            var statistics = server.Statistics();
+            emit(new
+            {
+                Socket = server.SocketPath,
+                statistics.Requests,
+                statistics.Reads,
+                statistics.ReadTransactions,
+            });
+        }
+
+        private object ReadKeys()
+        {
+            var keys = Mailbox().Read<LoRaWAN_keys_t>(Command_e.CMD_KEYS);
+            var otaa = new OTAA_10x_t();
+            DataToStruct(keys.keyData, ref otaa);
+            return new
+            {
+                KeyType = keys.KeyType.ToString(),
+                keys.PublicNetwork,
+                DevEui = Convert.ToHexString(otaa.DevEui),
+                AppEui = Convert.ToHexString(otaa.AppEui),
+                AppKey = Convert.ToHexString(otaa.AppKey),
+            };
+        }
+
+        private object WriteKeys(string devEui, string appEui, string appKey, bool commit)
+        {
+            var mailbox = Mailbox();
+            var keys = new LoRaWAN_keys_t
+            {
+                KeyType = keyType_e.OTAA_10x_key,
+                PublicNetwork = true,
+                keyData = StructToData(new OTAA_10x_t { DevEui = ParseHex(devEui, 8), AppEui = ParseHex(appEui, 8), AppKey = ParseHex(appKey, 16) }),
+                reserved = new byte[32],
+            };
+            mailbox.Write(keys, Command_e.CMD_KEYS);
+            var readBack = mailbox.Read<LoRaWAN_keys_t>(Command_e.CMD_KEYS);
+            if (!readBack.keyData.SequenceEqual(keys.keyData))
+                throw new InvalidOperationException("Key verification failed.");
+            if (!commit)
+                return new { Written = true, Committed = false };
+            var stored = mailbox.Commit();
+            return new { Written = true, Committed = true, KeysCrc = $"0x{stored.KeysCrc:X8}" };
+        }
+
+        private object Info()
+        {
+            var mailbox = Mailbox();
+            var core = mailbox.Read<coreInfo_t>(Command_e.CMD_INFO_STACK);
+            var firmware = mailbox.Read<FirmwareInfo_t>(Command_e.CMD_INFO_FIRMWARE);
+            return new
+            {
+                StackVersion = Version(core.StackVersion),
+                StackBuild = $"{core.BuildDayOfMonth:D2}-{core.BuildMonth:D2}-{core.BuildYear:D2} {core.BuildHour:D2}:{core.BuildMinute:D2}:{core.BuildSecond:D2} #{core.BuildNumber}",
+                DevEui = Convert.ToHexString(core.DevEUI ?? Array.Empty<byte>()),
+                CodeName = core.CodeName ?? string.Empty,
+                BuildType = core.BuildType.ToString(),
+                StackRegion = core.StackRegion.ToString(),
+                StackOption = core.StackOption.ToString(),
+                StackStage = core.StackStage.ToString(),
+                FirmwareVersion = Version(firmware.FirmwareVersion),
+                FirmwareBuild = $"{firmware.BuildDayOfMonth:D2}-{firmware.BuildMonth:D2}-{firmware.BuildYear:D2} {firmware.BuildHour:D2}:{firmware.BuildMinute:D2}:{firmware.BuildSecond:D2} #{firmware.BuildNumber}",
+            };
+        }
+
+        private object ReadAdc() => new { Voltage = Mailbox().ReadInt32(Command_e.CMD_ADCVAL) / 1000.0 };
+
+        private AdcStream AdcStreamReader(bool output = false) => new AdcStream(Mailbox(), (address, length) =>
+        {
+            if (UseServer) return Client.ReadMemory(address, length);
+            Programmer.Attach(AP_e.AP_CM4);
+            return Programmer.TransferBlockRead(address, 0, length);
+        }, output);
+
+        /// <summary>Shows, or sets, the filter, decimation and statistics window of the ADC processing stage.</summary>
+        /// <param name="filter">Empty to keep the filter, "none", "fir taps cutoff" or "biquad cutoff [stages]".</param>
+        /// <param name="decimation">Filtered samples per output sample, 0 to keep.</param>
+        /// <param name="window">Output samples per statistics window, 0 to keep.</param>
+        private object AdcProcessing(List<string> filter, int decimation, int window)
+        {
+            var stream = AdcStreamReader();
+            var config = stream.Processing();
+            if (filter.Count > 0 || decimation > 0 || window > 0)
+            {
+                decimation = decimation > 0 ? decimation : config.Decimation;
+                window = window > 0 ? window : config.Window;
+                double rate = stream.Info().Rate;
+                if (filter.Count == 0)
+                {
+                    config.Decimation = (ushort)decimation;
+                    config.Window = (ushort)window;
+                }
+                else config = filter[0] switch
+                {
+                    "none" => AdcFilter.None(decimation, window),
+                    "fir" => AdcFilter.LowpassFir(int.Parse(Argument(filter, 1, "taps")), double.Parse(Argument(filter, 2, "cutoff Hz")), rate, decimation, window),
+                    "biquad" => AdcFilter.LowpassBiquad(filter.Count > 2 ? int.Parse(filter[2]) : 1, double.Parse(Argument(filter, 1, "cutoff Hz")), rate, decimation, window),
+                    _ => throw new ArgumentException($"Unknown filter '{filter[0]}', use none, fir or biquad."),
+                };
+                stream.Configure(config);
+                config = stream.Processing();
+            }
+            int coeffs = config.Filter == adcFilter_e.Biquad ? config.Length * 6 : config.Filter == adcFilter_e.FIR ? config.Length : 0;
+            return new
+            {
+                config.Filter,
+                config.Length,
+                config.PostShift,
+                config.Decimation,
+                config.Window,
+                OutputRate = stream.Info().Rate / (double)config.Decimation,
+                Coeffs = string.Join(" ", config.Coeffs.Take(coeffs)),
+            };
+        }
+
+        /// <summary>Scans the ADC channels, after changing the scan configuration when asked.</summary>
+        /// <param name="channels">Comma separated P10 pins (0-7), null to keep.</param>
+        /// <param name="average">Samples averaged per channel (1-256, a power of two), 0 to keep.</param>
+        /// <param name="aperture">Sample time in SAR clock cycles, 0 to keep.</param>
+        private object ScanAdc(string? channels, int average, int aperture)
+        {
+            var scanner = new AdcScan(Mailbox());
+            if (channels != null || average > 0 || aperture > 0)
+            {
+                var config = scanner.Config();
+                if (channels != null)
+                    config.Channels = (byte)channels.Split(',').Select(int.Parse).Aggregate(0, (mask, pin) =>
+                        pin is >= 0 and < AdcScanConfig_t.CHANNELS ? mask | 1 << pin : throw new ArgumentException($"Channel {pin} is not a P10 pin."));
+                if (average > 0)
+                    config.Averaging = (byte)(BitOperations.IsPow2(average) ? BitOperations.Log2((uint)average) : throw new ArgumentException("Average a power of two samples."));
+                if (aperture > 0)
+                    config.SampleTime = (ushort)aperture;
+                scanner.Configure(config);
+            }
+            var scan = scanner.Scan();
+            return Enumerable.Range(0, AdcScanConfig_t.CHANNELS).Where(pin => (scan.Channels & 1 << pin) != 0).Select(pin => new
+            {
+                scan.Scans,
+                Channel = $"P10.{pin}",
+                Voltage = scan.Millivolts[pin] / 1000.0,
+                Counts = scan.Counts[pin],
+                DurationUs = scan.Duration,
+            }).ToList();
+        }
+
+        /// <summary>Shows, or sets, the threshold event mode with its counters and last event.</summary>
+        /// <param name="condition">Empty to keep, "off", "below mv", "above mv", "inside low high" or "outside low high".</param>
+        /// <param name="pre">Samples before the trigger, -1 to keep.</param>
+        /// <param name="post">Samples from the trigger on, -1 to keep.</param>
+        /// <param name="holdoff">Samples after an event before re-arming, -1 to keep.</param>
+        private object AdcEventMode(List<string> condition, int pre, int post, int holdoff)
+        {
+            var events = new AdcEvents(Mailbox());
+            var config = events.Config();
+            if (condition.Count > 0 || pre >= 0 || post >= 0 || holdoff >= 0)
+            {
+                if (condition.Count > 0)
+                {
+                    config.Condition = Enum.TryParse(condition[0], true, out adcEventCondition_e parsed) ? parsed
+                        : throw new ArgumentException($"Unknown event condition '{condition[0]}', use off, below, above, inside or outside.");
+                    if (config.Condition == adcEventCondition_e.Below)
+                        config.Low = short.Parse(Argument(condition, 1, "limit mV"));
+                    else if (config.Condition == adcEventCondition_e.Above)
+                        config.High = short.Parse(Argument(condition, 1, "limit mV"));
+                    else if (config.Condition != adcEventCondition_e.Off)
+                    {
+                        config.Low = short.Parse(Argument(condition, 1, "low mV"));
+                        config.High = short.Parse(Argument(condition, 2, "high mV"));
+                    }
+                }
+                if (pre >= 0) config.Pre = (byte)pre;
+                if (post >= 0) config.Post = (byte)post;
+                if (holdoff >= 0) config.Holdoff = (ushort)holdoff;
+                events.Configure(config);
+                config = events.Config();
+            }
+            var status = events.Status();
+            return new
+            {
+                config.Condition,
+                Low = config.Low / 1000.0,
+                High = config.High / 1000.0,
+                config.Pre,
+                config.Post,
+                config.Holdoff,
+                status.Triggered,
+                status.Queued,
+                status.Dropped,
+                LastTimestamp = status.Last.Timestamp,
+                LastEvent = string.Join(" ", status.Last.Millivolts.Take(status.Last.Count).Select((mv, i) => i == status.Last.Pre ? $"[{mv}]" : $"{mv}")),
+            };
+        }
+
+        private object KvInfo()
+        {
+            var info = new KvStore(Mailbox()).Info();
+            return new
+            {
+                info.Keys,
+                info.LiveBytes,
+                info.Capacity,
+                info.FreeBlocks,
+                info.Blocks,
+                info.MaxValue,
+                info.Sequence,
+                info.Compactions,
+            };
+        }
+
+        /// <summary>Reads the values of the keys, all values when none given.</summary>
+        private object KvGet(List<byte> keys)
+        {
+            var store = new KvStore(Mailbox());
+            var values = keys.Count == 0 ? store.Read() : store.Read(keys.Min(), keys.Max());
+            return values.Where(kv => keys.Count == 0 || keys.Contains(kv.Key)).Select(kv => new
+            {
+                kv.Key,
+                kv.Value.Length,
+                Value = Convert.ToHexString(kv.Value),
+            }).ToList();
+        }
+
+        private object KvWrite(List<KeyValuePair<byte, byte[]?>> entries)
+        {
+            new KvStore(Mailbox()).Write(entries);
+            return new { Written = entries.Count(kv => kv.Value != null), Deleted = entries.Count(kv => kv.Value == null) };
+        }
+
+        private static byte ParseKey(string text) =>
+            byte.TryParse(text, out byte key) && key < KvStore.KEYS ? key : throw new ArgumentException($"Invalid key '{text}', use 0 to {KvStore.KEYS - 1}.");
+
+        /// <summary>Decodes an uplink payload: a frame of aggregated readings or, with isEvent, a threshold event.</summary>
+        /// <param name="received">Receive time of the uplink (ISO 8601), null for now.</param>
+        private static object DecodeUplink(byte[] payload, bool isEvent, string? received)
+        {
+            if (isEvent)
+            {
+                var adcEvent = AdcEvents.Decode(payload);
+                return new
+                {
+                    adcEvent.Timestamp,
+                    adcEvent.Number,
+                    Samples = string.Join(" ", adcEvent.Millivolts.Take(adcEvent.Count).Select((mv, i) => i == adcEvent.Pre ? $"[{mv}]" : $"{mv}")),
+                };
+            }
+            var time = received != null ? DateTime.Parse(received, System.Globalization.CultureInfo.InvariantCulture) : DateTime.Now;
+            return AdcAggregate.Decode(payload, time).Select(reading => new
+            {
+                Time = reading.Time.ToString("s"),
+                Values = string.Join(" ", reading.Values),
+            }).ToList();
+        }
+
+        private static object AdcStatistics(AdcStats_t stats) => new
+        {
+            stats.Windows,
+            stats.Timestamp,
+            stats.Count,
+            Mean = stats.Mean / 1000.0,
+            Min = stats.Min / 1000.0,
+            Max = stats.Max / 1000.0,
+            Rms = stats.Rms / 1000.0,
+        };
+
+        private object AdcHistory(int count)
+        {
+            var samples = AdcStreamReader().History(count, out uint head);
+            return samples.Select((sample, i) => new
+            {
+                Sequence = head - samples.Length + i,
+                sample.Timestamp,
+                Voltage = sample.Millivolts / 1000.0,
+                sample.Counts,
+            }).ToList();
+        }
+
+        /// <summary>Emits every sample of the ADC stream until cancelled or count samples are taken.</summary>
+        /// <param name="rate">Sample rate to start the stream with, 0 to read the running stream.</param>
+        /// <param name="intervalMs">Time between ring buffer reads.</param>
+        /// <param name="filtered">Read the output of the processing stage instead of the raw samples.</param>
+        private void StreamAdc(uint rate, int intervalMs, int count, bool filtered, Action<object> emit)
+        {
+            var stream = AdcStreamReader(filtered);
+            if (rate > 0) stream.Start(rate);
+            int emitted = 0;
+            while ((count == 0 || emitted < count) && !Cancel.IsCancellationRequested)
+            {
+                var samples = stream.Read(out uint first);
+                for (int i = 0; i < samples.Length && (count == 0 || emitted < count); i++, emitted++)
+                    emit(new
+                    {
+                        Sequence = first + (uint)i,
+                        samples[i].Timestamp,
+                        Voltage = samples[i].Millivolts / 1000.0,
+                        samples[i].Counts,
+                        stream.Lost,
+                    });
+                if (Cancel.WaitHandle.WaitOne(intervalMs)) break;
+            }
+        }
+
+        private object ReadLeds()
+        {
+            uint state = Mailbox().ReadInt32(Command_e.CMD_LEDS);
+            return new { Red = (state & 0x00000001) != 0, Blue = (state & 0x00000100) != 0 };
+        }
+
+        private object SetLeds(bool red, bool blue)
+        {
+            Mailbox().WriteInt32((red ? 0x00000001u : 0) | (blue ? 0x00000100u : 0), Command_e.CMD_LEDS);
+            return new { Red = red, Blue = blue };
+        }
+
+        /// <summary>Samples the ADC and LED state until cancelled or count samples are taken.</summary>
+        private void Watch(int intervalMs, int count, Action<object> emit)
+        {
+            var mailbox = Mailbox();
+            var start = Stopwatch.StartNew();
+            for (int sample = 0; (count == 0 || sample < count) && !Cancel.IsCancellationRequested; sample++)
+            {
+                if (sample > 0 && Cancel.WaitHandle.WaitOne(intervalMs)) break;
+                double voltage = mailbox.ReadInt32(Command_e.CMD_ADCVAL) / 1000.0;
+                uint leds = mailbox.ReadInt32(Command_e.CMD_LEDS);
+                emit(new
+                {
+                    Sample = sample,
+                    Time = Math.Round(start.Elapsed.TotalSeconds, 3),
+                    Voltage = voltage,
+                    Red = (leds & 0x00000001) != 0,
+                    Blue = (leds & 0x00000100) != 0,
+                });
+            }
+        }
+
+        /// <summary>Resolves the probe selector to a probe.</summary>
+        private CmsisDap.DeviceInfo SelectProbe()
+        {
+            if (ProbeSelector.StartsWith("sim"))
+                return SimulatedProbe.Enumerate(1)[0];
+
+            var probes = dap.Enumerate();
+            if (probes.Count == 0)
+                throw new IOException("No CMSIS-DAP device found.");
+            if (int.TryParse(ProbeSelector, out int index))
+                return index < probes.Count ? probes[index] : throw new ArgumentException($"Probe {index} not found, {probes.Count} probe(s) connected.");
+            return probes.FirstOrDefault(p => p.Path.Contains(ProbeSelector, StringComparison.OrdinalIgnoreCase))
+                ?? throw new ArgumentException($"No probe matches '{ProbeSelector}'.");
+        }
+
+        private void ReportProgress(uint value, uint max)
+        {
+            if (!ShowProgress || max == 0) return;
+            Console.Error.Write($"\r{Math.Min(100, (ulong)value * 100 / max),3}%");
+            if (value >= max) Console.Error.Write("\r    \r");
+        }
+
+        private static string Argument(List<string> args, int index, string name) =>
+            index < args.Count && !args[index].StartsWith("--") ? args[index] : throw new ArgumentException($"Missing argument <{name}>.");
+
+        private static int Option(List<string> args, string name, int defaultValue)
+        {
+            int index = args.IndexOf(name);
+            return index >= 0 && index + 1 < args.Count ? int.Parse(args[index + 1]) : defaultValue;
+        }
+
+        private static string? OptionText(List<string> args, string name)
+        {
+            int index = args.IndexOf(name);
+            return index >= 0 && index + 1 < args.Count ? args[index + 1] : null;
+        }
+
+        private static bool ParseOnOff(string value) => value.ToLowerInvariant() switch
+        {
+            "1" or "on" or "true" => true,
+            "0" or "off" or "false" => false,
+            _ => throw new ArgumentException($"'{value}' is not on/off.")
+        };
+
+        /// <param name="length">Expected number of bytes, 0 for any whole number of bytes.</param>
+        private static byte[] ParseHex(string value, int length)
+        {
+            string hex = new string(value.Replace("0x", "").Where(c => c != '-' && c != ':').ToArray());
+            if ((length > 0 ? hex.Length != length * 2 : hex.Length == 0 || hex.Length % 2 != 0) || !hex.All(Uri.IsHexDigit))
+                throw new ArgumentException(length > 0 ? $"'{value}' is not a {length} byte hex value." : $"'{value}' is not a hex byte string.");
+            return Convert.FromHexString(hex);
+        }
+
+        /// <summary>Parses a decimal or 0x prefixed hexadecimal number.</summary>
+        private static uint ParseAddress(string value) =>
+            value.StartsWith("0x", StringComparison.OrdinalIgnoreCase)
+                ? Convert.ToUInt32(value.Substring(2), 16)
+                : uint.Parse(value);
+
+        private static string Version(uint version) =>
+            $"{version >> 24:X2}.{(version >> 16) & 0xFF:X2}.{(version >> 8) & 0xFF:X2}.{version & 0xFF:X2}";
+
+        public void Dispose()
+        {
+            client?.Dispose();
+            device?.Dispose();
+        }
+    }
+}
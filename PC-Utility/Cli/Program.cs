@@ -0,0 +1,268 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Command Line Interface
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Headless front end for scripted production use (Windows, Linux, macOS)
+// - Text output, or one JSON object per result line with --json
+// - Batch mode runs commands from a file or stdin on one open probe
+// - serve shares the probe with other processes, --server makes the memory
+//   and mailbox commands use such a server instead of opening the probe
+//
+// Usage:
+//   dapcli [--probe index|serial|sim] [--family name] [--clock hz] [--json]
+//          [--server] [--socket path] <command> [args]
+//   dapcli [options] batch [file|-] [--keep-going]
+//
+// Commands:
+//   list                                  List connected probes
+//   acquire                               Acquire the target and read the silicon info
+//   tune [--max hz]                       Find the highest reliable SWD clock and store it for the probe
+//   reset                                 Toggle XRES
+//   flash <image> [--no-verify]           Program (and verify) a .hex, .elf or .cyacd2 image
+//   verify <image>                        Verify an image
+//   keys read                             Read the LoRaWAN keys
+//   keys write <DevEUI> <AppEUI> <AppKey> [--no-commit]
+//   info                                  Read the stack and firmware info
+//   adc                                   Read the ADC voltage
+//   adc history [n]                       Read the latest n (max 14) samples of the ADC stream
+//   adc start <hz> | adc stop             Set the ADC stream sample rate, or stop it
+//   adc stream [--rate hz] [--interval ms] [--count n] [--filtered]
+//                                         Read every ADC stream sample from target RAM until Ctrl+C
+//   adc filter [none | fir <taps> <hz> | biquad <hz> [stages]] [--decimate n] [--window n]
+//                                         Show or set the ADC processing stage
+//   adc stats                             Read the statistics of the last ADC processing window
+//   adc scan [--channels 0,3,..] [--average n] [--aperture cycles]
+//                                         Convert the P10 channels in one hardware averaged scan
+//   adc event [off | below|above <mV> | inside|outside <low> <high>] [--pre n] [--post n] [--holdoff n]
+//                                         Show or set the threshold event mode
+//   kv [info]                             Show the usage of the firmware key-value store
+//   kv get [key ..]                       Read values (hex), all keys when none given
+//   kv put <key> <hex> [<key> <hex> ..]   Write values
+//   kv delete <key> [key ..]              Delete keys
+//   decode <hex> [--received time] [--event]
+//                                         Decode an aggregated (or event) uplink payload
+//   leds [red blue]                       Read, or set (on/off) the LEDs
+//   watch [--interval ms] [--count n]     Sample ADC and LEDs until Ctrl+C
+//   read <address> <length>               Read target memory
+//   write <address> <hex>                 Write target memory
+//   monitor <address> <length> [--interval ms] [--count n]
+//                                         Read target memory periodically until Ctrl+C
+//   serve                                 Share the probe through a probe server until Ctrl+C
+//   sleep <ms>                            Pause (batch mode)
+//
+// Exit code: 0 success, 1 command failed, 2 usage error
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Diagnostics;
+using System.Text;
+using System.Text.Json;
+
+namespace CmsisDap_Communicator
+{
+    internal static class Program
+    {
+        private static readonly JsonSerializerOptions JsonOptions = new() { PropertyNamingPolicy = JsonNamingPolicy.CamelCase };
+        private static bool json;
+        private static bool lastUsageError;                                     // Last command failed on its arguments.
+
+        static int Main(string[] args)
+        {
+            var session = new CliSession();
+            bool keepGoing = false;
+            int index = 0;
+            try
+            {
+                for (; index < args.Length && args[index].StartsWith("--"); index++)
+                {
+                    switch (args[index])
+                    {
+                        case "--json": json = true; break;
+                        case "--keep-going": keepGoing = true; break;
+                        case "--probe": session.ProbeSelector = Value(args, ++index); break;
+                        case "--server": session.UseServer = true; break;
+                        case "--socket": session.SocketPath = Value(args, ++index); break;
+                        case "--clock": session.SwjClockSpeed = uint.Parse(Value(args, ++index)); break;
+                        case "--family":
+                            string name = Value(args, ++index);
+                            session.Family = PSoC6Family.All.FirstOrDefault(f => f.Name.Equals(name, StringComparison.OrdinalIgnoreCase))
+                                ?? throw new ArgumentException($"Unknown family '{name}', use {string.Join(", ", PSoC6Family.All.Select(f => f.Name))}.");
+                            break;
+                        case "--help": return Usage(0);
+                        default: throw new ArgumentException($"Unknown option '{args[index]}'.");
+                    }
+                }
+            }
+            catch (Exception ex) when (ex is ArgumentException or FormatException)
+            {
+                Console.Error.WriteLine(ex.Message);
+                return 2;
+            }
+            if (index >= args.Length)
+                return Usage(2);
+            if (args[index] == "help")
+                return Usage(0);
+
+            session.ShowProgress = !json && !Console.IsErrorRedirected;
+            var cancel = new CancellationTokenSource();
+            Console.CancelKeyPress += (sender, e) =>
+            {
+                // First Ctrl+C stops a running watch, monitor or serve, the second one terminates
+                if (cancel.IsCancellationRequested) return;
+                cancel.Cancel();
+                e.Cancel = true;
+            };
+            session.Cancel = cancel.Token;
+
+            using (session)
+            {
+                var command = args.Skip(index).ToList();
+                if (command[0] != "batch")
+                    return Execute(session, command) ? 0 : (lastUsageError ? 2 : 1);
+
+                if (command.Skip(1).Contains("--keep-going")) keepGoing = true;
+                string source = command.Skip(1).FirstOrDefault(a => !a.StartsWith("--")) ?? "-";
+                using var reader = source == "-" ? Console.In : new StreamReader(source);
+                bool allOk = true;
+                string? line;
+                while ((line = reader.ReadLine()) != null && !cancel.IsCancellationRequested)
+                {
+                    var tokens = Tokenize(line);
+                    if (tokens.Count == 0 || tokens[0].StartsWith('#')) continue;
+                    if (!Execute(session, tokens))
+                    {
+                        allOk = false;
+                        if (!keepGoing) break;
+                    }
+                }
+                return allOk ? 0 : 1;
+            }
+        }
+
+        /// <summary>Runs a command and writes its results or error.</summary>
+        /// <returns>True if the command succeeded.</returns>
+        private static bool Execute(CliSession session, List<string> command)
+        {
+            string name = string.Join(" ", command.TakeWhile(a => !a.StartsWith("--")).Take(command[0] is "keys" or "adc" or "kv" ? 2 : 1));
+            var stopwatch = Stopwatch.StartNew();
+            try
+            {
+                session.Run(command, result => WriteResult(name, result, stopwatch.Elapsed));
+                return true;
+            }
+            catch (Exception ex)
+            {
+                lastUsageError = ex is ArgumentException or FormatException;
+                if (json)
+                    Console.WriteLine(JsonSerializer.Serialize(new { command = name, ok = false, error = ex.Message }, JsonOptions));
+                else
+                    Console.Error.WriteLine($"{name}: FAILED: {ex.Message}");
+                return false;
+            }
+        }
+
+        private static void WriteResult(string name, object result, TimeSpan elapsed)
+        {
+            if (json)
+            {
+                Console.WriteLine(JsonSerializer.Serialize(new { command = name, ok = true, elapsedMs = Math.Round(elapsed.TotalMilliseconds, 1), result }, JsonOptions));
+                return;
+            }
+            if (result is System.Collections.IEnumerable items and not string)
+            {
+                foreach (var item in items)
+                    Console.WriteLine(string.Join("  ", item.GetType().GetProperties().Select(p => $"{p.Name}={p.GetValue(item)}")));
+                return;
+            }
+            var properties = result.GetType().GetProperties();
+            int width = properties.Max(p => p.Name.Length);
+            foreach (var property in properties)
+                Console.WriteLine($"{property.Name.PadRight(width)} : {property.GetValue(result)}");
+        }
+
+        /// <summary>Splits a batch line on whitespace, double quotes group words.</summary>
+        private static List<string> Tokenize(string line)
+        {
+            var tokens = new List<string>();
+            var current = new StringBuilder();
+            bool quoted = false, any = false;
+            foreach (char c in line)
+            {
+                if (c == '"') { quoted = !quoted; any = true; }
+                else if (char.IsWhiteSpace(c) && !quoted)
+                {
+                    if (any) tokens.Add(current.ToString());
+                    current.Clear();
+                    any = false;
+                }
+                else { current.Append(c); any = true; }
+            }
+            if (any) tokens.Add(current.ToString());
+            return tokens;
+        }
+
+        private static string Value(string[] args, int index) =>
+            index < args.Length ? args[index] : throw new ArgumentException($"Missing value for {args[index - 1]}.");
+
+        private static int Usage(int exitCode)
+        {
+            Console.WriteLine("""
+                Usage: dapcli [--probe index|serial|sim] [--family name] [--clock hz] [--json]
+                              [--server] [--socket path] <command> [args]
+                       dapcli [options] batch [file|-] [--keep-going]
+
+                Commands:
+                  list                                  List connected probes
+                  acquire                               Acquire the target and read the silicon info
+                  tune [--max hz]                       Find the highest reliable SWD clock and store it for the probe
+                  reset                                 Toggle XRES
+                  flash <image> [--no-verify]           Program (and verify) a .hex, .elf or .cyacd2 image
+                  verify <image>                        Verify an image
+                  keys read                             Read the LoRaWAN keys
+                  keys write <DevEUI> <AppEUI> <AppKey> [--no-commit]
+                  info                                  Read the stack and firmware info
+                  adc                                   Read the ADC voltage
+                  adc history [n]                       Read the latest n (max 14) samples of the ADC stream
+                  adc start <hz> | adc stop             Set the ADC stream sample rate, or stop it
+                  adc stream [--rate hz] [--interval ms] [--count n] [--filtered]
+                                                        Read every ADC stream sample from target RAM until Ctrl+C
+                  adc filter [none | fir <taps> <hz> | biquad <hz> [stages]] [--decimate n] [--window n]
+                                                        Show or set the ADC processing stage
+                  adc stats                             Read the statistics of the last ADC processing window
+                  adc scan [--channels 0,3,..] [--average n] [--aperture cycles]
+                                                        Convert the P10 channels in one hardware averaged scan
+                  adc event [off | below|above <mV> | inside|outside <low> <high>] [--pre n] [--post n] [--holdoff n]
+                                                        Show or set the threshold event mode
+                  kv [info]                             Show the usage of the firmware key-value store
+                  kv get [key ..]                       Read values (hex), all keys when none given
+                  kv put <key> <hex> [<key> <hex> ..]   Write values
+                  kv delete <key> [key ..]              Delete keys
+                  decode <hex> [--received time] [--event]
+                                                        Decode an aggregated (or event) uplink payload
+                  leds [red blue]                       Read, or set (on/off) the LEDs
+                  watch [--interval ms] [--count n]     Sample ADC and LEDs until Ctrl+C
+                  read <address> <length>               Read target memory
+                  write <address> <hex>                 Write target memory
+                  monitor <address> <length> [--interval ms] [--count n]
+                                                        Read target memory periodically until Ctrl+C
+                  serve                                 Share the probe through a probe server until Ctrl+C
+                  sleep <ms>                            Pause (batch mode)
+                """);
+            return exitCode;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Aggregated Uplink Decoder
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Decodes the uplink frames in which the firmware batches its readings
+//   (aggregate.c): a format byte, the age of the first reading, then per
+//   reading the seconds since the previous one and the value differences,
+//   as LEB128 varints, signed numbers zigzag coded
+// - The receive time of the frame gives the absolute reading times
+// - A reading too large for a frame at the data rate comes as is: format
+//   version 0, then the values as int16
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Reading of an aggregated uplink, for the ADC statistics the values are mean, min, max and RMS (mV).</summary>
+    public readonly record struct AggregateReading(DateTime Time, short[] Values);
+
+    /// <summary>Decoder of the firmware's aggregated uplink frames.</summary>
+    public static class AdcAggregate
+    {
+        public const int VERSION = 1;                                           // AGGREGATE_VERSION.
+        public const int RAW_VERSION = 0;                                       // AGGREGATE_RAW_VERSION, a single reading.
+        public const int MAX_VALUES = 8;                                        // AGGREGATE_MAX_VALUES.
+
+        /// <summary>Decodes an aggregated uplink frame.</summary>
+        /// <param name="payload">Application payload of the frame.</param>
+        /// <param name="received">Time the frame was received, the firmware flushed it just before sending.</param>
+        /// <returns>Readings, oldest first.</returns>
+        /// <exception cref="FormatException">Thrown when the payload is not an aggregated frame.</exception>
+        public static AggregateReading[] Decode(byte[] payload, DateTime received)
+        {
+            if (payload.Length >= 3 && payload[0] >> 4 == RAW_VERSION && (payload[0] & 0x0F) is > 0 and <= MAX_VALUES && payload.Length == 1 + (payload[0] & 0x0F) * 2)
+                return new[] { new AggregateReading(received, Enumerable.Range(0, payload[0] & 0x0F).Select(i => BitConverter.ToInt16(payload, 1 + i * 2)).ToArray()) };
+            if (payload.Length < 2 || payload[0] >> 4 != VERSION || (payload[0] & 0x0F) is 0 or > MAX_VALUES)
+                throw new FormatException($"Not an aggregated uplink payload ({payload.Length} bytes).");
+            int count = payload[0] & 0x0F;
+            int offset = 1;
+            var time = received - TimeSpan.FromSeconds(Varint(payload, ref offset));
+            var readings = new List<AggregateReading>();
+            var values = new int[count];
+            while (offset < payload.Length)
+            {
+                if (readings.Count > 0)
+                    time += TimeSpan.FromSeconds(Varint(payload, ref offset));
+                for (int i = 0; i < count; i++)
+                    values[i] = (readings.Count > 0 ? values[i] : 0) + ZigZag(Varint(payload, ref offset));
+                readings.Add(new AggregateReading(time, values.Select(v => (short)v).ToArray()));
+            }
+            if (readings.Count == 0)
+                throw new FormatException("Aggregated uplink payload without readings.");
+            return readings.ToArray();
+        }
+
+        private static uint Varint(byte[] data, ref int offset)
+        {
+            uint value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                if (offset >= data.Length)
+                    throw new FormatException("Aggregated uplink payload ends within a number.");
+                byte b = data[offset++];
+                value |= (uint)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                    return value;
+            }
+            throw new FormatException("Aggregated uplink payload has an overlong number.");
+        }
+
+        private static int ZigZag(uint value) => (int)(value >> 1) ^ -(int)(value & 1);
+    }
+}
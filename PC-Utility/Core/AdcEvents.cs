@@ -0,0 +1,74 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - ADC Threshold Events
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Configures the firmware event mode through the mailbox: the SAR range
+//   detection triggers on a threshold crossing, the firmware captures the
+//   stream samples around the trigger and sends only these events uplink
+// - Decodes the event uplink payload
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Threshold events of the firmware ADC stream.</summary>
+    public class AdcEvents
+    {
+        private const int EVENT_HEADER_SIZE = 8;                                // AdcEvent_t fields before the samples.
+
+        private readonly IMailbox mailbox;
+
+        public AdcEvents(IMailbox mailbox)
+        {
+            this.mailbox = mailbox;
+        }
+
+        /// <summary>Reads the event mode configuration.</summary>
+        public AdcEventConfig_t Config() => mailbox.Read<AdcEventConfig_t>(Command_e.CMD_ADCEVENTCFG);
+
+        /// <summary>Sets the event condition, limits and capture, detection starts over.</summary>
+        /// <exception cref="ArgumentException">Thrown when the configuration is out of the firmware's range.</exception>
+        public void Configure(AdcEventConfig_t config)
+        {
+            if (config.Condition > adcEventCondition_e.Outside)
+                throw new ArgumentException($"Unknown event condition {config.Condition}.");
+            if (config.Post == 0 || config.Pre + config.Post > AdcEvent_t.MAX_SAMPLES)
+                throw new ArgumentException($"Events hold at least one post-trigger sample and at most {AdcEvent_t.MAX_SAMPLES} samples.");
+            if (config.Low > config.High)
+                throw new ArgumentException("Low limit above the high limit.");
+            mailbox.Write(config, Command_e.CMD_ADCEVENTCFG);
+        }
+
+        /// <summary>Reads the event counters and the last event.</summary>
+        public AdcEventStatus_t Status() => mailbox.Read<AdcEventStatus_t>(Command_e.CMD_ADCEVENT);
+
+        /// <summary>Decodes an event uplink payload.</summary>
+        /// <exception cref="FormatException">Thrown when the payload is not an event.</exception>
+        public static AdcEvent_t Decode(byte[] payload)
+        {
+            if (payload.Length < EVENT_HEADER_SIZE || payload[7] > AdcEvent_t.MAX_SAMPLES || payload.Length != EVENT_HEADER_SIZE + payload[7] * 2)
+                throw new FormatException($"Not an ADC event payload ({payload.Length} bytes).");
+            var data = new byte[GetStructSize<AdcEvent_t>()];
+            Array.Copy(payload, data, payload.Length);
+            var result = new AdcEvent_t();
+            DataToStruct(data, ref result);
+            return result;
+        }
+    }
+}
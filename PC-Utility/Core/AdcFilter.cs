@@ -0,0 +1,109 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - ADC Filter Design
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Designs the fixed point coefficients of the firmware ADC processing stage:
+//   windowed-sinc FIR low-pass in Q15 and Butterworth biquad low-pass in the
+//   CMSIS-DSP df1 Q15 layout
+// - Rounded coefficients are corrected for unity DC gain, so the window mean
+//   matches the input level
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Coefficient design for AdcDspConfig_t.</summary>
+    public static class AdcFilter
+    {
+        private const int BIQUAD_POST_SHIFT = 1;                                // Coefficients in Q14, |a1| may reach 2.
+
+        /// <summary>No filter, only decimation and statistics.</summary>
+        public static AdcDspConfig_t None(int decimation, int window) => Config(adcFilter_e.None, 0, 0, decimation, window, new short[0]);
+
+        /// <summary>Windowed-sinc (Hamming) FIR low-pass.</summary>
+        /// <param name="taps">Even number of taps, at most MAX_COEFFS.</param>
+        /// <param name="cutoffHz">-6 dB frequency.</param>
+        /// <param name="rateHz">Stream sample rate.</param>
+        public static AdcDspConfig_t LowpassFir(int taps, double cutoffHz, double rateHz, int decimation, int window)
+        {
+            if (taps < 2 || taps > AdcDspConfig_t.MAX_COEFFS || taps % 2 != 0)
+                throw new ArgumentException($"FIR filters need an even number of 2 to {AdcDspConfig_t.MAX_COEFFS} taps.");
+            CheckCutoff(cutoffHz, rateHz);
+            double fc = cutoffHz / rateHz;
+            var h = new double[taps];
+            for (int n = 0; n < taps; n++)
+            {
+                double m = n - (taps - 1) / 2.0;
+                double sinc = m == 0 ? 2 * fc : Math.Sin(2 * Math.PI * fc * m) / (Math.PI * m);
+                h[n] = sinc * (0.54 - 0.46 * Math.Cos(2 * Math.PI * n / (taps - 1)));
+            }
+            double gain = h.Sum();
+            return Config(adcFilter_e.FIR, taps, 0, decimation, window, Quantize(h.Select(c => c / gain).ToArray(), 15));
+        }
+
+        /// <summary>Butterworth biquad low-pass (Q = 1/sqrt(2)), as a cascade of identical stages.</summary>
+        /// <param name="stages">Number of biquad stages, at most MAX_COEFFS / 6.</param>
+        public static AdcDspConfig_t LowpassBiquad(int stages, double cutoffHz, double rateHz, int decimation, int window)
+        {
+            if (stages < 1 || stages > AdcDspConfig_t.MAX_COEFFS / 6)
+                throw new ArgumentException($"Biquad filters need 1 to {AdcDspConfig_t.MAX_COEFFS / 6} stages.");
+            CheckCutoff(cutoffHz, rateHz);
+            double w0 = 2 * Math.PI * cutoffHz / rateHz;
+            double alpha = Math.Sin(w0) / Math.Sqrt(2);
+            double a0 = 1 + alpha;
+            double b0 = (1 - Math.Cos(w0)) / 2 / a0, b1 = (1 - Math.Cos(w0)) / a0;
+            double a1 = -2 * Math.Cos(w0) / a0, a2 = (1 - alpha) / a0;
+
+            // Feedback coefficients are negated in the CMSIS-DSP layout, the numerator absorbs the rounding of all five
+            int scale = 1 << (15 - BIQUAD_POST_SHIFT);
+            short qa1 = (short)Math.Round(-a1 * scale), qa2 = (short)Math.Round(-a2 * scale);
+            short qb0 = (short)Math.Round(b0 * scale);
+            short qb1 = (short)(scale - qa1 - qa2 - 2 * qb0);
+            var stage = new short[] { qb0, 0, qb1, qb0, qa1, qa2 };
+            return Config(adcFilter_e.Biquad, stages, BIQUAD_POST_SHIFT, decimation, window, Enumerable.Repeat(stage, stages).SelectMany(c => c).ToArray());
+        }
+
+        private static void CheckCutoff(double cutoffHz, double rateHz)
+        {
+            if (rateHz <= 0)
+                throw new ArgumentException("ADC stream not running, the filter needs its sample rate.");
+            if (cutoffHz <= 0 || cutoffHz >= rateHz / 2)
+                throw new ArgumentException($"Cutoff must be between 0 and {rateHz / 2} Hz (half the sample rate).");
+        }
+
+        /// <summary>Rounds to Q(bits) and puts the rounding error of the sum into the largest coefficient.</summary>
+        private static short[] Quantize(double[] coeffs, int bits)
+        {
+            int scale = 1 << bits;
+            var q = coeffs.Select(c => (int)Math.Round(c * scale)).ToArray();
+            int largest = Array.IndexOf(q, q.Max());
+            q[largest] += scale - q.Sum();
+            return q.Select(c => (short)Math.Clamp(c, short.MinValue, short.MaxValue)).ToArray();
+        }
+
+        private static AdcDspConfig_t Config(adcFilter_e filter, int length, int postShift, int decimation, int window, short[] coeffs)
+        {
+            if (decimation < 1 || decimation > ushort.MaxValue || window < 1 || window > ushort.MaxValue)
+                throw new ArgumentException($"Decimation and window must be 1 to {ushort.MaxValue}.");
+            var padded = new short[AdcDspConfig_t.MAX_COEFFS];
+            Array.Copy(coeffs, padded, coeffs.Length);
+            return new AdcDspConfig_t { Filter = filter, Length = (byte)length, PostShift = (sbyte)postShift, Decimation = (ushort)decimation, Window = (ushort)window, Coeffs = padded };
+        }
+    }
+}
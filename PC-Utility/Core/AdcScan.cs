@@ -0,0 +1,63 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - ADC Scan
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Configures the firmware multi-channel SAR scan (channels on the SARMUX
+//   port P10, hardware averaging, aperture) through the mailbox
+// - One scan converts all channels and returns them in one mailbox read,
+//   a running ADC stream pauses for it
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Multi-channel scans of the firmware ADC.</summary>
+    public class AdcScan
+    {
+        private readonly IMailbox mailbox;
+
+        public AdcScan(IMailbox mailbox)
+        {
+            this.mailbox = mailbox;
+        }
+
+        /// <summary>Reads the scan configuration.</summary>
+        public AdcScanConfig_t Config() => mailbox.Read<AdcScanConfig_t>(Command_e.CMD_ADCSCANCFG);
+
+        /// <summary>Sets the channels, averaging and aperture of the scans.</summary>
+        /// <exception cref="ArgumentException">Thrown when the configuration is out of the firmware's range.</exception>
+        /// <exception cref="InvalidOperationException">Thrown when the firmware refused it, a pin is in use by another peripheral.</exception>
+        public void Configure(AdcScanConfig_t config)
+        {
+            if (config.Channels == 0)
+                throw new ArgumentException("Scan at least one channel.");
+            if (config.Averaging > AdcScanConfig_t.MAX_AVERAGING)
+                throw new ArgumentException($"Averaging of at most {1 << AdcScanConfig_t.MAX_AVERAGING} samples.");
+            if (config.SampleTime is < AdcScanConfig_t.MIN_SAMPLE_TIME or > AdcScanConfig_t.MAX_SAMPLE_TIME)
+                throw new ArgumentException($"Sample time of {AdcScanConfig_t.MIN_SAMPLE_TIME} to {AdcScanConfig_t.MAX_SAMPLE_TIME} clock cycles.");
+            mailbox.Write(config, Command_e.CMD_ADCSCANCFG);
+            var stored = Config();
+            if (stored.Channels != config.Channels || stored.Averaging != config.Averaging || stored.SampleTime != config.SampleTime)
+                throw new InvalidOperationException($"Scan configuration refused, check that pins 0x{config.Channels:X2} of P10 are free for analog use.");
+        }
+
+        /// <summary>Converts all configured channels in one scan.</summary>
+        public AdcScan_t Scan() => mailbox.Read<AdcScan_t>(Command_e.CMD_ADCSCAN);
+    }
+}
@@ -0,0 +1,176 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - ADC Stream Reader
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Controls the firmware ADC stream through the mailbox (rate, latest
+//   samples) and reads its ring buffer directly from target RAM, so the
+//   host keeps up with the full sample rate without firmware involvement
+// - Sample n sits in slot n % Size and is intact while head - n < Size,
+//   samples overwritten before they were read are counted as lost
+// - The same reader serves the raw stream and the output of the processing
+//   stage (filtered, decimated), which has the same ring layout
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Reader of the firmware ADC stream ring buffer.</summary>
+    public class AdcStream
+    {
+        public const uint STREAM_MAGIC = 0x53434441;                            // "ADCS", adcStream_t.magic.
+        public const int STREAM_HEADER_SIZE = 16;                               // adcStream_t fields before the samples.
+        private const int HEAD_OFFSET = 4;                                      // adcStream_t.head.
+        public static readonly int MAX_HISTORY = (MailboxClient.MAILBOX_DATA_SIZE - GetStructSize<AdcHistory_t>()) / GetStructSize<AdcSample_t>();
+
+        private readonly IMailbox mailbox;
+        private readonly Func<uint, int, byte[]> readMemory;
+        private readonly Command_e infoCommand;
+        private AdcStreamInfo_t info;
+        private uint next;                                                      // Sequence number of the next sample to read.
+
+        public long Lost { get; private set; }                                  // Samples overwritten before Read got to them.
+        public uint Rate => info.Rate;
+
+        /// <summary>Constructs a stream reader.</summary>
+        /// <param name="mailbox">Mailbox of the firmware.</param>
+        /// <param name="readMemory">Reads target RAM (address, length), word aligned.</param>
+        /// <param name="output">Read the processing stage output instead of the raw samples.</param>
+        public AdcStream(IMailbox mailbox, Func<uint, int, byte[]> readMemory, bool output = false)
+        {
+            this.mailbox = mailbox;
+            this.readMemory = readMemory;
+            infoCommand = output ? Command_e.CMD_ADCOUTPUT : Command_e.CMD_ADCSTREAM;
+        }
+
+        /// <summary>Reads the ring buffer location and state.</summary>
+        public AdcStreamInfo_t Info()
+        {
+            info = mailbox.Read<AdcStreamInfo_t>(infoCommand);
+            return info;
+        }
+
+        /// <summary>Reads the processing configuration.</summary>
+        public AdcDspConfig_t Processing() => mailbox.Read<AdcDspConfig_t>(Command_e.CMD_ADCDSP);
+
+        /// <summary>Sets the filter, decimation and statistics window, restarting the output and the statistics.</summary>
+        /// <exception cref="ArgumentException">Thrown when the configuration is out of the firmware's range.</exception>
+        public void Configure(AdcDspConfig_t config)
+        {
+            if (config.Decimation == 0 || config.Window == 0)
+                throw new ArgumentException("Decimation and window must be at least 1.");
+            if (config.Filter == adcFilter_e.FIR && (config.Length == 0 || config.Length > AdcDspConfig_t.MAX_COEFFS || config.Length % 2 != 0))
+                throw new ArgumentException($"FIR filters need an even number of 2 to {AdcDspConfig_t.MAX_COEFFS} taps.");
+            if (config.Filter == adcFilter_e.Biquad && (config.Length == 0 || config.Length > AdcDspConfig_t.MAX_COEFFS / 6 || config.PostShift is < 0 or > 14))
+                throw new ArgumentException($"Biquad filters need 1 to {AdcDspConfig_t.MAX_COEFFS / 6} stages and a post shift of 0 to 14.");
+            config.Coeffs ??= new short[AdcDspConfig_t.MAX_COEFFS];
+            if (config.Coeffs.Length != AdcDspConfig_t.MAX_COEFFS)
+                Array.Resize(ref config.Coeffs, AdcDspConfig_t.MAX_COEFFS);
+            mailbox.Write(config, Command_e.CMD_ADCDSP);
+            info = default;
+        }
+
+        /// <summary>Reads the statistics of the last completed window.</summary>
+        public AdcStats_t Stats() => mailbox.Read<AdcStats_t>(Command_e.CMD_ADCSTATS);
+
+        /// <summary>(Re)starts sampling, the firmware averages its scans down to the rate.</summary>
+        /// <param name="rate">Sample rate (Hz), 0 stops the stream.</param>
+        /// <returns>Sample rate achieved.</returns>
+        public uint Start(uint rate)
+        {
+            mailbox.WriteInt32(rate, Command_e.CMD_ADCSTREAM);
+            Info();                                                             // Output rate follows the stream rate.
+            next = 0;
+            Lost = 0;
+            return info.Rate;
+        }
+
+        public void Stop() => Start(0);
+
+        /// <summary>Reads the latest samples through the mailbox.</summary>
+        /// <param name="count">Number of samples, at most MAX_HISTORY.</param>
+        /// <param name="head">Sequence number after the last sample.</param>
+        /// <returns>Samples, oldest first, fewer than count shortly after a start.</returns>
+        public AdcSample_t[] History(int count, out uint head)
+        {
+            if (count < 1 || count > MAX_HISTORY)
+                throw new ArgumentException($"History of 1 to {MAX_HISTORY} samples.");
+            byte[] data = mailbox.ReadData(Command_e.CMD_ADCHISTORY, GetStructSize<AdcHistory_t>() + count * GetStructSize<AdcSample_t>());
+            var history = new AdcHistory_t();
+            DataToStruct(data, ref history);
+            head = history.Head;
+            return Parse(data, GetStructSize<AdcHistory_t>(), Math.Min(count, (int)history.Count));
+        }
+
+        /// <summary>Reads the samples written since the previous Read from target RAM.</summary>
+        /// <param name="first">Sequence number of the first sample returned.</param>
+        /// <exception cref="InvalidOperationException">Thrown when the stream is not running.</exception>
+        public AdcSample_t[] Read(out uint first)
+        {
+            if (info.Address == 0 || info.Rate == 0)
+            {
+                Info();
+                if (info.Rate == 0)
+                    throw new InvalidOperationException("ADC stream not running.");
+                if (ReadWord(info.Address) != STREAM_MAGIC)
+                    throw new InvalidOperationException($"No ADC stream at 0x{info.Address:X8}.");
+                next = info.Head;                                               // Start with the samples to come.
+            }
+
+            uint head = ReadWord(info.Address + HEAD_OFFSET);
+            if (head < next)                                                    // Restarted by the firmware.
+                next = 0;
+            first = next;
+            if (head - first >= info.Size)
+                first = head - info.Size + 1;
+            int count = (int)(head - first);
+            var data = new byte[count * info.SampleSize];
+            int slot = (int)(first % info.Size);
+            int firstPart = Math.Min(count, info.Size - slot);
+            if (firstPart > 0)
+                Array.Copy(readMemory(SlotAddress(slot), firstPart * info.SampleSize), data, firstPart * info.SampleSize);
+            if (count > firstPart)                                              // Wrapped around the end of the ring.
+                Array.Copy(readMemory(SlotAddress(0), (count - firstPart) * info.SampleSize), 0, data, firstPart * info.SampleSize, (count - firstPart) * info.SampleSize);
+
+            // Drop the samples the firmware overwrote while they were read
+            uint after = count > 0 ? ReadWord(info.Address + HEAD_OFFSET) : head;
+            int skip = after - first >= info.Size ? (int)Math.Min(count, after - first - info.Size + 1) : 0;
+            Lost += first + skip - next;
+            first += (uint)skip;
+            next = head;
+            return Parse(data, skip * info.SampleSize, count - skip);
+        }
+
+        private uint SlotAddress(int slot) => info.Address + STREAM_HEADER_SIZE + (uint)(slot * info.SampleSize);
+
+        private uint ReadWord(uint address) => BitConverter.ToUInt32(readMemory(address, 4));
+
+        private AdcSample_t[] Parse(byte[] data, int offset, int count)
+        {
+            var samples = new AdcSample_t[count];
+            int size = GetStructSize<AdcSample_t>();
+            for (int i = 0; i < count; i++, offset += size)
+            {
+                samples[i].Timestamp = BitConverter.ToUInt32(data, offset);
+                samples[i].Millivolts = BitConverter.ToInt16(data, offset + 4);
+                samples[i].Counts = BitConverter.ToInt16(data, offset + 6);
+            }
+            return samples;
+        }
+    }
+}
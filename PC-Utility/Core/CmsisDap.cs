@@ -20,6 +20,7 @@
 // - Provides low-level communication with CMSIS-DAP HID devices
 // - Sends DAP commands and parses basic DAP_INFO queries
 // - Extracts packet capabilities and device identity details
+// - Packs command sequences into DAP_ExecuteCommands packets
 //
 //  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
 //  Created: 2025
@@ -109,10 +110,13 @@ namespace CmsisDap_Communicator
 
         public class Device : IDisposable
         {
-            private HidStream _stream;
-            public bool IsConnected => _stream != null && _stream.CanWrite;
+            private readonly IDapTransport _transport;
+            private readonly Queue<(byte[] Payload, long SentTicks)> _outstanding = new();
+            public DapStatistics Statistics { get; } = new DapStatistics();    // Packet, byte and latency counters per DAP command.
+            public bool IsConnected => _transport.IsConnected;
             public int PacketSize { get; private set; } = 64;
             public int PacketCount { get; private set; } = 1;
+            public bool? SupportsExecuteCommands { get; private set; }         // DAP_ExecuteCommands accepted, null until first used.
             public byte Capabilities { get; private set; }
             public string FirmwareVersion { get; private set; }
             public string VendorName { get; private set; }
@@ -129,12 +133,17 @@ namespace CmsisDap_Communicator
             /// </summary>
             /// <param name="device">The HID device representing a CMSIS-DAP programmer.</param>
             /// <exception cref="IOException">Thrown if the device stream could not be opened.</exception>
-            public Device(HidDevice device)
+            public Device(HidDevice device) : this(new HidTransport(device))
             {
-                if (!device.TryOpen(out _stream))
-                {
-                    throw new IOException("Failed to open device stream.");
-                }
+            }
+
+            /// <summary>
+            /// Initializes a new CMSIS-DAP device on a transport and queries device info.
+            /// </summary>
+            /// <param name="transport">Packet transport to the probe (USB HID or simulated).</param>
+            public Device(IDapTransport transport)
+            {
+                _transport = transport;
 
                 // Initialize device information.
                 Capabilities = SendCommand(new byte[] { CMD_DAP_INFO, INFO_ID_CAPABILITIES }).ElementAtOrDefault(2);
@@ -160,9 +169,6 @@ namespace CmsisDap_Communicator
                 ? Encoding.ASCII.GetString(response.Skip(2).ToArray()).TrimEnd('\0')
                 : string.Empty;
 
-            private readonly byte[] _txBuffer = new byte[65];
-            private readonly byte[] _rxBuffer = new byte[65];
-
             /// <summary>
             /// Sends a DAP command to the CMSIS-DAP device and returns the response (excluding report ID).
             /// </summary>
@@ -170,18 +176,149 @@ namespace CmsisDap_Communicator
             /// <returns>Device response without the report ID.</returns>
             public byte[] SendCommand(byte[] payload)
             {
-                _txBuffer[0] = 0x00; // HID Report ID
-                int len = Math.Min(payload.Length, 64);
-                Buffer.BlockCopy(payload, 0, _txBuffer, 1, len);
-                _stream.Write(_txBuffer, 0, _txBuffer.Length);
-
-                int read = _stream.Read(_rxBuffer, 0, _rxBuffer.Length);
-                if (read < 2)
-                    throw new IOException("Invalid response");
-
-                byte[] result = new byte[read - 1];
-                Buffer.BlockCopy(_rxBuffer, 1, result, 0, read - 1);
-                return result;
+                WritePacket(payload);
+                return ReadPacket();
+            }
+
+            /// <summary>
+            /// Sends a sequence of DAP commands while keeping up to PacketCount commands queued in the probe,
+            /// so the USB round trip of one command overlaps with the execution of the next.
+            /// </summary>
+            /// <param name="payloads">Command payloads in execution order.</param>
+            /// <returns>Device responses (without report ID) in the same order as the commands.</returns>
+            public List<byte[]> SendCommands(IReadOnlyList<byte[]> payloads)
+            {
+                var results = new List<byte[]>(payloads.Count);
+                int window = Math.Max(1, PacketCount);
+                int sent = 0;
+                bool reading = false;
+                try
+                {
+                    while (results.Count < payloads.Count)
+                    {
+                        while (sent < payloads.Count && sent - results.Count < window)
+                        {
+                            WritePacket(payloads[sent]);
+                            sent++;
+                        }
+                        reading = true;
+                        results.Add(ReadPacket());
+                        reading = false;
+                    }
+                    return results;
+                }
+                finally
+                {
+                    // Failed partway: the probe still holds the responses of the commands queued behind,
+                    // read them now or the next command gets one of them
+                    for (int unread = sent - results.Count - (reading ? 1 : 0); unread > 0; unread--)
+                    {
+                        try { ReadPacket(); }
+                        catch { break; }                                        // Transport gone, the first error is the one thrown.
+                    }
+                }
+            }
+
+            /// <summary>
+            /// Sends a command batch, packing consecutive commands into DAP_ExecuteCommands packets as long as
+            /// the request and the largest possible response fit in one packet. Probes that do not know
+            /// DAP_ExecuteCommands get the commands one per packet.
+            /// </summary>
+            /// <param name="batch">Commands in execution order.</param>
+            /// <returns>Device response of every command, split from the packed responses, in command order.</returns>
+            public List<byte[]> Execute(CommandBatch batch)
+            {
+                var commands = batch.Commands;
+                if (SupportsExecuteCommands == false)
+                    return SendCommands(commands);
+
+                var packets = new List<byte[]>();
+                var groups = new List<(int First, int Count)>();
+                for (int first = 0; first < commands.Count;)
+                {
+                    int count = 0, request = 2, response = 2;
+                    while (first + count < commands.Count && count < 255)
+                    {
+                        byte[] command = commands[first + count];
+                        int maxResponse = MaxResponseLength(command);
+                        if (request + command.Length > PacketSize || response + maxResponse > PacketSize) break;
+                        request += command.Length;
+                        response += maxResponse;
+                        count++;
+                    }
+                    // A command that fits only on its own is sent as is
+                    count = Math.Max(1, count);
+                    packets.Add(count == 1 ? commands[first] : ExecuteCommands(commands.Skip(first).Take(count)));
+                    groups.Add((first, count));
+                    first += count;
+                }
+
+                var responses = new List<byte[]>(packets.Count);
+                int sent = 0;
+                if (SupportsExecuteCommands == null && groups.Any(g => g.Count > 1))
+                {
+                    // First packed packet on its own: an unknown command is not executed, so it can be resent unpacked
+                    int probe = groups.FindIndex(g => g.Count > 1);
+                    responses.AddRange(SendCommands(packets.Take(probe + 1).ToList()));
+                    sent = probe + 1;
+                    SupportsExecuteCommands = responses[probe].Length > 0 && responses[probe][0] == CMD_DAP_EXECUTE_COMMANDS;
+                    if (SupportsExecuteCommands == false)
+                    {
+                        var plain = responses.Take(probe).ToList();
+                        plain.AddRange(SendCommands(commands.Skip(groups[probe].First).ToList()));
+                        return plain;
+                    }
+                }
+                responses.AddRange(SendCommands(packets.Skip(sent).ToList()));
+
+                var results = new List<byte[]>(commands.Count);
+                for (int g = 0; g < groups.Count; g++)
+                {
+                    var (first, count) = groups[g];
+                    byte[] packed = responses[g];
+                    if (count == 1)
+                    {
+                        results.Add(packed);
+                        continue;
+                    }
+                    if (packed.Length < 2 || packed[0] != CMD_DAP_EXECUTE_COMMANDS || packed[1] != count)
+                        throw new InvalidOperationException("DAP_ExecuteCommands failed: invalid response.");
+                    int pos = 2;
+                    for (int i = 0; i < count; i++)
+                    {
+                        int length = ResponseLength(commands[first + i], packed, pos);
+                        if (pos + length > packed.Length)
+                            throw new InvalidOperationException("DAP_ExecuteCommands failed: truncated response.");
+                        results.Add(packed.AsSpan(pos, length).ToArray());
+                        pos += length;
+                    }
+                }
+                return results;
+            }
+
+            private void WritePacket(byte[] payload)
+            {
+                _transport.Write(payload);
+                _outstanding.Enqueue((payload, Statistics.Sent()));
+            }
+
+            private byte[] ReadPacket()
+            {
+                byte[] response;
+                try
+                {
+                    response = _transport.Read();
+                }
+                catch
+                {
+                    // Responses of the queued commands are lost with the transport
+                    Statistics.Discard(_outstanding.Count);
+                    _outstanding.Clear();
+                    throw;
+                }
+                if (_outstanding.TryDequeue(out var sent))
+                    Statistics.Received(sent.Payload, response.Length, sent.SentTicks);
+                return response;
             }
 
 
@@ -277,17 +414,18 @@ namespace CmsisDap_Communicator
             public byte[] TransferAbort() => SendCommand(CmsisDap.TransferAbort());
 
             /// <summary>
-            /// Sends a Write Abort command to abort the current write operation.
+            /// Sends a Write Abort command, writes the DP ABORT register.
             /// </summary>
+            /// <param name="abort">Value for the ABORT register.</param>
             /// <returns>The device response as a byte array.</returns>
-            public byte[] WriteAbort() => SendCommand(CmsisDap.WriteAbort());
+            public byte[] WriteAbort(uint abort) => SendCommand(CmsisDap.WriteAbort(abort));
 
             /// <summary>
-            /// Sends a Delay command to the device with the specified delay in milliseconds.
+            /// Sends a Delay command to the device, the probe waits before executing the next command.
             /// </summary>
-            /// <param name="delay">The delay time in milliseconds.</param>
+            /// <param name="microseconds">The delay time in microseconds.</param>
             /// <returns>The device response as a byte array.</returns>
-            public byte[] Delay(byte delay) => SendCommand(CmsisDap.Delay(delay));
+            public byte[] Delay(ushort microseconds) => SendCommand(CmsisDap.Delay(microseconds));
 
             /// <summary>
             /// Sends a SWJ Sequence command with the specified sequence of bytes.
@@ -327,7 +465,7 @@ namespace CmsisDap_Communicator
 
             public void Dispose()
             {
-                _stream?.Dispose();
+                _transport?.Dispose();
             }
         }
 
@@ -375,8 +513,31 @@ namespace CmsisDap_Communicator
 
         }
 
+        /// <summary>Sequence of DAP commands sent with Device.Execute.</summary>
+        public class CommandBatch
+        {
+            private readonly List<byte[]> _commands = new();
+            public IReadOnlyList<byte[]> Commands => _commands;
+            public int Count => _commands.Count;
+
+            /// <summary>Appends a command built by one of the CmsisDap command builders.</summary>
+            /// <exception cref="ArgumentException">Thrown for commands without a response or with an inconsistent length.</exception>
+            public CommandBatch Add(byte[] command)
+            {
+                if (command.Length == 0 || command[0] == CMD_DAP_TFER_ABORT || command[0] == CMD_DAP_EXECUTE_COMMANDS || command[0] == CMD_DAP_QUEUE_COMMANDS)
+                    throw new ArgumentException($"Command 0x{command.ElementAtOrDefault(0):X2} cannot be batched.");
+                if (RequestLength(command, 0) != command.Length)
+                    throw new ArgumentException($"Command 0x{command[0]:X2} has length {command.Length}, expected {RequestLength(command, 0)}.");
+                _commands.Add(command);
+                return this;
+            }
+        }
+
         public Device Open(DeviceInfo info)
         {
+            if (info.Path.StartsWith(SimulatedProbe.PATH_PREFIX))
+                return new Device(new SimulatedProbe(info.Path));
+
             var device = DeviceList.Local.GetHidDevices().FirstOrDefault(d => d.DevicePath == info.Path);
             if (device == null)
             {
@@ -405,6 +566,8 @@ namespace CmsisDap_Communicator
         public const byte CMD_DAP_JTAG_SEQ = 0x14;
         public const byte CMD_DAP_JTAG_CONFIGURE = 0x15;
         public const byte CMD_DAP_JTAG_IDCODE = 0x16;
+        public const byte CMD_DAP_QUEUE_COMMANDS = 0x7E;
+        public const byte CMD_DAP_EXECUTE_COMMANDS = 0x7F;
 
         // DAP Info IDs
         public const byte INFO_ID_VENDOR_NAME = 0x01;
@@ -498,15 +661,19 @@ namespace CmsisDap_Communicator
         public static byte[] TransferBlock(byte dapIndex, byte req, params byte[] payload) =>
             new byte[] { CMD_DAP_TFER_BLOCK, dapIndex, (byte)((payload.Length >> 2) & 0xFF), (byte)(payload.Length >> 10), req }.Concat(payload).ToArray();
 
+        // CMD_DAP_TFER_BLOCK (read): Request 'count' words from the register in 'req', no transfer data is sent.
+        public static byte[] TransferBlockRead(byte dapIndex, byte req, ushort count) =>
+            new byte[] { CMD_DAP_TFER_BLOCK, dapIndex, (byte)(count & 0xFF), (byte)(count >> 8), req };
+
         //
         // CMD_DAP_TFER_ABORT: Abort the current transfer.
         public static byte[] TransferAbort() => new[] { CMD_DAP_TFER_ABORT };
 
-        // CMD_DAP_WRITE_ABORT: Abort the current write operation.
-        public static byte[] WriteAbort() => new[] { CMD_DAP_WRITE_ABORT };
+        // CMD_DAP_WRITE_ABORT: Write the DP ABORT register, 'abort' as 32-bit value (little-endian), also while a transfer is stalled.
+        public static byte[] WriteAbort(uint abort) => new[] { CMD_DAP_WRITE_ABORT, (byte)0x00, (byte)(abort & 0xFF), (byte)(abort >> 8), (byte)(abort >> 16), (byte)(abort >> 24) };
 
-        // CMD_DAP_DELAY: Insert a delay; 'delay' is typically in milliseconds.
-        public static byte[] Delay(byte delay) => new[] { CMD_DAP_DELAY, delay };
+        // CMD_DAP_DELAY: Wait on the probe before the next command, 'microseconds' as 16-bit value (little-endian).
+        public static byte[] Delay(ushort microseconds) => new[] { CMD_DAP_DELAY, (byte)(microseconds & 0xFF), (byte)(microseconds >> 8) };
 
         /// Builds a DAP_Transfer command.
         /// Layout: [0]=0x05 | [1]=DAP Index | [2]=Transfer Count | [3]=Transfer Request | [4..]=Transfer Data (if required).
@@ -525,5 +692,119 @@ namespace CmsisDap_Communicator
 
         // CMD_DAP_JTAG_IDCODE: Retrieve the JTAG IDCODE.
         public static byte[] JtagIdCode() => new[] { CMD_DAP_JTAG_IDCODE };
+
+        // CMD_DAP_EXECUTE_COMMANDS: Execute the given commands from one packet, the responses are packed the same way.
+        public static byte[] ExecuteCommands(IEnumerable<byte[]> commands)
+        {
+            var list = commands.ToList();
+            return new[] { CMD_DAP_EXECUTE_COMMANDS, (byte)list.Count }.Concat(list.SelectMany(c => c)).ToArray();
+        }
+
+        /// <summary>Returns the request length of the command starting at offset.</summary>
+        /// <exception cref="ArgumentException">Thrown for unknown commands.</exception>
+        public static int RequestLength(byte[] buffer, int offset)
+        {
+            byte Byte(int index) => offset + index < buffer.Length ? buffer[offset + index] : (byte)0;
+            switch (buffer[offset])
+            {
+                case CMD_DAP_DISCONNECT:
+                case CMD_DAP_TFER_ABORT:
+                case CMD_DAP_RESET_TARGET:
+                    return 1;
+                case CMD_DAP_INFO:
+                case CMD_DAP_CONNECT:
+                case CMD_DAP_SWD_CONFIGURE:
+                case CMD_DAP_JTAG_IDCODE:
+                    return 2;
+                case CMD_DAP_LED:
+                case CMD_DAP_DELAY:
+                    return 3;
+                case CMD_DAP_SWJ_CLOCK: return 5;
+                case CMD_DAP_TFER_CONFIGURE:
+                case CMD_DAP_WRITE_ABORT:
+                    return 6;
+                case CMD_DAP_SWJ_PINS: return 7;
+                case CMD_DAP_SWJ_SEQ: return 2 + ((Byte(1) == 0 ? 256 : Byte(1)) + 7) / 8;
+                case CMD_DAP_JTAG_CONFIGURE: return 2 + Byte(1);
+                case CMD_DAP_TFER_BLOCK:
+                    return 5 + ((Byte(4) & 0x02) != 0 ? 0 : (Byte(2) | (Byte(3) << 8)) * 4);
+                case CMD_DAP_TFER:
+                {
+                    int pos = 3;
+                    for (int i = 0; i < Byte(2); i++)
+                        pos += Device.RequiresTransferData(Byte(pos)) ? 5 : 1;
+                    return pos;
+                }
+                case CMD_DAP_JTAG_SEQ:
+                {
+                    int pos = 2;
+                    for (int i = 0; i < Byte(1); i++)
+                        pos += 1 + (JtagSequenceBits(Byte(pos)) + 7) / 8;
+                    return pos;
+                }
+                default:
+                    throw new ArgumentException($"Unknown DAP command 0x{buffer[offset]:X2}.");
+            }
+        }
+
+        /// <summary>Returns the length of the response at offset, as answer to command.</summary>
+        /// <exception cref="ArgumentException">Thrown for unknown commands and commands without a response.</exception>
+        public static int ResponseLength(byte[] command, byte[] response, int offset)
+        {
+            byte Byte(int index) => offset + index < response.Length ? response[offset + index] : (byte)0;
+            return command[0] switch
+            {
+                CMD_DAP_INFO => 2 + Byte(1),
+                CMD_DAP_TFER => 3 + 4 * TransferResponseWords(command, Byte(1)),
+                CMD_DAP_TFER_BLOCK => 4 + ((command[4] & 0x02) != 0 ? 4 * (Byte(1) | (Byte(2) << 8)) : 0),
+                _ => MaxResponseLength(command),
+            };
+        }
+
+        /// <summary>Returns the length of the response to command when all its transfers succeed.</summary>
+        /// <exception cref="ArgumentException">Thrown for unknown commands and commands without a response.</exception>
+        public static int MaxResponseLength(byte[] command)
+        {
+            switch (command[0])
+            {
+                case CMD_DAP_INFO: return 2 + 255;
+                case CMD_DAP_TFER: return 3 + 4 * TransferResponseWords(command, command[2]);
+                case CMD_DAP_TFER_BLOCK: return 4 + ((command[4] & 0x02) != 0 ? 4 * (command[2] | (command[3] << 8)) : 0);
+                case CMD_DAP_RESET_TARGET: return 3;
+                case CMD_DAP_JTAG_IDCODE: return 6;
+                case CMD_DAP_JTAG_SEQ:
+                {
+                    int pos = 2, length = 2;
+                    for (int i = 0; i < command[1]; i++)
+                    {
+                        int bytes = (JtagSequenceBits(command[pos]) + 7) / 8;
+                        if ((command[pos] & 0x80) != 0) length += bytes;             // TDO capture
+                        pos += 1 + bytes;
+                    }
+                    return length;
+                }
+                case CMD_DAP_TFER_ABORT:
+                    throw new ArgumentException("DAP_TransferAbort has no response.");
+                default:
+                    RequestLength(command, 0);                                      // Throws on unknown commands
+                    return 2;
+            }
+        }
+
+        /// <summary>Counts the response data words of the first count transfers of a DAP_Transfer command.</summary>
+        private static int TransferResponseWords(byte[] command, int count)
+        {
+            int pos = 3, words = 0;
+            for (int i = 0; i < count && pos < command.Length; i++)
+            {
+                byte req = command[pos];
+                pos += Device.RequiresTransferData(req) ? 5 : 1;
+                if (!Device.RequiresTransferData(req)) words++;                    // Read without value match
+                if ((req & DapReg.TIMESTAMP) != 0) words++;
+            }
+            return words;
+        }
+
+        private static int JtagSequenceBits(byte info) => (info & 0x3F) == 0 ? 64 : info & 0x3F;
     }
 }
@@ -22,6 +22,19 @@ namespace CmsisDap_Communicator
             CMD_KEYS,
             CMD_ADCVAL,
             CMD_LEDS,
+            CMD_COMMIT,
+            CMD_ADCSTREAM,
+            CMD_ADCHISTORY,
+            CMD_ADCDSP,
+            CMD_ADCSTATS,
+            CMD_ADCOUTPUT,
+            CMD_ADCSCANCFG,
+            CMD_ADCSCAN,
+            CMD_ADCEVENTCFG,
+            CMD_ADCEVENT,
+            CMD_KVINFO,
+            CMD_KVCURSOR,
+            CMD_KVDATA,
             CMD_EXIT = 0xFF
         }
 
@@ -169,6 +182,188 @@ namespace CmsisDap_Communicator
 
 
 
+        public enum flashStoreResult_e : byte
+        {
+            OK = 0x00,
+            Unchanged = 0x01,
+            Empty = 0x02,
+            CrcError = 0x03,
+            LengthError = 0x04,
+            FlashError = 0x05
+        }
+
+        // Result of CMD_COMMIT: digests of the records stored in flash.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct CommitInfo_t
+        {
+            public uint KeysCrc;
+            public uint ConfigCrc;
+            public flashStoreResult_e KeysResult;
+            public flashStoreResult_e ConfigResult;
+            public byte ConfigLength;
+            public byte reserved;
+        }
+
+        // One sample of the firmware ADC stream ring buffer.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcSample_t
+        {
+            public uint Timestamp;                                      // Microseconds since the stream started
+            public short Millivolts;
+            public short Counts;                                        // Raw ADC counts, channel 0
+        }
+
+        // Result of CMD_ADCSTREAM: where the ring buffer is and what it holds.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcStreamInfo_t
+        {
+            public uint Address;                                        // Ring buffer (adcStream_t) in target RAM
+            public uint Head;                                           // Samples written since the stream started
+            public uint Rate;                                           // Sample rate (Hz), 0 when stopped
+            public ushort Size;                                         // Ring buffer slots
+            public ushort SampleSize;
+        }
+
+        // Result of CMD_ADCHISTORY, followed by Count samples (oldest first).
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcHistory_t
+        {
+            public uint Head;                                           // Sequence number after the last sample
+            public ushort Count;
+            public ushort reserved;
+        }
+
+        public enum adcFilter_e : byte
+        {
+            None = 0x00,
+            FIR = 0x01,                                                 // Coeffs b[0]..b[n-1] in Q15, b[0] on the newest sample
+            Biquad = 0x02,                                              // { b0, 0, b1, b2, a1, a2 } per stage in Q(15 - PostShift), a1/a2 negated
+        }
+
+        // CMD_ADCDSP: filter, decimation and statistics window of the ADC stream processing.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcDspConfig_t
+        {
+            public const int MAX_COEFFS = 32;
+            public adcFilter_e Filter;
+            public byte Length;                                         // FIR taps (even) or biquad stages
+            public sbyte PostShift;
+            public byte reserved;
+            public ushort Decimation;                                   // Filtered samples per output sample
+            public ushort Window;                                       // Output samples per statistics window
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = MAX_COEFFS)]
+            public short[] Coeffs;
+        }
+
+        // Result of CMD_ADCSTATS: statistics of the last completed window, in millivolts.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcStats_t
+        {
+            public uint Windows;                                        // Windows completed since boot
+            public uint Timestamp;                                      // Stream timestamp of the last sample
+            public ushort Count;
+            public short Min;
+            public short Max;
+            public short Mean;
+            public ushort Rms;
+            public ushort reserved;
+        }
+
+        // CMD_ADCSCANCFG: channels and hardware averaging of a multi-channel scan.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcScanConfig_t
+        {
+            public const int CHANNELS = 8;                              // SARMUX dedicated port pins P10.0 to P10.7
+            public const int MAX_AVERAGING = 8;
+            public const int MIN_SAMPLE_TIME = 2;
+            public const int MAX_SAMPLE_TIME = 1023;
+            public byte Channels;                                       // Bit n scans pin P10.n
+            public byte Averaging;                                      // log2 of the samples averaged per channel, 0 is off
+            public ushort SampleTime;                                   // Aperture in SAR clock cycles
+        }
+
+        // Result of CMD_ADCSCAN: one scan of all configured channels, the others read 0.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcScan_t
+        {
+            public uint Scans;                                          // Scans since boot, this one included
+            public byte Channels;
+            public byte reserved;
+            public ushort Duration;                                     // Microseconds from the start to the end of the scan
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = AdcScanConfig_t.CHANNELS)]
+            public short[] Millivolts;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = AdcScanConfig_t.CHANNELS)]
+            public short[] Counts;
+        }
+
+        public enum adcEventCondition_e : byte
+        {
+            Off = 0x00,
+            Below = 0x01,                                               // Below Low
+            Inside = 0x02,                                              // From Low up to High
+            Above = 0x03,                                               // From High up
+            Outside = 0x04,                                             // Below Low or from High up
+        }
+
+        // CMD_ADCEVENTCFG: threshold event mode on the SAR range detection of channel 0.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcEventConfig_t
+        {
+            public adcEventCondition_e Condition;
+            public byte Pre;                                            // Stream samples before the trigger
+            public byte Post;                                           // Stream samples from the trigger on
+            public byte reserved;
+            public short Low;                                           // Millivolts
+            public short High;
+            public ushort Holdoff;                                      // Stream samples after an event before re-arming
+            public ushort reserved2;
+        }
+
+        // Threshold event as sent in the uplink, which leaves out the samples beyond Count.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcEvent_t
+        {
+            public const int MAX_SAMPLES = 16;
+            public uint Timestamp;                                      // Stream timestamp of the trigger sample
+            public ushort Number;                                       // Events triggered since boot
+            public byte Pre;                                            // Samples before the trigger
+            public byte Count;
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = MAX_SAMPLES)]
+            public short[] Millivolts;
+        }
+
+        // Result of CMD_ADCEVENT: event counters and the last event.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct AdcEventStatus_t
+        {
+            public uint Triggered;                                      // Events since boot
+            public ushort Queued;                                       // Events waiting for uplink
+            public ushort Dropped;                                      // Events lost to a full queue
+            public AdcEvent_t Last;                                     // Count 0 before the first event
+        }
+
+        // Result of CMD_KVINFO: usage of the firmware key-value store.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct KvStoreInfo_t
+        {
+            public byte Keys;                                           // Keys with a value
+            public byte FreeBlocks;
+            public byte Blocks;
+            public byte MaxValue;                                       // Longest value (bytes)
+            public ushort LiveBytes;                                    // Records in use, deleted keys included
+            public ushort Capacity;
+            public uint Sequence;                                       // Segment writes
+            public uint Compactions;                                    // Since boot
+        }
+
+        // Result of CMD_KVDATA, followed by Count entries: key, length, value.
+        [StructLayout(LayoutKind.Sequential, Pack = 1)]
+        public struct KvList_t
+        {
+            public byte Count;
+            public byte Next;                                           // Key to read on from, KvStore.KEYS after the last key
+        }
+
         [StructLayout(LayoutKind.Sequential, Pack = 1)]
         public struct FirmwareInfo_t
         {
@@ -398,6 +593,19 @@ namespace CmsisDap_Communicator
             }
             return data;
         }
+        // CRC-32 (IEEE 802.3), as used by the firmware flash store.
+        public static uint Crc32(byte[] data)
+        {
+            uint crc = 0xFFFFFFFF;
+            foreach (byte b in data)
+            {
+                crc ^= b;
+                for (int bit = 0; bit < 8; bit++)
+                    crc = (crc >> 1) ^ (0xEDB88320 & (uint)-(int)(crc & 1));
+            }
+            return ~crc;
+        }
+
         public static int GetStructSize<T>() where T : struct
         {
             return Marshal.SizeOf<T>();
@@ -0,0 +1,270 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - USB Packet Statistics
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Counts packets and bytes per DAP command ID sent by a CmsisDap.Device
+// - Keeps a latency histogram per command (write of the command until its response is read)
+// - Tracks the time with at least one command outstanding, so a slow operation can be
+//   told apart as USB / probe bound (busy) or target / host bound (idle, e.g. SROM polling)
+// - Counts the recovery steps taken after WAIT and FAULT responses
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Diagnostics;
+using System.Text;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Recovery steps after a failed transfer, cheapest first.</summary>
+    public enum DapRecovery
+    {
+        WaitRetry,              ///< Transfer resent after WAIT.
+        Abort,                  ///< Sticky errors cleared with ABORT and the AP reselected.
+        Handshake,              ///< Connect and handshake repeated.
+        ClockStepDown           ///< SWD clock lowered after repeated transfer errors.
+    }
+
+    /// <summary>Counters of one DAP command ID.</summary>
+    public class DapCommandStats
+    {
+        /// <summary>Upper bounds (µs) of the latency histogram buckets, the last bucket holds everything above.</summary>
+        public static readonly int[] BucketLimitsUs = { 250, 500, 1000, 2000, 4000, 8000, 16000, 32000 };
+
+        public byte CommandId { get; }
+        public string Name => DapStatistics.CommandName(CommandId);
+        public long Packets { get; internal set; }
+        public long BytesOut { get; internal set; }
+        public long BytesIn { get; internal set; }
+        public long Packed { get; internal set; }                               // Runs inside DAP_ExecuteCommands / DAP_QueueCommands packets; for those two, the commands carried.
+        public TimeSpan TotalLatency { get; internal set; }
+        public TimeSpan MaxLatency { get; internal set; }
+        public long[] Histogram { get; } = new long[BucketLimitsUs.Length + 1];
+        public TimeSpan MeanLatency => Packets > 0 ? TotalLatency / Packets : TimeSpan.Zero;
+
+        public DapCommandStats(byte commandId)
+        {
+            CommandId = commandId;
+        }
+
+        internal void Add(int bytesOut, int bytesIn, TimeSpan latency)
+        {
+            Packets++;
+            BytesOut += bytesOut;
+            BytesIn += bytesIn;
+            TotalLatency += latency;
+            if (latency > MaxLatency) MaxLatency = latency;
+            int bucket = Array.FindIndex(BucketLimitsUs, limit => latency.TotalMicroseconds <= limit);
+            Histogram[bucket < 0 ? BucketLimitsUs.Length : bucket]++;
+        }
+
+        internal DapCommandStats Clone()
+        {
+            var copy = new DapCommandStats(CommandId)
+            {
+                Packets = Packets,
+                BytesOut = BytesOut,
+                BytesIn = BytesIn,
+                Packed = Packed,
+                TotalLatency = TotalLatency,
+                MaxLatency = MaxLatency,
+            };
+            Histogram.CopyTo(copy.Histogram, 0);
+            return copy;
+        }
+    }
+
+    /// <summary>Immutable copy of the statistics of a device.</summary>
+    public class DapStatisticsSnapshot
+    {
+        public TimeSpan Elapsed { get; init; }                                  // Time since the statistics were (re)started.
+        public TimeSpan Busy { get; init; }                                     // Time with at least one command outstanding.
+        public IReadOnlyList<DapCommandStats> Commands { get; init; } = Array.Empty<DapCommandStats>();
+        public IReadOnlyList<long> Recoveries { get; init; } = new long[Enum.GetValues<DapRecovery>().Length];   // Recovery steps taken, indexed by DapRecovery.
+        public long Packets => Commands.Sum(c => c.Packets);
+        public long BytesOut => Commands.Sum(c => c.BytesOut);
+        public long BytesIn => Commands.Sum(c => c.BytesIn);
+        public long Executed => Commands.Where(c => !DapStatistics.IsPacking(c.CommandId)).Sum(c => c.Packets + c.Packed);   // Commands run, packed ones included.
+
+        /// <summary>Formats the snapshot as a table for the status window.</summary>
+        public string ToReport()
+        {
+            var sb = new StringBuilder();
+            double busyPercent = Elapsed > TimeSpan.Zero ? 100.0 * Busy.Ticks / Elapsed.Ticks : 0;
+            sb.Append($"\r\nUSB: {Packets} packets ({Executed} commands), {BytesOut} bytes out, {BytesIn} bytes in, busy {Busy.TotalMilliseconds:F0} of {Elapsed.TotalMilliseconds:F0} ms ({busyPercent:F0}%)");
+            sb.Append($"\r\n {"Command",-22} {"Packets",8} {"Packed",8} {"Out",8} {"In",8} {"Mean µs",8} {"Max µs",8}  Latency histogram (≤{string.Join("/", DapCommandStats.BucketLimitsUs.Select(l => l >= 1000 ? $"{l / 1000}m" : l.ToString()))}/>µs)");
+            foreach (var c in Commands.OrderByDescending(c => c.TotalLatency))
+                sb.Append($"\r\n {c.Name,-22} {c.Packets,8} {c.Packed,8} {c.BytesOut,8} {c.BytesIn,8} {c.MeanLatency.TotalMicroseconds,8:F0} {c.MaxLatency.TotalMicroseconds,8:F0}  {string.Join(" ", c.Histogram)}");
+            if (Recoveries.Any(r => r > 0))
+                sb.Append($"\r\nRecovery: {Recoveries[(int)DapRecovery.WaitRetry]} WAIT retries, {Recoveries[(int)DapRecovery.Abort]} ABORT, {Recoveries[(int)DapRecovery.Handshake]} handshakes, {Recoveries[(int)DapRecovery.ClockStepDown]} clock step downs");
+            return sb.ToString();
+        }
+    }
+
+    /// <summary>Live packet statistics of a CmsisDap.Device, safe to snapshot from another thread.</summary>
+    public class DapStatistics
+    {
+        private readonly object sync = new();
+        private readonly SortedDictionary<byte, DapCommandStats> commands = new();
+        private long startTicks = Stopwatch.GetTimestamp();
+        private long busyTicks;
+        private long busySinceTicks;
+        private int outstanding;
+        private readonly long[] recoveries = new long[Enum.GetValues<DapRecovery>().Length];
+
+        /// <summary>Registers a command written to the probe.</summary>
+        /// <returns>Timestamp to pass to <see cref="Received"/>.</returns>
+        internal long Sent()
+        {
+            long now = Stopwatch.GetTimestamp();
+            lock (sync)
+            {
+                if (outstanding++ == 0) busySinceTicks = now;
+            }
+            return now;
+        }
+
+        /// <summary>Registers the response of a command.</summary>
+        /// <param name="command">Command as sent, the commands packed in it are counted by their own ID.</param>
+        /// <param name="bytesIn">Response length.</param>
+        /// <param name="sentTicks">Timestamp returned by <see cref="Sent"/>.</param>
+        internal void Received(byte[] command, int bytesIn, long sentTicks)
+        {
+            long now = Stopwatch.GetTimestamp();
+            lock (sync)
+            {
+                var stats = Get(command[0]);
+                stats.Add(command.Length, bytesIn, Stopwatch.GetElapsedTime(sentTicks, now));
+                if (IsPacking(command[0]))
+                {
+                    foreach (byte inner in PackedCommands(command))
+                    {
+                        Get(inner).Packed++;
+                        stats.Packed++;
+                    }
+                }
+                if (outstanding > 0 && --outstanding == 0)
+                    busyTicks += now - Math.Max(busySinceTicks, startTicks);
+            }
+        }
+
+        private DapCommandStats Get(byte commandId)
+        {
+            if (!commands.TryGetValue(commandId, out var stats))
+                commands[commandId] = stats = new DapCommandStats(commandId);
+            return stats;
+        }
+
+        /// <summary>True for the commands that carry other commands.</summary>
+        public static bool IsPacking(byte commandId) =>
+            commandId == CmsisDap.CMD_DAP_EXECUTE_COMMANDS || commandId == CmsisDap.CMD_DAP_QUEUE_COMMANDS;
+
+        /// <summary>Returns the IDs of the commands packed in a DAP_ExecuteCommands / DAP_QueueCommands request.</summary>
+        /// <remarks>Stops at the first command it cannot size, a malformed packet is counted up to there.</remarks>
+        private static IEnumerable<byte> PackedCommands(byte[] command)
+        {
+            var ids = new List<byte>();
+            for (int i = 0, pos = 2; i < command.ElementAtOrDefault(1) && pos < command.Length; i++)
+            {
+                ids.Add(command[pos]);
+                try
+                {
+                    pos += CmsisDap.RequestLength(command, pos);
+                }
+                catch (ArgumentException)
+                {
+                    break;
+                }
+            }
+            return ids;
+        }
+
+        /// <summary>Drops commands whose responses will never be read (transport failure).</summary>
+        internal void Discard(int count)
+        {
+            long now = Stopwatch.GetTimestamp();
+            lock (sync)
+            {
+                if (outstanding > 0 && (outstanding = Math.Max(0, outstanding - count)) == 0)
+                    busyTicks += now - Math.Max(busySinceTicks, startTicks);
+            }
+        }
+
+        /// <summary>Registers a recovery step taken after a failed transfer.</summary>
+        internal void Recovered(DapRecovery step)
+        {
+            lock (sync)
+            {
+                recoveries[(int)step]++;
+            }
+        }
+
+        /// <summary>Returns a copy of the current counters.</summary>
+        public DapStatisticsSnapshot Snapshot()
+        {
+            long now = Stopwatch.GetTimestamp();
+            lock (sync)
+            {
+                long busy = busyTicks + (outstanding > 0 ? now - Math.Max(busySinceTicks, startTicks) : 0);
+                return new DapStatisticsSnapshot
+                {
+                    Elapsed = Stopwatch.GetElapsedTime(startTicks, now),
+                    Busy = TimeSpan.FromSeconds((double)busy / Stopwatch.Frequency),
+                    Commands = commands.Values.Select(c => c.Clone()).ToList(),
+                    Recoveries = (long[])recoveries.Clone(),
+                };
+            }
+        }
+
+        /// <summary>Clears all counters and restarts the elapsed time.</summary>
+        public void Reset()
+        {
+            lock (sync)
+            {
+                commands.Clear();
+                Array.Clear(recoveries);
+                busyTicks = 0;
+                startTicks = Stopwatch.GetTimestamp();
+            }
+        }
+
+        /// <summary>Returns the CMSIS-DAP name of a command ID.</summary>
+        public static string CommandName(byte commandId) => commandId switch
+        {
+            CmsisDap.CMD_DAP_INFO => "DAP_Info",
+            CmsisDap.CMD_DAP_LED => "DAP_HostStatus",
+            CmsisDap.CMD_DAP_CONNECT => "DAP_Connect",
+            CmsisDap.CMD_DAP_DISCONNECT => "DAP_Disconnect",
+            CmsisDap.CMD_DAP_TFER_CONFIGURE => "DAP_TransferConfigure",
+            CmsisDap.CMD_DAP_TFER => "DAP_Transfer",
+            CmsisDap.CMD_DAP_TFER_BLOCK => "DAP_TransferBlock",
+            CmsisDap.CMD_DAP_TFER_ABORT => "DAP_TransferAbort",
+            CmsisDap.CMD_DAP_WRITE_ABORT => "DAP_WriteABORT",
+            CmsisDap.CMD_DAP_DELAY => "DAP_Delay",
+            CmsisDap.CMD_DAP_RESET_TARGET => "DAP_ResetTarget",
+            CmsisDap.CMD_DAP_SWJ_PINS => "DAP_SWJ_Pins",
+            CmsisDap.CMD_DAP_SWJ_CLOCK => "DAP_SWJ_Clock",
+            CmsisDap.CMD_DAP_SWJ_SEQ => "DAP_SWJ_Sequence",
+            CmsisDap.CMD_DAP_SWD_CONFIGURE => "DAP_SWD_Configure",
+            CmsisDap.CMD_DAP_JTAG_SEQ => "DAP_JTAG_Sequence",
+            CmsisDap.CMD_DAP_JTAG_CONFIGURE => "DAP_JTAG_Configure",
+            CmsisDap.CMD_DAP_JTAG_IDCODE => "DAP_JTAG_IDCODE",
+            CmsisDap.CMD_DAP_QUEUE_COMMANDS => "DAP_QueueCommands",
+            CmsisDap.CMD_DAP_EXECUTE_COMMANDS => "DAP_ExecuteCommands",
+            _ => $"0x{commandId:X2}"
+        };
+    }
+}
@@ -0,0 +1,88 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Probe Transport
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Packet transport underneath CmsisDap.Device
+// - HidTransport talks to a USB HID CMSIS-DAP probe, SimulatedProbe runs in-process
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using HidSharp;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Moves CMSIS-DAP command and response packets between the host and a probe.</summary>
+    public interface IDapTransport : IDisposable
+    {
+        /// <summary>True while the probe can accept commands.</summary>
+        bool IsConnected { get; }
+
+        /// <summary>Sends one command packet (without HID report ID).</summary>
+        /// <param name="payload">Command bytes.</param>
+        void Write(byte[] payload);
+
+        /// <summary>Receives the response of the oldest outstanding command (without HID report ID).</summary>
+        byte[] Read();
+    }
+
+    /// <summary>Transport for CMSIS-DAP v1 probes on a USB HID interface.</summary>
+    public class HidTransport : IDapTransport
+    {
+        private const int REPORT_SIZE = 64;                                     // HID report payload size.
+
+        private readonly HidStream _stream;
+        private readonly byte[] _txBuffer = new byte[REPORT_SIZE + 1];
+        private readonly byte[] _rxBuffer = new byte[REPORT_SIZE + 1];
+
+        public bool IsConnected => _stream != null && _stream.CanWrite;
+
+        /// <summary>Opens the HID stream of a probe.</summary>
+        /// <param name="device">The HID device representing a CMSIS-DAP programmer.</param>
+        /// <exception cref="IOException">Thrown if the device stream could not be opened.</exception>
+        public HidTransport(HidDevice device)
+        {
+            if (!device.TryOpen(out _stream))
+            {
+                throw new IOException("Failed to open device stream.");
+            }
+        }
+
+        public void Write(byte[] payload)
+        {
+            _txBuffer[0] = 0x00; // HID Report ID
+            int len = Math.Min(payload.Length, REPORT_SIZE);
+            Buffer.BlockCopy(payload, 0, _txBuffer, 1, len);
+            _stream.Write(_txBuffer, 0, _txBuffer.Length);
+        }
+
+        public byte[] Read()
+        {
+            int read = _stream.Read(_rxBuffer, 0, _rxBuffer.Length);
+            if (read < 2)
+                throw new IOException("Invalid response");
+
+            byte[] result = new byte[read - 1];
+            Buffer.BlockCopy(_rxBuffer, 1, result, 0, read - 1);
+            return result;
+        }
+
+        public void Dispose()
+        {
+            _stream?.Dispose();
+        }
+    }
+}
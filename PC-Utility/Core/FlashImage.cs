@@ -0,0 +1,365 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Sparse Flash Image Model
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// References:
+// - Intel Hexadecimal Object File Format Specification Rev. A
+// - ELF: Tool Interface Standard (TIS) Portable Formats Specification 1.2
+// - Infineon AN213924 PSoC 6 MCU Bootloader Software Development Kit (.cyacd2)
+//
+// Description:
+// - Holds a firmware image as an ordered list of address/data segments
+// - Memory-maps the input file, ELF segments are read straight from the view
+// - Loads Intel HEX, ELF and .cyacd2 files as produced by cymcuelftool
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Globalization;
+using System.IO.MemoryMappedFiles;
+using System.Text;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>A contiguous block of image data at a target address.</summary>
+    public sealed class FlashSegment
+    {
+        private readonly MemoryMappedViewAccessor? _view;  // Backing view for file-mapped data (ELF).
+        private readonly long _viewOffset;                  // Offset of the data in the view.
+        private readonly byte[]? _data;                     // Backing array for decoded data (HEX, cyacd2).
+
+        public uint Address { get; }                        // Target start address.
+        public int Length { get; }                          // Length in bytes.
+        public uint EndAddress => Address + (uint)Length;   // First address after the segment.
+        public string Name { get; }                         // Origin of the segment, for reporting.
+
+        internal FlashSegment(string name, uint address, byte[] data)
+        {
+            Name = name;
+            Address = address;
+            Length = data.Length;
+            _data = data;
+        }
+
+        internal FlashSegment(string name, uint address, MemoryMappedViewAccessor view, long viewOffset, int length)
+        {
+            Name = name;
+            Address = address;
+            Length = length;
+            _view = view;
+            _viewOffset = viewOffset;
+        }
+
+        /// <summary>Copies segment data into a buffer.</summary>
+        /// <param name="offset">Offset within the segment.</param>
+        /// <param name="buffer">Destination buffer.</param>
+        /// <param name="bufferOffset">Offset in the destination buffer.</param>
+        /// <param name="count">Number of bytes to copy.</param>
+        public void Read(int offset, byte[] buffer, int bufferOffset, int count)
+        {
+            if (offset < 0 || count < 0 || offset + count > Length)
+                throw new ArgumentOutOfRangeException(nameof(offset), $"Read outside segment {Name}.");
+            if (_data != null)
+                Buffer.BlockCopy(_data, offset, buffer, bufferOffset, count);
+            else
+                _view!.ReadArray(_viewOffset + offset, buffer, bufferOffset, count);
+        }
+
+        /// <summary>Returns a copy of the segment data.</summary>
+        public byte[] ToArray()
+        {
+            byte[] result = new byte[Length];
+            Read(0, result, 0, Length);
+            return result;
+        }
+
+        public override string ToString() => $"{Name}: 0x{Address:X8} - 0x{EndAddress:X8} ({Length} bytes)";
+    }
+
+    /// <summary>Sparse firmware image: ordered, non-overlapping segments loaded from HEX, ELF or cyacd2.</summary>
+    /// <remarks>The image is read-only after loading and may be shared between threads.</remarks>
+    public sealed class FlashImage : IDisposable
+    {
+        private readonly MemoryMappedFile? _file;
+        private readonly MemoryMappedViewAccessor? _view;
+        private readonly List<FlashSegment> _segments;
+
+        public string FileName { get; }
+        public IReadOnlyList<FlashSegment> Segments => _segments;
+        public long TotalBytes => _segments.Sum(s => (long)s.Length);
+
+        private FlashImage(string fileName, List<FlashSegment> segments, MemoryMappedFile? file = null, MemoryMappedViewAccessor? view = null)
+        {
+            FileName = fileName;
+            _file = file;
+            _view = view;
+            _segments = segments.OrderBy(s => s.Address).ToList();
+            for (int i = 1; i < _segments.Count; i++)
+            {
+                if (_segments[i].Address < _segments[i - 1].EndAddress)
+                    throw new InvalidDataException($"Overlapping image segments at 0x{_segments[i].Address:X8}.");
+            }
+        }
+
+        /// <summary>Builds an image from a single contiguous buffer.</summary>
+        /// <param name="data">Image data.</param>
+        /// <param name="address">Target start address.</param>
+        public static FlashImage FromBytes(byte[] data, uint address) =>
+            new FlashImage("<memory>", new List<FlashSegment> { new FlashSegment("data", address, data) });
+
+        /// <summary>Loads an image, selecting the loader from the file extension.</summary>
+        /// <param name="path">Path to a .hex, .elf or .cyacd2 file.</param>
+        public static FlashImage Load(string path)
+        {
+            switch (Path.GetExtension(path).ToLowerInvariant())
+            {
+                case ".hex":
+                case ".ihex":
+                    return LoadHex(path);
+                case ".elf":
+                case ".axf":
+                    return LoadElf(path);
+                case ".cyacd2":
+                    return LoadCyacd2(path);
+                default:
+                    throw new NotSupportedException($"Unsupported image format: {Path.GetFileName(path)}");
+            }
+        }
+
+        /// <summary>Loads an Intel HEX file (record types 00, 01, 02, 03, 04 and 05).</summary>
+        public static FlashImage LoadHex(string path)
+        {
+            var builder = new SegmentBuilder();
+            uint upperAddress = 0;
+            int lineNumber = 0;
+
+            foreach (string line in MappedLines(path))
+            {
+                lineNumber++;
+                if (line.Length == 0) continue;
+                if (line[0] != ':')
+                    throw new InvalidDataException($"HEX line {lineNumber}: missing start code.");
+
+                byte[] record = ParseHex(line, 1, line.Length - 1, lineNumber);
+                if (record.Length < 5 || record.Length != record[0] + 5)
+                    throw new InvalidDataException($"HEX line {lineNumber}: invalid record length.");
+                byte sum = 0;
+                foreach (byte b in record) sum += b;
+                if (sum != 0)
+                    throw new InvalidDataException($"HEX line {lineNumber}: checksum error.");
+
+                int count = record[0];
+                uint offset = (uint)(record[1] << 8 | record[2]);
+                switch (record[3])
+                {
+                    case 0x00:                                                          // Data
+                        builder.Add(upperAddress + offset, record, 4, count);
+                        break;
+                    case 0x01:                                                          // End of file
+                        return new FlashImage(path, builder.Build("hex"));
+                    case 0x02:                                                          // Extended segment address
+                        upperAddress = (uint)(record[4] << 8 | record[5]) << 4;
+                        break;
+                    case 0x04:                                                          // Extended linear address
+                        upperAddress = (uint)(record[4] << 8 | record[5]) << 16;
+                        break;
+                    case 0x03:                                                          // Start segment address
+                    case 0x05:                                                          // Start linear address
+                        break;
+                    default:
+                        throw new InvalidDataException($"HEX line {lineNumber}: unknown record type 0x{record[3]:X2}.");
+                }
+            }
+            throw new InvalidDataException("HEX file has no end-of-file record.");
+        }
+
+        /// <summary>Loads the PT_LOAD program headers of a 32-bit little-endian ELF file at their load (physical) address.</summary>
+        /// <remarks>Segment data is not copied, it is read from the memory-mapped file when programming.</remarks>
+        public static FlashImage LoadElf(string path)
+        {
+            const uint PT_LOAD = 1;
+            var file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read);
+            var view = file.CreateViewAccessor(0, 0, MemoryMappedFileAccess.Read);
+            try
+            {
+                long fileLength = new FileInfo(path).Length;
+                if (fileLength < 52 || view.ReadUInt32(0) != 0x464C457F)               // 0x7F 'E' 'L' 'F'
+                    throw new InvalidDataException("Not an ELF file.");
+                if (view.ReadByte(4) != 1 || view.ReadByte(5) != 1)
+                    throw new InvalidDataException("Only 32-bit little-endian ELF files are supported.");
+
+                uint phOffset = view.ReadUInt32(0x1C);
+                ushort phEntrySize = view.ReadUInt16(0x2A);
+                ushort phCount = view.ReadUInt16(0x2C);
+
+                var segments = new List<FlashSegment>();
+                for (int i = 0; i < phCount; i++)
+                {
+                    long ph = phOffset + (long)i * phEntrySize;
+                    if (ph + 32 > fileLength)
+                        throw new InvalidDataException("ELF program header outside file.");
+                    uint type = view.ReadUInt32(ph + 0);
+                    uint offset = view.ReadUInt32(ph + 4);
+                    uint physAddr = view.ReadUInt32(ph + 12);
+                    uint fileSize = view.ReadUInt32(ph + 16);
+                    if (type != PT_LOAD || fileSize == 0) continue;
+                    if (offset + (long)fileSize > fileLength)
+                        throw new InvalidDataException($"ELF segment {i} data outside file.");
+                    segments.Add(new FlashSegment($"elf[{i}]", physAddr, view, offset, (int)fileSize));
+                }
+                return new FlashImage(path, segments, file, view);
+            }
+            catch
+            {
+                view.Dispose();
+                file.Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>Loads a .cyacd2 bootloader file: a header line, optional @ directives and ':'-rows of a
+        /// little-endian 32-bit address followed by data.</summary>
+        public static FlashImage LoadCyacd2(string path)
+        {
+            var builder = new SegmentBuilder();
+            int lineNumber = 0;
+
+            foreach (string line in MappedLines(path))
+            {
+                lineNumber++;
+                if (line.Length == 0 || line[0] == '@') continue;                       // @APPINFO / @EIV directives
+                if (lineNumber == 1) continue;                                          // File header (version, silicon ID, app ID...)
+                if (line[0] != ':')
+                    throw new InvalidDataException($"cyacd2 line {lineNumber}: missing row marker.");
+
+                byte[] row = ParseHex(line, 1, line.Length - 1, lineNumber);
+                if (row.Length < 4)
+                    throw new InvalidDataException($"cyacd2 line {lineNumber}: row too short.");
+                builder.Add(BitConverter.ToUInt32(row, 0), row, 4, row.Length - 4);
+            }
+            return new FlashImage(path, builder.Build("cyacd2"));
+        }
+
+        /// <summary>Returns the row runs (start, end) touched by the image within a memory region.</summary>
+        /// <param name="rowSize">Row size in bytes (power of two).</param>
+        /// <param name="regionBase">Base address of the region.</param>
+        /// <param name="regionSize">Size of the region in bytes.</param>
+        /// <returns>Row aligned, ascending and non-adjacent address ranges.</returns>
+        public List<(uint Start, uint End)> RowRuns(uint rowSize, uint regionBase, uint regionSize)
+        {
+            var runs = new List<(uint Start, uint End)>();
+            ulong regionEnd = (ulong)regionBase + regionSize;
+            foreach (var segment in _segments)
+            {
+                if (segment.EndAddress <= regionBase || segment.Address >= regionEnd) continue;
+                if (segment.Address < regionBase || segment.EndAddress > regionEnd)
+                    throw new InvalidDataException($"Segment {segment} crosses the region boundary at 0x{regionBase:X8}.");
+
+                uint start = segment.Address & ~(rowSize - 1);
+                uint end = (segment.EndAddress + rowSize - 1) & ~(rowSize - 1);
+                if (runs.Count > 0 && start <= runs[^1].End)
+                    runs[^1] = (runs[^1].Start, Math.Max(end, runs[^1].End));
+                else
+                    runs.Add((start, end));
+            }
+            return runs;
+        }
+
+        /// <summary>Copies all image data that falls inside a row into the row buffer; bytes not covered are left unchanged.</summary>
+        /// <param name="rowAddress">Address of the row.</param>
+        /// <param name="row">Row buffer.</param>
+        /// <returns>Number of bytes of the row covered by the image.</returns>
+        public int OverlayRow(uint rowAddress, byte[] row)
+        {
+            int covered = 0;
+            ulong rowEnd = (ulong)rowAddress + (uint)row.Length;
+            foreach (var segment in _segments)
+            {
+                if (segment.EndAddress <= rowAddress) continue;
+                if (segment.Address >= rowEnd) break;
+                uint start = Math.Max(segment.Address, rowAddress);
+                uint end = (uint)Math.Min(segment.EndAddress, rowEnd);
+                segment.Read((int)(start - segment.Address), row, (int)(start - rowAddress), (int)(end - start));
+                covered += (int)(end - start);
+            }
+            return covered;
+        }
+
+        public void Dispose()
+        {
+            _view?.Dispose();
+            _file?.Dispose();
+        }
+
+        /// <summary>Enumerates the text lines of a memory-mapped file.</summary>
+        private static IEnumerable<string> MappedLines(string path)
+        {
+            if (new FileInfo(path).Length == 0) yield break;
+            using var file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read);
+            using var stream = file.CreateViewStream(0, 0, MemoryMappedFileAccess.Read);
+            using var reader = new StreamReader(stream, Encoding.ASCII);
+            string? line;
+            while ((line = reader.ReadLine()) != null)
+            {
+                // The view is rounded up to a page, the tail is zero filled
+                line = line.Trim().TrimEnd('\0');
+                yield return line;
+            }
+        }
+
+        private static byte[] ParseHex(string text, int start, int length, int lineNumber)
+        {
+            if ((length & 1) != 0)
+                throw new InvalidDataException($"Line {lineNumber}: odd number of hex digits.");
+            byte[] result = new byte[length / 2];
+            for (int i = 0; i < result.Length; i++)
+            {
+                if (!byte.TryParse(text.AsSpan(start + i * 2, 2), NumberStyles.HexNumber, CultureInfo.InvariantCulture, out result[i]))
+                    throw new InvalidDataException($"Line {lineNumber}: invalid hex digits.");
+            }
+            return result;
+        }
+
+        /// <summary>Collects data records and merges address-contiguous records into segments.</summary>
+        private sealed class SegmentBuilder
+        {
+            private readonly List<(uint Address, List<byte> Data)> _blocks = new();
+
+            public void Add(uint address, byte[] source, int offset, int count)
+            {
+                if (count == 0) return;
+                var last = _blocks.Count > 0 ? _blocks[^1] : default;
+                if (last.Data != null && last.Address + (uint)last.Data.Count == address)
+                    last.Data.AddRange(new ArraySegment<byte>(source, offset, count));
+                else
+                    _blocks.Add((address, new List<byte>(new ArraySegment<byte>(source, offset, count))));
+            }
+
+            public List<FlashSegment> Build(string name)
+            {
+                // Records are usually ordered, merge any out-of-order neighbours after sorting
+                var merged = new List<(uint Address, List<byte> Data)>();
+                foreach (var block in _blocks.OrderBy(b => b.Address))
+                {
+                    if (merged.Count > 0 && merged[^1].Address + (uint)merged[^1].Data.Count == block.Address)
+                        merged[^1].Data.AddRange(block.Data);
+                    else
+                        merged.Add(block);
+                }
+                return merged.Select((b, i) => new FlashSegment($"{name}[{i}]", b.Address, b.Data.ToArray())).ToList();
+            }
+        }
+    }
+}
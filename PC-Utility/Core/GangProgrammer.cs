@@ -0,0 +1,172 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Gang Programming
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Runs a job on every connected CMSIS-DAP probe in parallel, one worker per probe
+// - Retries failed units without blocking the other workers
+// - Reports state and progress per unit through events
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>State of a unit in a gang run.</summary>
+    public enum GangState
+    {
+        Pending,                ///< Waiting for its worker to start.
+        Running,                ///< Job in progress.
+        Retrying,               ///< Last attempt failed, another attempt follows.
+        Passed,                 ///< Job completed successfully.
+        Failed                  ///< All attempts failed.
+    }
+
+    /// <summary>One probe and the board connected to it in a gang run.</summary>
+    public class GangUnit
+    {
+        public int Slot { get; }                                                // Position in the gang (0-based).
+        public CmsisDap.DeviceInfo Probe { get; }                               // Probe driving this unit.
+        public GangState State { get; internal set; } = GangState.Pending;
+        public int Attempts { get; internal set; }                              // Attempts made so far.
+        public int Percent { get; internal set; }                               // Progress of the current attempt (0..100).
+        public string? Step { get; internal set; }                              // Current step, set by the job.
+        public string? Error { get; internal set; }                             // Last error message.
+        public TimeSpan Elapsed { get; internal set; }                          // Duration of the run on this unit.
+
+        internal GangUnit(int slot, CmsisDap.DeviceInfo probe)
+        {
+            Slot = slot;
+            Probe = probe;
+        }
+
+        public override string ToString() =>
+            $"[{Slot}] {State,-8} {Percent,3}% {Step} {(Error != null ? "- " + Error : "")}";
+    }
+
+    /// <summary>Thrown by a gang job to fail a unit without retrying it.</summary>
+    public class GangFatalException : Exception
+    {
+        public GangFatalException(string message) : base(message) { }
+    }
+
+    /// <summary>Runs a job on many probes in parallel, with a dedicated worker per probe.</summary>
+    public class GangProgrammer
+    {
+        private readonly CmsisDap dap = new CmsisDap();
+
+        public PSoC6Family Family { get; set; } = PSoC6Family.PSOC6ABLE2;       // Target family of all units.
+        public SWJ_Interface Interface { get; set; } = SWJ_Interface.SWD;       // Debug interface.
+        public uint SwjClockSpeed { get; set; } = 4000000;                      // SWD clock speed (Hz) of probes without a clock profile.
+        public ProbeProfileStore? Profiles { get; set; }                        // Per probe SWD clock (adaptive) and APs, null for SwjClockSpeed on all.
+        public int MaxAttempts { get; set; } = 3;                               // Attempts per unit before it is failed.
+        public TimeSpan RetryDelay { get; set; } = TimeSpan.FromMilliseconds(500);
+
+        /// <summary>Raised when a unit changes state or step.</summary>
+        public event Action<GangUnit>? UnitChanged;
+        /// <summary>Raised when the progress percentage of a unit changes.</summary>
+        public event Action<GangUnit>? UnitProgress;
+
+        /// <summary>Runs a job on every probe in parallel.</summary>
+        /// <param name="probes">Probes to use, one unit per probe.</param>
+        /// <param name="job">Job to run per unit. It gets a programmer bound to the probe of the unit and throws on failure.</param>
+        /// <param name="cancel">Stops starting new attempts when cancelled.</param>
+        /// <returns>The units with their final state.</returns>
+        public async Task<IReadOnlyList<GangUnit>> RunAsync(IEnumerable<CmsisDap.DeviceInfo> probes, Action<Psoc6Programmer, GangUnit> job, CancellationToken cancel = default)
+        {
+            var units = probes.Select((probe, slot) => new GangUnit(slot, probe)).ToList();
+
+            // USB transfers block, give each probe its own thread instead of a pool thread
+            var workers = units.Select(unit => Task.Factory.StartNew(() => RunUnit(unit, job, cancel),
+                cancel, TaskCreationOptions.LongRunning, TaskScheduler.Default));
+            await Task.WhenAll(workers);
+            return units;
+        }
+
+        /// <summary>Programs and verifies an image on every probe in parallel.</summary>
+        /// <param name="probes">Probes to use, one unit per probe.</param>
+        /// <param name="image">Image to program, shared read-only between the workers.</param>
+        /// <param name="cancel">Stops starting new attempts when cancelled.</param>
+        public Task<IReadOnlyList<GangUnit>> ProgramAsync(IEnumerable<CmsisDap.DeviceInfo> probes, FlashImage image, CancellationToken cancel = default)
+        {
+            return RunAsync(probes, (programmer, unit) =>
+            {
+                SetStep(unit, "Acquire");
+                programmer.Acquire(AcquireMode.ACQ_RESET, false, AP_e.AP_CM4);
+                SetStep(unit, "Program");
+                programmer.ProgramImage(image);
+                SetStep(unit, "Verify");
+                programmer.VerifyImage(image);
+                SetStep(unit, "Reset");
+                programmer.ToggleXRES();
+            }, cancel);
+        }
+
+        /// <summary>Sets the current step of a unit and reports it.</summary>
+        public void SetStep(GangUnit unit, string step)
+        {
+            unit.Step = step;
+            unit.Percent = 0;
+            UnitChanged?.Invoke(unit);
+        }
+
+        private void RunUnit(GangUnit unit, Action<Psoc6Programmer, GangUnit> job, CancellationToken cancel)
+        {
+            DateTime start = DateTime.Now;
+            while (unit.State != GangState.Passed && unit.State != GangState.Failed)
+            {
+                unit.Attempts++;
+                unit.State = GangState.Running;
+                unit.Percent = 0;
+                UnitChanged?.Invoke(unit);
+                try
+                {
+                    cancel.ThrowIfCancellationRequested();
+                    // Reopen the probe on every attempt, a failed attempt may leave the HID stream unusable
+                    using var device = dap.Open(unit.Probe);
+                    var programmer = new Psoc6Programmer(device, Family, Interface, Profiles?.ClockFor(device.SerialNumber, Family, SwjClockSpeed) ?? SwjClockSpeed)
+                    {
+                        Progress = (value, max) => ReportProgress(unit, value, max),
+                        AdaptiveClock = Profiles != null,
+                        Profiles = Profiles,
+                    };
+                    programmer.ClockChanged += clock => Profiles?.UpdateClock(device.SerialNumber, Family, clock);
+                    job(programmer, unit);
+                    unit.State = GangState.Passed;
+                    unit.Error = null;
+                }
+                catch (Exception ex)
+                {
+                    unit.Error = ex.Message;
+                    bool retry = ex is not GangFatalException && !cancel.IsCancellationRequested && unit.Attempts < MaxAttempts;
+                    unit.State = retry ? GangState.Retrying : GangState.Failed;
+                    UnitChanged?.Invoke(unit);
+                    if (retry) Thread.Sleep(RetryDelay);
+                }
+            }
+            unit.Elapsed = DateTime.Now - start;
+            UnitChanged?.Invoke(unit);
+        }
+
+        private void ReportProgress(GangUnit unit, uint value, uint max)
+        {
+            if (max == 0) return;
+            int percent = (int)Math.Min(100, (ulong)value * 100 / max);
+            if (percent == unit.Percent) return;
+            unit.Percent = percent;
+            UnitProgress?.Invoke(unit);
+        }
+    }
+}
@@ -0,0 +1,303 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Bulk LoRaWAN Key Provisioning
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Streams a CSV manifest of DevEUI / AppEUI / AppKey rows into a DevEUI index
+// - Binds each board to its manifest row by the DevEUI reported in coreInfo_t
+// - Writes, reads back and commits the keys to flash on all attached probes in parallel
+// - Records every result in an append-only journal, a restarted run skips
+//   boards that were already provisioned
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Globalization;
+using System.Text;
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>One row of the key manifest.</summary>
+    public class KeyManifestRow
+    {
+        public int LineNumber { get; init; }                                    // Line in the CSV file (1-based).
+        public byte[] DevEui { get; init; } = new byte[8];
+        public byte[] AppEui { get; init; } = new byte[8];
+        public byte[] AppKey { get; init; } = new byte[16];
+    }
+
+    /// <summary>Key manifest indexed by DevEUI.</summary>
+    /// <remarks>
+    /// The CSV needs a header with the columns DevEUI, AppEUI and AppKey (any order, extra columns are ignored),
+    /// separated by ',' or ';'. Values are hex with optional '-', ':' or space separators.
+    /// </remarks>
+    public class KeyManifest
+    {
+        private readonly Dictionary<string, KeyManifestRow> rows = new();
+
+        public int Count => rows.Count;
+
+        /// <summary>Reads a manifest line by line, only the parsed keys are kept in memory.</summary>
+        /// <param name="path">Path of the CSV file.</param>
+        public static KeyManifest Load(string path)
+        {
+            var manifest = new KeyManifest();
+            using var reader = new StreamReader(path, Encoding.UTF8, true, 1 << 16);
+
+            string? line = reader.ReadLine();
+            if (line == null)
+                throw new InvalidDataException("Key manifest is empty.");
+            char separator = line.Contains(';') ? ';' : ',';
+            var columns = line.Split(separator).Select(c => c.Trim().Trim('"').ToUpperInvariant()).ToList();
+            int devEuiCol = RequireColumn(columns, "DEVEUI");
+            int appEuiCol = RequireColumn(columns, "APPEUI");
+            int appKeyCol = RequireColumn(columns, "APPKEY");
+
+            int lineNumber = 1;
+            while ((line = reader.ReadLine()) != null)
+            {
+                lineNumber++;
+                if (string.IsNullOrWhiteSpace(line)) continue;
+                var fields = line.Split(separator);
+                if (fields.Length < columns.Count)
+                    throw new InvalidDataException($"Key manifest line {lineNumber}: expected {columns.Count} fields.");
+
+                var row = new KeyManifestRow
+                {
+                    LineNumber = lineNumber,
+                    DevEui = ParseHexField(fields[devEuiCol], 8, lineNumber),
+                    AppEui = ParseHexField(fields[appEuiCol], 8, lineNumber),
+                    AppKey = ParseHexField(fields[appKeyCol], 16, lineNumber),
+                };
+                string key = Convert.ToHexString(row.DevEui);
+                if (!manifest.rows.TryAdd(key, row))
+                    throw new InvalidDataException($"Key manifest line {lineNumber}: duplicate DevEUI {key} (first on line {manifest.rows[key].LineNumber}).");
+            }
+            return manifest;
+        }
+
+        /// <summary>Finds the manifest row of a DevEUI.</summary>
+        public bool TryGet(byte[] devEui, out KeyManifestRow row) =>
+            rows.TryGetValue(Convert.ToHexString(devEui), out row!);
+
+        private static int RequireColumn(List<string> columns, string name)
+        {
+            int index = columns.IndexOf(name);
+            if (index < 0)
+                throw new InvalidDataException($"Key manifest has no {name} column.");
+            return index;
+        }
+
+        private static byte[] ParseHexField(string field, int length, int lineNumber)
+        {
+            string hex = new string(field.Trim().Trim('"').Replace("0x", "").Where(c => c != '-' && c != ':' && c != ' ').ToArray());
+            if (hex.Length != length * 2 || !hex.All(Uri.IsHexDigit))
+                throw new InvalidDataException($"Key manifest line {lineNumber}: '{field}' is not a {length} byte hex value.");
+            return Convert.FromHexString(hex);
+        }
+    }
+
+    /// <summary>Append-only provisioning journal.</summary>
+    /// <remarks>
+    /// One line per event: <c>timestamp;DevEUI;BEGIN|DONE|FAIL;probe;detail</c>. Lines are flushed to disk before
+    /// the next step, so after a crash a DevEUI with a DONE line is never written again, and a BEGIN without DONE
+    /// is simply provisioned again with the same manifest row.
+    /// </remarks>
+    public class ProvisioningJournal : IDisposable
+    {
+        private readonly FileStream stream;
+        private readonly StreamWriter writer;
+        private readonly HashSet<string> done = new();
+        private readonly HashSet<string> claimed = new();
+        private readonly object sync = new();
+
+        public int DoneCount { get { lock (sync) return done.Count; } }
+
+        /// <summary>Opens a journal, replaying the existing entries.</summary>
+        /// <param name="path">Path of the journal file, created when missing.</param>
+        public ProvisioningJournal(string path)
+        {
+            if (File.Exists(path))
+            {
+                foreach (string line in File.ReadLines(path))
+                {
+                    var fields = line.Split(';');
+                    if (fields.Length >= 3 && fields[2] == "DONE")
+                        done.Add(fields[1]);
+                }
+            }
+            stream = new FileStream(path, FileMode.Append, FileAccess.Write, FileShare.Read);
+            writer = new StreamWriter(stream, new UTF8Encoding(false));
+        }
+
+        /// <summary>Claims a DevEUI for this run.</summary>
+        /// <returns>False when the DevEUI is already provisioned or is being provisioned by another probe.</returns>
+        public bool TryClaim(string devEui)
+        {
+            lock (sync)
+                return !done.Contains(devEui) && claimed.Add(devEui);
+        }
+
+        /// <summary>Releases a claim after a failed attempt.</summary>
+        public void Release(string devEui)
+        {
+            lock (sync) claimed.Remove(devEui);
+        }
+
+        public bool IsDone(string devEui)
+        {
+            lock (sync) return done.Contains(devEui);
+        }
+
+        /// <summary>Appends an entry and flushes it to disk.</summary>
+        public void Append(string devEui, string state, string probe, string detail = "")
+        {
+            lock (sync)
+            {
+                string time = DateTime.UtcNow.ToString("yyyy-MM-ddTHH:mm:ss.fffZ", CultureInfo.InvariantCulture);
+                writer.WriteLine($"{time};{devEui};{state};{probe};{detail.Replace(';', ',').ReplaceLineEndings(" ")}");
+                writer.Flush();
+                stream.Flush(true);
+                if (state == "DONE")
+                    done.Add(devEui);
+            }
+        }
+
+        public void Dispose()
+        {
+            writer.Dispose();
+        }
+    }
+
+    /// <summary>Outcome of provisioning one board.</summary>
+    public enum ProvisionOutcome
+    {
+        Pending,                ///< Not finished.
+        Provisioned,            ///< Keys written and verified in this run.
+        AlreadyProvisioned,     ///< Journal shows the board was provisioned before.
+        NotInManifest,          ///< DevEUI of the board is not in the manifest.
+        Failed                  ///< Provisioning failed.
+    }
+
+    /// <summary>Result of provisioning the board on one probe.</summary>
+    public class ProvisionResult
+    {
+        public GangUnit Unit { get; init; } = null!;
+        public string? DevEui { get; internal set; }
+        public ProvisionOutcome Outcome { get; internal set; } = ProvisionOutcome.Pending;
+    }
+
+    /// <summary>Provisions LoRaWAN keys from a manifest on all attached probes in parallel.</summary>
+    public class KeyProvisioner
+    {
+        private readonly KeyManifest manifest;
+        private readonly ProvisioningJournal journal;
+
+        public GangProgrammer Gang { get; } = new GangProgrammer();
+
+        /// <summary>Constructs a provisioner.</summary>
+        /// <param name="manifest">Key manifest.</param>
+        /// <param name="journal">Journal shared by all runs on this manifest.</param>
+        public KeyProvisioner(KeyManifest manifest, ProvisioningJournal journal)
+        {
+            this.manifest = manifest;
+            this.journal = journal;
+        }
+
+        /// <summary>Provisions the board on every probe.</summary>
+        /// <param name="probes">Probes to use.</param>
+        /// <param name="cancel">Stops starting new attempts when cancelled.</param>
+        public async Task<IReadOnlyList<ProvisionResult>> ProvisionAsync(IEnumerable<CmsisDap.DeviceInfo> probes, CancellationToken cancel = default)
+        {
+            var results = new Dictionary<int, ProvisionResult>();
+            var units = await Gang.RunAsync(probes, (programmer, unit) =>
+            {
+                ProvisionResult result;
+                lock (results)
+                {
+                    if (!results.TryGetValue(unit.Slot, out result!))
+                        results[unit.Slot] = result = new ProvisionResult { Unit = unit };
+                }
+                Provision(programmer, unit, result);
+            }, cancel);
+
+            foreach (var unit in units)
+            {
+                if (!results.TryGetValue(unit.Slot, out var result))
+                    results[unit.Slot] = result = new ProvisionResult { Unit = unit };
+                if (unit.State == GangState.Failed && result.Outcome == ProvisionOutcome.Pending)
+                    result.Outcome = ProvisionOutcome.Failed;
+            }
+            return results.Values.OrderBy(r => r.Unit.Slot).ToList();
+        }
+
+        private void Provision(Psoc6Programmer programmer, GangUnit unit, ProvisionResult result)
+        {
+            Gang.SetStep(unit, "Identify");
+            var mailbox = new MailboxClient(programmer).Attach();
+            var coreInfo = mailbox.Read<coreInfo_t>(Command_e.CMD_INFO_STACK);
+            string devEui = Convert.ToHexString(coreInfo.DevEUI);
+            string probe = unit.Probe.Path;
+            result.DevEui = devEui;
+
+            if (!manifest.TryGet(coreInfo.DevEUI, out var row))
+            {
+                result.Outcome = ProvisionOutcome.NotInManifest;
+                throw new GangFatalException($"DevEUI {devEui} is not in the manifest.");
+            }
+            if (!journal.TryClaim(devEui))
+            {
+                if (!journal.IsDone(devEui))
+                    throw new GangFatalException($"DevEUI {devEui} is being provisioned on another probe.");
+                result.Outcome = ProvisionOutcome.AlreadyProvisioned;
+                Gang.SetStep(unit, "Already provisioned");
+                return;
+            }
+
+            try
+            {
+                journal.Append(devEui, "BEGIN", probe, $"manifest line {row.LineNumber}");
+                Gang.SetStep(unit, "Write keys");
+                var keys = new LoRaWAN_keys_t
+                {
+                    KeyType = keyType_e.OTAA_10x_key,
+                    PublicNetwork = true,
+                    keyData = StructToData(new OTAA_10x_t { DevEui = row.DevEui, AppEui = row.AppEui, AppKey = row.AppKey }),
+                    reserved = new byte[32],
+                };
+                mailbox.Write(keys, Command_e.CMD_KEYS);
+
+                Gang.SetStep(unit, "Verify keys");
+                var readBack = mailbox.Read<LoRaWAN_keys_t>(Command_e.CMD_KEYS);
+                if (!readBack.keyData.SequenceEqual(keys.keyData))
+                    throw new InvalidOperationException("Key verification failed.");
+
+                // Persist the keys, a reset would otherwise fall back to the keys of the firmware build
+                Gang.SetStep(unit, "Commit keys");
+                var commit = mailbox.Commit();
+
+                journal.Append(devEui, "DONE", probe, $"keys crc 0x{commit.KeysCrc:X8}");
+                result.Outcome = ProvisionOutcome.Provisioned;
+            }
+            catch (Exception ex)
+            {
+                journal.Append(devEui, "FAIL", probe, ex.Message);
+                journal.Release(devEui);
+                throw;
+            }
+        }
+    }
+}
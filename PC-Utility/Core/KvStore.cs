@@ -0,0 +1,127 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Key-Value Store
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Reads and writes the firmware key-value store through the mailbox,
+//   as many values per command as fit the mailbox
+// - Keys 0 to KEYS - 1, values up to MAX_VALUE bytes; the firmware commits
+//   each write command in one go, all or nothing, and rejects it when the store is full
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Client of the firmware key-value store.</summary>
+    public class KvStore
+    {
+        public const int KEYS = 64;                                             // KVSTORE_KEYS.
+        public const int MAX_VALUE = 64;                                        // KVSTORE_MAX_VALUE.
+        private const byte DELETED = 0xFF;                                      // KVSTORE_DELETED, entry length of a delete.
+        private const int ENTRY_HEADER_SIZE = 2;                                // kvEntry_t: key, length.
+        private const int RECORD_HEADER_SIZE = 4;                               // kvRecord_t: crc, key, length.
+        private const int SEGMENT_DATA = 243;                                   // KVSTORE_SEGMENT_DATA, records of one write command.
+
+        private readonly IMailbox mailbox;
+
+        public KvStore(IMailbox mailbox)
+        {
+            this.mailbox = mailbox;
+        }
+
+        /// <summary>Reads the usage of the store.</summary>
+        public KvStoreInfo_t Info() => mailbox.Read<KvStoreInfo_t>(Command_e.CMD_KVINFO);
+
+        /// <summary>Reads the values of a key range.</summary>
+        /// <returns>Values by key, keys without a value are left out.</returns>
+        public SortedDictionary<byte, byte[]> Read(byte first = 0, byte last = KEYS - 1)
+        {
+            var values = new SortedDictionary<byte, byte[]>();
+            int next = first;
+            while (next <= last && next < KEYS)
+            {
+                mailbox.WriteInt32((uint)next, Command_e.CMD_KVCURSOR);
+                byte[] data = mailbox.ReadData(Command_e.CMD_KVDATA, MailboxClient.MAILBOX_DATA_SIZE);
+                var list = new KvList_t();
+                DataToStruct(data, ref list);
+                int offset = GetStructSize<KvList_t>();
+                for (int i = 0; i < list.Count; i++)
+                {
+                    byte key = data[offset], length = data[offset + 1];
+                    if (key <= last)
+                        values[key] = data[(offset + ENTRY_HEADER_SIZE)..(offset + ENTRY_HEADER_SIZE + length)];
+                    offset += ENTRY_HEADER_SIZE + length;
+                }
+                if (list.Count == 0 && list.Next < KEYS)
+                    throw new InvalidOperationException($"Key-value store read stuck at key {list.Next}.");
+                next = list.Next;
+            }
+            return values;
+        }
+
+        /// <summary>Reads one value, null when the key has none.</summary>
+        public byte[]? Get(byte key) => Read(key, key).TryGetValue(key, out var value) ? value : null;
+
+        /// <summary>Writes values, a null value deletes the key.</summary>
+        /// <remarks>Each mailbox command is committed as a whole; a large set takes several.</remarks>
+        /// <exception cref="ArgumentException">Thrown when a key or value is out of the firmware's range.</exception>
+        /// <exception cref="InvalidOperationException">Thrown when the firmware did not store a command's values.</exception>
+        public void Write(IEnumerable<KeyValuePair<byte, byte[]?>> entries)
+        {
+            var command = new List<byte>();
+            int records = 0;                                                    // Flash bytes of the command.
+            foreach (var (key, value) in entries)
+            {
+                if (key >= KEYS)
+                    throw new ArgumentException($"Key {key} out of range, use 0 to {KEYS - 1}.");
+                if (value != null && value.Length > MAX_VALUE)
+                    throw new ArgumentException($"Value of key {key} too long: {value.Length} bytes, at most {MAX_VALUE}.");
+                int size = ENTRY_HEADER_SIZE + (value?.Length ?? 0);
+                int record = RECORD_HEADER_SIZE + (value?.Length ?? 0);
+                if (command.Count + size > MailboxClient.MAILBOX_DATA_SIZE || records + record > SEGMENT_DATA)
+                {
+                    Send(command);
+                    records = 0;
+                }
+                records += record;
+                command.Add(key);
+                command.Add(value != null ? (byte)value.Length : DELETED);
+                if (value != null) command.AddRange(value);
+            }
+            if (command.Count > 0)
+                Send(command);
+        }
+
+        public void Put(byte key, byte[] value) => Write(new[] { new KeyValuePair<byte, byte[]?>(key, value) });
+
+        public void Delete(byte key) => Write(new[] { new KeyValuePair<byte, byte[]?>(key, null) });
+
+        private void Send(List<byte> command)
+        {
+            try
+            {
+                mailbox.WriteData(command.ToArray(), Command_e.CMD_KVDATA);
+            }
+            catch (InvalidOperationException ex) when (ex.Message.Contains("Invalid Command"))
+            {
+                throw new InvalidOperationException("Key-value store write rejected, the store is full or the flash failed.", ex);
+            }
+            command.Clear();
+        }
+    }
+}
@@ -0,0 +1,155 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - CommData Mailbox Client
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Exchanges commands with the firmware communicator through the CommData
+//   mailbox in target SRAM while the CPU is running
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Firmware mailbox commands, on a local probe or through a probe server.</summary>
+    public interface IMailbox
+    {
+        void WriteData(byte[] data, Command_e Command);
+        void WriteInt32(UInt32 data, Command_e Command);
+        byte[] ReadData(Command_e Command, int length);
+        UInt32 ReadInt32(Command_e Command);
+        CommitInfo_t Commit(byte[]? config = null);
+        T Read<T>(Command_e Command) where T : struct;
+        void Write<T>(T structure, Command_e Command) where T : struct;
+    }
+
+    /// <summary>Client for the firmware CommData mailbox (header + 124 data bytes at 0x08038000).</summary>
+    public class MailboxClient : IMailbox
+    {
+        public const uint MAILBOX_ADDR = 0x08038000;                           // CommData header address.
+        public const uint MAILBOX_DATA_ADDR = MAILBOX_ADDR + 4;                // CommData payload address.
+        public const int MAILBOX_DATA_SIZE = 124;                              // CommData payload size.
+
+        public Psoc6Programmer Programmer { get; }
+        public int TimeoutMs { get; set; } = 100;                               // Time the firmware gets to handle a command.
+
+        /// <summary>Constructs a mailbox client on a programmer.</summary>
+        /// <param name="Programmer">Programmer connected to the target.</param>
+        public MailboxClient(Psoc6Programmer Programmer)
+        {
+            this.Programmer = Programmer;
+        }
+
+        /// <summary>Attaches to the running CM4 core without halting it.</summary>
+        public MailboxClient Attach()
+        {
+            Programmer.Attach(AP_e.AP_CM4);
+            return this;
+        }
+
+        /// <summary>Waits until the firmware has handled the command and checks the response flags.</summary>
+        public void WaitResponse()
+        {
+            Header_t header = new Header_t();
+            // The probe polls the command byte until the firmware set it back to idle
+            bool idle = Programmer.PollIO(MAILBOX_ADDR, 0xFF, (uint)Command_e.CMD_IDLE, TimeoutMs, out uint value);
+            header.Value = value;
+            if (!idle) throw new InvalidOperationException("Read timeout: No response from target, check firmware and CPU execution state.");
+            if (header.CommandInvalid) throw new InvalidOperationException("Error, target response: Invalid Command.");
+            if (header.SizeInvalid) throw new InvalidOperationException("Error, target response: Invalid Data Length.");
+            if (header.Reset) throw new InvalidOperationException("Error, target response: Received Reset.");
+        }
+
+        /// <summary>Writes a data block to the firmware.</summary>
+        public void WriteData(byte[] data, Command_e Command)
+        {
+            if (data.Length > MAILBOX_DATA_SIZE)
+                throw new ArgumentException($"Mailbox data too long: {data.Length} bytes.");
+            Programmer.TransferBlock(MAILBOX_DATA_ADDR, data, 0, data.Length);
+            Header_t header = new Header_t() { Command = Command, DataLength = (ushort)data.Length };
+            // Write header after data transfer to ensure data is present at PSoC before parsing
+            Programmer.WriteIO(MAILBOX_ADDR, header.Value);
+            WaitResponse();
+        }
+
+        /// <summary>Writes a 32-bit value to the firmware.</summary>
+        public void WriteInt32(UInt32 data, Command_e Command)
+        {
+            Programmer.WriteIO(MAILBOX_DATA_ADDR, data);
+            Header_t header = new Header_t() { Command = Command, DataLength = 4 };
+            // Write header after data transfer to ensure data is present at PSoC before parsing
+            Programmer.WriteIO(MAILBOX_ADDR, header.Value);
+            WaitResponse();
+        }
+
+        /// <summary>Reads a data block from the firmware.</summary>
+        public byte[] ReadData(Command_e Command, int length)
+        {
+            Header_t header = new Header_t() { Command = Command, Read = true, DataLength = (ushort)length };
+            Programmer.WriteIO(MAILBOX_ADDR, header.Value);
+            WaitResponse();
+            return Programmer.TransferBlockRead(MAILBOX_DATA_ADDR, 0, length);
+        }
+
+        /// <summary>Reads a 32-bit value from the firmware.</summary>
+        public UInt32 ReadInt32(Command_e Command)
+        {
+            Header_t header = new Header_t() { Command = Command, Read = true, DataLength = 4 };
+            Programmer.WriteIO(MAILBOX_ADDR, header.Value);
+            WaitResponse();
+            return Programmer.ReadIO(MAILBOX_DATA_ADDR);
+        }
+
+        /// <summary>Commits the keys in firmware RAM, and optionally a configuration blob, to flash and checks the stored digests.</summary>
+        /// <param name="config">Configuration blob (max 64 bytes), null to leave the stored configuration untouched.</param>
+        /// <returns>Digests of the stored records, read back from flash.</returns>
+        public CommitInfo_t Commit(byte[]? config = null)
+        {
+            config ??= Array.Empty<byte>();
+            WriteData(config, Command_e.CMD_COMMIT);
+            var written = new CommitInfo_t();
+            DataToStruct(Programmer.TransferBlockRead(MAILBOX_DATA_ADDR, 0, GetStructSize<CommitInfo_t>()), ref written);
+            if (written.KeysResult > flashStoreResult_e.Unchanged)
+                throw new InvalidOperationException($"Key commit failed: {written.KeysResult}.");
+            if (config.Length > 0 && written.ConfigResult > flashStoreResult_e.Unchanged)
+                throw new InvalidOperationException($"Configuration commit failed: {written.ConfigResult}.");
+
+            // The digest of the flash content must match the keys in RAM and the blob sent
+            var stored = Read<CommitInfo_t>(Command_e.CMD_COMMIT);
+            uint keysCrc = Crc32(ReadData(Command_e.CMD_KEYS, GetStructSize<LoRaWAN_keys_t>()));
+            if (stored.KeysResult != flashStoreResult_e.OK || stored.KeysCrc != keysCrc)
+                throw new InvalidOperationException($"Key commit digest mismatch: flash 0x{stored.KeysCrc:X8}, expected 0x{keysCrc:X8}.");
+            if (config.Length > 0 && (stored.ConfigResult != flashStoreResult_e.OK || stored.ConfigCrc != Crc32(config)))
+                throw new InvalidOperationException($"Configuration commit digest mismatch: flash 0x{stored.ConfigCrc:X8}, expected 0x{Crc32(config):X8}.");
+            return stored;
+        }
+
+        /// <summary>Reads a structure from the firmware.</summary>
+        public T Read<T>(Command_e Command) where T : struct
+        {
+            var result = new T();
+            DataToStruct(ReadData(Command, GetStructSize<T>()), ref result);
+            return result;
+        }
+
+        /// <summary>Writes a structure to the firmware.</summary>
+        public void Write<T>(T structure, Command_e Command) where T : struct
+        {
+            WriteData(StructToData(structure), Command);
+        }
+    }
+}
@@ -0,0 +1,1254 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - High-Level Flashing Logic
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// References:
+// - CMSIS-DAP: https://arm-software.github.io/CMSIS_5/DAP/html/index.html
+// - Infineon PSoC 6 Programming Specification 002-15554 Rev. *O
+//
+// Description:
+// - Provides full flashing workflow for PSoC6 over CMSIS-DAP
+// - Supports acquisition, erase, program, and verify flows
+// - Communicates using SWD or JTAG over DAP USB interface
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Diagnostics;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Enumeration for target acquisition modes.</summary>
+    public enum AcquireMode
+    {
+        ACQ_RESET,              ///< Reset the target.
+        ACQ_POWER_CYCLE         ///< Power-cycle the target.
+    }
+
+    /// <summary>Enumeration for the SWJ interface type.</summary>
+    public enum SWJ_Interface
+    {
+        SWD,                    ///< Serial Wire Debug.
+        JTAG                    ///< JTAG interface.
+    }
+
+    /// <summary>Enumeration for time units used in delays.</summary>
+    public enum timeUnit_e : int
+    {
+        TIME_1MS = 1,           ///< 1 millisecond.
+        TIME_100MS = 100        ///< 100 millisecond.
+    }
+
+    /// <summary>Enumeration for Access Port selection.</summary>
+    public enum AP_e
+    {
+        AP_SYS = 0,             ///< Use AP number 0 (typically for external debugger/DAP access).
+        AP_CM0 = 1,             ///< Use AP number 1 (typically for CM0+).
+        AP_CM4 = 2,             ///< Use AP number 2 (typically for CM4).
+        AP_AUTO = 255           ///< Automatically scan and select an AP.
+    }
+    public enum ProtectionState_e : byte
+    {
+        VIRGIN = 0x01,
+        NORMAL = 0x02,
+        SECURE = 0x03,
+        DEAD = 0x04
+    }
+
+    public class PSoC6Family
+    {
+        public string Name { get; }
+        public ushort FamilyId { get; }
+        public Func<PSoCclass> Factory { get; }
+
+        private PSoC6Family(string name, ushort familyId, Func<PSoCclass> factory)
+        {
+            Name = name;
+            FamilyId = familyId;
+            Factory = factory;
+        }
+
+        public PSoCclass Create() => Factory();
+
+        public static readonly PSoC6Family PSOC6ABLE2 = new("PSOC6ABLE2", 0x100, () => new PSoC6Able2());
+        public static readonly PSoC6Family PSOC6A2M = new("PSOC6A2M", 0x102, () => new PSoC6A2M());
+        public static readonly PSoC6Family PSOC6A512K = new("PSOC6A512K", 0x105, () => new PSoC6A512K());
+        public static readonly PSoC6Family PSOC6A256K = new("PSOC6A256K", 0x10E, () => new PSoC6A256K());
+
+        public static IEnumerable<PSoC6Family> All => new[] { PSOC6ABLE2, PSOC6A2M, PSOC6A512K, PSOC6A256K };
+
+        public static PSoC6Family FromFamilyId(ushort familyId)
+            => All.FirstOrDefault(f => f.FamilyId == familyId)
+               ?? throw new ArgumentException($"Unknown Family ID: 0x{familyId:X4}");
+    }
+
+    /// <summary>High-level programmer for PSoC6 devices using CMSIS-DAP.</summary>
+    public class Psoc6Programmer
+    {
+        private readonly CmsisDap.Device Device;                                // CMSIS-DAP device instance.
+        private readonly PSoCclass PSoC;                                        // Target-specific constants instance.
+        private readonly PSoC6Family Family;                                    // Target family, key of the probe profile.
+        public SWJ_Interface Interface { get; set; } = SWJ_Interface.SWD;       // Selected SWJ interface (SWD or JTAG).
+        public uint SwjClockSpeed { get; private set; } = 2000000;              // SWD clock (Hz), applied by the handshake.
+        public static Action<uint, uint> DefaultProgress { get; set; } = (value, max) => { };   // Progress sink of new programmers, set by the UI.
+        public Action<uint, uint> Progress { get; set; } = DefaultProgress;     // Progress sink (value, max), per instance for parallel programmers.
+        public int WaitRetries { get; set; } = 3;                               // Resends of a transfer answered WAIT, each after the probe's own WAIT retries.
+        private byte selectedAP;                                                // AP selected by DAP_Init, reselected after clearing sticky errors.
+        public bool AdaptiveClock { get; set; }                                 // Step the clock down when transfer errors accumulate.
+        public int StepDownErrors { get; set; } = 3;                            // Transfer errors within one second that step the clock down.
+        public event Action<uint>? ClockChanged;                                // New clock (Hz) after an adaptive step down.
+        private readonly Queue<long> errorTicks = new();                        // Times of the recent transfer errors.
+        public ProbeProfileStore? Profiles { get; set; }                        // AP map per probe for AP_AUTO, null to scan on every attach.
+
+        /// <summary>Constructs a new Psoc6Programmer.</summary>
+        /// <param name="Device">CMSIS-DAP device instance.</param>
+        /// <param name="PSoC">Target constants instance (e.g. new Psoc6A256K()).</param>
+        /// <param name="Interface">Interface (SWD or JTAG).</param>
+        /// <param name="SwjClockSpeed">SWD Clock Speed (Hz).</param>
+        public Psoc6Programmer(CmsisDap.Device Device, PSoC6Family PSoC6Family, SWJ_Interface Interface = SWJ_Interface.SWD, uint SwjClockSpeed = 2000000)
+        {
+            this.Device = Device;                                               // Assign CMSIS-DAP device.
+            PSoC = PSoC6Family.Create();
+            Family = PSoC6Family;
+            this.Interface = Interface;                                         // Set interface type.
+            this.SwjClockSpeed = SwjClockSpeed;
+        }
+
+        /// <summary>Writes a 32-bit value to a DAP register using device.Transfer.</summary>
+        /// <param name="req">DAP register request (from DapReg.Write).</param>
+        /// <param name="data">32-bit data to write.</param>
+        private void WriteDAP(byte req, uint data)
+        {
+            TransferRecover("WriteDAP", (req, data));                           // Perform transfer.
+        }
+
+        /// <summary>Reads a 32-bit value from a DAP register using device.Transfer.</summary>
+        /// <param name="req">DAP register request (from DapReg.Read).</param>
+        /// <returns>Output 32-bit data.</returns>
+        private uint ReadDAP(byte req)
+        {
+            byte[] response = TransferRecover("ReadDAP", (req, null));          // Perform read transfer.
+            return BitConverter.ToUInt32(response, 3);
+        }
+
+        /// <summary>Progress of the recovery of one failing transfer.</summary>
+        private struct Recovery
+        {
+            public int Waits;                                                   // WAIT resends so far.
+            public bool Aborted;                                                // Sticky errors cleared.
+            public bool Reinitialized;                                          // Handshake repeated.
+        }
+
+        /// <summary>Performs a DAP_Transfer, recovering from WAIT and FAULT responses.</summary>
+        /// <param name="operation">Name used in the exception message.</param>
+        /// <param name="transfers">Transfers of the command, repeated as a whole after a recovery step.</param>
+        /// <returns>Response with all transfers done.</returns>
+        /// <exception cref="InvalidOperationException">Thrown when the transfer still fails after all recovery steps.</exception>
+        private byte[] TransferRecover(string operation, params (byte req, uint? data)[] transfers)
+        {
+            byte[] command = CmsisDap.Transfer(0x00, transfers);
+            byte expectedAck = (byte)((Interface == SWJ_Interface.SWD) ? 0x01 : 0x02);
+            var recovery = new Recovery();
+            while (true)
+            {
+                byte[] response = Device.SendCommand(command);
+                if (response.Length >= 3 && response[1] == transfers.Length && response[2] == expectedAck)
+                    return response;
+                byte ack = response.ElementAtOrDefault(2);
+                if (!Recover(ack, ref recovery))
+                    throw new InvalidOperationException($"{operation} failed: Invalid response or ACK 0x{ack:X2}.");
+            }
+        }
+
+        /// <summary>Recovers the DAP after a failed transfer, cheapest step first: resend on WAIT, clear the
+        /// sticky errors with ABORT and reselect the AP, repeat the handshake as last resort.</summary>
+        /// <param name="ack">ACK of the failed transfer.</param>
+        /// <param name="recovery">Steps taken so far for this transfer.</param>
+        /// <returns>True if the transfer should be repeated, false when all steps are used up.</returns>
+        private bool Recover(byte ack, ref Recovery recovery)
+        {
+            ack &= 0x07;
+            bool wait = Interface == SWJ_Interface.SWD && ack == 0x02;         // Target busy, e.g. waking up from deep sleep.
+            if (!wait)
+                CountTransferError();
+            if (wait && recovery.Waits < WaitRetries)
+            {
+                recovery.Waits++;
+                Device.Statistics.Recovered(DapRecovery.WaitRetry);
+                return true;
+            }
+            if (!recovery.Aborted && (wait || ack == 0x04))
+            {
+                recovery.Aborted = true;
+                Device.Statistics.Recovered(DapRecovery.Abort);
+                if (ClearStickyErrors())
+                    return true;
+            }
+            if (recovery.Reinitialized)
+                return false;
+            recovery.Reinitialized = true;                                      // No ACK, or ABORT did not help.
+            Device.Statistics.Recovered(DapRecovery.Handshake);
+            uint clock = SwjClockSpeed;
+            for (int step = 0; ; step++)
+            {
+                try
+                {
+                    DAP_Init(selectedAP);
+                    break;
+                }
+                catch (TimeoutException) when (AdaptiveClock && step < MAX_HANDSHAKE_STEP_DOWNS && SwjClockSpeed > ClockSteps[0])
+                {
+                    SwjClockSpeed = ClockSteps.Last(hz => hz < SwjClockSpeed); // Kept only if the handshake succeeds.
+                }
+                catch
+                {
+                    SwjClockSpeed = clock;                                      // Target gone rather than clock too high.
+                    throw;
+                }
+            }
+            if (SwjClockSpeed != clock)
+            {
+                Device.Statistics.Recovered(DapRecovery.ClockStepDown);
+                ClockChanged?.Invoke(SwjClockSpeed);
+            }
+            return true;
+        }
+
+        // Lower clocks the handshake recovery tries before it gives up
+        private const int MAX_HANDSHAKE_STEP_DOWNS = 2;
+
+        /// <summary>Steps the clock down one of ClockSteps when AdaptiveClock is set and StepDownErrors
+        /// transfer errors occurred within one second.</summary>
+        private void CountTransferError()
+        {
+            if (!AdaptiveClock)
+                return;
+            long now = Stopwatch.GetTimestamp();
+            errorTicks.Enqueue(now);
+            while (now - errorTicks.Peek() > Stopwatch.Frequency)
+                errorTicks.Dequeue();
+            uint lower = ClockSteps.LastOrDefault(hz => hz < SwjClockSpeed);
+            if (errorTicks.Count < StepDownErrors || lower == 0)
+                return;
+            errorTicks.Clear();
+            SwjClockSpeed = lower;
+            Device.SwjClock(lower);
+            Device.Statistics.Recovered(DapRecovery.ClockStepDown);
+            ClockChanged?.Invoke(lower);
+        }
+
+        /// <summary>Aborts a stalled AP access, clears the sticky errors and reselects the AP in one exchange.</summary>
+        /// <returns>True if the DP accepted the writes.</returns>
+        private bool ClearStickyErrors()
+        {
+            var responses = Device.Execute(new CmsisDap.CommandBatch()
+                .Add(CmsisDap.WriteAbort(0x0000001F))                           // DAPABORT, STKCMPCLR, STKERRCLR, WDERRCLR, ORUNERRCLR.
+                .Add(CmsisDap.Transfer(0x00,
+                    (DapReg.Write.SELECT, (uint)(selectedAP << 24)),
+                    (DapReg.Write.CSW, 0x23000002))));
+            byte expectedAck = (byte)((Interface == SWJ_Interface.SWD) ? 0x01 : 0x02);
+            return responses[0].ElementAtOrDefault(1) == 0x00 && responses[1].ElementAtOrDefault(1) == 2 && responses[1].ElementAtOrDefault(2) == expectedAck;
+        }
+
+        /// <summary>Performs a combined write operation: writes the target address into TAR and writes data into DRW in one USB packet.</summary>
+        /// <param name="addr">The target memory address.</param>
+        /// <param name="data">The 32-bit data word to write.</param>
+        public void WriteIO(uint addr, uint data)
+        {
+            // Send a single transfer command with two operations:
+            // 1. Write to TAR with the provided address.
+            // 2. Write to DRW with the provided data.
+            // Expected response structure (example):
+            // Byte0: CMD (e.g., 0x05)
+            // Byte1: Count
+            // Byte2: ACK of the last transfer
+            TransferRecover("WriteIO",
+                (DapReg.Write.TAR, addr),
+                (DapReg.Write.DRW, data));
+        }
+
+        /// <summary>Performs a combined read operation: writes the target address to TAR, then reads from DRW (dummy read) 
+        /// and from RDBUFF (final read) in one USB packet.</summary>
+        /// <param name="addr">The target memory address to read from.</param>
+        /// <returns>Output 32-bit word read from the target (from RDBUFF).</returns>
+        public uint ReadIO(uint addr)
+        {
+            // Send a single transfer command with three operations:
+            // 1. Write to TAR with the given address.
+            // 2. Read from DRW (dummy read).
+            // 3. Read from RDBUFF (final valid read).
+            // Expected response structure (example):
+            // Byte0: CMD (e.g., 0x05)
+            // Byte1: Count
+            // Byte2: ACK of the last transfer
+            // Byte3-6: Data for DRW read (dummy value – discarded)
+            // Byte7-10: Data for RDBUFF read (valid target data)
+            byte[] response = TransferRecover("ReadIO",
+                (DapReg.Write.TAR, addr),
+                (DapReg.Read.DRW, null),
+                (DapReg.Read.RDBUFF, null));
+
+            return BitConverter.ToUInt32(response, 7); // Extract the 32-bit data from the final read.
+        }
+
+        /// <summary>Waits for the specified time unit and increments the timer.</summary>
+        /// <param name="timer">Reference to cumulative timer variable.</param>
+        /// <param name="unit">Time unit (e.g., TIME_1MS).</param>
+        /// <returns>Updated timer value.</returns>
+        public uint Wait(ref uint timer, timeUnit_e unit)
+        {
+            HostDelay(TimeSpan.FromMilliseconds((int)unit));         // Wait for specified duration.
+            return ++timer;                                          // Increment and return timer.
+        }
+
+        /// <summary>Waits on the host with sub-millisecond resolution, for waits that cannot run on the probe.</summary>
+        /// <remarks>Thread.Sleep(1) can take a whole scheduler tick (15.6 ms on Windows), so only the part
+        /// of the wait longer than a tick is slept and the remainder is spun.</remarks>
+        public static void HostDelay(TimeSpan time)
+        {
+            long end = Stopwatch.GetTimestamp() + (long)(time.TotalSeconds * Stopwatch.Frequency);
+            long tick = Stopwatch.Frequency * 16 / 1000;
+            for (long remaining; (remaining = end - Stopwatch.GetTimestamp()) > 0;)
+            {
+                if (remaining > tick)
+                    Thread.Sleep((int)((remaining - tick) * 1000 / Stopwatch.Frequency));
+                else
+                    Thread.SpinWait(100);
+            }
+        }
+
+        // Time the probe keeps repeating a value match read before it reports a mismatch
+        private const int MATCH_WINDOW_US = 20000;
+        // SWD bits per value match retry: AP read with its posted read, plus idle and turnaround cycles
+        private const int MATCH_RETRY_BITS = 100;
+
+        /// <summary>Value match retries (match_retry of DAP_TransferConfigure) that last about MATCH_WINDOW_US at the SWD clock.</summary>
+        private ushort MatchRetry => (ushort)Math.Clamp((ulong)SwjClockSpeed * MATCH_WINDOW_US / 1000000 / MATCH_RETRY_BITS, 1, 0xFFFF);
+
+        /// <summary>Polls a target word until (value &amp; mask) == expected. The probe repeats the read
+        /// (value match with match_retry), the host only resends when a whole window did not match.</summary>
+        /// <param name="addr">Target address of the word.</param>
+        /// <param name="mask">Bits compared.</param>
+        /// <param name="expected">Expected value of the compared bits.</param>
+        /// <param name="timeoutMs">Time after which polling stops.</param>
+        /// <param name="value">Matching value, or the last value read on timeout.</param>
+        /// <param name="then">Transfers executed in the same packet once the word matches.</param>
+        /// <returns>True if the word matched within the timeout.</returns>
+        /// <exception cref="InvalidOperationException">Thrown on a transfer fault that recovery did not clear.</exception>
+        public bool PollIO(uint addr, uint mask, uint expected, int timeoutMs, out uint value, params (byte req, uint? data)[] then)
+        {
+            byte[] poll = CmsisDap.Transfer(0x00, new (byte, uint?)[]
+            {
+                (DapReg.Write.CSW, 0x23000002),                             // No auto increment: the retries read the same word.
+                (DapReg.MASK, mask),
+                (DapReg.Write.TAR, addr),
+                ((byte)(DapReg.Read.DRW | DapReg.MATCH), expected),
+                (DapReg.Read.DRW, null),                                    // Matching value.
+            }.Concat(then).ToArray());
+            int transfers = poll[2];
+            byte expectedAck = (byte)((Interface == SWJ_Interface.SWD) ? 0x01 : 0x02);
+            var recovery = new Recovery();
+            var timer = Stopwatch.StartNew();
+            do
+            {
+                byte[] response = Device.SendCommand(poll);
+                if (response.Length >= 7 && response[1] == transfers && response[2] == expectedAck)
+                {
+                    value = BitConverter.ToUInt32(response, 3);
+                    return true;
+                }
+                if ((response.ElementAtOrDefault(2) & 0x07) != expectedAck && !Recover(response.ElementAtOrDefault(2), ref recovery))
+                    throw new InvalidOperationException($"PollIO failed at 0x{addr:X8}: ACK 0x{response.ElementAtOrDefault(2):X2}.");
+            } while (timer.ElapsedMilliseconds < timeoutMs);
+            value = ReadIO(addr);
+            return false;
+        }
+
+        // Line reset, JTAG-to-SWD select sequence 0xE79E, line reset and idle cycles
+        private static readonly byte[] JTAG_TO_SWD_SEQUENCE = CmsisDap.SwjSeq(0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                                                              0x9E, 0xE7,
+                                                                              0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                                                              0x00);
+
+        /// <summary>Sends the SWJ sequence to switch from JTAG to SWD mode.</summary>
+        /// <returns>True if the response indicates the SWJ sequence command.</returns>
+        public void DAP_JTAGtoSWD()
+        {
+            byte[] resp = Device.SendCommand(JTAG_TO_SWD_SEQUENCE);   // Send SWJ sequence per CMSIS-DAP.
+            if (resp.Length == 0 || resp[0] != CmsisDap.CMD_DAP_SWJ_SEQ)
+                throw new InvalidOperationException("DAP_JTAGtoSWD failed: No or invalid response.");
+        }
+
+
+        // Line reset, SWD-to-JTAG select sequence 0xE73C and TMS high into Test-Logic-Reset
+        private static readonly byte[] SWD_TO_JTAG_SEQUENCE = CmsisDap.SwjSeq(0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                                                              0x3C, 0xE7,
+                                                                              0xFF);
+
+        /// <summary>Sends the SWJ sequence to switch from SWD to JTAG mode.</summary>
+        private void DAP_SWDtoJTAG()
+        {
+            byte[] resp = Device.SendCommand(SWD_TO_JTAG_SEQUENCE);   // Send SWJ sequence per CMSIS-DAP.
+            if (resp.Length == 0 || resp[0] != CmsisDap.CMD_DAP_SWJ_SEQ)
+                throw new InvalidOperationException("DAP_SWDtoJTAG failed: No or invalid response.");
+        }
+
+        /// <summary>Toggles external reset (XRES) of the target, the 10 ms pulse is timed by the probe.</summary>
+        public void ToggleXRES()
+        {
+            Device.Execute(new CmsisDap.CommandBatch()
+                .Add(CmsisDap.SwjPins(0x20, 0xA0, 0x00000000))
+                .Add(CmsisDap.Delay(10000))
+                .Add(CmsisDap.SwjPins(0xA0, 0xA0, 0x00000000)));
+        }
+
+        /// <summary>Stub for powering on or power-cycling the target.</summary>
+        private void PowerOn()
+        {
+            // Implement power-cycle control.
+        }
+
+        /// <summary>Performs the DAP handshake by reading the target IDCODE.</summary>
+        public void DAP_Handshake() => DAP_Handshake(Array.Empty<(byte, uint?)>());
+
+        /// <summary>Performs the DAP handshake: connect, clock setup, SWJ switch and IDCODE read in one exchange.</summary>
+        /// <param name="setup">DP/AP transfers executed right after the IDCODE read, in the same exchange.</param>
+        private void DAP_Handshake(params (byte req, uint? data)[] setup)
+        {
+            uint id = 0;                                       // IDCODE read from target.
+            byte expectedAck = (Interface == SWJ_Interface.SWD) ? (byte)0x01 : (byte)0x02;  // Expected ACK value.
+            uint targetID = (Interface == SWJ_Interface.SWD) ? 0x6BA02477u : 0x6BA00477u;// Expected target ID.
+            var transfers = new[] { (DapReg.Read.IDCODE, (uint?)null) }.Concat(setup).ToArray();
+            var timer = Stopwatch.StartNew();
+            for (int attempt = 0; ; attempt++)
+            {
+                var batch = new CmsisDap.CommandBatch();
+                if (attempt > 0)
+                    batch.Add(CmsisDap.Delay(1000));                // Wait between polls, on the probe.
+                batch.Add(CmsisDap.Connect())
+                    .Add(CmsisDap.TransferConfigure(0x00, 0x0040, MatchRetry))
+                    .Add(CmsisDap.SwjClock(SwjClockSpeed));
+                batch.Add(Interface == SWJ_Interface.SWD
+                    ? JTAG_TO_SWD_SEQUENCE                          // Switch to SWD if required.
+                    : SWD_TO_JTAG_SEQUENCE);                        // Switch to JTAG if required.
+                batch.Add(CmsisDap.Transfer(0x00, transfers));
+
+                byte[] response = Device.Execute(batch)[^1];
+                // All transfers done: the IDCODE read succeeded and the setup is complete
+                if (response.Length >= 7 && response[1] == transfers.Length && response[2] == expectedAck)
+                    id = BitConverter.ToUInt32(response, 3);
+                if (id == targetID)
+                    return;
+                if (timer.ElapsedMilliseconds >= 300)               // Loop until timeout.
+                    break;
+            }
+            if (id != 0)
+                throw new TimeoutException("DAP Handshake failed: Target ID not matched.");
+            throw new TimeoutException("DAP Handshake failed: Timeout.");
+        }
+
+        /// <summary>Initializes the Debug Access Port (DAP), the setup writes go with the handshake in one exchange.</summary>
+        /// <param name="apNum">Access Port number. 0 – System AP; 1 – CM0+ AP; 2 – CM4 AP.</param>
+        public void DAP_Init(byte apNum)
+        {
+            selectedAP = apNum;
+            if (Interface == SWJ_Interface.JTAG)
+                DAP_Handshake(
+                    (DapReg.Write.CTRLSTAT, 0x50000032),            // Write CTRLSTAT (JTAG).
+                    (DapReg.Write.SELECT, (uint)(apNum << 24)),     // Select AP.
+                    (DapReg.Write.CSW, 0x23000002));                // Set CSW.
+            else
+                DAP_Handshake(
+                    (DapReg.Write.ABORT, 0x0000001E),               // Clear sticky errors (SWD).
+                    (DapReg.Write.CTRLSTAT, 0x50000000),            // Write CTRLSTAT (SWD).
+                    (DapReg.Write.SELECT, (uint)(apNum << 24)),     // Select AP.
+                    (DapReg.Write.CSW, 0x23000002));                // Set CSW.
+        }
+
+        /// <summary>SWD clocks tried by TuneClock and the adaptive step down (Hz), the probe rounds them to its own dividers.</summary>
+        public static readonly uint[] ClockSteps =
+            { 1000000, 2000000, 4000000, 6000000, 8000000, 10000000, 12000000, 15000000, 20000000, 24000000, 30000000 };
+
+        // SRAM used by the clock pattern test, clear of the SROM parameter block
+        private const uint CLOCK_TEST_OFFSET = 0x1000;
+        private const int CLOCK_TEST_SIZE = 1024;
+
+        /// <summary>Binary searches ClockSteps for the highest clock that passes a write/read pattern test on SRAM
+        /// and keeps that clock. Call after Acquire, the test area is restored afterwards.</summary>
+        /// <param name="maxHz">Highest clock to try.</param>
+        /// <param name="passes">Pattern test repetitions per clock.</param>
+        /// <returns>The tuned clock (Hz).</returns>
+        /// <exception cref="InvalidOperationException">Thrown when even the lowest clock fails.</exception>
+        public uint TuneClock(uint maxHz = 30000000, int passes = 3)
+        {
+            // The tests set the clock themselves, a step down on their errors would skew the search
+            bool adaptive = AdaptiveClock;
+            AdaptiveClock = false;
+            try
+            {
+                uint addr = PSoC.SRAM_SCRATCH_ADDR + CLOCK_TEST_OFFSET;
+                uint[] steps = ClockSteps.Where(hz => hz <= maxHz).ToArray();
+                if (steps.Length == 0 || !TestClock(steps[0], addr, passes, out byte[] saved))
+                    throw new InvalidOperationException($"SWD clock test failed at {ClockSteps[0] / 1000000.0} MHz.");
+
+                int good = 0, bad = steps.Length;
+                while (bad - good > 1)
+                {
+                    int mid = (good + bad) / 2;
+                    if (TestClock(steps[mid], addr, passes, out _))
+                        good = mid;
+                    else
+                        bad = mid;
+                }
+                // Confirm with a longer test, a marginal clock may pass a short one
+                while (good > 0 && !TestClock(steps[good], addr, passes * 4, out _))
+                    good--;
+                if (!TestClock(steps[good], addr, 1, out _))
+                    throw new InvalidOperationException("SWD clock test failed after tuning.");
+                TransferBlock(addr, saved, 0, saved.Length);
+                return SwjClockSpeed;
+            }
+            finally
+            {
+                AdaptiveClock = adaptive;
+            }
+        }
+
+        /// <summary>Reconnects at a clock and writes, reads back and compares test patterns.</summary>
+        /// <param name="saved">SRAM contents before the test.</param>
+        /// <returns>True if all patterns matched without a transfer error.</returns>
+        private bool TestClock(uint hz, uint addr, int passes, out byte[] saved)
+        {
+            saved = Array.Empty<byte>();
+            var pattern = new byte[CLOCK_TEST_SIZE];
+            var random = new Random((int)hz);
+            for (int i = 0; i < pattern.Length / 4; i++)
+            {
+                // Walking ones, alternating bits, all ones/zeros and random words
+                uint word = (i % 4) switch
+                {
+                    0 => 1u << (i / 4 % 32),
+                    1 => (i & 8) != 0 ? 0xAAAAAAAA : 0x55555555,
+                    2 => (i & 8) != 0 ? 0xFFFFFFFF : 0x00000000,
+                    _ => (uint)random.Next() ^ ((uint)random.Next() << 16),
+                };
+                BitConverter.TryWriteBytes(pattern.AsSpan(i * 4), word);
+            }
+
+            SwjClockSpeed = hz;
+            long errors = Device.Statistics.Snapshot().Recoveries.Sum();
+            try
+            {
+                DAP_Init(selectedAP);
+                saved = TransferBlockRead(addr, 0, CLOCK_TEST_SIZE);
+                for (int pass = 0; pass < passes; pass++)
+                {
+                    TransferBlock(addr, pattern, 0, pattern.Length);
+                    if (!TransferBlockRead(addr, 0, pattern.Length).SequenceEqual(pattern) || ReadIO(addr + 4) != BitConverter.ToUInt32(pattern, 4))
+                        return false;
+                    Array.Reverse(pattern);                                     // Other bit transitions on the next pass.
+                }
+                TransferBlock(addr, saved, 0, saved.Length);
+            }
+            catch (Exception ex) when (ex is InvalidOperationException or TimeoutException)
+            {
+                return false;
+            }
+            return Device.Statistics.Snapshot().Recoveries.Sum() == errors;     // Recovered errors count as a failure.
+        }
+
+        /// <summary>Scans APs (0-2) to locate one with valid CPU access.</summary>
+        /// <returns>Byte array with valid APs found.</returns>
+        public byte[] DAP_ScanAP()
+        {
+            List<byte> APlist = new List<byte>();
+            DAP_Init(0);                                    // One handshake, the other APs are only selected.
+            for (byte i = 0; i < 3; i++)
+            {
+                try
+                {
+                    if (IsCpuAP(i))
+                        APlist.Add(i);
+                }
+                catch (Exception ex) when (ex is InvalidOperationException or TimeoutException) { }
+            }
+            return APlist.ToArray();
+        }
+
+        /// <summary>Selects an AP and checks for CPU access by reading CPUID.</summary>
+        private bool IsCpuAP(byte apNum)
+        {
+            TransferRecover("SelectAP",
+                (DapReg.Write.SELECT, (uint)(apNum << 24)),     // Select AP.
+                (DapReg.Write.CSW, 0x23000002));                // Set CSW.
+            selectedAP = apNum;
+            return (ReadIO(0xE000ED00) & 0xFF000000) == 0x41000000;    // Read CPUID register.
+        }
+
+        /// <summary>Connects to the AP with CPU access for AP_AUTO. Goes straight to the AP stored in the probe
+        /// profile and scans only when there is none or it has no CPU access any more.</summary>
+        /// <returns>The AP number.</returns>
+        private byte AttachAutoAP()
+        {
+            string serial = Device.SerialNumber;
+            int[]? known = Profiles?.Find(serial, Family)?.AccessPorts;
+            if (known is { Length: > 0 } && known[0] is >= 0 and <= 0xFF)
+            {
+                byte apNumber = (byte)known[0];
+                try
+                {
+                    DAP_Init(apNumber);
+                    if (IsCpuAP(apNumber))
+                        return apNumber;
+                }
+                catch (Exception ex) when (ex is InvalidOperationException or TimeoutException) { }
+            }
+
+            byte[] AvailableAPs = DAP_ScanAP();  // Check for available APs, This includes Handshake (wait for device to boot after reset and DAP initialization
+            if (AvailableAPs.Length == 0)
+                throw new InvalidOperationException("No AP with CPU access found.");
+            if (!IsCpuAP(AvailableAPs[0]))     //  Use first available AP
+                throw new InvalidOperationException($"AP {AvailableAPs[0]} lost CPU access.");
+            Profiles?.UpdateAccessPorts(serial, Family, AvailableAPs);
+            return AvailableAPs[0];
+        }
+
+        /// <summary>Polls the IPC lock status until the expected state is reached.</summary>
+        /// <param name="ipcId">IPC channel ID.</param>
+        /// <param name="isLockExpected">True for lock acquired; false for released.</param>
+        public void Ipc_PollLockStatus(byte ipcId, bool isLockExpected)
+        {
+            uint ipcAddr = (uint)(PSoC.IPC_STRUCT0 + PSoC.IPC_STRUCT_SIZE * ipcId);     // IPC base for channel.
+            if (PollIO(ipcAddr + PSoC.IPC_STRUCT_LOCK_STATUS_OFFSET, 0x80000000, isLockExpected ? 0x80000000 : 0, 1000, out uint status))
+                return;
+            throw new TimeoutException($"IPC lock status timeout. Expected: {isLockExpected}, Last status: 0x{status:X8}");
+        }
+
+        /// <summary>Attempts to acquire an IPC channel, reading its ACQUIRE register takes the lock when free.</summary>
+        /// <param name="ipcId">The IPC channel number.</param>
+        public bool Ipc_Acquire(byte ipcId)
+        {
+            uint ipcAddr = (uint)(PSoC.IPC_STRUCT0 + PSoC.IPC_STRUCT_SIZE * ipcId);    // IPC base for channel.
+            ReadIO(PSoC.MEM_BASE_PPU4);                                                 // Dummy read, recovers the DAP if needed.
+            return PollIO(ipcAddr + PSoC.IPC_STRUCT_ACQUIRE_OFFSET, PSoC.IPC_STRUCT_ACQUIRE_SUCCESS_MSK, PSoC.IPC_STRUCT_ACQUIRE_SUCCESS_MSK, 1000, out _);
+        }
+
+        /// <summary>Polls for the result of an SROM API call via its status register.</summary>
+        /// <param name="addr">Address of the status register.</param>
+        /// <returns>Output register value.</returns>
+        public uint PollSromApiStatus(uint addr)
+        {
+            if (PollIO(addr, PSoC.SROMAPI_STATUS_MSK, PSoC.SROMAPI_STAT_SUCCESS, 1000, out uint data))
+                return data;
+            throw new TimeoutException($"SROM API status polling failed. Last status: 0x{data & PSoC.SROMAPI_STATUS_MSK:X8}");
+        }
+
+        /// <summary>Calls an SROM API command via IPC.</summary>
+        /// <param name="callIdAndParams">SROM API opcode with parameters if needed.</param>
+        /// <returns>Output result from API call.</returns>
+        public uint CallSromApi(uint callIdAndParams)
+        {
+            // Use IPC for CM0+ (IpcId = 0) if using flash loader running on CM0+ core
+            // Use IPC for CM4 (IpcId = 1) if using flash loader running on CM4 core
+            // Use IPC for DAP (IpcId = 2) if using external debugger
+            const byte ipcId = 2;                                                       // Use IPC channel 2.
+            uint ipcAddr = (uint)(PSoC.IPC_STRUCT0 + PSoC.IPC_STRUCT_SIZE * ipcId);     // IPC base for channel.
+            uint intrMaskDap = 1u << (16 + ipcId);
+            bool isDataInRam = ((callIdAndParams & PSoC.SROMAPI_DATA_LOCATION_MSK) == 0);
+            uint intrMaskInitial = StartSromCall(ipcAddr, isDataInRam ? PSoC.SRAM_SCRATCH_ADDR : callIdAndParams, intrMaskDap);
+            Ipc_PollLockStatus(ipcId, false);
+
+            // Status poll and interrupt mask restore in one packet, the mask is only restored once the status matched
+            uint statusAddr = isDataInRam ? PSoC.SRAM_SCRATCH_ADDR : ipcAddr + PSoC.IPC_STRUCT_DATA_OFFSET;
+            if (!PollIO(statusAddr, PSoC.SROMAPI_STATUS_MSK, PSoC.SROMAPI_STAT_SUCCESS, 1000, out uint dataOut,
+                    (DapReg.Write.TAR, PSoC.IPC_INTR_STRUCT + PSoC.IPC_INTR_STRUCT_INTR_MASK_OFFSET),
+                    (DapReg.Write.DRW, intrMaskInitial)))
+                throw new TimeoutException($"SROM API status polling failed. Last status: 0x{dataOut & PSoC.SROMAPI_STATUS_MSK:X8}");
+            return dataOut;
+        }
+
+        /// <summary>Acquires the IPC structure, passes the call data and notifies the SROM in one DAP_Transfer.</summary>
+        /// <param name="ipcAddr">IPC structure base address.</param>
+        /// <param name="ipcData">Value for the IPC DATA register (call id and parameters, or the scratch address).</param>
+        /// <param name="intrMaskDap">IPC interrupt mask selecting the DAP structure.</param>
+        /// <returns>IPC interrupt mask before the call, to be restored afterwards.</returns>
+        private uint StartSromCall(uint ipcAddr, uint ipcData, uint intrMaskDap)
+        {
+            uint intrMaskAddr = PSoC.IPC_INTR_STRUCT + PSoC.IPC_INTR_STRUCT_INTR_MASK_OFFSET;
+            byte expectedAck = (byte)((Interface == SWJ_Interface.SWD) ? 0x01 : 0x02);
+            // Reading ACQUIRE acquires the lock. The value match stops the transfer before the
+            // DATA and NOTIFY writes while the lock is taken, so a busy IPC is never notified.
+            byte[] acquireAndNotify = CmsisDap.Transfer(0x00,
+                (DapReg.Write.CSW, 0x23000002),                                 // Word access, block transfers leave auto increment on.
+                (DapReg.Write.TAR, intrMaskAddr),
+                (DapReg.Read.DRW, null),                                        // Initial interrupt mask.
+                (DapReg.MASK, PSoC.IPC_STRUCT_ACQUIRE_SUCCESS_MSK),
+                (DapReg.Write.TAR, ipcAddr + PSoC.IPC_STRUCT_ACQUIRE_OFFSET),
+                ((byte)(DapReg.Read.DRW | DapReg.MATCH), PSoC.IPC_STRUCT_ACQUIRE_SUCCESS_MSK),
+                (DapReg.Write.TAR, ipcAddr + PSoC.IPC_STRUCT_DATA_OFFSET),
+                (DapReg.Write.DRW, ipcData),
+                (DapReg.Write.TAR, intrMaskAddr),
+                (DapReg.Write.DRW, intrMaskDap),
+                (DapReg.Write.TAR, ipcAddr + PSoC.IPC_STRUCT_NOTIFY_OFFSET),
+                (DapReg.Write.DRW, 1));
+            int transfers = acquireAndNotify[2];
+
+            // The probe retries the ACQUIRE read for a match window, the host only resends after that
+            var recovery = new Recovery();
+            var timer = Stopwatch.StartNew();
+            do
+            {
+                byte[] response = Device.SendCommand(acquireAndNotify);
+                if (response.Length >= 7 && response[1] == transfers && response[2] == expectedAck)
+                    return BitConverter.ToUInt32(response, 3);
+                // Transfer fault, not just a taken lock
+                if ((response.ElementAtOrDefault(2) & 0x07) != expectedAck && !Recover(response.ElementAtOrDefault(2), ref recovery))
+                    throw new InvalidOperationException($"SROM API call failed: ACK 0x{response.ElementAtOrDefault(2):X2}.");
+            } while (timer.ElapsedMilliseconds < 1000);
+            throw new TimeoutException("SROM API call failed: IPC lock not acquired.");
+        }
+
+        public void Attach(AP_e AP)
+        {
+            byte apNumber = (byte)AP;
+            if (AP == AP_e.AP_AUTO)
+            {
+                apNumber = AttachAutoAP();
+            }
+            else
+            {
+                DAP_Init(apNumber);
+            }
+        }
+        /// <summary>Acquires the target by resetting it, setting test mode, scanning for AP, and verifying PC.</summary>
+        /// <param name="mode">Acquisition mode (ACQ_RESET or ACQ_POWER_CYCLE).</param>
+        /// <param name="TestModeBit">If true, perform normal acquire; if false, perform alternative acquire.</param>
+        /// <param name="AP">Access Port selection (AP_CM0, AP_CM4, AP_DAP or AP_AUTO for automatic scan).</param>
+        public void Acquire(AcquireMode mode, bool TestModeBit, AP_e AP)
+        {
+            if (mode == AcquireMode.ACQ_RESET)
+                ToggleXRES();                                       // Reset via XRES.
+            else if (mode == AcquireMode.ACQ_POWER_CYCLE)
+                PowerOn();                                          // Power cycle target.
+            HostDelay(TimeSpan.FromMilliseconds(100)); // Allow 100ms to start up
+
+            byte apNumber = (byte)AP;
+            if (AP == AP_e.AP_AUTO)
+            {
+                apNumber = AttachAutoAP();     // Includes Handshake (wait for device to boot after reset and DAP initialization)
+            }
+            else
+            {
+                DAP_Init(apNumber);
+            }
+
+
+            if (TestModeBit)
+            {
+                //DAP_Init(apNumber);
+                WriteIO(PSoC.SRSS_TST_MODE, PSoC.SRSS_TST_MODE_TEST_MODE_MSK);
+                // if (!DAP_ScanAP(out byte apNum))
+                //     return false;
+                uint testMode = ReadIO(PSoC.SRSS_TST_MODE);
+                if ((testMode & PSoC.SRSS_TST_MODE_TEST_MODE_MSK) == 0)
+                    throw new InvalidOperationException("Test mode not set.");
+
+                WriteIO(0xE000EDF4, 0x0000000F);                        // Select PC register.
+                uint pc = ReadIO(0xE000EDF8);                         // Read PC register.
+                if (((pc >= PSoC.MEM_BASE_ROM) && (pc < PSoC.MEM_BASE_ROM + PSoC.MEM_SIZE_ROM)) ||
+                    ((pc >= PSoC.MEM_BASE_FLASH) && (pc < PSoC.MEM_BASE_FLASH + PSoC.MEM_SIZE_SFLASH)))
+                    return;
+                throw new InvalidOperationException("PC not in ROM or FLASH.");
+            }
+            else
+            {
+
+                /// <summary>Alternative acquisition method which halts CPU, loads infinite loop into SRAM, and resumes CPU.</summary>
+                uint MemVTbase = apNumber == 2 ? PSoC.MEM_VTBASE_CM4 : PSoC.MEM_VTBASE_CM0;
+                uint vtBase = ReadIO(MemVTbase) & 0xFFFF0000u;
+                if (vtBase == 0 || vtBase == 0xFFFF0000u) return;
+
+                uint resetAddress = ReadIO(vtBase + 4);
+                if (resetAddress == 0) return;
+
+                WriteIO(0xE000EDF0, 0xA05F0003);
+                uint dhcsr = ReadIO(0xE000EDF0);
+                if ((dhcsr & 0x03u) != 0x03u)
+                    throw new InvalidOperationException("CPU not halted.");
+
+                WriteIO(0xE0002000, 0x00000003);
+                resetAddress = (resetAddress & 0x1FFFFFFCu) | 0xC0000001;
+                WriteIO(0xE0002008, resetAddress);
+                try
+                {
+                    WriteIO(0xE000ED0C, 0x05FA0004);
+                }
+                catch { }
+
+                DAP_Init(apNumber);
+
+                if (!PollIO(0xE000EDF0, 0x03, 0x03, 110, out dhcsr))
+                    throw new TimeoutException("CPU failed to halt after reset.");
+
+                WriteIO(0x08000300, 0xE7FEE7FE);
+                WriteIO(0xE000EDF8, 0x08000301);
+                WriteIO(0xE000EDF4, 0x0001000F);
+                WriteIO(0xE000EDF8, 0x0800FFF0);
+                WriteIO(0xE000EDF4, 0x00010011);
+                WriteIO(0xE000EDF4, 0x00000010);
+
+                uint psrRegVal = ReadIO(0xE000EDF8);
+                psrRegVal |= 0x01000000;
+                WriteIO(0xE000EDF8, psrRegVal);
+                WriteIO(0xE000EDF4, 0x00010010);
+                WriteIO(0xE0002000, 0x00000002);
+                WriteIO(0xE000EDF0, 0xA05F0001);
+            }
+        }
+
+        /// <summary>Retrieves the Silicon ID by calling SROM API commands.</summary>
+        /// <param name="fileID">A 4-byte array where fileID[0,1] are the silicon ID and fileID[2,3] are the family ID.</param>
+        public void GetSiliconInfo(out UInt16 FamilyId, out UInt16 SiliconId, out byte RevisionId, out byte ProtectionState)
+        {
+            uint dataOut0 = CallSromApi(SromCodeWithParams(PSoC.SROMAPI_SILID_CODE, 0));
+            uint dataOut1 = CallSromApi(SromCodeWithParams(PSoC.SROMAPI_SILID_CODE, 1));
+
+            FamilyId = (UInt16)(dataOut0 & 0xFFFF);
+            SiliconId = (UInt16)(dataOut1 & 0xFFFF);
+            RevisionId = (byte)((dataOut0 >> 16) & 0xFF);
+            ProtectionState = (byte)((dataOut1 >> 16) & 0x0F);
+            Profiles?.UpdateSiliconId(Device.SerialNumber, Family, SiliconId);     // Other silicon: rescan the APs on the next attach.
+        }
+
+        /// <summary>Helper: Combines SROM API opcode with a parameter (shifted left by 8 bits).</summary>
+        /// <param name="opcode">SROM API opcode.</param>
+        /// <param name="param">Parameter to embed.</param>
+        /// <returns>Combined opcode and parameter.</returns>
+        private uint SromCodeWithParams(uint opcode, uint param)
+        {
+            return opcode | (param << 8);    // Combine opcode and parameter.
+        }
+
+        /// <summary>Erases the application flash using the SROM API.</summary>
+        /// <param name="StartAddr">The address to start erasing (Erasing will be row aligned).</param>
+        /// <param name="EndAddr">The address to start erasing (Erasing will be row aligned).</param>
+        public void EraseFlash(uint StartAddr, uint EndAddr)
+        {
+            uint subsectorSize = PSoC.ROW_SIZE * 8;
+            uint sectorSize = PSoC.ROW_SIZE * 512;
+
+
+            // Align addresses to row boundaries
+            StartAddr &= ~(PSoC.ROW_SIZE - 1);
+            EndAddr = (EndAddr + PSoC.ROW_SIZE - 1) & ~(PSoC.ROW_SIZE - 1);
+
+            // If full erase is requested and aligned
+            if (StartAddr == PSoC.MEM_BASE_FLASH && (EndAddr - StartAddr) >= PSoC.MEM_SIZE_FLASH)
+            {
+                CallSromApi(PSoC.SROMAPI_ERASEALL_CODE);
+                return;
+            }
+
+            while (StartAddr < EndAddr)
+            {
+                uint remaining = EndAddr - StartAddr;
+                uint opcode;
+
+                if ((StartAddr % sectorSize == 0) && remaining >= sectorSize)
+                {
+                    opcode = PSoC.SROMAPI_ERASESECTOR_CODE;
+                }
+                else if ((StartAddr % subsectorSize == 0) && remaining >= subsectorSize)
+                {
+                    opcode = PSoC.SROMAPI_ERASESUBSECTOR_CODE;
+                }
+                else
+                {
+                    opcode = PSoC.SROMAPI_ERASEROW_CODE;
+                }
+
+                // Inline erase logic
+                WriteIO(PSoC.SRAM_SCRATCH_ADDR, opcode);
+                WriteIO(PSoC.SRAM_SCRATCH_ADDR + 0x04, StartAddr);
+                CallSromApi(opcode);
+
+                // Advance by opcode size
+                StartAddr += opcode == PSoC.SROMAPI_ERASESECTOR_CODE ? sectorSize :
+                             opcode == PSoC.SROMAPI_ERASESUBSECTOR_CODE ? subsectorSize :
+                             PSoC.ROW_SIZE;
+                Progress(StartAddr, EndAddr);
+            }
+        }
+
+        /// <summary>Programs application flash row by row using the ProgramRow SROM API.</summary>
+        /// <param name="flashData">Byte array containing the flash image.</param>
+        /// <param name="flashStartAddress">Start Address of the flash image.</param>
+        public void ProgramFlash(byte[] flashData, uint flashStartAddress)
+        {
+            uint totalRows = (uint)flashData.Length / PSoC.ROW_SIZE;
+
+            for (uint rowID = 0; rowID < totalRows; rowID++)
+            {
+                uint flashStartAddr = flashStartAddress + rowID * PSoC.ROW_SIZE;
+                int rowOffset = (int)(rowID * PSoC.ROW_SIZE);
+
+                // Setup SROM parameters and row data, use Program Row assuming rows are already erased
+                StageRowInScratch(PSoC.SROMAPI_PROGRAMROW_CODE, flashStartAddr, flashData, rowOffset);
+
+                // Call the SROM API to program the row
+                CallSromApi(PSoC.SROMAPI_PROGRAMROW_CODE);
+                Progress(rowID, totalRows);
+            }
+        }
+
+        /// <summary>Uploads the SROM parameter block and one row of data to the SRAM scratch area in a single block transfer.</summary>
+        /// <param name="opcode">SROM API opcode (ProgramRow or WriteRow).</param>
+        /// <param name="rowAddress">Flash address of the row to program.</param>
+        /// <param name="data">Byte array containing the row data.</param>
+        /// <param name="offset">Offset of the row within data; missing bytes at the end of data are written as 0x00.</param>
+        private void StageRowInScratch(uint opcode, uint rowAddress, byte[] data, int offset)
+        {
+            const int PARAM_SIZE = 0x10;
+            byte[] block = new byte[PARAM_SIZE + PSoC.ROW_SIZE];
+            uint parameters = (6u << 0) | (1u << 8) | (0u << 16) | (0u << 24);
+            BitConverter.GetBytes(opcode).CopyTo(block, 0x00);
+            BitConverter.GetBytes(parameters).CopyTo(block, 0x04);
+            BitConverter.GetBytes(rowAddress).CopyTo(block, 0x08);
+            BitConverter.GetBytes(PSoC.SRAM_SCRATCH_ADDR + PARAM_SIZE).CopyTo(block, 0x0C);
+            int copyLen = Math.Max(0, Math.Min((int)PSoC.ROW_SIZE, data.Length - offset));
+            Buffer.BlockCopy(data, offset, block, PARAM_SIZE, copyLen);
+
+            TransferBlock(PSoC.SRAM_SCRATCH_ADDR, block, 0, block.Length);
+        }
+
+        /// <summary>Writes a buffer to target memory using pipelined DAP_TransferBlock commands.</summary>
+        /// <param name="baseAddr">Target address to write to (word aligned).</param>
+        /// <param name="flashData">Source buffer.</param>
+        /// <param name="offset">Offset in the source buffer.</param>
+        /// <param name="length">Number of bytes to write (padded to whole words).</param>
+        public void TransferBlock(uint baseAddr, byte[] flashData, int offset, int length)
+        {
+            const int MAX_USB_BYTES = 64;
+            const int HEADER_SIZE = 5; // DAP_TransferBlock Command | DAP Index | Transfer Count 2 byte | Transfer Request 
+            const int WORD_SIZE = 4;
+            const int MAX_WORDS = (MAX_USB_BYTES - HEADER_SIZE) / WORD_SIZE;
+
+            int paddedLength = ((length + 3) / 4) * 4;
+            var commands = new List<byte[]>();
+            var offsets = new List<int>();
+
+            for (int relOffset = 0; relOffset < paddedLength;)
+            {
+                uint addr = baseAddr + (uint)relOffset;
+                int chunkSize = Math.Min(Math.Min(MAX_WORDS * WORD_SIZE, paddedLength - relOffset), TarWrapRemaining(addr));
+
+                // Setup CSW + TAR only at the start and where the TAR auto increment wraps
+                if (relOffset == 0 || (addr & (TAR_WRAP_SIZE - 1)) == 0)
+                {
+                    commands.Add(CmsisDap.Transfer(0x00,
+                        (DapReg.Write.CSW, 0x23000012),             // Set up auto increment for TAR
+                        (DapReg.Write.TAR, addr)));
+                    offsets.Add(relOffset);
+                }
+
+                byte[] payload = new byte[chunkSize];
+                int copyLen = Math.Max(0, Math.Min(length - relOffset, chunkSize));
+                Buffer.BlockCopy(flashData, offset + relOffset, payload, 0, copyLen);
+                commands.Add(CmsisDap.TransferBlock(0x00, DapReg.Write.DRW, payload));
+                offsets.Add(relOffset);
+                relOffset += chunkSize;
+            }
+
+            // A failed block is written again as a whole after recovery, the writes are idempotent
+            for (var recovery = new Recovery(); ;)
+            {
+                List<byte[]> responses = Device.SendCommands(commands);
+                string? error = null;
+                byte ack = 0;
+                for (int i = 0; i < responses.Count && error == null; i++)
+                {
+                    byte[] response = responses[i];
+                    if (commands[i][0] == CmsisDap.CMD_DAP_TFER)
+                    {
+                        if (response.Length < 4 || response[2] != (byte)((Interface == SWJ_Interface.SWD) ? 0x01 : 0x02))
+                        {
+                            error = $"TransferBlock CSW/TAR setup failed at offset {offset + offsets[i]}";
+                            ack = response.ElementAtOrDefault(2);
+                        }
+                    }
+                    else if (response.Length < 4 || response[3] != 0x01)
+                    {
+                        error = $"TransferBlock write failed at offset {offset + offsets[i]}";
+                        ack = response.ElementAtOrDefault(3);
+                    }
+                }
+                if (error == null)
+                    return;
+                if (!Recover(ack, ref recovery))
+                    throw new InvalidOperationException(error);
+            }
+        }
+
+        /// <summary>Reads a block of target memory using pipelined DAP_TransferBlock commands.</summary>
+        /// <param name="baseAddr">Target address to read from (word aligned).</param>
+        /// <param name="offset">Offset in the returned buffer where the data is placed.</param>
+        /// <param name="length">Number of bytes to read.</param>
+        /// <returns>Buffer of offset + length bytes containing the data read.</returns>
+        public byte[] TransferBlockRead(uint baseAddr, int offset, int length)
+        {
+            byte[] buffer = new byte[offset + length];
+            const int MAX_USB_BYTES = 64;
+            const int HEADER_SIZE = 5; // CMD | DAP Index | Transfer Count (2 bytes) | Request
+            const int WORD_SIZE = 4;
+            const int MAX_WORDS = (MAX_USB_BYTES - HEADER_SIZE) / WORD_SIZE;
+
+            int paddedLength = ((length + 3) / 4) * 4;
+            var commands = new List<byte[]>();
+            var offsets = new List<int>();
+
+            for (int relOffset = 0; relOffset < paddedLength;)
+            {
+                uint addr = baseAddr + (uint)relOffset;
+                int chunkSize = Math.Min(Math.Min(MAX_WORDS * WORD_SIZE, paddedLength - relOffset), TarWrapRemaining(addr));
+
+                // Setup CSW + TAR only at the start and where the TAR auto increment wraps
+                if (relOffset == 0 || (addr & (TAR_WRAP_SIZE - 1)) == 0)
+                {
+                    commands.Add(CmsisDap.Transfer(0x00,
+                        (DapReg.Write.CSW, 0x23000052),                  // 32-bit read, auto-increment
+                        (DapReg.Write.TAR, addr)));
+                    offsets.Add(relOffset);
+                }
+
+                // Perform block read
+                commands.Add(CmsisDap.TransferBlockRead(0x00, DapReg.Read.DRW, (ushort)(chunkSize / WORD_SIZE)));
+                offsets.Add(relOffset);
+                relOffset += chunkSize;
+            }
+
+            // A failed block is read again as a whole after recovery
+            for (var recovery = new Recovery(); ;)
+            {
+                List<byte[]> responses = Device.SendCommands(commands);
+                string? error = null;
+                byte ack = 0;
+                for (int i = 0; i < responses.Count && error == null; i++)
+                {
+                    byte[] response = responses[i];
+                    int relOffset = offsets[i];
+                    if (commands[i][0] == CmsisDap.CMD_DAP_TFER)
+                    {
+                        if (response.Length < 4 || response[2] != (byte)((Interface == SWJ_Interface.SWD) ? 0x01 : 0x02))
+                        {
+                            error = $"TransferBlockRead CSW/TAR setup failed at offset {offset + relOffset}";
+                            ack = response.ElementAtOrDefault(2);
+                        }
+                        continue;
+                    }
+
+                    int chunkSize = (commands[i][2] | (commands[i][3] << 8)) * WORD_SIZE;
+                    if (response.Length < 4 + chunkSize || response[3] != 0x01)
+                    {
+                        error = $"TransferBlock read failed at offset {offset + relOffset}";
+                        ack = response.ElementAtOrDefault(3);
+                        continue;
+                    }
+
+                    // Copy read chunk into result buffer
+                    int copyLen = Math.Min(length - relOffset, chunkSize);
+                    Buffer.BlockCopy(response, 4, buffer, offset + relOffset, copyLen);
+                }
+                if (error == null)
+                    return buffer;
+                if (!Recover(ack, ref recovery))
+                    throw new InvalidOperationException(error);
+            }
+        }
+
+        // The MEM-AP only guarantees TAR auto increment within a 1 KB address window.
+        private const uint TAR_WRAP_SIZE = 0x400;
+
+        /// <summary>Returns the number of bytes left before the TAR auto increment window wraps.</summary>
+        private static int TarWrapRemaining(uint addr) => (int)(TAR_WRAP_SIZE - (addr & (TAR_WRAP_SIZE - 1)));
+
+        /// <summary>Verifies application flash by comparing byte-by-byte.</summary>
+        /// <param name="FlashData">Byte array of the expected flash image.</param>
+        /// <param name="FlashSize">Total number of bytes in the flash image.</param>
+        public void VerifyFlash(byte[] FlashData, uint FlashStartAddress)
+        {
+            byte[] chipData = new byte[PSoC.ROW_SIZE];
+            uint totalRows = (uint)FlashData.Length / PSoC.ROW_SIZE;
+
+            for (uint rowID = 0; rowID < totalRows; rowID++)
+            {
+                uint rowOffset = rowID * PSoC.ROW_SIZE;
+                uint rowAddress = FlashStartAddress + rowOffset;
+
+                for (uint i = 0; i < PSoC.ROW_SIZE; i += 4)
+                {
+                    uint word = ReadIO(rowAddress + i);
+                    uint expected = (uint)FlashData[rowOffset + i] |
+                                    (uint)FlashData[rowOffset + i + 1] << 8 |
+                                    (uint)FlashData[rowOffset + i + 2] << 16 |
+                                    (uint)FlashData[rowOffset + i + 3] << 24;
+
+                    if (word != expected)
+                        throw new InvalidOperationException($"Flash verification failed at address 0x{rowAddress + i:X8}");
+                }
+            }
+        }
+
+        /// <summary>Verifies the flash checksum using the SROM API.</summary>
+        /// <param name="ExpectedChecksum">Expected checksum value.</param>
+        /// <returns>True if the computed checksum matches the expected value.</returns>
+        public void VerifyChecksum(uint ExpectedChecksum)
+        {
+            uint opCode = PSoC.SROMAPI_CHECKSUM_CODE |
+                          (0u << 22) |
+                          (1u << 21) |
+                          ((0u & 0x1FFF) << 8);
+
+            uint result = CallSromApi(opCode);
+            uint checksum = result & PSoC.SROMAPI_CHECKSUM_DATA_MSK;
+
+            if (checksum != ExpectedChecksum)
+                throw new InvalidOperationException($"Checksum mismatch: expected 0x{ExpectedChecksum:X8}, got 0x{checksum:X8}");
+        }
+
+        /// <summary>Programs a generic flash region (e.g., AUXflash or SFlash) row by row using the WriteRow SROM API.</summary>
+        /// <param name="FlashData">Byte array containing the flash image.</param>
+        /// <param name="FlashSize">Size in bytes of the flash region.</param>
+        /// <param name="BaseAddr">Base address of the target flash region.</param>
+        public void ProgramFlashGeneric(byte[] FlashData, uint FlashSize, uint BaseAddr)
+        {
+            uint totalRows = FlashSize / PSoC.ROW_SIZE;
+
+            for (uint rowID = 0; rowID < totalRows; rowID++)
+            {
+                uint flashStartAddr = BaseAddr + rowID * PSoC.ROW_SIZE;
+
+                // Setup SROM parameters and row data, WriteRow erases the row before programming
+                StageRowInScratch(PSoC.SROMAPI_WRITEROW_CODE, flashStartAddr, FlashData, (int)(rowID * PSoC.ROW_SIZE));
+
+                CallSromApi(PSoC.SROMAPI_WRITEROW_CODE);
+                Progress(rowID, totalRows);
+            }
+        }
+
+        /// <summary>Verifies a generic flash region by reading back and comparing each row.</summary>
+        /// <param name="FlashData">Byte array of the expected flash image.</param>
+        /// <param name="FlashSize">Total number of bytes of the flash image.</param>
+        /// <param name="BaseAddr">Base address of the flash region.</param>
+        public void VerifyFlashGeneric(byte[] FlashData, uint FlashSize, uint BaseAddr)
+        {
+            uint totalRows = FlashSize / PSoC.ROW_SIZE;
+
+            for (uint rowID = 0; rowID < totalRows; rowID++)
+            {
+                uint rowAddress = BaseAddr + rowID * PSoC.ROW_SIZE;
+                byte[] chipData = TransferBlockRead(rowAddress, 0, (int)PSoC.ROW_SIZE);
+
+                for (uint i = 0; i < PSoC.ROW_SIZE; i++)
+                {
+                    if (chipData[i] != FlashData[rowID * PSoC.ROW_SIZE + i])
+                        throw new InvalidOperationException($"VerifyFlashGeneric failed at row {rowID}, byte offset {i}");
+                }
+            }
+        }
+
+        /// <summary>Returns the row runs of an image per flash region, with the SROM opcode used to write them.</summary>
+        /// <remarks>Application flash is erased over the touched rows and written with ProgramRow, AUXflash and SFlash are written with WriteRow.</remarks>
+        private List<(uint Start, uint End, uint Opcode)> PlanImage(FlashImage image)
+        {
+            var plan = new List<(uint Start, uint End, uint Opcode)>();
+            var regions = new (uint Base, uint Size, uint Opcode)[]
+            {
+                (PSoC.MEM_BASE_FLASH, PSoC.MEM_SIZE_FLASH, PSoC.SROMAPI_PROGRAMROW_CODE),
+                (PSoC.MEM_BASE_AUXFLASH, PSoC.MEM_SIZE_AUXFLASH, PSoC.SROMAPI_WRITEROW_CODE),
+                (PSoC.MEM_BASE_SFLASH, PSoC.MEM_SIZE_SFLASH, PSoC.SROMAPI_WRITEROW_CODE),
+            };
+            foreach (var region in regions)
+            {
+                foreach (var run in image.RowRuns(PSoC.ROW_SIZE, region.Base, region.Size))
+                    plan.Add((run.Start, run.End, region.Opcode));
+            }
+            // Segments outside flash (e.g. cymcuelftool checksum / metadata sections) are not programmed
+            return plan;
+        }
+
+        /// <summary>Erases and programs only the flash rows covered by the segments of a sparse image.</summary>
+        /// <param name="image">Image to program.</param>
+        /// <remarks>Bytes of a partially covered row keep their current content for WriteRow regions, in application flash they stay erased.</remarks>
+        public void ProgramImage(FlashImage image)
+        {
+            var plan = PlanImage(image);
+            uint totalRows = (uint)plan.Sum(run => (run.End - run.Start) / PSoC.ROW_SIZE);
+            uint rowsDone = 0;
+            byte[] row = new byte[PSoC.ROW_SIZE];
+
+            foreach (var run in plan)
+            {
+                if (run.Opcode == PSoC.SROMAPI_PROGRAMROW_CODE)
+                    EraseFlash(run.Start, run.End);
+
+                for (uint rowAddress = run.Start; rowAddress < run.End; rowAddress += PSoC.ROW_SIZE)
+                {
+                    Array.Clear(row);
+                    if (run.Opcode == PSoC.SROMAPI_WRITEROW_CODE)
+                    {
+                        // WriteRow erases the full row, preserve the bytes the image does not cover
+                        if (image.OverlayRow(rowAddress, row) < row.Length)
+                        {
+                            row = TransferBlockRead(rowAddress, 0, (int)PSoC.ROW_SIZE);
+                            image.OverlayRow(rowAddress, row);
+                        }
+                    }
+                    else
+                        image.OverlayRow(rowAddress, row);
+
+                    StageRowInScratch(run.Opcode, rowAddress, row, 0);
+                    CallSromApi(run.Opcode);
+                    Progress(++rowsDone, totalRows);
+                }
+            }
+        }
+
+        /// <summary>Verifies the segments of a sparse image by reading back the covered rows.</summary>
+        /// <param name="image">Image to verify against.</param>
+        public void VerifyImage(FlashImage image)
+        {
+            var plan = PlanImage(image);
+            uint totalRows = (uint)plan.Sum(run => (run.End - run.Start) / PSoC.ROW_SIZE);
+            uint rowsDone = 0;
+
+            foreach (var run in plan)
+            {
+                for (uint rowAddress = run.Start; rowAddress < run.End; rowAddress += PSoC.ROW_SIZE)
+                {
+                    byte[] chipData = TransferBlockRead(rowAddress, 0, (int)PSoC.ROW_SIZE);
+                    byte[] expected = (byte[])chipData.Clone();
+                    image.OverlayRow(rowAddress, expected);
+
+                    for (int i = 0; i < chipData.Length; i++)
+                    {
+                        if (chipData[i] != expected[i])
+                            throw new InvalidOperationException($"Image verification failed at address 0x{rowAddress + (uint)i:X8}");
+                    }
+                    Progress(++rowsDone, totalRows);
+                }
+            }
+        }
+    }
+}
\ No newline at end of file
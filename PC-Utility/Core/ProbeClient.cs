@@ -0,0 +1,196 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Probe Server Client
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Connects to a probe server and uses its shared probe: memory read/write,
+//   mailbox commands, subscriptions and the server log
+// - Calls are synchronous and may be made from several threads
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Collections.Concurrent;
+using System.Net.Sockets;
+using System.Text;
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Client of a ProbeServer.</summary>
+    public class ProbeClient : IDisposable
+    {
+        private readonly Socket socket;
+        private readonly StreamWriter writer;
+        private readonly ConcurrentDictionary<int, TaskCompletionSource<ProbeMessage>> pending = new();
+        private int nextId;
+
+        public int TimeoutMs { get; set; } = 10000;                             // Includes the time queued behind other clients.
+        public IMailbox Mailbox { get; }                                        // Firmware mailbox of the shared target.
+        public event Action<int, byte[]>? DataReceived;                         // Subscription id and data of a subscription read.
+        public event Action<int, string>? DataFailed;                           // Subscription id and error of a failed subscription read.
+        public event Action<string>? LogReceived;                               // Server log lines, after EnableLog.
+
+        /// <summary>Connects to a probe server.</summary>
+        /// <param name="socketPath">Socket file, null for the default path.</param>
+        /// <exception cref="IOException">Thrown when no server listens on the socket.</exception>
+        public ProbeClient(string? socketPath = null)
+        {
+            socketPath ??= ProbeServer.DefaultSocketPath;
+            socket = new Socket(AddressFamily.Unix, SocketType.Stream, ProtocolType.Unspecified);
+            try
+            {
+                socket.Connect(new UnixDomainSocketEndPoint(socketPath));
+            }
+            catch (SocketException ex)
+            {
+                socket.Dispose();
+                throw new IOException($"No probe server on {socketPath}: {ex.Message}", ex);
+            }
+            var stream = new NetworkStream(socket, true);
+            writer = new StreamWriter(stream, new UTF8Encoding(false)) { AutoFlush = true, NewLine = "\n" };
+            Mailbox = new RemoteMailbox(this);
+            new Thread(() => ReceiveLoop(new StreamReader(stream, Encoding.UTF8))) { IsBackground = true, Name = "ProbeClient receive" }.Start();
+        }
+
+        public bool IsConnected => socket.Connected;
+
+        /// <summary>Reads target memory, any address and length.</summary>
+        public byte[] ReadMemory(uint address, int length) =>
+            Convert.FromHexString(Request(new ProbeMessage { Op = "read", Address = address, Length = length }).Data ?? string.Empty);
+
+        /// <summary>Writes target memory, any address and length.</summary>
+        public void WriteMemory(uint address, byte[] data) =>
+            Request(new ProbeMessage { Op = "write", Address = address, Data = Convert.ToHexString(data) });
+
+        /// <summary>Has the server read a memory range periodically, the data arrives through DataReceived.</summary>
+        /// <returns>Subscription id.</returns>
+        public int Subscribe(uint address, int length, int intervalMs) =>
+            Request(new ProbeMessage { Op = "subscribe", Address = address, Length = length, Interval = intervalMs }).Subscription ?? 0;
+
+        public void Unsubscribe(int id) => Request(new ProbeMessage { Op = "unsubscribe", Subscription = id });
+
+        /// <summary>Starts streaming the server log to LogReceived.</summary>
+        public void EnableLog() => Request(new ProbeMessage { Op = "log" });
+
+        public ProbeServerStatistics Statistics() =>
+            Request(new ProbeMessage { Op = "stats" }).Stats ?? new ProbeServerStatistics();
+
+        /// <summary>Sends a request and waits for its response.</summary>
+        /// <exception cref="InvalidOperationException">Thrown with the server error when the request failed.</exception>
+        /// <exception cref="TimeoutException">Thrown when the server did not respond within TimeoutMs.</exception>
+        internal ProbeMessage Request(ProbeMessage message)
+        {
+            message.Id = Interlocked.Increment(ref nextId);
+            var response = new TaskCompletionSource<ProbeMessage>(TaskCreationOptions.RunContinuationsAsynchronously);
+            pending[message.Id] = response;
+            try
+            {
+                lock (writer) writer.WriteLine(message.ToJson());
+                if (!response.Task.Wait(TimeoutMs))
+                    throw new TimeoutException($"No response from the probe server on '{message.Op}'.");
+                var result = response.Task.Result;
+                if (result.Ok != true)
+                    throw new InvalidOperationException(result.Error ?? "Probe server request failed.");
+                return result;
+            }
+            finally
+            {
+                pending.TryRemove(message.Id, out _);
+            }
+        }
+
+        private void ReceiveLoop(StreamReader reader)
+        {
+            try
+            {
+                string? line;
+                while ((line = reader.ReadLine()) != null)
+                {
+                    var message = ProbeMessage.FromJson(line);
+                    switch (message.Event)
+                    {
+                        case "data" when message.Error != null:
+                            DataFailed?.Invoke(message.Subscription ?? 0, message.Error);
+                            break;
+                        case "data":
+                            DataReceived?.Invoke(message.Subscription ?? 0, Convert.FromHexString(message.Data ?? string.Empty));
+                            break;
+                        case "log":
+                            LogReceived?.Invoke(message.Text ?? string.Empty);
+                            break;
+                        case null:
+                            if (pending.TryGetValue(message.Id, out var response))
+                                response.TrySetResult(message);
+                            break;
+                    }
+                }
+            }
+            catch (Exception) { }                                               // Connection closed.
+            foreach (var response in pending.Values)
+                response.TrySetException(new IOException("Probe server connection closed."));
+        }
+
+        public void Dispose()
+        {
+            socket.Dispose();
+        }
+
+        /// <summary>Mailbox commands executed by the server, each one atomic between clients.</summary>
+        private sealed class RemoteMailbox : IMailbox
+        {
+            private readonly ProbeClient client;
+
+            public RemoteMailbox(ProbeClient client)
+            {
+                this.client = client;
+            }
+
+            public void WriteData(byte[] data, Command_e Command)
+            {
+                if (data.Length > MailboxClient.MAILBOX_DATA_SIZE)
+                    throw new ArgumentException($"Mailbox data too long: {data.Length} bytes.");
+                client.Request(new ProbeMessage { Op = "mailbox", Command = (byte)Command, Read = false, Data = Convert.ToHexString(data) });
+            }
+
+            public void WriteInt32(UInt32 data, Command_e Command) => WriteData(BitConverter.GetBytes(data), Command);
+
+            public byte[] ReadData(Command_e Command, int length) =>
+                Convert.FromHexString(client.Request(new ProbeMessage { Op = "mailbox", Command = (byte)Command, Read = true, Length = length }).Data ?? string.Empty);
+
+            public UInt32 ReadInt32(Command_e Command) => BitConverter.ToUInt32(ReadData(Command, 4));
+
+            public CommitInfo_t Commit(byte[]? config = null)
+            {
+                var response = client.Request(new ProbeMessage { Op = "commit", Data = config != null ? Convert.ToHexString(config) : null });
+                var stored = new CommitInfo_t();
+                DataToStruct(Convert.FromHexString(response.Data ?? string.Empty), ref stored);
+                return stored;
+            }
+
+            public T Read<T>(Command_e Command) where T : struct
+            {
+                var result = new T();
+                DataToStruct(ReadData(Command, GetStructSize<T>()), ref result);
+                return result;
+            }
+
+            public void Write<T>(T structure, Command_e Command) where T : struct
+            {
+                WriteData(StructToData(structure), Command);
+            }
+        }
+    }
+}
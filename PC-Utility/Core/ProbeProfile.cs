@@ -0,0 +1,135 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Probe Profiles
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Remembers per probe serial number and target family:
+//   - the SWD clock: the highest reliable clock found by
+//     Psoc6Programmer.TuneClock, lowered again when the adaptive clock steps down
+//   - the APs with CPU access found by an AP scan, for the silicon ID last
+//     read through the probe, so AP_AUTO attaches without scanning
+// - One JSON file in the local application data, shared by the GUI and the CLI
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Text.Json;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Settings learned for one probe and target family.</summary>
+    public class ProbeProfile
+    {
+        public string ProbeSerial { get; set; } = string.Empty;
+        public string Target { get; set; } = string.Empty;                      // PSoC6Family name.
+        public uint ClockHz { get; set; }                                       // Clock to use, 0 if unknown.
+        public uint TunedClockHz { get; set; }                                  // Result of the last TuneClock, 0 if never tuned.
+        public ushort SiliconId { get; set; }                                   // Silicon ID the APs were found on, 0 if not read yet.
+        public int[]? AccessPorts { get; set; }                                 // APs with CPU access, first one used by AP_AUTO.
+        public DateTime Updated { get; set; }
+    }
+
+    /// <summary>Persistent store of probe profiles, safe to use from several threads.</summary>
+    public class ProbeProfileStore
+    {
+        private static readonly JsonSerializerOptions JsonOptions = new() { WriteIndented = true };
+        private readonly object sync = new();
+        private readonly List<ProbeProfile> profiles;
+
+        private static string Folder =>
+            Path.Combine(Environment.GetFolderPath(Environment.SpecialFolder.LocalApplicationData, Environment.SpecialFolderOption.Create), "CmsisDap-Communicator");
+
+        public static string DefaultPath => Path.Combine(Folder, "probe-profiles.json");
+
+        // Store of the versions that kept only the clock, the same format without the APs
+        private static string LegacyPath => Path.Combine(Folder, "clock-profiles.json");
+
+        public string FilePath { get; }
+
+        /// <summary>Opens a store, an unreadable file starts empty and is replaced on the next update.</summary>
+        /// <param name="path">JSON file, null for the default path; that one takes over clock-profiles.json of older versions.</param>
+        public ProbeProfileStore(string? path = null)
+        {
+            FilePath = path ?? DefaultPath;
+            try
+            {
+                if (path == null && !File.Exists(FilePath) && File.Exists(LegacyPath))
+                    File.Move(LegacyPath, FilePath);
+                profiles = File.Exists(FilePath)
+                    ? JsonSerializer.Deserialize<List<ProbeProfile>>(File.ReadAllText(FilePath), JsonOptions) ?? new()
+                    : new();
+            }
+            catch (Exception ex) when (ex is IOException or JsonException or UnauthorizedAccessException)
+            {
+                profiles = new();
+            }
+        }
+
+        /// <summary>Returns the profile of a probe and target, null if there is none.</summary>
+        public ProbeProfile? Find(string probeSerial, PSoC6Family family)
+        {
+            lock (sync)
+                return profiles.FirstOrDefault(p => p.ProbeSerial == probeSerial && p.Target == family.Name);
+        }
+
+        /// <summary>Returns the stored clock of a probe and target, or defaultHz if there is none.</summary>
+        public uint ClockFor(string probeSerial, PSoC6Family family, uint defaultHz) =>
+            Find(probeSerial, family)?.ClockHz is > 0 and uint clockHz ? clockHz : defaultHz;
+
+        /// <summary>Stores the clock of a probe and target.</summary>
+        /// <param name="tuned">True if clockHz is the result of TuneClock.</param>
+        public void UpdateClock(string probeSerial, PSoC6Family family, uint clockHz, bool tuned = false) =>
+            Update(probeSerial, family, profile =>
+            {
+                profile.ClockHz = clockHz;
+                if (tuned) profile.TunedClockHz = clockHz;
+            });
+
+        /// <summary>Stores the APs found by a scan.</summary>
+        public void UpdateAccessPorts(string probeSerial, PSoC6Family family, byte[] accessPorts) =>
+            Update(probeSerial, family, profile => profile.AccessPorts = accessPorts.Select(ap => (int)ap).ToArray());
+
+        /// <summary>Stores the silicon ID read through a probe, a different silicon drops the stored APs.</summary>
+        public void UpdateSiliconId(string probeSerial, PSoC6Family family, ushort siliconId)
+        {
+            if (Find(probeSerial, family)?.SiliconId == siliconId)
+                return;
+            Update(probeSerial, family, profile =>
+            {
+                if (profile.SiliconId != 0) profile.AccessPorts = null;
+                profile.SiliconId = siliconId;
+            });
+        }
+
+        /// <summary>Changes the profile of a probe and target, created when missing, and saves the file.</summary>
+        private void Update(string probeSerial, PSoC6Family family, Action<ProbeProfile> change)
+        {
+            lock (sync)
+            {
+                var profile = profiles.FirstOrDefault(p => p.ProbeSerial == probeSerial && p.Target == family.Name);
+                if (profile == null)
+                    profiles.Add(profile = new ProbeProfile { ProbeSerial = probeSerial, Target = family.Name });
+                change(profile);
+                profile.Updated = DateTime.Now;
+
+                // Replace the file in one step, the GUI and a CLI may read it at the same time
+                Directory.CreateDirectory(Path.GetDirectoryName(Path.GetFullPath(FilePath))!);
+                string temp = FilePath + ".tmp";
+                File.WriteAllText(temp, JsonSerializer.Serialize(profiles, JsonOptions));
+                File.Move(temp, FilePath, true);
+            }
+        }
+    }
+}
@@ -0,0 +1,583 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Probe Server
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Owns one probe and shares it between local clients over a Unix domain
+//   socket (Linux, macOS and Windows 10 1803+), one JSON message per line
+// - Serves memory read/write, mailbox commands, periodic memory reads
+//   (subscriptions) and the server log
+// - One worker thread talks to the probe. Every round it takes the oldest
+//   request of each client in turn, so a busy client cannot starve the others
+// - Reads of the same round that overlap or lie close together are merged
+//   into one TransferBlockRead. Subscriptions with the same interval are due
+//   at the same moments, so identical ranges are read once for all clients
+// - Each client has a bounded outbox written by its own task, a client that
+//   stops reading is disconnected when it fills instead of blocking the worker
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Diagnostics;
+using System.Net.Sockets;
+using System.Text;
+using System.Text.Json;
+using System.Text.Json.Serialization;
+using System.Threading.Channels;
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Request, response or event exchanged with a probe server.</summary>
+    /// <remarks>
+    /// Requests (Op): read {Address, Length}, write {Address, Data}, mailbox {Command, Read, Length | Data},
+    /// commit {Data}, subscribe {Address, Length, Interval}, unsubscribe {Subscription}, log, stats.
+    /// Responses repeat the request Id with Ok and Data, Subscription, Error or Stats.
+    /// Events: data {Subscription, Address, Data | Error} and log {Text}.
+    /// </remarks>
+    public class ProbeMessage
+    {
+        public int Id { get; set; }
+        public string? Op { get; set; }
+        public string? Event { get; set; }
+        public bool? Ok { get; set; }
+        public string? Error { get; set; }
+        public uint? Address { get; set; }
+        public int? Length { get; set; }
+        public string? Data { get; set; }                                       // Hex encoded bytes.
+        public byte? Command { get; set; }                                      // Mailbox Command_e.
+        public bool? Read { get; set; }                                         // Mailbox read (true) or write.
+        public int? Interval { get; set; }                                      // Subscription interval (ms).
+        public int? Subscription { get; set; }                                  // Subscription id.
+        public string? Text { get; set; }
+        public ProbeServerStatistics? Stats { get; set; }
+
+        internal static readonly JsonSerializerOptions JsonOptions = new()
+        {
+            PropertyNamingPolicy = JsonNamingPolicy.CamelCase,
+            DefaultIgnoreCondition = JsonIgnoreCondition.WhenWritingNull,
+        };
+
+        public string ToJson() => JsonSerializer.Serialize(this, JsonOptions);
+
+        public static ProbeMessage FromJson(string line) =>
+            JsonSerializer.Deserialize<ProbeMessage>(line, JsonOptions) ?? throw new InvalidDataException("Empty message.");
+    }
+
+    /// <summary>Request counters of a probe server.</summary>
+    public class ProbeServerStatistics
+    {
+        public int Clients { get; set; }
+        public int Subscriptions { get; set; }
+        public long Requests { get; set; }                                      // Requests handled by the worker.
+        public long Reads { get; set; }                                         // Memory reads, including subscription polls.
+        public long ReadTransactions { get; set; }                              // TransferBlockRead calls that served them.
+    }
+
+    /// <summary>Shares one probe between local clients.</summary>
+    public class ProbeServer : IDisposable
+    {
+        public const int MAX_READ_SIZE = 0x10000;                               // Largest single read or write.
+        public const int OUTBOX_SIZE = 256;                                     // Messages waiting for a client before it is dropped.
+
+        public Psoc6Programmer Programmer { get; }
+        public string SocketPath { get; }
+        public int MergeGap { get; set; } = 64;                                 // Reads closer than this are merged (bytes).
+        public int MaxMergeSize { get; set; } = 4096;                           // Largest merged read (bytes).
+        public event Action<string>? Log;                                       // Server log lines.
+
+        private readonly List<Connection> connections = new();
+        private readonly List<Subscription> subscriptions = new();
+        private readonly AutoResetEvent wakeUp = new(false);
+        private readonly Stopwatch clock = Stopwatch.StartNew();
+        private readonly CancellationTokenSource stop = new();
+        private Socket? listener;
+        private Thread? worker, poller;
+        private MailboxClient? mailbox;
+        private int nextConnectionId, nextSubscriptionId, nextClient;
+        private long requests, reads, readTransactions;
+
+        /// <summary>Constructs a server on an opened programmer.</summary>
+        /// <param name="Programmer">Programmer of the shared probe, only used from the worker thread.</param>
+        /// <param name="SocketPath">Socket file, null for the default path.</param>
+        public ProbeServer(Psoc6Programmer Programmer, string? SocketPath = null)
+        {
+            this.Programmer = Programmer;
+            this.SocketPath = SocketPath ?? DefaultSocketPath;
+        }
+
+        /// <summary>Socket file used when no path is given.</summary>
+        public static string DefaultSocketPath => Path.Combine(Path.GetTempPath(), "cmsisdap-probe.sock");
+
+        /// <summary>Binds the socket and starts serving.</summary>
+        /// <exception cref="IOException">Thrown when another server already listens on the socket.</exception>
+        public void Start()
+        {
+            if (File.Exists(SocketPath))
+            {
+                // A socket file left behind by a server that died can be reused
+                using var probe = new Socket(AddressFamily.Unix, SocketType.Stream, ProtocolType.Unspecified);
+                try
+                {
+                    probe.Connect(new UnixDomainSocketEndPoint(SocketPath));
+                    throw new IOException($"A probe server is already running on {SocketPath}.");
+                }
+                catch (SocketException)
+                {
+                    File.Delete(SocketPath);
+                }
+            }
+            listener = new Socket(AddressFamily.Unix, SocketType.Stream, ProtocolType.Unspecified);
+            listener.Bind(new UnixDomainSocketEndPoint(SocketPath));
+            listener.Listen(8);
+
+            worker = new Thread(WorkerLoop) { IsBackground = true, Name = "ProbeServer worker" };
+            poller = new Thread(PollLoop) { IsBackground = true, Name = "ProbeServer poller" };
+            worker.Start();
+            poller.Start();
+            _ = AcceptLoop();
+            WriteLog($"Serving on {SocketPath}");
+        }
+
+        public ProbeServerStatistics Statistics()
+        {
+            lock (connections)
+                return new ProbeServerStatistics
+                {
+                    Clients = connections.Count,
+                    Subscriptions = subscriptions.Count,
+                    Requests = Interlocked.Read(ref requests),
+                    Reads = Interlocked.Read(ref reads),
+                    ReadTransactions = Interlocked.Read(ref readTransactions),
+                };
+        }
+
+        #region Connections
+
+        private sealed class Connection
+        {
+            public int Id;
+            public Socket Socket = null!;
+            public StreamWriter Writer = null!;
+            public readonly Channel<string> Outbox = Channel.CreateBounded<string>(
+                new BoundedChannelOptions(OUTBOX_SIZE) { SingleReader = true });
+            public readonly Queue<Request> Queue = new();                       // Pending requests, guarded by the connections lock.
+            public bool LogEnabled;
+            public volatile bool Closed;                                        // Disconnected, messages are dropped.
+        }
+
+        private sealed class Subscription
+        {
+            public int Id;
+            public Connection Owner = null!;
+            public uint Address;
+            public int Length;
+            public long IntervalTicks;
+            public long NextDue;
+            public volatile bool Pending;                                       // A poll is queued, skip until it is served.
+        }
+
+        private sealed record Request(Connection Client, ProbeMessage Message, Subscription? Subscription = null);
+
+        private async Task AcceptLoop()
+        {
+            while (!stop.IsCancellationRequested)
+            {
+                Socket socket;
+                try
+                {
+                    socket = await listener!.AcceptAsync(stop.Token);
+                }
+                catch (Exception) when (stop.IsCancellationRequested)
+                {
+                    return;
+                }
+                var stream = new NetworkStream(socket, true);
+                var connection = new Connection
+                {
+                    Id = Interlocked.Increment(ref nextConnectionId),
+                    Socket = socket,
+                    Writer = new StreamWriter(stream, new UTF8Encoding(false)) { AutoFlush = true, NewLine = "\n" },
+                };
+                lock (connections) connections.Add(connection);
+                WriteLog($"Client {connection.Id} connected");
+                _ = SendLoop(connection);
+                _ = ReceiveLoop(connection, new StreamReader(stream, Encoding.UTF8));
+            }
+        }
+
+        private async Task ReceiveLoop(Connection connection, StreamReader reader)
+        {
+            try
+            {
+                string? line;
+                while ((line = await reader.ReadLineAsync(stop.Token)) != null)
+                {
+                    if (line.Length == 0) continue;
+                    ProbeMessage message;
+                    try
+                    {
+                        message = ProbeMessage.FromJson(line);
+                    }
+                    catch (JsonException ex)
+                    {
+                        Send(connection, new ProbeMessage { Ok = false, Error = $"Invalid message: {ex.Message}" });
+                        continue;
+                    }
+                    Dispatch(connection, message);
+                }
+            }
+            catch (Exception) { }                                               // Connection reset or server stopped.
+            Disconnect(connection);
+        }
+
+        /// <summary>Writes the outbox of a client, a slow client only holds up its own messages.</summary>
+        private async Task SendLoop(Connection connection)
+        {
+            try
+            {
+                await foreach (string line in connection.Outbox.Reader.ReadAllAsync(stop.Token))
+                    await connection.Writer.WriteLineAsync(line.AsMemory(), stop.Token);
+            }
+            catch (Exception) { }                                               // Connection reset or server stopped.
+            Disconnect(connection);
+        }
+
+        /// <summary>Handles requests that do not need the probe, queues the others for the worker.</summary>
+        private void Dispatch(Connection connection, ProbeMessage message)
+        {
+            switch (message.Op)
+            {
+                case "read" or "write" or "mailbox" or "commit":
+                    lock (connections) connection.Queue.Enqueue(new Request(connection, message));
+                    wakeUp.Set();
+                    break;
+                case "subscribe":
+                    if (message.Address is not uint address || message.Length is not int length || length <= 0 || length > MAX_READ_SIZE)
+                    {
+                        Reply(connection, message, error: "subscribe needs an address and a length.");
+                        break;
+                    }
+                    long interval = Math.Max(10, message.Interval ?? 1000) * Stopwatch.Frequency / 1000;
+                    var subscription = new Subscription
+                    {
+                        Id = Interlocked.Increment(ref nextSubscriptionId),
+                        Owner = connection,
+                        Address = address,
+                        Length = length,
+                        IntervalTicks = interval,
+                        // Due on whole multiples of the interval, so subscriptions with the same interval poll together
+                        NextDue = (clock.ElapsedTicks / interval + 1) * interval,
+                    };
+                    lock (connections) subscriptions.Add(subscription);
+                    Reply(connection, message, new ProbeMessage { Subscription = subscription.Id });
+                    break;
+                case "unsubscribe":
+                    lock (connections) subscriptions.RemoveAll(s => s.Owner == connection && s.Id == message.Subscription);
+                    Reply(connection, message);
+                    break;
+                case "log":
+                    connection.LogEnabled = true;
+                    Reply(connection, message);
+                    break;
+                case "stats":
+                    Reply(connection, message, new ProbeMessage { Stats = Statistics() });
+                    break;
+                default:
+                    Reply(connection, message, error: $"Unknown op '{message.Op}'.");
+                    break;
+            }
+        }
+
+        private void Disconnect(Connection connection)
+        {
+            lock (connections)
+            {
+                if (!connections.Remove(connection)) return;
+                connection.Closed = true;
+                subscriptions.RemoveAll(s => s.Owner == connection);
+                connection.Queue.Clear();
+            }
+            connection.Outbox.Writer.TryComplete();
+            connection.Socket.Dispose();
+            WriteLog($"Client {connection.Id} disconnected");
+        }
+
+        private void Reply(Connection connection, ProbeMessage request, ProbeMessage? response = null, string? error = null)
+        {
+            response ??= new ProbeMessage();
+            response.Id = request.Id;
+            response.Ok = error == null;
+            response.Error = error;
+            Send(connection, response);
+        }
+
+        /// <summary>Queues a message for a client without waiting, a client whose outbox is full is disconnected.</summary>
+        private void Send(Connection connection, ProbeMessage message)
+        {
+            if (connection.Outbox.Writer.TryWrite(message.ToJson()) || connection.Closed)
+                return;
+            Disconnect(connection);
+            WriteLog($"Client {connection.Id} dropped, it left {OUTBOX_SIZE} messages unread");
+        }
+
+        private void WriteLog(string text)
+        {
+            Log?.Invoke(text);
+            List<Connection> listeners;
+            lock (connections) listeners = connections.Where(c => c.LogEnabled).ToList();
+            foreach (var connection in listeners)
+                Send(connection, new ProbeMessage { Event = "log", Text = text });
+        }
+
+        #endregion
+
+        #region Worker
+
+        /// <summary>Queues the subscription reads that are due.</summary>
+        private void PollLoop()
+        {
+            while (!stop.Token.WaitHandle.WaitOne(5))
+            {
+                long now = clock.ElapsedTicks;
+                bool queued = false;
+                lock (connections)
+                {
+                    foreach (var subscription in subscriptions)
+                    {
+                        if (now < subscription.NextDue) continue;
+                        // Skip missed intervals rather than catching up with a burst
+                        subscription.NextDue += ((now - subscription.NextDue) / subscription.IntervalTicks + 1) * subscription.IntervalTicks;
+                        if (subscription.Pending) continue;
+                        subscription.Pending = true;
+                        var read = new ProbeMessage { Op = "read", Address = subscription.Address, Length = subscription.Length };
+                        subscription.Owner.Queue.Enqueue(new Request(subscription.Owner, read, subscription));
+                        queued = true;
+                    }
+                }
+                if (queued) wakeUp.Set();
+            }
+        }
+
+        private void WorkerLoop()
+        {
+            while (!stop.IsCancellationRequested)
+            {
+                var round = TakeRound();
+                if (round.Count == 0)
+                {
+                    wakeUp.WaitOne(100);
+                    continue;
+                }
+                ExecuteRound(round);
+            }
+        }
+
+        /// <summary>Takes the oldest request of every client, starting one client further each round.</summary>
+        private List<Request> TakeRound()
+        {
+            var round = new List<Request>();
+            lock (connections)
+            {
+                int count = connections.Count;
+                for (int i = 0; i < count; i++)
+                {
+                    var connection = connections[(nextClient + i) % count];
+                    if (connection.Queue.Count > 0)
+                        round.Add(connection.Queue.Dequeue());
+                }
+                nextClient = count > 0 ? (nextClient + 1) % count : 0;
+            }
+            return round;
+        }
+
+        private void ExecuteRound(List<Request> round)
+        {
+            Interlocked.Add(ref requests, round.Count);
+            try
+            {
+                // Attached once for all clients, and again after a failure
+                mailbox ??= new MailboxClient(Programmer).Attach();
+            }
+            catch (Exception ex)
+            {
+                foreach (var request in round)
+                    Fail(request, $"Attach failed: {ex.Message}");
+                return;
+            }
+
+            var readRequests = new List<Request>();
+            foreach (var request in round)
+            {
+                if (request.Message.Op != "read") continue;
+                if (request.Message.Address is uint address && request.Message.Length is int length
+                    && length > 0 && length <= MAX_READ_SIZE && (ulong)address + (ulong)length <= 0x100000000UL)
+                    readRequests.Add(request);
+                else
+                    Fail(request, "read needs an address and a length.");
+            }
+            foreach (var group in MergeReads(readRequests))
+                ExecuteReads(group);
+
+            foreach (var request in round.Where(r => r.Message.Op != "read"))
+            {
+                try
+                {
+                    Reply(request.Client, request.Message, Execute(request.Message));
+                }
+                catch (Exception ex)
+                {
+                    Fail(request, ex.Message);
+                    if (ex is not ArgumentException) mailbox = null;
+                }
+            }
+        }
+
+        /// <summary>Groups reads, sorted by address, whose ranges overlap or are less than MergeGap apart.</summary>
+        private IEnumerable<List<Request>> MergeReads(List<Request> readRequests)
+        {
+            var group = new List<Request>();
+            ulong start = 0, end = 0;
+            foreach (var request in readRequests.OrderBy(r => r.Message.Address))
+            {
+                ulong address = request.Message.Address!.Value;
+                ulong requestEnd = address + (ulong)request.Message.Length!.Value;
+                if (group.Count > 0 && address <= end + (ulong)MergeGap && Math.Max(end, requestEnd) - start <= (ulong)MaxMergeSize)
+                {
+                    end = Math.Max(end, requestEnd);
+                    group.Add(request);
+                    continue;
+                }
+                if (group.Count > 0) yield return group;
+                group = new List<Request> { request };
+                start = address;
+                end = requestEnd;
+            }
+            if (group.Count > 0) yield return group;
+        }
+
+        /// <summary>Serves a group of reads with one word aligned block read.</summary>
+        private void ExecuteReads(List<Request> group)
+        {
+            uint start = group.Min(r => r.Message.Address!.Value) & ~3u;
+            ulong end = group.Max(r => (ulong)r.Message.Address!.Value + (ulong)r.Message.Length!.Value);
+            int length = (int)(((end + 3) & ~3UL) - start);
+            byte[] data;
+            try
+            {
+                data = Programmer.TransferBlockRead(start, 0, length);
+                Interlocked.Increment(ref readTransactions);
+                Interlocked.Add(ref reads, group.Count);
+            }
+            catch (Exception ex)
+            {
+                mailbox = null;
+                foreach (var request in group)
+                    Fail(request, ex.Message);
+                return;
+            }
+
+            foreach (var request in group)
+            {
+                int offset = (int)(request.Message.Address!.Value - start);
+                string hex = Convert.ToHexString(data, offset, request.Message.Length!.Value);
+                if (request.Subscription is Subscription subscription)
+                {
+                    subscription.Pending = false;
+                    Send(request.Client, new ProbeMessage { Event = "data", Subscription = subscription.Id, Address = subscription.Address, Data = hex });
+                }
+                else
+                    Reply(request.Client, request.Message, new ProbeMessage { Data = hex });
+            }
+        }
+
+        private void Fail(Request request, string error)
+        {
+            if (request.Subscription is Subscription subscription)
+            {
+                subscription.Pending = false;
+                Send(request.Client, new ProbeMessage { Event = "data", Subscription = subscription.Id, Address = subscription.Address, Error = error });
+            }
+            else
+                Reply(request.Client, request.Message, error: error);
+        }
+
+        /// <summary>Executes a write, mailbox or commit request.</summary>
+        private ProbeMessage Execute(ProbeMessage message)
+        {
+            byte[] data = message.Data != null ? Convert.FromHexString(message.Data) : Array.Empty<byte>();
+            switch (message.Op)
+            {
+                case "write":
+                    if (message.Address is not uint address || data.Length == 0 || data.Length > MAX_READ_SIZE)
+                        throw new ArgumentException("write needs an address and data.");
+                    WriteMemory(address, data);
+                    return new ProbeMessage();
+                case "mailbox":
+                    var command = (Command_e)(message.Command ?? throw new ArgumentException("mailbox needs a command."));
+                    if (message.Read == true)
+                    {
+                        int length = message.Length ?? 4;
+                        if (length <= 0 || length > MailboxClient.MAILBOX_DATA_SIZE)
+                            throw new ArgumentException($"Mailbox read length {length} out of range.");
+                        byte[] result = length == 4 ? BitConverter.GetBytes(mailbox!.ReadInt32(command)) : mailbox!.ReadData(command, length);
+                        return new ProbeMessage { Data = Convert.ToHexString(result) };
+                    }
+                    if (data.Length == 4)
+                        mailbox!.WriteInt32(BitConverter.ToUInt32(data), command);
+                    else
+                        mailbox!.WriteData(data, command);
+                    return new ProbeMessage();
+                case "commit":
+                    var stored = mailbox!.Commit(data.Length > 0 ? data : null);
+                    return new ProbeMessage { Data = Convert.ToHexString(StructToData(stored)) };
+                default:
+                    throw new ArgumentException($"Unknown op '{message.Op}'.");
+            }
+        }
+
+        /// <summary>Writes memory, bytes next to an unaligned start or end are read first and written back unchanged.</summary>
+        private void WriteMemory(uint address, byte[] data)
+        {
+            uint start = address & ~3u;
+            int length = (int)((((ulong)address + (ulong)data.Length + 3) & ~3UL) - start);
+            if (start == address && length == data.Length)
+            {
+                Programmer.TransferBlock(address, data, 0, data.Length);
+                return;
+            }
+            byte[] words = Programmer.TransferBlockRead(start, 0, length);
+            Buffer.BlockCopy(data, 0, words, (int)(address - start), data.Length);
+            Programmer.TransferBlock(start, words, 0, length);
+        }
+
+        #endregion
+
+        public void Dispose()
+        {
+            if (stop.IsCancellationRequested) return;
+            stop.Cancel();
+            wakeUp.Set();
+            worker?.Join(2000);
+            poller?.Join(1000);
+            listener?.Dispose();
+            List<Connection> open;
+            lock (connections) open = connections.ToList();
+            foreach (var connection in open)
+                connection.Socket.Dispose();
+            try { File.Delete(SocketPath); } catch (IOException) { }
+        }
+    }
+}
@@ -0,0 +1,668 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Simulated Probe and Target
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// References:
+// - CMSIS-DAP: https://arm-software.github.io/CMSIS_5/DAP/html/index.html
+// - ARM Debug Interface Architecture Specification ADIv5
+// - Infineon PSoC 6 Programming Specification 002-15554 Rev. *O
+//
+// Description:
+// - In-process CMSIS-DAP probe: decodes the DAP commands used by this tool
+// - Models the SW-DP, a MEM-AP with CSW / TAR auto increment and a sparse
+//   PSoC6 memory map (SRAM, application / AUX / supervisory flash)
+// - Emulates the IPC structures and the SROM API calls made by CallSromApi,
+//   and the firmware CommData mailbox
+// - Adds a configurable USB latency and SWD execution time per packet
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using System.Diagnostics;
+using System.Text;
+
+namespace CmsisDap_Communicator
+{
+    /// <summary>Simulated CMSIS-DAP probe with a PSoC6 target attached.</summary>
+    /// <remarks>Use with <c>new CmsisDap.Device(new SimulatedProbe())</c>, or open a DeviceInfo whose path starts with <see cref="PATH_PREFIX"/>.</remarks>
+    public class SimulatedProbe : IDapTransport
+    {
+        public const string PATH_PREFIX = "sim:";
+
+        private const byte ACK_OK = 0x01;
+        private const byte ACK_WAIT = 0x02;
+        private const byte ACK_FAULT = 0x04;
+        private const byte ACK_NONE = 0x07;                                     // No ACK: protocol error.
+        private const byte ACK_MISMATCH = 0x10;
+        private const int PACKET_SIZE = 64;                                     // Reported DAP_Info packet size, responses are padded to it like HID reports.
+        private const int SWD_BITS_PER_TRANSFER = 46;                           // Request, turnaround, ACK, data, parity and idle cycles.
+
+        private readonly Queue<(byte[] Response, long ReadyTicks)> _pending = new();
+        private long _lastReadyTicks;
+
+        // Debug port state
+        private uint _ctrlStat;
+        private uint _select;
+        private uint _rdBuff;
+        private uint _matchMask = 0xFFFFFFFF;
+        private ushort _matchRetry;
+        private long _delayTicks;                                               // DAP_Delay time of the command being executed.
+        private bool _stickyError;
+
+        // MEM-AP state
+        private uint _csw = 0x23000002;
+        private uint _tar;
+
+        public SimulatedPsoc6 Target { get; }
+        public string SerialNumber { get; }
+        public bool IsConnected { get; private set; } = true;
+        public int PacketCount { get; set; } = 4;                               // Reported DAP_Info packet count.
+        public TimeSpan UsbLatency { get; set; } = TimeSpan.Zero;               // Time from sending a command until its response can be read.
+        public uint SwjClockHz { get; private set; } = 1000000;                 // Set by DAP_SWJ_Clock, scales the SWD execution time.
+        public bool ModelSwdTime { get; set; } = false;                         // Add the SWD wire time of every transfer to the response time.
+        public uint MaxClockHz { get; set; } = uint.MaxValue;                   // Above this SWD clock no transfer is acknowledged, models a long cable.
+        public int WaitAccesses { get; set; }                                   // Next AP transfers answered WAIT after the probe retries, models a target in deep sleep.
+        public long PacketsWritten { get; private set; }
+
+        /// <summary>Constructs a simulated probe with a PSOC6ABLE2 target.</summary>
+        /// <param name="path">Device path, "sim:&lt;serial&gt;".</param>
+        public SimulatedProbe(string path = PATH_PREFIX + "0") : this(PSoC6Family.PSOC6ABLE2, path)
+        {
+        }
+
+        /// <summary>Constructs a simulated probe.</summary>
+        /// <param name="family">Family of the simulated target.</param>
+        /// <param name="path">Device path, "sim:&lt;serial&gt;".</param>
+        public SimulatedProbe(PSoC6Family family, string path = PATH_PREFIX + "0")
+        {
+            Target = new SimulatedPsoc6(family);
+            SerialNumber = path.StartsWith(PATH_PREFIX) ? path.Substring(PATH_PREFIX.Length) : path;
+        }
+
+        /// <summary>Returns DeviceInfo entries that open simulated probes through CmsisDap.Open.</summary>
+        /// <param name="count">Number of probes.</param>
+        public static List<CmsisDap.DeviceInfo> Enumerate(int count) =>
+            Enumerable.Range(0, count).Select(i => new CmsisDap.DeviceInfo
+            {
+                Path = PATH_PREFIX + i,
+                Product = "Simulated CMSIS-DAP",
+                Manufacturer = "Onethinx",
+            }).ToList();
+
+        public void Write(byte[] payload)
+        {
+            if (!IsConnected)
+                throw new IOException("Simulated probe disconnected.");
+            if (_pending.Count >= Math.Max(1, PacketCount))
+                throw new IOException($"Simulated probe packet buffer overflow ({PacketCount} packets).");
+
+            PacketsWritten++;
+            _delayTicks = 0;
+            byte[] response = Execute(payload, out int transfers);
+            if (response.Length < PACKET_SIZE)
+                Array.Resize(ref response, PACKET_SIZE);
+
+            // The response is ready after the USB round trip, but no earlier than the previous
+            // command plus the SWD and DAP_Delay time of this one: the probe executes queued commands in order
+            long now = Stopwatch.GetTimestamp();
+            long swdTicks = ModelSwdTime ? (long)((double)transfers * SWD_BITS_PER_TRANSFER / SwjClockHz * Stopwatch.Frequency) : 0;
+            long ready = Math.Max(now + (long)(UsbLatency.TotalSeconds * Stopwatch.Frequency), _lastReadyTicks + swdTicks + _delayTicks);
+            _lastReadyTicks = ready;
+            _pending.Enqueue((response, ready));
+        }
+
+        public byte[] Read()
+        {
+            if (_pending.Count == 0)
+                throw new IOException("Simulated probe read without outstanding command.");
+            var (response, ready) = _pending.Dequeue();
+            while (true)
+            {
+                long remaining = ready - Stopwatch.GetTimestamp();
+                if (remaining <= 0) break;
+                if (remaining > Stopwatch.Frequency / 500)
+                    Thread.Sleep(1);
+                else
+                    Thread.SpinWait(50);
+            }
+            return response;
+        }
+
+        public void Dispose()
+        {
+            IsConnected = false;
+        }
+
+        private byte[] Execute(byte[] cmd, out int transfers)
+        {
+            transfers = 0;
+            switch (cmd[0])
+            {
+                case CmsisDap.CMD_DAP_INFO:
+                    return Info(cmd[1]);
+                case CmsisDap.CMD_DAP_WRITE_ABORT:
+                    uint abort = BitConverter.ToUInt32(cmd, 2);
+                    Access(DapReg.Write.ABORT, ref abort);
+                    return new byte[] { cmd[0], 0x00 };
+                case CmsisDap.CMD_DAP_LED:
+                case CmsisDap.CMD_DAP_DISCONNECT:
+                case CmsisDap.CMD_DAP_SWJ_SEQ:
+                case CmsisDap.CMD_DAP_SWD_CONFIGURE:
+                case CmsisDap.CMD_DAP_JTAG_SEQ:
+                case CmsisDap.CMD_DAP_JTAG_CONFIGURE:
+                    return new byte[] { cmd[0], 0x00 };
+                case CmsisDap.CMD_DAP_DELAY:
+                    _delayTicks += (cmd[1] | (cmd[2] << 8)) * Stopwatch.Frequency / 1000000;
+                    return new byte[] { cmd[0], 0x00 };
+                case CmsisDap.CMD_DAP_CONNECT:
+                    return new byte[] { cmd[0], (byte)(cmd.Length > 1 && cmd[1] == (byte)CmsisDap.ConnectMode.JTAG ? 0x00 : 0x01) };
+                case CmsisDap.CMD_DAP_TFER_CONFIGURE:
+                    _matchRetry = (ushort)(cmd[4] | (cmd[5] << 8));
+                    return new byte[] { cmd[0], 0x00 };
+                case CmsisDap.CMD_DAP_RESET_TARGET:
+                    Target.Reset();
+                    return new byte[] { cmd[0], 0x00, 0x01 };
+                case CmsisDap.CMD_DAP_SWJ_CLOCK:
+                    SwjClockHz = Math.Max(1u, BitConverter.ToUInt32(cmd, 1));
+                    return new byte[] { cmd[0], 0x00 };
+                case CmsisDap.CMD_DAP_SWJ_PINS:
+                    // nRESET driven low resets the target
+                    if ((cmd[2] & CmsisDap.Pins.nRESET) != 0 && (cmd[1] & CmsisDap.Pins.nRESET) == 0)
+                        Target.Reset();
+                    return new byte[] { cmd[0], (byte)(cmd[1] | (~cmd[2] & 0xFF)) };
+                case CmsisDap.CMD_DAP_TFER:
+                    return Transfer(cmd, out transfers);
+                case CmsisDap.CMD_DAP_TFER_BLOCK:
+                    return TransferBlock(cmd, out transfers);
+                case CmsisDap.CMD_DAP_EXECUTE_COMMANDS:
+                    return ExecuteCommands(cmd, out transfers);
+                default:
+                    return new byte[] { cmd[0], 0xFF };
+            }
+        }
+
+        private byte[] Info(byte id)
+        {
+            string? text = id switch
+            {
+                CmsisDap.INFO_ID_VENDOR_NAME => "Onethinx",
+                CmsisDap.INFO_ID_PRODUCT_NAME => "Simulated CMSIS-DAP",
+                CmsisDap.INFO_ID_SERIAL_NUMBER => SerialNumber,
+                CmsisDap.INFO_ID_PROTOCOL_VERSION => "2.1.0",
+                CmsisDap.INFO_ID_TARGETDEV_VENDOR => "Infineon",
+                CmsisDap.INFO_ID_TARGETDEV_NAME => Target.Family.Name,
+                CmsisDap.INFO_ID_PRODUCT_FW_VERSION => "1.0",
+                _ => null
+            };
+            if (text != null)
+                return new byte[] { CmsisDap.CMD_DAP_INFO, (byte)(text.Length + 1) }.Concat(Encoding.ASCII.GetBytes(text)).Append((byte)0).ToArray();
+            return id switch
+            {
+                CmsisDap.INFO_ID_CAPABILITIES => new byte[] { CmsisDap.CMD_DAP_INFO, 1, CmsisDap.INFO_CAPS_SWD },
+                CmsisDap.INFO_ID_PACKET_COUNT => new byte[] { CmsisDap.CMD_DAP_INFO, 1, (byte)PacketCount },
+                CmsisDap.INFO_ID_PACKET_SIZE => new byte[] { CmsisDap.CMD_DAP_INFO, 2, PACKET_SIZE, 0 },
+                _ => new byte[] { CmsisDap.CMD_DAP_INFO, 0 }
+            };
+        }
+
+        /// <summary>DAP_ExecuteCommands: [cmd, count, command*] -> [cmd, count, response*].</summary>
+        private byte[] ExecuteCommands(byte[] cmd, out int transfers)
+        {
+            var response = new List<byte> { cmd[0], cmd[1] };
+            transfers = 0;
+            int pos = 2;
+            for (int i = 0; i < cmd[1]; i++)
+            {
+                int length = CmsisDap.RequestLength(cmd, pos);
+                response.AddRange(Execute(cmd.AsSpan(pos, length).ToArray(), out int executed));
+                transfers += executed;
+                pos += length;
+            }
+            return response.ToArray();
+        }
+
+        /// <summary>DAP_Transfer: [cmd, index, count, (req, data?)*] -> [cmd, executed, ack, read data*].</summary>
+        private byte[] Transfer(byte[] cmd, out int transfers)
+        {
+            var response = new List<byte> { cmd[0], 0, 0 };
+            int count = cmd[2];
+            int pos = 3;
+            byte ack = ACK_OK;
+            transfers = 0;
+            for (int i = 0; i < count; i++)
+            {
+                byte req = cmd[pos++];
+                uint data = 0;
+                if (CmsisDap.Device.RequiresTransferData(req))
+                {
+                    data = BitConverter.ToUInt32(cmd, pos);
+                    pos += 4;
+                }
+                transfers++;
+
+                if ((req & DapReg.MASK) != 0)
+                {
+                    _matchMask = data;
+                }
+                else if ((req & DapReg.MATCH) != 0)
+                {
+                    // Read until (value & mask) == match, up to match_retry extra reads
+                    uint value = 0;
+                    for (int retry = 0; retry <= _matchRetry; retry++)
+                    {
+                        ack = Access(req, ref value);
+                        if (ack != ACK_OK || (value & _matchMask) == data) break;
+                        transfers++;
+                    }
+                    if (ack == ACK_OK && (value & _matchMask) != data)
+                        ack |= ACK_MISMATCH;
+                }
+                else
+                {
+                    ack = Access(req, ref data);
+                    if (ack == ACK_OK && (req & 0x02) != 0)
+                        response.AddRange(BitConverter.GetBytes(data));
+                }
+                if (ack != ACK_OK) break;
+                response[1]++;
+            }
+            response[2] = ack;
+            return response.ToArray();
+        }
+
+        /// <summary>DAP_TransferBlock: [cmd, index, count(2), req, data*] -> [cmd, executed(2), ack, read data*].</summary>
+        private byte[] TransferBlock(byte[] cmd, out int transfers)
+        {
+            int count = cmd[2] | (cmd[3] << 8);
+            byte req = cmd[4];
+            bool read = (req & 0x02) != 0;
+            var response = new List<byte>(4 + (read ? count * 4 : 0)) { cmd[0], 0, 0, 0 };
+            byte ack = ACK_OK;
+            int executed = 0;
+            for (; executed < count; executed++)
+            {
+                uint data = read ? 0 : BitConverter.ToUInt32(cmd, 5 + executed * 4);
+                ack = Access(req, ref data);
+                if (ack != ACK_OK) break;
+                if (read) response.AddRange(BitConverter.GetBytes(data));
+            }
+            transfers = executed;
+            response[1] = (byte)executed;
+            response[2] = (byte)(executed >> 8);
+            response[3] = ack;
+            return response.ToArray();
+        }
+
+        /// <summary>Performs one DP or AP register access.</summary>
+        private byte Access(byte req, ref uint data)
+        {
+            if (SwjClockHz > MaxClockHz)
+                return ACK_NONE;
+            bool ap = (req & 0x01) != 0;
+            bool read = (req & 0x02) != 0;
+            int addr = req & 0x0C;
+
+            if (!ap)
+            {
+                switch (addr, read)
+                {
+                    case (0x0, true): data = 0x6BA02477; break;                 // IDCODE
+                    case (0x0, false):                                          // ABORT
+                        if ((data & 0x1E) != 0) _stickyError = false;
+                        break;
+                    case (0x4, true):                                           // CTRL/STAT, power-up requests acknowledged
+                        data = (_ctrlStat & 0x50000000) | ((_ctrlStat & 0x50000000) << 1) | (_stickyError ? 0x20u : 0u);
+                        break;
+                    case (0x4, false): _ctrlStat = data; break;
+                    case (0x8, false): _select = data; break;                   // SELECT
+                    case (0x8, true): data = _rdBuff; break;                    // RESEND
+                    case (0xC, true): data = _rdBuff; break;                    // RDBUFF
+                }
+                return ACK_OK;
+            }
+
+            if (_stickyError)
+                return ACK_FAULT;
+            if (WaitAccesses > 0)
+            {
+                WaitAccesses--;
+                return ACK_WAIT;
+            }
+            uint apSel = _select >> 24;
+            uint bank = (_select >> 4) & 0xF;
+            if (apSel > 2)
+            {
+                _stickyError = true;
+                return ACK_FAULT;
+            }
+
+            switch (bank << 4 | (uint)addr, read)
+            {
+                case (0x00, true): data = _csw; break;
+                case (0x00, false): _csw = data; break;
+                case (0x04, true): data = _tar; break;
+                case (0x04, false): _tar = data; break;
+                case (0x0C, true):
+                    data = Target.ReadWord(_tar);
+                    AutoIncrement();
+                    break;
+                case (0x0C, false):
+                    Target.WriteWord(_tar, data);
+                    AutoIncrement();
+                    break;
+                case (0xFC, true): data = 0x24770011; break;                    // IDR: AHB-AP
+                default:
+                    if (read) data = 0;
+                    break;
+            }
+            if (read) _rdBuff = data;
+            return ACK_OK;
+        }
+
+        /// <summary>Increments TAR after a DRW access when CSW.AddrInc is single, wrapping within the 1 KB auto increment window.</summary>
+        private void AutoIncrement()
+        {
+            if (((_csw >> 4) & 0x3) == 0x1)
+                _tar = (_tar & ~0x3FFu) | ((_tar + 4) & 0x3FFu);
+        }
+    }
+
+    /// <summary>Sparse memory model of a PSoC6 with IPC based SROM API and the CommData mailbox.</summary>
+    public class SimulatedPsoc6
+    {
+        private const int PAGE_BITS = 12;
+        private readonly Dictionary<uint, byte[]> _pages = new();
+        private readonly Dictionary<byte, byte[]> _mailboxStore = new();
+        private readonly SortedDictionary<byte, byte[]> _kvStore = new();      // Firmware key-value store, by key.
+        private byte _kvCursor;
+        private readonly PSoCclass PSoC;
+
+        private bool _ipcLocked;
+        private long _ipcReleaseTicks;
+
+        public PSoC6Family Family { get; }
+        public ushort SiliconId { get; set; } = 0xE207;
+        public byte RevisionId { get; set; } = 0x21;
+        public ProtectionState_e Protection { get; set; } = ProtectionState_e.NORMAL;
+        public TimeSpan RowWriteTime { get; set; } = TimeSpan.Zero;             // Time the IPC lock is held per programmed or erased row.
+        public bool EmulateMailbox { get; set; } = true;                        // Answer CommData mailbox commands like the firmware communicator.
+        public long SromCalls { get; private set; }
+
+        public SimulatedPsoc6(PSoC6Family family)
+        {
+            Family = family;
+            PSoC = family.Create();
+            WriteWord(0xE000ED00, 0x410FC241);                                  // CPUID: Cortex-M4 r0p1
+            WriteWord(PSoC.MEM_VTBASE_CM4, PSoC.MEM_BASE_FLASH);
+        }
+
+        /// <summary>Target reset: releases the IPC lock and clears the mailbox.</summary>
+        public void Reset()
+        {
+            _ipcLocked = false;
+            _ipcReleaseTicks = 0;
+            WriteRaw(MailboxClient.MAILBOX_ADDR, 0);
+        }
+
+        /// <summary>Copies target memory, bypassing the bus model.</summary>
+        public byte[] ReadMemory(uint addr, int length)
+        {
+            byte[] result = new byte[length];
+            for (int i = 0; i < length; i++)
+                result[i] = ReadByte(addr + (uint)i);
+            return result;
+        }
+
+        /// <summary>Fills target memory, bypassing the bus model (e.g. to preload flash).</summary>
+        public void WriteMemory(uint addr, byte[] data)
+        {
+            for (int i = 0; i < data.Length; i++)
+                WriteByte(addr + (uint)i, data[i]);
+        }
+
+        /// <summary>Bus read as seen through the MEM-AP.</summary>
+        public uint ReadWord(uint addr)
+        {
+            uint ipcAddr = PSoC.IPC_STRUCT2;
+            if (addr == ipcAddr + PSoC.IPC_STRUCT_ACQUIRE_OFFSET)
+            {
+                // The debugger is the only master on this struct: acquiring succeeds unless an SROM call still holds the lock
+                UpdateIpcLock();
+                if (_ipcReleaseTicks != 0) return 0;
+                _ipcLocked = true;
+                return PSoC.IPC_STRUCT_ACQUIRE_SUCCESS_MSK;
+            }
+            if (addr == ipcAddr + PSoC.IPC_STRUCT_LOCK_STATUS_OFFSET)
+            {
+                UpdateIpcLock();
+                return _ipcLocked ? PSoC.IPC_STRUCT_LOCK_STATUS_ACQUIRED_MSK : 0;
+            }
+            return ReadRaw(addr);
+        }
+
+        /// <summary>Bus write as seen through the MEM-AP. Flash is not writable from the bus.</summary>
+        public void WriteWord(uint addr, uint data)
+        {
+            uint ipcAddr = PSoC.IPC_STRUCT2;
+            if (addr == ipcAddr + PSoC.IPC_STRUCT_ACQUIRE_OFFSET)
+            {
+                UpdateIpcLock();
+                if (_ipcReleaseTicks == 0) _ipcLocked = true;
+                return;
+            }
+            if (addr == ipcAddr + PSoC.IPC_STRUCT_NOTIFY_OFFSET)
+            {
+                if ((data & 1) != 0) SromCall();
+                return;
+            }
+            if (IsFlash(addr)) return;
+            WriteRaw(addr, data);
+            if (addr == MailboxClient.MAILBOX_ADDR && EmulateMailbox && (data & 0xFF) != 0)
+                MailboxCommand(data);
+        }
+
+        private void UpdateIpcLock()
+        {
+            if (_ipcLocked && _ipcReleaseTicks != 0 && Stopwatch.GetTimestamp() >= _ipcReleaseTicks)
+            {
+                _ipcLocked = false;
+                _ipcReleaseTicks = 0;
+            }
+        }
+
+        private bool IsFlash(uint addr) =>
+            (addr >= PSoC.MEM_BASE_FLASH && addr - PSoC.MEM_BASE_FLASH < PSoC.MEM_SIZE_FLASH) ||
+            (addr >= PSoC.MEM_BASE_AUXFLASH && addr - PSoC.MEM_BASE_AUXFLASH < PSoC.MEM_SIZE_AUXFLASH) ||
+            (addr >= PSoC.MEM_BASE_SFLASH && addr - PSoC.MEM_BASE_SFLASH < PSoC.MEM_SIZE_SFLASH);
+
+        /// <summary>Executes the SROM API call passed through IPC struct 2, then releases the lock (after the modelled flash time).</summary>
+        private void SromCall()
+        {
+            SromCalls++;
+            uint ipcData = ReadRaw(PSoC.IPC_STRUCT2 + PSoC.IPC_STRUCT_DATA_OFFSET);
+            bool dataInRam = (ipcData & PSoC.SROMAPI_DATA_LOCATION_MSK) == 0;
+            uint opcode = dataInRam ? ReadRaw(ipcData) : ipcData;
+            int rows = 0;
+            uint result;
+
+            switch (opcode >> 24)
+            {
+                case 0x00:                                                      // SiliconID
+                    result = ((opcode >> 8) & 0xFF) == 0
+                        ? (uint)(Family.FamilyId | RevisionId << 16)
+                        : (uint)(SiliconId | (byte)Protection << 16);
+                    break;
+                case 0x05:                                                      // WriteRow
+                case 0x06:                                                      // ProgramRow
+                {
+                    uint rowAddr = ReadRaw(ipcData + 0x08) & ~(PSoC.ROW_SIZE - 1);
+                    uint dataAddr = ReadRaw(ipcData + 0x0C);
+                    bool program = (opcode >> 24) == 0x06;
+                    for (uint i = 0; i < PSoC.ROW_SIZE; i++)
+                    {
+                        // ProgramRow does not erase, bits already set stay set
+                        byte value = ReadByte(dataAddr + i);
+                        WriteByte(rowAddr + i, program ? (byte)(ReadByte(rowAddr + i) | value) : value);
+                    }
+                    rows = 1;
+                    result = 0;
+                    break;
+                }
+                case 0x1C: rows = Erase(ReadRaw(ipcData + 0x04), 1); result = 0; break;                 // EraseRow
+                case 0x1D: rows = Erase(ReadRaw(ipcData + 0x04), 8); result = 0; break;                 // EraseSubsector
+                case 0x14: rows = Erase(ReadRaw(ipcData + 0x04), 512); result = 0; break;               // EraseSector
+                case 0x0A: rows = Erase(PSoC.MEM_BASE_FLASH, (int)(PSoC.MEM_SIZE_FLASH / PSoC.ROW_SIZE)); result = 0; break; // EraseAll
+                case 0x0B:                                                      // Checksum (whole application flash)
+                {
+                    uint sum = 0;
+                    foreach (var page in _pages.Where(p => IsFlash(p.Key << PAGE_BITS) && (p.Key << PAGE_BITS) < PSoC.MEM_BASE_FLASH + PSoC.MEM_SIZE_FLASH))
+                        foreach (byte b in page.Value) sum += b;
+                    result = sum & PSoC.SROMAPI_CHECKSUM_DATA_MSK;
+                    break;
+                }
+                default:
+                    WriteRaw(dataInRam ? ipcData : PSoC.IPC_STRUCT2 + PSoC.IPC_STRUCT_DATA_OFFSET, 0xF0000003);  // Invalid opcode
+                    _ipcLocked = false;
+                    return;
+            }
+
+            WriteRaw(dataInRam ? ipcData : PSoC.IPC_STRUCT2 + PSoC.IPC_STRUCT_DATA_OFFSET, PSoC.SROMAPI_STAT_SUCCESS | result);
+            if (rows > 0 && RowWriteTime > TimeSpan.Zero)
+                _ipcReleaseTicks = Stopwatch.GetTimestamp() + (long)(RowWriteTime.TotalSeconds * rows * Stopwatch.Frequency);
+            else
+                _ipcLocked = false;
+        }
+
+        private int Erase(uint addr, int rows)
+        {
+            uint start = addr & ~(PSoC.ROW_SIZE * (uint)rows - 1);
+            uint end = start + PSoC.ROW_SIZE * (uint)rows;
+            for (uint a = start; a < end; a = (a | ((1u << PAGE_BITS) - 1)) + 1)
+            {
+                // Only the erased rows, a sparse page holds several
+                if (!_pages.TryGetValue(a >> PAGE_BITS, out var page)) continue;
+                int offset = (int)(a & ((1u << PAGE_BITS) - 1));
+                Array.Clear(page, offset, (int)Math.Min(end - a, (uint)(page.Length - offset)));
+            }
+            return rows;
+        }
+
+        /// <summary>Answers a mailbox command: writes are stored per command, reads return the stored data.</summary>
+        private void MailboxCommand(uint headerValue)
+        {
+            byte command = (byte)headerValue;
+            bool read = (headerValue & 0x100) != 0;
+            int length = (int)(headerValue >> 16);
+            if (command == (byte)DataPacket.Command_e.CMD_ADCVAL && read)
+                _mailboxStore[command] = BitConverter.GetBytes(3300);
+            if (command >= (byte)DataPacket.Command_e.CMD_KVINFO && command <= (byte)DataPacket.Command_e.CMD_KVDATA)
+                KvCommand(command, read, length);
+            else if (read)
+            {
+                byte[] stored = _mailboxStore.TryGetValue(command, out var value) ? value : Array.Empty<byte>();
+                byte[] data = new byte[length];
+                Array.Copy(stored, data, Math.Min(stored.Length, length));
+                WriteMemory(MailboxClient.MAILBOX_DATA_ADDR, data);
+            }
+            else if (command == (byte)DataPacket.Command_e.CMD_COMMIT)
+            {
+                // Store the keys (and configuration) like the firmware, answer with the digests
+                byte[] keys = new byte[DataPacket.GetStructSize<DataPacket.LoRaWAN_keys_t>()];
+                if (_mailboxStore.TryGetValue((byte)DataPacket.Command_e.CMD_KEYS, out var stored))
+                    Array.Copy(stored, keys, Math.Min(stored.Length, keys.Length));
+                byte[] config = ReadMemory(MailboxClient.MAILBOX_DATA_ADDR, length);
+                var info = new DataPacket.CommitInfo_t
+                {
+                    KeysCrc = DataPacket.Crc32(keys),
+                    ConfigCrc = length > 0 ? DataPacket.Crc32(config) : 0,
+                    KeysResult = DataPacket.flashStoreResult_e.OK,
+                    ConfigResult = length > 0 ? DataPacket.flashStoreResult_e.OK : DataPacket.flashStoreResult_e.Empty,
+                    ConfigLength = (byte)length,
+                };
+                byte[] data = DataPacket.StructToData(info);
+                WriteMemory(MailboxClient.MAILBOX_DATA_ADDR, data);
+                _mailboxStore[command] = data;
+            }
+            else
+            {
+                _mailboxStore[command] = ReadMemory(MailboxClient.MAILBOX_DATA_ADDR, length);
+            }
+            WriteRaw(MailboxClient.MAILBOX_ADDR, (uint)length << 16);          // CMD_IDLE, echo the data length
+        }
+
+        /// <summary>Answers the key-value store commands like the firmware, without its flash layout.</summary>
+        private void KvCommand(byte command, bool read, int length)
+        {
+            var data = new List<byte>();
+            if (command == (byte)DataPacket.Command_e.CMD_KVINFO && read)
+            {
+                data.AddRange(DataPacket.StructToData(new DataPacket.KvStoreInfo_t
+                {
+                    Keys = (byte)_kvStore.Count,
+                    Blocks = 8,
+                    FreeBlocks = 7,
+                    MaxValue = KvStore.MAX_VALUE,
+                    LiveBytes = (ushort)_kvStore.Values.Sum(v => 4 + v.Length),
+                    Capacity = 1050,
+                }));
+            }
+            else if (command == (byte)DataPacket.Command_e.CMD_KVCURSOR && !read)
+                _kvCursor = ReadByte(MailboxClient.MAILBOX_DATA_ADDR);
+            else if (command == (byte)DataPacket.Command_e.CMD_KVDATA && read)
+            {
+                var entries = _kvStore.Where(kv => kv.Key >= _kvCursor).ToList();
+                int count = 0;
+                for (; count < entries.Count && 2 + data.Count + 2 + entries[count].Value.Length <= length; count++)
+                    data.AddRange(new[] { entries[count].Key, (byte)entries[count].Value.Length }.Concat(entries[count].Value));
+                _kvCursor = count < entries.Count ? entries[count].Key : (byte)KvStore.KEYS;
+                data.InsertRange(0, new[] { (byte)count, _kvCursor });
+            }
+            else if (command == (byte)DataPacket.Command_e.CMD_KVDATA)
+            {
+                byte[] entries = ReadMemory(MailboxClient.MAILBOX_DATA_ADDR, length);
+                for (int offset = 0; offset + 2 <= entries.Length; offset += 2 + (entries[offset + 1] == 0xFF ? 0 : entries[offset + 1]))
+                {
+                    if (entries[offset + 1] == 0xFF) _kvStore.Remove(entries[offset]);
+                    else _kvStore[entries[offset]] = entries[(offset + 2)..(offset + 2 + entries[offset + 1])];
+                }
+            }
+            data.AddRange(new byte[Math.Max(0, length - data.Count)]);
+            if (read)
+                WriteMemory(MailboxClient.MAILBOX_DATA_ADDR, data.Take(length).ToArray());
+        }
+
+        private uint ReadRaw(uint addr) =>
+            (uint)(ReadByte(addr) | ReadByte(addr + 1) << 8 | ReadByte(addr + 2) << 16 | ReadByte(addr + 3) << 24);
+
+        private void WriteRaw(uint addr, uint data)
+        {
+            for (int i = 0; i < 4; i++)
+                WriteByte(addr + (uint)i, (byte)(data >> (i * 8)));
+        }
+
+        private byte ReadByte(uint addr) =>
+            _pages.TryGetValue(addr >> PAGE_BITS, out var page) ? page[addr & ((1u << PAGE_BITS) - 1)] : (byte)0;
+
+        private void WriteByte(uint addr, byte value)
+        {
+            if (!_pages.TryGetValue(addr >> PAGE_BITS, out var page))
+            {
+                if (value == 0) return;
+                _pages[addr >> PAGE_BITS] = page = new byte[1 << PAGE_BITS];
+            }
+            page[addr & ((1u << PAGE_BITS) - 1)] = value;
+        }
+    }
+}
@@ -47,6 +47,9 @@ namespace CmsisDap_Communicator
         CmsisDap dap = new CmsisDap();
         private DeviceInfo? _selectedDevice = null;
         private CmsisDap.Device? _programmer = null;
+        private bool _reportUsbStatistics = false;                              // Print the USB packet statistics after every operation.
+        private readonly ProbeProfileStore _probeProfiles = new();              // SWD clock (tuned on the first acquire) and APs per probe.
+        const uint DefaultSwjClock = 4000000;                                   // SWD clock of probes without a profile.
 
         const string thisName = "CMSIS-DAP Communicator 1.0 by Onethinx.com | Rolf Nooteboom";
         Color backColor = Color.FromArgb(32, 32, 32);
@@ -94,6 +97,7 @@ namespace CmsisDap_Communicator
             UIExtension.GroupBox = gbCommunicate;
             UIExtension.ProgressBar = pnlProgress;
             UIExtension.cbProgrammer = cbProgs;
+            Psoc6Programmer.DefaultProgress = UIExtension.Progress;
             btScanUSB_Click(this, new EventArgs());
             cbProgs.DrawMode = DrawMode.OwnerDrawFixed;
             cbProgs.DrawItem += (sender, e) =>
@@ -109,6 +113,23 @@ namespace CmsisDap_Communicator
             this.Text = thisName;
             lblTop.Text = thisName;
 
+            // Status window context menu: per-operation USB packet statistics
+            var miUsbStatistics = new ToolStripMenuItem("Show USB statistics") { CheckOnClick = true };
+            miUsbStatistics.CheckedChanged += (sender, e) => _reportUsbStatistics = miUsbStatistics.Checked;
+            tbStatus.ContextMenuStrip = new ContextMenuStrip();
+            tbStatus.ContextMenuStrip.Items.Add(miUsbStatistics);
+
+            // Dropping an image file on the form gang-programs it on all listed probes, a .csv key manifest provisions them
+            AllowDrop = true;
+            DragEnter += (sender, e) => e.Effect = e.Data?.GetDataPresent(DataFormats.FileDrop) == true ? DragDropEffects.Copy : DragDropEffects.None;
+            DragDrop += (sender, e) =>
+            {
+                if (e.Data?.GetData(DataFormats.FileDrop) is not string[] files || files.Length == 0) return;
+                if (Path.GetExtension(files[0]).Equals(".csv", StringComparison.OrdinalIgnoreCase))
+                    Execute("Key provisioning", () => { ProvisionKeys(files[0]); });
+                else
+                    Execute("Gang programming", () => { GangProgram(files[0]); });
+            };
         }
 
         private void btScanUSB_Click(object sender, EventArgs e)
@@ -165,11 +186,14 @@ namespace CmsisDap_Communicator
                     DateTime startAction = DateTime.Now;
                     UIExtension.ToStatus($"\r\n\r\nStart of {name.ToLower()}: {startAction:G}");
                     UIExtension.Progress(0, 100);
+                    _programmer?.Statistics.Reset();
                     action();
                     UIExtension.ToStatus($"\r\n{name} successfully.");
 
                     TimeSpan elapsed = DateTime.Now - startAction;
                     UIExtension.ToStatus($"\r\nTotal time: {elapsed.Seconds}.{elapsed.Milliseconds:D3} seconds");
+                    if (_reportUsbStatistics && _programmer != null)
+                        UIExtension.ToStatus(_programmer.Statistics.Snapshot().ToReport());
                 }
                 catch (Exception ex)
                 {
@@ -231,6 +255,9 @@ namespace CmsisDap_Communicator
             LoRaWAN_keys.keyData = StructToData(OTAA_10x_keys);
             byte[] CommData = StructToData(LoRaWAN_keys);
             WriteData(CommData, Command_e.CMD_KEYS);
+            UIExtension.ToStatus("\r\nCommitting LoRaWAN keys to flash...");
+            var commit = OpenMailbox().Commit();
+            UIExtension.ToStatus($"\r\nKeys stored, digest 0x{commit.KeysCrc:X8}");
         }
 
         void Com_ReadKeys()
@@ -345,7 +372,7 @@ namespace CmsisDap_Communicator
             var Device = OpenSelectedProg();
             UIExtension.ToStatus("\r\nConnecting target...");
 
-            Psoc6Programmer Programmer = new Psoc6Programmer(Device!, PSoC6Family.PSOC6ABLE2, SWJ_Interface.SWD, 4000000);
+            Psoc6Programmer Programmer = CreateProgrammer(Device);
             Programmer.ToggleXRES();
         }
         private void btAcquire_Click(object sender, EventArgs e)
@@ -356,69 +383,114 @@ namespace CmsisDap_Communicator
             });
         }
 
-        private void WaitResponse(Psoc6Programmer Programmer)
+        /// <summary>
+        /// Programs an image on all connected probes in parallel.
+        /// </summary>
+        void GangProgram(string path)
         {
-            Header_t header = new Header_t();
-            int timeOut = 100;
-            do
+            var probes = dap.Enumerate().Where(d => !d.IsUnverified).ToList();
+            if (probes.Count == 0)
+                throw new Exception("No CMSIS-DAP device found.");
+
+            // Release the probe held by the single-device functions, the gang opens every probe itself
+            _programmer?.Dispose();
+            _programmer = null;
+            _selectedDevice = null;
+
+            using var image = FlashImage.Load(path);
+            UIExtension.ToStatus($"\r\nImage {Path.GetFileName(path)}: {image.Segments.Count} segment(s), {image.TotalBytes} bytes");
+            UIExtension.ToStatus($"\r\nProgramming {probes.Count} unit(s)...");
+
+            var gang = new GangProgrammer { Profiles = _probeProfiles };
+            var percents = new int[probes.Count];
+            gang.UnitChanged += unit =>
             {
-                header.Value = Programmer.ReadIO(0x08038000);
-                if (header.Command == Command_e.CMD_IDLE) break;
-                Thread.Sleep(1);
-            } while (--timeOut > 0);
-            if (timeOut == 0) throw new InvalidOperationException("Read timeout: No response from target, check firmware and CPU execution state.");
-            if (header.CommandInvalid) throw new InvalidOperationException("Error, target response: Invalid Command.");
-            if (header.SizeInvalid) throw new InvalidOperationException("Error, target response: Invalid Data Length.");
-            if (header.Reset) throw new InvalidOperationException("Error, target response: Received Reset.");
+                if (unit.State != GangState.Running || unit.Step != null)
+                    UIExtension.ToStatus($"\r\n{unit}", unit.State == GangState.Failed ? Color.Red : this.ForeColor);
+            };
+            gang.UnitProgress += unit =>
+            {
+                percents[unit.Slot] = unit.Percent;
+                UIExtension.Progress(percents.Sum(), percents.Length * 100);
+            };
 
+            var units = gang.ProgramAsync(probes, image).GetAwaiter().GetResult();
+            foreach (var unit in units)
+                UIExtension.ToStatus($"\r\n[{unit.Slot}] {unit.Probe}: {unit.State} after {unit.Attempts} attempt(s), {unit.Elapsed.TotalSeconds:0.0} s",
+                    unit.State == GangState.Passed ? this.ForeColor : Color.Red);
+            int failed = units.Count(u => u.State != GangState.Passed);
+            if (failed > 0)
+                throw new Exception($"{failed} of {units.Count} unit(s) failed.");
         }
 
-        private void WriteData(byte[] data, Command_e Command)
+        /// <summary>
+        /// Provisions LoRaWAN keys from a CSV manifest on all connected probes, resuming from the manifest journal.
+        /// </summary>
+        void ProvisionKeys(string manifestPath)
         {
-            var Device = OpenSelectedProg();
-            Psoc6Programmer Programmer = new Psoc6Programmer(Device!, PSoC6Family.PSOC6ABLE2, SWJ_Interface.SWD, 4000000);
-            Programmer.Attach(AP_e.AP_CM4);
-            Programmer.TransferBlock(0x08038004, data, 0, data.Length);
-            Header_t header = new Header_t() { Command = Command, DataLength = (ushort)data.Length };
-            // Write header after data transfer to ensure data is present at PSoC before parsing
-            Programmer.WriteIO(0x08038000, header.Value);
-            WaitResponse(Programmer);
-        }
+            var probes = dap.Enumerate().Where(d => !d.IsUnverified).ToList();
+            if (probes.Count == 0)
+                throw new Exception("No CMSIS-DAP device found.");
 
-        private void WriteInt32(UInt32 data, Command_e Command)
-        {
-            var Device = OpenSelectedProg();
-            Psoc6Programmer Programmer = new Psoc6Programmer(Device!, PSoC6Family.PSOC6ABLE2, SWJ_Interface.SWD, 4000000);
-            Programmer.Attach(AP_e.AP_CM4);
-            Programmer.WriteIO(0x08038004, data);
-            Header_t header = new Header_t() { Command = Command, DataLength = 4 };
-            // Write header after data transfer to ensure data is present at PSoC before parsing
-            Programmer.WriteIO(0x08038000, header.Value);
-            WaitResponse(Programmer);
+            _programmer?.Dispose();
+            _programmer = null;
+            _selectedDevice = null;
+
+            var manifest = KeyManifest.Load(manifestPath);
+            using var journal = new ProvisioningJournal(manifestPath + ".journal");
+            UIExtension.ToStatus($"\r\nManifest {Path.GetFileName(manifestPath)}: {manifest.Count} device(s), {journal.DoneCount} provisioned before");
+
+            var provisioner = new KeyProvisioner(manifest, journal);
+            provisioner.Gang.Profiles = _probeProfiles;
+            provisioner.Gang.UnitChanged += unit =>
+            {
+                if (unit.State != GangState.Running || unit.Step != null)
+                    UIExtension.ToStatus($"\r\n{unit}", unit.State == GangState.Failed ? Color.Red : this.ForeColor);
+            };
+
+            var results = provisioner.ProvisionAsync(probes).GetAwaiter().GetResult();
+            foreach (var result in results)
+                UIExtension.ToStatus($"\r\n[{result.Unit.Slot}] DevEUI {result.DevEui ?? "?"}: {result.Outcome}",
+                    result.Outcome is ProvisionOutcome.Provisioned or ProvisionOutcome.AlreadyProvisioned ? this.ForeColor : Color.Red);
+            int failed = results.Count(r => r.Outcome is not (ProvisionOutcome.Provisioned or ProvisionOutcome.AlreadyProvisioned));
+            if (failed > 0)
+                throw new Exception($"{failed} of {results.Count} board(s) not provisioned.");
         }
 
-        private byte[] ReadData(Command_e Command, int length)
+        /// <summary>
+        /// Creates a programmer at the SWD clock stored for the probe, adaptive clock steps are stored back.
+        /// </summary>
+        private Psoc6Programmer CreateProgrammer(CmsisDap.Device device)
         {
-            var Device = OpenSelectedProg();
-            Psoc6Programmer Programmer = new Psoc6Programmer(Device!, PSoC6Family.PSOC6ABLE2, SWJ_Interface.SWD, 4000000);
-            Programmer.Attach(AP_e.AP_CM4);
-            Header_t header = new Header_t() { Command = Command, Read = true, DataLength = (ushort)length };
-            Programmer.WriteIO(0x08038000, header.Value);
-            WaitResponse(Programmer);
-            return Programmer.TransferBlockRead(0x08038004, 0, length);
+            var family = PSoC6Family.PSOC6ABLE2;
+            var programmer = new Psoc6Programmer(device, family, SWJ_Interface.SWD, _probeProfiles.ClockFor(device.SerialNumber, family, DefaultSwjClock))
+            {
+                AdaptiveClock = true,
+                Profiles = _probeProfiles
+            };
+            programmer.ClockChanged += clock =>
+            {
+                _probeProfiles.UpdateClock(device.SerialNumber, family, clock);
+                UIExtension.ToStatus($"\r\nTransfer errors, SWD clock lowered to {clock / 1000000.0:0.#} MHz", Color.Orange);
+            };
+            return programmer;
         }
 
-        private UInt32 ReadInt32(Command_e Command)
+        private MailboxClient OpenMailbox()
         {
             var Device = OpenSelectedProg();
-            Psoc6Programmer Programmer = new Psoc6Programmer(Device!, PSoC6Family.PSOC6ABLE2, SWJ_Interface.SWD, 4000000);
-            Programmer.Attach(AP_e.AP_CM4);
-            Header_t header = new Header_t() { Command = Command, Read = true, DataLength = 4 };
-            Programmer.WriteIO(0x08038000, header.Value);
-            WaitResponse(Programmer);
-            return Programmer.ReadIO(0x08038004);
+            Psoc6Programmer Programmer = CreateProgrammer(Device);
+            return new MailboxClient(Programmer).Attach();
         }
 
+        private void WriteData(byte[] data, Command_e Command) => OpenMailbox().WriteData(data, Command);
+
+        private void WriteInt32(UInt32 data, Command_e Command) => OpenMailbox().WriteInt32(data, Command);
+
+        private byte[] ReadData(Command_e Command, int length) => OpenMailbox().ReadData(Command, length);
+
+        private UInt32 ReadInt32(Command_e Command) => OpenMailbox().ReadInt32(Command);
+
         /// <summary>
         /// Acquires the target and identifies silicon using SROM Call.
         /// </summary>
@@ -430,11 +502,20 @@ namespace CmsisDap_Communicator
             // -----------------------------
             UIExtension.ToStatus("\r\nAcquiring target...");
 
-            Psoc6Programmer Programmer = new Psoc6Programmer(Device!, PSoC6Family.PSOC6ABLE2, SWJ_Interface.SWD, 4000000);
+            Psoc6Programmer Programmer = CreateProgrammer(Device);
             Programmer.Acquire(AcquireMode.ACQ_RESET, false, AP_e.AP_CM4);
 
             UIExtension.ToStatus("\r\nTarget acquired successfully.");
 
+            // First acquire with this probe: find the highest reliable SWD clock
+            if (_probeProfiles.Find(Device.SerialNumber, PSoC6Family.PSOC6ABLE2)?.TunedClockHz is null or 0)
+            {
+                UIExtension.ToStatus("\r\nTuning SWD clock...");
+                uint clock = Programmer.TuneClock();
+                _probeProfiles.UpdateClock(Device.SerialNumber, PSoC6Family.PSOC6ABLE2, clock, true);
+            }
+            UIExtension.ToStatus($"\r\nSWD clock: {Programmer.SwjClockSpeed / 1000000.0:0.#} MHz");
+
             // -----------------------------
             // Read PSoC6 Info
             // -----------------------------
@@ -0,0 +1,98 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Tests
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - Runs the tests against the simulated probe, no hardware needed
+// - Prints one line per test and exits with 1 when a test failed
+//
+// Usage:
+//   DapTests [filter]
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+namespace CmsisDap_Communicator
+{
+    internal static class Program
+    {
+        static int Main(string[] args)
+        {
+            string? filter = args.FirstOrDefault();
+            int passed = 0, failed = 0;
+            foreach (var (name, test) in SimulatedProbeTests.All)
+            {
+                if (filter != null && !name.Contains(filter, StringComparison.OrdinalIgnoreCase)) continue;
+                try
+                {
+                    test();
+                    passed++;
+                    Console.WriteLine($"PASS {name}");
+                }
+                catch (Exception ex)
+                {
+                    failed++;
+                    Console.WriteLine($"FAIL {name}: {ex.Message}");
+                }
+            }
+            Console.WriteLine($"{passed} passed, {failed} failed.");
+            return failed > 0 ? 1 : 0;
+        }
+    }
+
+    /// <summary>Thrown by a failing check.</summary>
+    public class TestFailedException : Exception
+    {
+        public TestFailedException(string message) : base(message)
+        {
+        }
+    }
+
+    internal static class Assert
+    {
+        public static void True(bool condition, string message)
+        {
+            if (!condition) throw new TestFailedException(message);
+        }
+
+        public static void Equal<T>(T expected, T actual, string what)
+        {
+            if (!EqualityComparer<T>.Default.Equals(expected, actual))
+                throw new TestFailedException($"{what}: expected {expected}, got {actual}.");
+        }
+
+        public static void Bytes(byte[] expected, byte[] actual, string what)
+        {
+            if (expected.Length != actual.Length)
+                throw new TestFailedException($"{what}: expected {expected.Length} bytes, got {actual.Length}.");
+            for (int i = 0; i < expected.Length; i++)
+                if (expected[i] != actual[i])
+                    throw new TestFailedException($"{what}: byte {i} is 0x{actual[i]:X2}, expected 0x{expected[i]:X2}.");
+        }
+
+        public static void Throws<T>(Action action, string what) where T : Exception
+        {
+            try
+            {
+                action();
+            }
+            catch (T)
+            {
+                return;
+            }
+            throw new TestFailedException($"{what}: no {typeof(T).Name} thrown.");
+        }
+    }
+}
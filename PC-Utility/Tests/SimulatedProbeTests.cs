@@ -0,0 +1,287 @@
+﻿// **********************************************************************
+//     PSoC6 CMSIS-DAP Programmer - Simulated Probe Tests
+// ______________________________________________________________________
+//
+// Copyright (c) 2025 Rolf Nooteboom
+// SPDX-License-Identifier: AGPL-3.0-or-later WITH additional terms
+//
+// Licensed under the GNU Affero General Public License v3.0 or later (AGPL-3.0)
+// with the following modifications:
+// - This software may be used **only for non-commercial purposes**.
+// - All derivative works must be shared under the same license and
+//   must be reported back to the original author (Rolf Nooteboom).
+// - The original copyright, license, and attribution notices must be retained.
+//
+// Description:
+// - DAP_Transfer WAIT and FAULT responses and the programmer's recovery
+// - DAP_TransferBlock writes and reads across the 1 KB TAR auto increment wrap
+// - LoRaWAN key commit and key-value store round trips through the mailbox
+//
+//  Author: Rolf Nooteboom <rolf@nooteboom-elektronica.com>
+//  Created: 2025
+//
+// **********************************************************************
+
+using static CmsisDap_Communicator.DataPacket;
+
+namespace CmsisDap_Communicator
+{
+    internal static class SimulatedProbeTests
+    {
+        private const byte ACK_OK = 0x01;
+        private const byte ACK_WAIT = 0x02;
+        private const byte ACK_FAULT = 0x04;
+
+        public static IEnumerable<(string Name, Action Run)> All => new (string, Action)[]
+        {
+            (nameof(TransferWait), TransferWait),
+            (nameof(TransferWaitRecovered), TransferWaitRecovered),
+            (nameof(TransferWaitAbort), TransferWaitAbort),
+            (nameof(TransferFault), TransferFault),
+            (nameof(TransferFaultRecovered), TransferFaultRecovered),
+            (nameof(StatisticsCountPacked), StatisticsCountPacked),
+            (nameof(TarAutoIncrementWraps), TarAutoIncrementWraps),
+            (nameof(BlockAcrossTarWrap), BlockAcrossTarWrap),
+            (nameof(KeysCommit), KeysCommit),
+            (nameof(KvRoundTrip), KvRoundTrip),
+            (nameof(KvReadPages), KvReadPages),
+        };
+
+        /// <summary>Simulated probe with a programmer attached to the CM4 AP.</summary>
+        private sealed class Fixture : IDisposable
+        {
+            public SimulatedProbe Probe { get; } = new SimulatedProbe();
+            public CmsisDap.Device Device { get; }
+            public Psoc6Programmer Programmer { get; }
+            public PSoCclass PSoC { get; } = PSoC6Family.PSOC6ABLE2.Create();
+            public uint Scratch => PSoC.SRAM_SCRATCH_ADDR + 0x1000;            // Clear of the SROM parameter block.
+
+            public Fixture()
+            {
+                Device = new CmsisDap.Device(Probe);
+                Programmer = new Psoc6Programmer(Device, PSoC6Family.PSOC6ABLE2);
+                Programmer.Attach(AP_e.AP_CM4);
+            }
+
+            public long Recoveries(DapRecovery step) => Device.Statistics.Snapshot().Recoveries[(int)step];
+
+            public void Dispose() => Device.Dispose();
+        }
+
+        /// <summary>A WAIT stops the DAP_Transfer at the waiting transfer, the transfers before it are executed.</summary>
+        private static void TransferWait()
+        {
+            using var f = new Fixture();
+            f.Probe.WaitAccesses = 1;
+            byte[] response = f.Device.Transfer(0x00,
+                (DapReg.Write.SELECT, (uint)AP_e.AP_CM4 << 24),
+                (DapReg.Write.TAR, f.Scratch),
+                (DapReg.Write.DRW, 0x12345678));
+            Assert.Equal(1, (int)response[1], "Executed transfers");
+            Assert.Equal(ACK_WAIT, response[2], "ACK");
+
+            response = f.Device.Transfer(0x00, (DapReg.Write.TAR, f.Scratch), (DapReg.Write.DRW, 0x12345678));
+            Assert.Equal(2, (int)response[1], "Executed transfers after the WAIT");
+            Assert.Equal(ACK_OK, response[2], "ACK after the WAIT");
+            Assert.Equal(0x12345678u, BitConverter.ToUInt32(f.Probe.Target.ReadMemory(f.Scratch, 4)), "Written word");
+        }
+
+        /// <summary>WAIT responses within WaitRetries are resent without further recovery.</summary>
+        private static void TransferWaitRecovered()
+        {
+            using var f = new Fixture();
+            f.Probe.WaitAccesses = f.Programmer.WaitRetries;
+            f.Programmer.WriteIO(f.Scratch, 0xCAFEF00D);
+            Assert.Equal(0xCAFEF00Du, f.Programmer.ReadIO(f.Scratch), "ReadIO");
+            Assert.Equal((long)f.Programmer.WaitRetries, f.Recoveries(DapRecovery.WaitRetry), "WAIT retries");
+            Assert.Equal(0L, f.Recoveries(DapRecovery.Abort), "ABORTs");
+            Assert.Equal(0L, f.Recoveries(DapRecovery.Handshake), "Handshakes");
+        }
+
+        /// <summary>A target that keeps answering WAIT is aborted, then the transfer is repeated.</summary>
+        private static void TransferWaitAbort()
+        {
+            using var f = new Fixture();
+            f.Probe.WaitAccesses = f.Programmer.WaitRetries + 1;
+            f.Programmer.WriteIO(f.Scratch, 0x0BADBEEF);
+            Assert.Equal(0x0BADBEEFu, BitConverter.ToUInt32(f.Probe.Target.ReadMemory(f.Scratch, 4)), "Written word");
+            Assert.Equal((long)f.Programmer.WaitRetries, f.Recoveries(DapRecovery.WaitRetry), "WAIT retries");
+            Assert.Equal(1L, f.Recoveries(DapRecovery.Abort), "ABORTs");
+        }
+
+        /// <summary>A FAULT sets the sticky error: every later AP access faults until ABORT clears it.</summary>
+        private static void TransferFault()
+        {
+            using var f = new Fixture();
+            byte[] response = f.Device.Transfer(0x00,
+                (DapReg.Write.SELECT, 3u << 24),                                // AP 3 does not exist.
+                (DapReg.Read.CSW, null));
+            Assert.Equal(1, (int)response[1], "Executed transfers");
+            Assert.Equal(ACK_FAULT, response[2], "ACK");
+
+            response = f.Device.Transfer(0x00, (DapReg.Write.SELECT, (uint)AP_e.AP_CM4 << 24), (DapReg.Read.CSW, null));
+            Assert.Equal(ACK_FAULT, response[2], "ACK with the sticky error set");
+            response = f.Device.Transfer(0x00, (DapReg.Read.CTRLSTAT, null));
+            Assert.True((BitConverter.ToUInt32(response, 3) & 0x20) != 0, "STICKYERR not set in CTRL/STAT.");
+
+            f.Device.WriteAbort(0x0000001E);
+            response = f.Device.Transfer(0x00, (DapReg.Read.CSW, null));
+            Assert.Equal(ACK_OK, response[2], "ACK after ABORT");
+        }
+
+        /// <summary>The programmer clears a sticky error, reselects its AP and repeats the transfer.</summary>
+        private static void TransferFaultRecovered()
+        {
+            using var f = new Fixture();
+            f.Programmer.WriteIO(f.Scratch, 0x5A5A5A5A);
+            f.Device.Transfer(0x00, (DapReg.Write.SELECT, 3u << 24), (DapReg.Read.CSW, null));
+            Assert.Equal(0x5A5A5A5Au, f.Programmer.ReadIO(f.Scratch), "ReadIO");
+            Assert.Equal(1L, f.Recoveries(DapRecovery.Abort), "ABORTs");
+            Assert.Equal(0L, f.Recoveries(DapRecovery.Handshake), "Handshakes");
+        }
+
+        /// <summary>Commands packed in DAP_ExecuteCommands are counted under their own ID, the packet under DAP_ExecuteCommands.</summary>
+        private static void StatisticsCountPacked()
+        {
+            using var f = new Fixture();
+            f.Device.Statistics.Reset();
+            var responses = f.Device.Execute(new CmsisDap.CommandBatch()
+                .Add(CmsisDap.WriteAbort(0x0000001E))
+                .Add(CmsisDap.Transfer(0x00, (DapReg.Write.TAR, f.Scratch), (DapReg.Write.DRW, 1)))
+                .Add(CmsisDap.Transfer(0x00, (DapReg.Read.RDBUFF, null))));
+            Assert.Equal(3, responses.Count, "Responses");
+
+            var snapshot = f.Device.Statistics.Snapshot();
+            var execute = snapshot.Commands.Single(c => c.CommandId == CmsisDap.CMD_DAP_EXECUTE_COMMANDS);
+            var abort = snapshot.Commands.Single(c => c.CommandId == CmsisDap.CMD_DAP_WRITE_ABORT);
+            var transfer = snapshot.Commands.Single(c => c.CommandId == CmsisDap.CMD_DAP_TFER);
+            Assert.Equal(1L, execute.Packets, "DAP_ExecuteCommands packets");
+            Assert.Equal(3L, execute.Packed, "Commands carried by DAP_ExecuteCommands");
+            Assert.Equal((0L, 1L), (abort.Packets, abort.Packed), "DAP_WriteABORT packets, packed");
+            Assert.Equal((0L, 2L), (transfer.Packets, transfer.Packed), "DAP_Transfer packets, packed");
+            Assert.Equal(3L, snapshot.Executed, "Commands executed");
+            Assert.True(snapshot.ToReport().Contains("(3 commands)"), "Report does not count the packed commands.");
+        }
+
+        /// <summary>The simulated MEM-AP wraps TAR within its 1 KB window, like the silicon.</summary>
+        private static void TarAutoIncrementWraps()
+        {
+            using var f = new Fixture();
+            uint window = f.Scratch & ~0x3FFu;
+            byte[] response = f.Device.Transfer(0x00,
+                (DapReg.Write.CSW, 0x23000012),
+                (DapReg.Write.TAR, window + 0x3FC),
+                (DapReg.Write.DRW, 0x11111111),
+                (DapReg.Write.DRW, 0x22222222));
+            Assert.Equal(ACK_OK, response[2], "ACK");
+            Assert.Equal(0x11111111u, BitConverter.ToUInt32(f.Probe.Target.ReadMemory(window + 0x3FC, 4)), "Last word of the window");
+            Assert.Equal(0x22222222u, BitConverter.ToUInt32(f.Probe.Target.ReadMemory(window, 4)), "Wrapped word");
+            Assert.Equal(0u, BitConverter.ToUInt32(f.Probe.Target.ReadMemory(window + 0x400, 4)), "Word after the window");
+        }
+
+        /// <summary>Block writes and reads spanning two TAR wraps land at the right addresses.</summary>
+        private static void BlockAcrossTarWrap()
+        {
+            using var f = new Fixture();
+            uint addr = (f.Scratch & ~0x3FFu) + 0x3F4;                          // Three words before the first wrap.
+            byte[] data = new byte[0x400 + 0x40];                               // Up to past the second wrap.
+            new Random(1).NextBytes(data);
+
+            f.Programmer.TransferBlock(addr, data, 0, data.Length);
+            Assert.Bytes(data, f.Probe.Target.ReadMemory(addr, data.Length), "Target memory");
+            Assert.Equal(0u, BitConverter.ToUInt32(f.Probe.Target.ReadMemory(addr - 4, 4)), "Word before the block");
+            Assert.Equal(0u, BitConverter.ToUInt32(f.Probe.Target.ReadMemory(addr + (uint)data.Length, 4)), "Word after the block");
+
+            byte[] read = f.Programmer.TransferBlockRead(addr, 2, data.Length);
+            Assert.Bytes(data, read[2..], "TransferBlockRead");
+
+            // A read with an odd length keeps only the bytes asked for
+            read = f.Programmer.TransferBlockRead(addr + 0x0C, 0, 0x3FF);
+            Assert.Bytes(data[0x0C..(0x0C + 0x3FF)], read, "Unaligned length read");
+        }
+
+        /// <summary>Keys and a configuration blob are committed, the digests match and the keys read back.</summary>
+        private static void KeysCommit()
+        {
+            using var f = new Fixture();
+            var mailbox = new MailboxClient(f.Programmer).Attach();
+            var random = new Random(2);
+            var keys = new LoRaWAN_keys_t { flags = 0x0102, keyData = new byte[32], reserved = new byte[32] };
+            random.NextBytes(keys.keyData);
+            byte[] config = new byte[20];
+            random.NextBytes(config);
+
+            mailbox.Write(keys, Command_e.CMD_KEYS);
+            var info = mailbox.Commit(config);
+            Assert.Equal(Crc32(StructToData(keys)), info.KeysCrc, "Keys digest");
+            Assert.Equal(Crc32(config), info.ConfigCrc, "Configuration digest");
+            Assert.Equal((byte)config.Length, info.ConfigLength, "Configuration length");
+
+            var read = mailbox.Read<LoRaWAN_keys_t>(Command_e.CMD_KEYS);
+            Assert.Equal(keys.flags, read.flags, "Key flags");
+            Assert.Bytes(keys.keyData, read.keyData, "Key data");
+        }
+
+        /// <summary>Puts, overwrites and deletes, single and batched, read back per key and as a whole.</summary>
+        private static void KvRoundTrip()
+        {
+            using var f = new Fixture();
+            var store = new KvStore(new MailboxClient(f.Programmer).Attach());
+            var expected = new SortedDictionary<byte, byte[]>();
+            var random = new Random(3);
+
+            store.Put(5, new byte[] { 1, 2, 3 });
+            expected[5] = new byte[] { 1, 2, 3 };
+            Assert.Bytes(expected[5], store.Get(5) ?? Array.Empty<byte>(), "Value of key 5");
+            Assert.True(store.Get(6) == null, "Key 6 has a value.");
+
+            // One batch larger than a mailbox command: puts, an empty value and a delete
+            var batch = new List<KeyValuePair<byte, byte[]?>>();
+            for (byte key = 10; key < 20; key++)
+            {
+                byte[] value = new byte[random.Next(KvStore.MAX_VALUE + 1)];
+                random.NextBytes(value);
+                batch.Add(new(key, value));
+                expected[key] = value;
+            }
+            batch.Add(new(20, Array.Empty<byte>()));
+            expected[20] = Array.Empty<byte>();
+            batch.Add(new(5, null));
+            expected.Remove(5);
+            store.Write(batch);
+
+            store.Put(12, new byte[KvStore.MAX_VALUE]);
+            expected[12] = new byte[KvStore.MAX_VALUE];
+            store.Delete(13);
+            expected.Remove(13);
+
+            var values = store.Read();
+            Assert.Equal(string.Join(",", expected.Keys), string.Join(",", values.Keys), "Keys");
+            foreach (var (key, value) in expected)
+                Assert.Bytes(value, values[key], $"Value of key {key}");
+            Assert.Equal((byte)expected.Count, store.Info().Keys, "Key count");
+
+            Assert.Throws<ArgumentException>(() => store.Put(KvStore.KEYS, new byte[1]), "Key out of range");
+            Assert.Throws<ArgumentException>(() => store.Put(0, new byte[KvStore.MAX_VALUE + 1]), "Value too long");
+        }
+
+        /// <summary>Reading more values than fit in one mailbox response follows the cursor to the last key.</summary>
+        private static void KvReadPages()
+        {
+            using var f = new Fixture();
+            var store = new KvStore(new MailboxClient(f.Programmer).Attach());
+            var batch = Enumerable.Range(0, KvStore.KEYS)
+                .Select(key => new KeyValuePair<byte, byte[]?>((byte)key, Enumerable.Repeat((byte)key, 16).ToArray()))
+                .ToList();
+            store.Write(batch);
+
+            var values = store.Read();
+            Assert.Equal(KvStore.KEYS, values.Count, "Keys read");
+            foreach (var (key, value) in batch)
+                Assert.Bytes(value!, values[key], $"Value of key {key}");
+
+            values = store.Read(30, 33);
+            Assert.Equal("30,31,32,33", string.Join(",", values.Keys), "Keys of a range");
+        }
+    }
+}